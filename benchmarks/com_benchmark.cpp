@@ -0,0 +1,327 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// Msg::Com round trip benchmark: a view thread sends in messages to an echo logic thread which
+// answers with out messages, through the same queues, coalescing and wake ups as the player
+// (the logic drains the in queue and sleeps on it, the view sleeps on the out listener).
+// Message mixes:
+//  - playback: controls and slider drags (volume and offset, latest wins), answered by a music
+//    information
+//  - browsing: folder openings, answered by the folder content (--entries entries)
+//  - mixed: one folder opening every 16 playback messages
+// For each mix:
+//  - round trip: one message in flight, percentiles of the send to answer handling latency
+//  - pipelined: the messages are sent without waiting for the answers, throughput until the
+//    answer of an end marker (the coalesced messages have no answer)
+//
+// usage: com_benchmark [--messages count] [--entries folder_entries]
+//
+#include "model/Messages.hpp"
+#include "utils/wake_signal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	constexpr std::size_t MIXED_BROWSING_PERIOD = 16;
+	constexpr const char* END_MARKER_PATH = "end";
+
+	struct Options
+	{
+		std::size_t messages = 100000;
+		std::size_t entries = 10000;
+	};
+
+	enum class Mix
+	{
+		PLAYBACK,
+		BROWSING,
+		MIXED,
+	};
+	constexpr Mix MIXES[] = {Mix::PLAYBACK, Mix::BROWSING, Mix::MIXED};
+
+	const char* mix_name(Mix mix) noexcept
+	{
+		switch(mix)
+		{
+			case Mix::PLAYBACK:
+				return "playback";
+			case Mix::BROWSING:
+				return "browsing";
+			case Mix::MIXED:
+				break;
+		}
+		return "mixed";
+	}
+
+	std::vector<PathInfo> make_folder(std::size_t entries)
+	{
+		std::vector<PathInfo> folder(entries);
+		for(std::size_t i = 0; i < entries; ++i)
+		{
+			PathInfo& info = folder[i];
+			info.file_name = "Artist - Album - " + std::to_string(i) + " - Title.flac";
+			info.path = "/music/library/Artist/Album/" + info.file_name;
+			info.is_folder = false;
+			info.file_size = 30 * 1024 * 1024;
+			info.has_supported_audio_extension = true;
+		}
+		return folder;
+	}
+
+	// Logic::run without the player: each dispatched message is answered
+	void echo_logic(Msg::Com& com, const std::vector<PathInfo>& folder)
+	{
+		std::vector<Msg::Com::InEnvelope> messages;
+		bool end = false;
+		while(!end)
+		{
+			if(com.in.drain(messages) == 0)
+			{
+				com.in.wait();
+				continue;
+			}
+			for(Msg::Com::InEnvelope& envelope: messages)
+			{
+				com.takeLatest(envelope);
+				std::visit(
+				  [&](auto&& message) {
+					  using message_type = std::decay_t<decltype(message)>;
+					  if constexpr(std::is_same<message_type, Msg::In::Close>::value)
+					  {
+						  end = true;
+					  }
+					  else if constexpr(std::is_same<message_type, Msg::In::Open>::value)
+					  {
+						  // the logic builds a new listing for each opening
+						  com.sendOutMessage<Msg::Out::FolderContent>(message.path, folder);
+					  }
+					  else if constexpr(std::is_same<message_type, Msg::In::Enqueue>::value)
+					  {
+						  com.sendOutMessage<Msg::Out::MusicInfo>(false, 0.f);
+					  }
+					  else
+					  {
+						  com.sendOutMessage<Msg::Out::MusicInfo>(true, 180.f);
+					  }
+				  },
+				  envelope.message);
+			}
+			messages.clear();
+		}
+	}
+
+	void send(Msg::Com& com, Mix mix, std::size_t index)
+	{
+		const bool browsing =
+		  mix == Mix::BROWSING || (mix == Mix::MIXED && index % MIXED_BROWSING_PERIOD == 0);
+		if(browsing)
+		{
+			com.sendInMessage<Msg::In::Open>(utf8_path("/music/library/Artist/Album"));
+			return;
+		}
+		switch(index % 4)
+		{
+			case 0:
+				com.sendInMessage<Msg::In::Control>(Msg::In::Control::Action::PLAY);
+				break;
+			case 1:
+				com.sendInMessage<Msg::In::Volume>(false, static_cast<float>(index % 100));
+				break;
+			case 2:
+				com.sendInMessage<Msg::In::MusicOffset>(static_cast<float>(index % 180));
+				break;
+			default:
+				com.sendInMessage<Msg::In::Volume>(false, 50.f);
+				break;
+		}
+	}
+
+	// view side: out messages swapped out and destroyed, like GUI::processMessages
+	class View
+	{
+	public:
+		explicit View(Msg::Com& com): m_com(com), m_wake(std::make_shared<wake_signal>())
+		{
+			m_com.out_listener = [wake = m_wake]() {
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				wake->notify();
+			};
+		}
+
+		// return the number of answers, sets end if the end marker answer was received
+		std::size_t receive(bool& end)
+		{
+			for(;;)
+			{
+				m_com.out.swap_all(m_messages);
+				if(!m_messages.empty())
+				{
+					break;
+				}
+				const std::uint32_t token = m_wake->prepare();
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if(!m_com.out.empty())
+				{
+					m_wake->cancel();
+					continue;
+				}
+				m_wake->wait(token);
+			}
+
+			const std::size_t count = m_messages.size();
+			for(const Msg::Com::OutEnvelope& envelope: m_messages)
+			{
+				if(const auto* info = std::get_if<Msg::Out::MusicInfo>(&envelope.message))
+				{
+					end |= !info->valid;
+				}
+			}
+			m_messages.clear();
+			return count;
+		}
+
+	private:
+		Msg::Com& m_com;
+		std::shared_ptr<wake_signal> m_wake;
+		Msg::Com::OutMessages m_messages;
+	};
+
+	double percentile(std::vector<clock_type::duration>& latencies, double ratio)
+	{
+		if(latencies.empty())
+		{
+			return 0;
+		}
+		const auto rank =
+		  static_cast<std::size_t>(ratio * static_cast<double>(latencies.size() - 1));
+		std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+		return std::chrono::duration<double, std::micro>(latencies[rank]).count();
+	}
+
+	void run(const Options& options, Mix mix, const std::vector<PathInfo>& folder)
+	{
+		// Com is large (coalescing slots, playback states), not on the stack
+		auto com = std::make_unique<Msg::Com>();
+		View view(*com);
+		std::thread logic([&]() { echo_logic(*com, folder); });
+
+		// browsing round trips are long, fewer of them
+		std::size_t messages = options.messages;
+		if(mix == Mix::BROWSING)
+		{
+			messages = std::max<std::size_t>(messages / 100, 1);
+		}
+
+		std::vector<clock_type::duration> latencies;
+		latencies.reserve(messages);
+		bool end = false;
+		for(std::size_t i = 0; i < messages; ++i)
+		{
+			const clock_type::time_point sent = clock_type::now();
+			send(*com, mix, i);
+			view.receive(end);
+			latencies.push_back(clock_type::now() - sent);
+		}
+
+		const clock_type::time_point start = clock_type::now();
+		for(std::size_t i = 0; i < messages; ++i)
+		{
+			send(*com, mix, i);
+		}
+		com->sendInMessage<Msg::In::Enqueue>(utf8_path(END_MARKER_PATH));
+		std::size_t answers = 0;
+		end = false;
+		while(!end)
+		{
+			answers += view.receive(end);
+		}
+		const double duration = std::chrono::duration<double>(clock_type::now() - start).count();
+
+		com->sendInMessage<Msg::In::Close>();
+		logic.join();
+
+		std::cout << "  " << std::left << std::setw(10) << mix_name(mix) << std::right
+		          << std::setw(10) << percentile(latencies, 0.5) << std::setw(10)
+		          << percentile(latencies, 0.99) << std::setw(10) << percentile(latencies, 0.999)
+		          << std::setw(12) << static_cast<double>(messages) / duration / 1e3
+		          << std::setw(10) << answers - 1 << std::setw(10) << com->coalescedCount()
+		          << std::endl;
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if(i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << argument << std::endl;
+				return false;
+			}
+			const std::string value = argv[++i];
+			if(argument == "--messages")
+			{
+				options.messages = std::max(std::stoul(value), 1ul);
+			}
+			else if(argument == "--entries")
+			{
+				options.entries = std::stoul(value);
+			}
+			else
+			{
+				std::cerr << "Unknown option " << argument << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	try
+	{
+		if(!parse_options(argc, argv, options))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		std::cerr << "Invalid option value: " << exception.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::vector<PathInfo> folder = make_folder(options.entries);
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "round trip latency (us) and pipelined throughput, folders of " << options.entries
+	          << " entries:" << std::endl;
+	std::cout << "  " << std::left << std::setw(10) << "mix" << std::right << std::setw(10)
+	          << "p50" << std::setw(10) << "p99" << std::setw(10) << "p999" << std::setw(12)
+	          << "kmsg/s" << std::setw(10) << "answers" << std::setw(10) << "coalesced"
+	          << std::endl;
+	for(Mix mix: MIXES)
+	{
+		run(options, mix, folder);
+	}
+	return EXIT_SUCCESS;
+}
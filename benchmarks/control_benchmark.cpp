@@ -0,0 +1,379 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// Control protocol benchmark, against a player started with --headless.
+// Measures the round trip latency of single requests, the throughput of pipelined requests and
+// the duration of one batch. The requests are "state" by default, answered by the control server
+// alone, or enqueue requests of the given file, handled by the logic. On the TCP port, the
+// connection is first authenticated with the token of the token file.
+//
+// usage: control_benchmark (--socket path | --port port --token-file path) [--operations count]
+//                          [--round-trips count] [--enqueue file]
+//
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	struct Options
+	{
+		std::string socket_path;
+		std::uint16_t port = 0;
+		std::string token_path;
+		std::size_t operations = 10000;
+		std::size_t round_trips = 1000;
+		std::string enqueue;
+	};
+
+	class Connection
+	{
+	public:
+		explicit Connection(const Options& options)
+		{
+			if(!options.socket_path.empty())
+			{
+				sockaddr_un address{};
+				address.sun_family = AF_UNIX;
+				std::strncpy(
+				  address.sun_path, options.socket_path.c_str(), sizeof(address.sun_path) - 1);
+				m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+				if(m_fd >= 0
+				   && ::connect(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+				        != 0)
+				{
+					close();
+				}
+			}
+			else
+			{
+				sockaddr_in address{};
+				address.sin_family = AF_INET;
+				address.sin_port = htons(options.port);
+				address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+				m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+				const int enable = 1;
+				if(m_fd >= 0
+				   && (::setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) != 0
+				       || ::connect(
+				            m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+				            != 0))
+				{
+					close();
+				}
+			}
+		}
+
+		Connection(const Connection&) = delete;
+		Connection& operator=(const Connection&) = delete;
+
+		~Connection()
+		{
+			close();
+		}
+
+		[[nodiscard]] bool valid() const noexcept
+		{
+			return m_fd >= 0;
+		}
+
+		bool send(const std::string& data)
+		{
+			std::size_t sent = 0;
+			while(sent < data.size())
+			{
+				const ssize_t count = ::write(m_fd, data.data() + sent, data.size() - sent);
+				if(count <= 0)
+				{
+					return false;
+				}
+				sent += static_cast<std::size_t>(count);
+			}
+			return true;
+		}
+
+		// next answer line, events are skipped (the benchmark doesn't subscribe)
+		bool receive(std::string& line)
+		{
+			for(;;)
+			{
+				const std::size_t end = m_buffer.find('\n', m_start);
+				if(end != std::string::npos)
+				{
+					line.assign(m_buffer, m_start, end - m_start);
+					m_start = end + 1;
+					return true;
+				}
+				m_buffer.erase(0, m_start);
+				m_start = 0;
+				char chunk[64 * 1024];
+				const ssize_t count = ::read(m_fd, chunk, sizeof(chunk));
+				if(count <= 0)
+				{
+					return false;
+				}
+				m_buffer.append(chunk, static_cast<std::size_t>(count));
+			}
+		}
+
+	private:
+		void close()
+		{
+			if(m_fd >= 0)
+			{
+				::close(m_fd);
+				m_fd = -1;
+			}
+		}
+
+		int m_fd = -1;
+		std::string m_buffer;
+		std::size_t m_start = 0;
+	};
+
+	double elapsed_us(clock_type::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+	}
+
+	double percentile(std::vector<double> values, double ratio)
+	{
+		if(values.empty())
+		{
+			return 0;
+		}
+		const auto index = static_cast<std::size_t>(ratio * static_cast<double>(values.size() - 1));
+		std::nth_element(
+		  values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+		return values[index];
+	}
+
+	nlohmann::json make_request(const Options& options, std::size_t id)
+	{
+		if(options.enqueue.empty())
+		{
+			return {{"id", id}, {"type", "state"}};
+		}
+		return {{"id", id}, {"type", "enqueue"}, {"path", options.enqueue}};
+	}
+
+	bool check_answer(const std::string& line)
+	{
+		const nlohmann::json answer = nlohmann::json::parse(line, nullptr, false);
+		if(answer.is_discarded() || !answer.value("ok", false))
+		{
+			std::cerr << "Request failed: " << line << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool authenticate(Connection& connection, const Options& options)
+	{
+		std::ifstream file(options.token_path);
+		std::string token;
+		if(!std::getline(file, token))
+		{
+			std::cerr << "Failed to read the token file " << options.token_path << std::endl;
+			return false;
+		}
+		const std::string request =
+		  nlohmann::json{{"type", "auth"}, {"token", token}}.dump() + '\n';
+		std::string line;
+		return connection.send(request) && connection.receive(line) && check_answer(line);
+	}
+
+	bool round_trips(Connection& connection, const Options& options)
+	{
+		std::vector<double> latencies;
+		latencies.reserve(options.round_trips);
+		std::string line;
+		for(std::size_t i = 0; i < options.round_trips; ++i)
+		{
+			const std::string request = make_request(options, i).dump() + '\n';
+			const clock_type::time_point start = clock_type::now();
+			if(!connection.send(request) || !connection.receive(line) || !check_answer(line))
+			{
+				return false;
+			}
+			latencies.push_back(elapsed_us(start));
+		}
+		std::cout << "round trip: p50 " << percentile(latencies, 0.5) << "us, p99 "
+		          << percentile(latencies, 0.99) << "us, max "
+		          << *std::max_element(latencies.cbegin(), latencies.cend()) << "us" << std::endl;
+		return true;
+	}
+
+	bool pipelined(Connection& connection, const Options& options)
+	{
+		std::string requests;
+		for(std::size_t i = 0; i < options.operations; ++i)
+		{
+			requests += make_request(options, i).dump();
+			requests += '\n';
+		}
+		const clock_type::time_point start = clock_type::now();
+		if(!connection.send(requests))
+		{
+			return false;
+		}
+		std::string line;
+		for(std::size_t i = 0; i < options.operations; ++i)
+		{
+			if(!connection.receive(line) || !check_answer(line))
+			{
+				return false;
+			}
+		}
+		const double duration_us = elapsed_us(start);
+		std::cout << "pipelined: " << options.operations << " requests in " << duration_us / 1000
+		          << "ms, " << static_cast<double>(options.operations) / duration_us * 1e6
+		          << " requests/s" << std::endl;
+		return true;
+	}
+
+	bool batch(Connection& connection, const Options& options)
+	{
+		nlohmann::json requests = nlohmann::json::array();
+		for(std::size_t i = 0; i < options.operations; ++i)
+		{
+			requests.push_back(make_request(options, i));
+		}
+		const std::string request =
+		  nlohmann::json{{"type", "batch"}, {"requests", std::move(requests)}}.dump() + '\n';
+
+		const clock_type::time_point start = clock_type::now();
+		std::string line;
+		if(!connection.send(request) || !connection.receive(line))
+		{
+			return false;
+		}
+		const double duration_us = elapsed_us(start);
+		const nlohmann::json answer = nlohmann::json::parse(line, nullptr, false);
+		const auto results = answer.find("results");
+		if(answer.is_discarded() || results == answer.end()
+		   || results->size() != options.operations)
+		{
+			std::cerr << "Invalid batch answer" << std::endl;
+			return false;
+		}
+		std::cout << "batch: " << options.operations << " operations in " << duration_us / 1000
+		          << "ms (" << request.size() / 1024 << "KiB request)" << std::endl;
+		return true;
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if(i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << argument << std::endl;
+				return false;
+			}
+			const std::string value = argv[++i];
+			if(argument == "--socket")
+			{
+				options.socket_path = value;
+			}
+			else if(argument == "--port")
+			{
+				options.port = static_cast<std::uint16_t>(std::stoul(value));
+			}
+			else if(argument == "--token-file")
+			{
+				options.token_path = value;
+			}
+			else if(argument == "--operations")
+			{
+				options.operations = std::max(std::stoul(value), 1ul);
+			}
+			else if(argument == "--round-trips")
+			{
+				options.round_trips = std::max(std::stoul(value), 1ul);
+			}
+			else if(argument == "--enqueue")
+			{
+				options.enqueue = value;
+			}
+			else
+			{
+				std::cerr << "Unknown option " << argument << std::endl;
+				return false;
+			}
+		}
+		if(options.socket_path.empty() == (options.port == 0))
+		{
+			std::cerr << "Either a socket path or a port is needed" << std::endl;
+			return false;
+		}
+		if(options.port != 0 && options.token_path.empty())
+		{
+			std::cerr << "A token file is needed with a port" << std::endl;
+			return false;
+		}
+		return true;
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	try
+	{
+		if(!parse_options(argc, argv, options))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		std::cerr << "Invalid option value: " << exception.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Connection connection(options);
+	if(!connection.valid())
+	{
+		std::cerr << "Failed to connect: " << std::strerror(errno) << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if(options.port != 0 && !authenticate(connection, options))
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	if(!round_trips(connection, options) || !pipelined(connection, options)
+	   || !batch(connection, options))
+	{
+		std::cerr << "Connection lost" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
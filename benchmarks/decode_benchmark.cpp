@@ -0,0 +1,536 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// Decode benchmark of the registered audio readers.
+// A corpus of sine sweeps is generated (WAV 16/24/float, FLAC, Vorbis, mono and stereo), files
+// of an optional corpus folder are added (MP3 can't be generated), then each file is decoded:
+// time to first sample, int16 and float throughput, seek latency percentiles and C++ heap
+// allocations. Results are written as JSON and compared to a previous run if given.
+//
+// usage: decode_benchmark [--corpus folder] [--output results.json] [--baseline previous.json]
+//                         [--duration seconds] [--repeat count] [--seeks count]
+//
+#include "audio/AudioFile.hpp"
+#include "audio/decoders/Registry.hpp"
+#include "utils/path_utils.hpp"
+
+#include "MappedFileInputStream.hpp"
+
+#include <SFML/Audio/OutputSoundFile.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	std::atomic<std::uint64_t> allocations{0};
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if(void* pointer = std::malloc(size == 0 ? 1 : size))
+	{
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	constexpr unsigned int SAMPLE_RATE = 44100;
+	constexpr double SWEEP_START_HZ = 20;
+	constexpr double SWEEP_END_HZ = 20000;
+	constexpr double SWEEP_AMPLITUDE = 0.5;
+	constexpr double PI = 3.14159265358979323846;
+
+	constexpr std::size_t READ_FRAMES = 4096;
+	constexpr std::size_t SEEK_READ_FRAMES = 1024;
+	constexpr std::uint32_t SEEK_SEED = 42;
+
+	struct Options
+	{
+		std::filesystem::path corpus;
+		std::filesystem::path output = "decode_benchmark.json";
+		std::filesystem::path baseline;
+		double duration_seconds = 30;
+		unsigned int repeat = 3;
+		unsigned int seeks = 200;
+	};
+
+	enum class WavEncoding
+	{
+		S16,
+		S24,
+		F32,
+	};
+
+	struct Result
+	{
+		std::string name;
+		std::string format;
+		unsigned int channels = 0;
+		unsigned int sample_rate = 0;
+		double duration_seconds = 0;
+		double file_megabytes = 0;
+		double first_sample_us = 0;
+		double int16_megabytes_per_second = 0;
+		double float_megabytes_per_second = 0;
+		double realtime_factor = 0;
+		double seek_p50_us = 0;
+		double seek_p90_us = 0;
+		double seek_p99_us = 0;
+		double seek_max_us = 0;
+		double allocations_per_second = 0;
+	};
+
+	double elapsed_us(clock_type::time_point begin, clock_type::time_point end) noexcept
+	{
+		return std::chrono::duration<double, std::micro>(end - begin).count();
+	}
+
+	// logarithmic sweep, the channels are shifted in phase
+	std::vector<float> sine_sweep(double duration_seconds, unsigned int channels)
+	{
+		const auto frames = static_cast<std::size_t>(duration_seconds * SAMPLE_RATE);
+		const double ratio = std::log(SWEEP_END_HZ / SWEEP_START_HZ);
+		std::vector<float> samples(frames * channels);
+		for(std::size_t frame = 0; frame < frames; ++frame)
+		{
+			const double t = static_cast<double>(frame) / SAMPLE_RATE;
+			const double phase = 2 * PI * SWEEP_START_HZ * duration_seconds / ratio
+			                     * (std::exp(t / duration_seconds * ratio) - 1);
+			for(unsigned int channel = 0; channel < channels; ++channel)
+			{
+				samples[frame * channels + channel] =
+				  static_cast<float>(SWEEP_AMPLITUDE * std::sin(phase + channel * PI / 2));
+			}
+		}
+		return samples;
+	}
+
+	std::vector<sf::Int16> to_int16(const std::vector<float>& samples)
+	{
+		std::vector<sf::Int16> output(samples.size());
+		std::transform(samples.cbegin(), samples.cend(), output.begin(), [](float sample) {
+			return static_cast<sf::Int16>(std::lround(sample * 32767));
+		});
+		return output;
+	}
+
+	void write_le(std::ofstream& stream, std::uint32_t value, unsigned int bytes)
+	{
+		for(unsigned int i = 0; i < bytes; ++i)
+		{
+			stream.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+		}
+	}
+
+	// SFML only writes 16 bits WAV files
+	bool write_wav(const std::filesystem::path& path,
+	               const std::vector<float>& samples,
+	               unsigned int channels,
+	               WavEncoding encoding)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		if(!stream)
+		{
+			return false;
+		}
+		const unsigned int bytes =
+		  encoding == WavEncoding::S16 ? 2 : encoding == WavEncoding::S24 ? 3 : 4;
+		const auto data_size = static_cast<std::uint32_t>(samples.size() * bytes);
+		stream.write("RIFF", 4);
+		write_le(stream, 36 + data_size, 4);
+		stream.write("WAVEfmt ", 8);
+		write_le(stream, 16, 4);
+		write_le(stream, encoding == WavEncoding::F32 ? 3 : 1, 2);
+		write_le(stream, channels, 2);
+		write_le(stream, SAMPLE_RATE, 4);
+		write_le(stream, SAMPLE_RATE * channels * bytes, 4);
+		write_le(stream, channels * bytes, 2);
+		write_le(stream, bytes * 8, 2);
+		stream.write("data", 4);
+		write_le(stream, data_size, 4);
+		for(float sample: samples)
+		{
+			switch(encoding)
+			{
+				case WavEncoding::S16:
+					write_le(stream, static_cast<std::uint32_t>(std::lround(sample * 32767)), 2);
+					break;
+				case WavEncoding::S24:
+					write_le(stream, static_cast<std::uint32_t>(std::lround(sample * 8388607)), 3);
+					break;
+				case WavEncoding::F32:
+				{
+					std::uint32_t bits;
+					static_assert(sizeof(bits) == sizeof(sample));
+					std::memcpy(&bits, &sample, sizeof(bits));
+					write_le(stream, bits, 4);
+					break;
+				}
+			}
+		}
+		return static_cast<bool>(stream);
+	}
+
+	// FLAC and Vorbis through the SFML writers (Vorbis is VBR)
+	bool write_sfml(const std::filesystem::path& path,
+	                const std::vector<float>& samples,
+	                unsigned int channels)
+	{
+		sf::OutputSoundFile file;
+		if(!file.openFromFile(path.string(), SAMPLE_RATE, channels))
+		{
+			return false;
+		}
+		const std::vector<sf::Int16> int16_samples = to_int16(samples);
+		file.write(int16_samples.data(), int16_samples.size());
+		return true;
+	}
+
+	std::vector<std::filesystem::path> generate_corpus(const std::filesystem::path& folder,
+	                                                   double duration_seconds)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(folder, error);
+
+		std::vector<std::filesystem::path> files;
+		for(unsigned int channels: {1u, 2u})
+		{
+			const std::vector<float> sweep = sine_sweep(duration_seconds, channels);
+			const std::string suffix = channels == 1 ? "_mono" : "_stereo";
+
+			const std::pair<const char*, WavEncoding> wav_files[] = {{"wav_s16", WavEncoding::S16},
+			                                                         {"wav_s24", WavEncoding::S24},
+			                                                         {"wav_f32", WavEncoding::F32}};
+			for(const auto& [name, encoding]: wav_files)
+			{
+				const std::filesystem::path path = folder / (name + suffix + ".wav");
+				if(write_wav(path, sweep, channels, encoding))
+				{
+					files.push_back(path);
+				}
+			}
+			for(const char* name: {"flac", "vorbis"})
+			{
+				const char* extension = name == std::string("flac") ? ".flac" : ".ogg";
+				const std::filesystem::path path = folder / (name + suffix + extension);
+				if(write_sfml(path, sweep, channels))
+				{
+					files.push_back(path);
+				}
+			}
+		}
+		return files;
+	}
+
+	double percentile(std::vector<double> values, double ratio)
+	{
+		if(values.empty())
+		{
+			return 0;
+		}
+		const auto index =
+		  std::min(static_cast<std::size_t>(ratio * values.size()), values.size() - 1);
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+
+	template<typename Sample>
+	double decode_seconds(audio::AudioFile& file, std::vector<Sample>& buffer)
+	{
+		file.seekFrame(0);
+		const auto begin = clock_type::now();
+		while(file.read(buffer.data(), buffer.size()) != 0)
+		{
+		}
+		return std::chrono::duration<double>(clock_type::now() - begin).count();
+	}
+
+	bool benchmark(const std::filesystem::path& path, const Options& options, Result& result)
+	{
+		const utf8_path file_path(path);
+		const auto open_begin = clock_type::now();
+		MappedFileInputStream stream;
+		audio::AudioFile file;
+		if(!stream.open(file_path.str_cref()) || !file.openFromStream(stream))
+		{
+			return false;
+		}
+		const unsigned int channels = file.getChannelCount();
+		std::vector<sf::Int16> int16_buffer(READ_FRAMES * channels);
+		file.read(int16_buffer.data(), int16_buffer.size());
+		result.first_sample_us = elapsed_us(open_begin, clock_type::now());
+
+		std::ostringstream format;
+		format << file.getFormat();
+		result.name = path.filename().string();
+		result.format = format.str();
+		result.channels = channels;
+		result.sample_rate = file.getSampleRate();
+		result.duration_seconds = file.getDuration().asSeconds();
+		result.file_megabytes = static_cast<double>(stream.getSize()) / (1 << 20);
+
+		// best of the runs, decoded size in 16 bits samples for both
+		std::vector<float> float_buffer(int16_buffer.size());
+		const double decoded_megabytes =
+		  static_cast<double>(file.getSampleCount() * sizeof(sf::Int16)) / (1 << 20);
+		double int16_seconds = std::numeric_limits<double>::max();
+		double float_seconds = std::numeric_limits<double>::max();
+		const std::uint64_t allocations_begin = allocations.load(std::memory_order_relaxed);
+		double total_seconds = 0;
+		for(unsigned int run = 0; run < options.repeat; ++run)
+		{
+			const double int16_run = decode_seconds(file, int16_buffer);
+			const double float_run = decode_seconds(file, float_buffer);
+			int16_seconds = std::min(int16_seconds, int16_run);
+			float_seconds = std::min(float_seconds, float_run);
+			total_seconds += int16_run + float_run;
+		}
+		const std::uint64_t run_allocations =
+		  allocations.load(std::memory_order_relaxed) - allocations_begin;
+		result.int16_megabytes_per_second = decoded_megabytes / int16_seconds;
+		result.float_megabytes_per_second = decoded_megabytes / float_seconds;
+		result.realtime_factor = result.duration_seconds / int16_seconds;
+		result.allocations_per_second =
+		  total_seconds > 0 ? static_cast<double>(run_allocations) / total_seconds : 0;
+
+		// random seeks, each followed by the read of the first samples
+		std::mt19937 random(SEEK_SEED);
+		std::uniform_int_distribution<sf::Uint64> frames(
+		  0, std::max<sf::Uint64>(file.getFrameCount(), 1) - 1);
+		std::vector<double> seeks;
+		seeks.reserve(options.seeks);
+		for(unsigned int i = 0; i < options.seeks; ++i)
+		{
+			const sf::Uint64 frame = frames(random);
+			const auto begin = clock_type::now();
+			file.seekFrame(frame);
+			file.read(int16_buffer.data(), SEEK_READ_FRAMES * channels);
+			seeks.push_back(elapsed_us(begin, clock_type::now()));
+		}
+		result.seek_p50_us = percentile(seeks, 0.5);
+		result.seek_p90_us = percentile(seeks, 0.9);
+		result.seek_p99_us = percentile(seeks, 0.99);
+		result.seek_max_us = percentile(seeks, 1);
+		return true;
+	}
+
+	nlohmann::json to_json(const Result& result)
+	{
+		return {{"name", result.name},
+		        {"format", result.format},
+		        {"channels", result.channels},
+		        {"sample_rate", result.sample_rate},
+		        {"duration_seconds", result.duration_seconds},
+		        {"file_megabytes", result.file_megabytes},
+		        {"first_sample_us", result.first_sample_us},
+		        {"int16_megabytes_per_second", result.int16_megabytes_per_second},
+		        {"float_megabytes_per_second", result.float_megabytes_per_second},
+		        {"realtime_factor", result.realtime_factor},
+		        {"seek_p50_us", result.seek_p50_us},
+		        {"seek_p90_us", result.seek_p90_us},
+		        {"seek_p99_us", result.seek_p99_us},
+		        {"seek_max_us", result.seek_max_us},
+		        {"allocations_per_second", result.allocations_per_second}};
+	}
+
+	std::string change(double value, const nlohmann::json& baseline, const char* key)
+	{
+		const auto it = baseline.find(key);
+		if(it == baseline.end() || !it->is_number() || it->get<double>() == 0)
+		{
+			return "";
+		}
+		std::ostringstream os;
+		os << std::showpos << std::fixed << std::setprecision(1)
+		   << (value / it->get<double>() - 1) * 100 << "%";
+		return " (" + os.str() + ")";
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if(i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << argument << std::endl;
+				return false;
+			}
+			const std::string value = argv[++i];
+			if(argument == "--corpus")
+			{
+				options.corpus = value;
+			}
+			else if(argument == "--output")
+			{
+				options.output = value;
+			}
+			else if(argument == "--baseline")
+			{
+				options.baseline = value;
+			}
+			else if(argument == "--duration")
+			{
+				options.duration_seconds = std::max(std::stod(value), 1.0);
+			}
+			else if(argument == "--repeat")
+			{
+				options.repeat = std::max(std::stoul(value), 1ul);
+			}
+			else if(argument == "--seeks")
+			{
+				options.seeks = static_cast<unsigned int>(std::stoul(value));
+			}
+			else
+			{
+				std::cerr << "Unknown option " << argument << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	try
+	{
+		if(!parse_options(argc, argv, options))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		std::cerr << "Invalid option value: " << exception.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::filesystem::path generated =
+	  std::filesystem::temp_directory_path() / "magicplayer_decode_benchmark";
+	std::cout << "Generating " << options.duration_seconds << "s sweeps in " << generated
+	          << std::endl;
+	std::vector<std::filesystem::path> files = generate_corpus(generated, options.duration_seconds);
+	if(!options.corpus.empty())
+	{
+		std::error_code error;
+		for(const auto& entry: std::filesystem::recursive_directory_iterator(options.corpus, error))
+		{
+			if(entry.is_regular_file(error)
+			   && audio::decoders::Registry::get().probe(utf8_path(entry.path()))
+			        != audio::decoders::Format::UNKNOWN)
+			{
+				files.push_back(entry.path());
+			}
+		}
+	}
+
+	nlohmann::json baseline_results = nlohmann::json::object();
+	if(!options.baseline.empty())
+	{
+		std::ifstream baseline_stream(options.baseline);
+		const nlohmann::json baseline = nlohmann::json::parse(baseline_stream, nullptr, false);
+		if(baseline.is_object() && baseline.count("results") != 0)
+		{
+			for(const nlohmann::json& result: baseline["results"])
+			{
+				baseline_results[result.value("name", "")] = result;
+			}
+		}
+		else
+		{
+			std::cerr << "Invalid baseline " << options.baseline << std::endl;
+		}
+	}
+
+	nlohmann::json results = nlohmann::json::array();
+	std::cout << std::fixed << std::setprecision(1);
+	for(const std::filesystem::path& path: files)
+	{
+		Result result;
+		if(!benchmark(path, options, result))
+		{
+			std::cerr << "Failed to decode " << path << std::endl;
+			continue;
+		}
+		const nlohmann::json previous =
+		  baseline_results.value(result.name, nlohmann::json::object());
+		std::cout << result.name << " [" << result.format << ", " << result.channels << "ch]\n"
+		          << "  first sample " << result.first_sample_us << "us"
+		          << change(result.first_sample_us, previous, "first_sample_us") << "\n"
+		          << "  decode int16 " << result.int16_megabytes_per_second << "MB/s"
+		          << change(
+		               result.int16_megabytes_per_second, previous, "int16_megabytes_per_second")
+		          << ", float " << result.float_megabytes_per_second << "MB/s"
+		          << change(
+		               result.float_megabytes_per_second, previous, "float_megabytes_per_second")
+		          << ", " << result.realtime_factor << "x real time\n"
+		          << "  seek p50 " << result.seek_p50_us << "us"
+		          << change(result.seek_p50_us, previous, "seek_p50_us") << ", p90 "
+		          << result.seek_p90_us << "us, p99 " << result.seek_p99_us << "us, max "
+		          << result.seek_max_us << "us\n"
+		          << "  " << result.allocations_per_second << " allocations/s" << std::endl;
+		results.push_back(to_json(result));
+	}
+
+	nlohmann::json output = {
+#if defined(__VERSION__)
+	  {"compiler", __VERSION__},
+#endif
+#if defined(NDEBUG)
+	  {"assertions", false},
+#else
+	  {"assertions", true},
+#endif
+	  {"duration_seconds", options.duration_seconds},
+	  {"repeat", options.repeat},
+	  {"seeks", options.seeks},
+	  {"results", std::move(results)}};
+	std::ofstream output_stream(options.output);
+	output_stream << std::setw(1) << std::setfill('\t') << output << std::endl;
+	if(!output_stream)
+	{
+		std::cerr << "Failed to write " << options.output << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Results written to " << options.output << std::endl;
+	return EXIT_SUCCESS;
+}
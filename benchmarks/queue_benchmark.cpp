@@ -0,0 +1,230 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// shared_queue contention benchmark: producer threads post to one consumer thread, like the view,
+// the control server and the background tasks posting to the logic. Compares the mutex queues
+// (atomic_size false and true) and the lock-free MPSC queue, in three cases:
+//  - saturated: the producers post continuously
+//  - bursts: the producers post bursts of messages separated by pauses (scan progress)
+//  - oversubscribed: saturated, with more producers than hardware threads, the consumer and the
+//    lock holders are preempted
+// The throughput is measured with the enqueue to dequeue latency percentiles, sampled on one
+// message out of LATENCY_SAMPLING.
+//
+// usage: queue_benchmark [--producers count] [--messages count_per_producer]
+//                        [--oversubscription producers_per_hardware_thread]
+//
+#include "utils/shared_queue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	constexpr std::size_t BURST_SIZE = 64;
+	constexpr std::chrono::microseconds BURST_PAUSE(50);
+	constexpr std::uint64_t LATENCY_SAMPLING = 16;
+
+	struct Options
+	{
+		std::size_t producers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		std::size_t messages = 1000000;
+		std::size_t oversubscription = 4;
+	};
+
+	// close to the size of an in message
+	struct Message
+	{
+		std::uint64_t producer;
+		std::uint64_t sequence;
+		// sending time of the sampled messages, 0 otherwise
+		clock_type::rep sent;
+		std::uint64_t payload[5];
+	};
+
+	struct Result
+	{
+		double throughput; // messages/s
+		// enqueue to dequeue latency percentiles, in microseconds
+		double p50;
+		double p99;
+		double p999;
+	};
+
+	double percentile(std::vector<clock_type::rep>& latencies, double ratio)
+	{
+		if(latencies.empty())
+		{
+			return 0;
+		}
+		const auto rank =
+		  static_cast<std::size_t>(ratio * static_cast<double>(latencies.size() - 1));
+		std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+		return std::chrono::duration<double, std::micro>(clock_type::duration(latencies[rank]))
+		  .count();
+	}
+
+	template<typename Queue>
+	Result run(const Options& options, std::size_t producers, bool bursts)
+	{
+		Queue queue;
+		std::vector<std::thread> threads;
+		threads.reserve(producers);
+
+		const clock_type::time_point start = clock_type::now();
+		for(std::size_t producer = 0; producer < producers; ++producer)
+		{
+			threads.emplace_back([&queue, &options, producer, bursts]() {
+				for(std::uint64_t i = 0; i < options.messages; ++i)
+				{
+					const clock_type::rep sent =
+					  i % LATENCY_SAMPLING == 0 ? clock_type::now().time_since_epoch().count() : 0;
+					queue.push_back(Message{producer, i, sent, {}});
+					if(bursts && i % BURST_SIZE == BURST_SIZE - 1)
+					{
+						std::this_thread::sleep_for(BURST_PAUSE);
+					}
+				}
+			});
+		}
+
+		// the order of each producer must be kept
+		std::vector<std::uint64_t> next_sequence(producers, 0);
+		const std::size_t total = producers * options.messages;
+		std::vector<clock_type::rep> latencies;
+		latencies.reserve(total / LATENCY_SAMPLING + producers);
+		for(std::size_t i = 0; i < total; ++i)
+		{
+			const Message& message = queue.front();
+			if(message.sent != 0)
+			{
+				latencies.push_back(clock_type::now().time_since_epoch().count() - message.sent);
+			}
+			if(message.sequence != next_sequence[message.producer]++)
+			{
+				std::cerr << "Messages out of order" << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			queue.pop_front();
+		}
+		const double duration =
+		  std::chrono::duration<double>(clock_type::now() - start).count();
+
+		for(std::thread& thread: threads)
+		{
+			thread.join();
+		}
+		return {static_cast<double>(total) / duration,
+		        percentile(latencies, 0.5),
+		        percentile(latencies, 0.99),
+		        percentile(latencies, 0.999)};
+	}
+
+	void print_header()
+	{
+		std::cout << "  " << std::setw(9) << "producers"
+		          << "  " << std::left << std::setw(17) << "queue" << std::right << std::setw(10)
+		          << "Mmsg/s" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"
+		          << std::setw(10) << "p999 us" << std::endl;
+	}
+
+	void print(const char* queue, std::size_t producers, const Result& result)
+	{
+		std::cout << "  " << std::setw(9) << producers << "  " << std::left << std::setw(17)
+		          << queue << std::right << std::setw(10) << result.throughput / 1e6
+		          << std::setw(10) << result.p50 << std::setw(10) << result.p99 << std::setw(10)
+		          << result.p999 << std::endl;
+	}
+
+	void run_all(const Options& options, std::size_t producers, bool bursts)
+	{
+		print("atomic_size=false",
+		      producers,
+		      run<shared_queue<Message>>(options, producers, bursts));
+		print("atomic_size=true",
+		      producers,
+		      run<shared_queue<Message, true>>(options, producers, bursts));
+		print("lock_free_mpsc",
+		      producers,
+		      run<shared_queue<Message, true, lock_free_mpsc>>(options, producers, bursts));
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if(i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << argument << std::endl;
+				return false;
+			}
+			const std::string value = argv[++i];
+			if(argument == "--producers")
+			{
+				options.producers = std::clamp(std::stoul(value), 1ul, 256ul);
+			}
+			else if(argument == "--messages")
+			{
+				options.messages = std::max(std::stoul(value), 1ul);
+			}
+			else if(argument == "--oversubscription")
+			{
+				options.oversubscription = std::clamp(std::stoul(value), 1ul, 64ul);
+			}
+			else
+			{
+				std::cerr << "Unknown option " << argument << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	try
+	{
+		if(!parse_options(argc, argv, options))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		std::cerr << "Invalid option value: " << exception.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	for(bool bursts: {false, true})
+	{
+		std::cout << (bursts ? "bursts:" : "saturated:") << std::endl;
+		print_header();
+		for(std::size_t producers = 1; producers <= options.producers; producers *= 2)
+		{
+			run_all(options, producers, bursts);
+		}
+	}
+
+	const std::size_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::cout << "oversubscribed (" << hardware_threads << " hardware threads):" << std::endl;
+	print_header();
+	run_all(options, hardware_threads * options.oversubscription, false);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,269 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// Playback zones benchmark: CPU and memory of the decoding side for 1 to N zones.
+// Each zone is a decoder read by a simulated audio thread, with the decoded audio cache shared
+// by all the zones as in the logic. Two cases are measured:
+//  - distinct tracks: every zone decodes its own file
+//  - same track: the track is prefetched once by the cache worker, the zones read from memory
+// The output (resampler, equalizer, limiter) costs are logged per zone by the logic.
+//
+// usage: zone_benchmark [--file audio_file] [--zones count] [--duration seconds]
+//
+#include "audio/Decoder.hpp"
+#include "audio/PcmCache.hpp"
+#include "utils/path_utils.hpp"
+
+#include <SFML/Audio/OutputSoundFile.hpp>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	constexpr unsigned int SAMPLE_RATE = 44100;
+	constexpr unsigned int CHANNELS = 2;
+	constexpr double PI = 3.14159265358979323846;
+
+	// audio thread chunk, as requested by the SFML streams
+	constexpr std::size_t READ_SAMPLES = 4096 * CHANNELS;
+	constexpr float DECODE_AHEAD_SECONDS = 2;
+	constexpr std::size_t CACHE_BUDGET = std::size_t(1) << 30;
+
+	struct Options
+	{
+		std::filesystem::path file;
+		std::size_t zones = 8;
+		double duration_seconds = 60;
+	};
+
+	struct Measure
+	{
+		double cpu_seconds = 0;
+		std::size_t memory_bytes = 0;
+	};
+
+	double cpu_time() noexcept
+	{
+		return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+	}
+
+	// stereo tones as FLAC, decoding cost close to real music
+	bool generate_track(const std::filesystem::path& path, double duration_seconds)
+	{
+		sf::OutputSoundFile file;
+		if(!file.openFromFile(path.string(), SAMPLE_RATE, CHANNELS))
+		{
+			return false;
+		}
+		const auto frames = static_cast<std::size_t>(duration_seconds * SAMPLE_RATE);
+		std::vector<sf::Int16> samples(frames * CHANNELS);
+		for(std::size_t frame = 0; frame < frames; ++frame)
+		{
+			const double t = static_cast<double>(frame) / SAMPLE_RATE;
+			for(unsigned int channel = 0; channel < CHANNELS; ++channel)
+			{
+				const double value = 0.3 * std::sin(2 * PI * 440 * (channel + 1) * t)
+				                     + 0.1 * std::sin(2 * PI * 3520 * t);
+				samples[frame * CHANNELS + channel] = static_cast<sf::Int16>(value * 32767);
+			}
+		}
+		file.write(samples.data(), samples.size());
+		return true;
+	}
+
+	// read all the decoders to the end like the audio threads of the zones
+	void play(std::vector<std::unique_ptr<audio::Decoder>>& decoders)
+	{
+		std::vector<sf::Int16> buffer(READ_SAMPLES);
+		bool playing = true;
+		while(playing)
+		{
+			playing = false;
+			std::size_t read = 0;
+			for(std::unique_ptr<audio::Decoder>& decoder: decoders)
+			{
+				if(!decoder->finished())
+				{
+					playing = true;
+					read += decoder->read(buffer.data(), buffer.size());
+				}
+			}
+			if(playing && read == 0)
+			{
+				// waiting for the decoding threads
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	bool measure(const std::vector<std::filesystem::path>& files,
+	             bool shared,
+	             const std::shared_ptr<spdlog::logger>& logger,
+	             Measure& result)
+	{
+		audio::PcmCache cache(logger);
+		cache.setBudget(shared ? CACHE_BUDGET : 0);
+
+		const double cpu_begin = cpu_time();
+		const clock_type::time_point wall_begin = clock_type::now();
+		if(shared)
+		{
+			// queued track, decoded in advance by the cache worker
+			cache.prefetch({utf8_path(files.front())});
+			while(cache.getStatistics().tracks == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				if(clock_type::now() - wall_begin > std::chrono::minutes(1))
+				{
+					return false;
+				}
+			}
+		}
+
+		std::vector<std::unique_ptr<audio::Decoder>> decoders;
+		for(const std::filesystem::path& file: files)
+		{
+			auto decoder = std::make_unique<audio::Decoder>(logger);
+			decoder->setCache(&cache);
+			if(!decoder->open(utf8_path(shared ? files.front() : file), DECODE_AHEAD_SECONDS))
+			{
+				return false;
+			}
+			result.memory_bytes += decoder->getBufferCapacity() * sizeof(sf::Int16);
+			decoders.push_back(std::move(decoder));
+		}
+		play(decoders);
+
+		result.cpu_seconds = cpu_time() - cpu_begin;
+		result.memory_bytes += cache.getStatistics().used_bytes;
+		return true;
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if(i + 1 >= argc)
+			{
+				std::cerr << "Missing value for " << argument << std::endl;
+				return false;
+			}
+			const std::string value = argv[++i];
+			if(argument == "--file")
+			{
+				options.file = value;
+			}
+			else if(argument == "--zones")
+			{
+				options.zones = std::clamp(std::stoul(value), 1ul, 64ul);
+			}
+			else if(argument == "--duration")
+			{
+				options.duration_seconds = std::max(std::stod(value), 1.0);
+			}
+			else
+			{
+				std::cerr << "Unknown option " << argument << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	try
+	{
+		if(!parse_options(argc, argv, options))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		std::cerr << "Invalid option value: " << exception.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// one copy per zone: distinct tracks must not be shared through the cache
+	const std::filesystem::path folder =
+	  std::filesystem::temp_directory_path() / "magicplayer_zone_benchmark";
+	std::error_code error;
+	std::filesystem::create_directories(folder, error);
+	const std::filesystem::path source =
+	  options.file.empty() ? folder / "track.flac" : options.file;
+	if(options.file.empty() && !generate_track(source, options.duration_seconds))
+	{
+		std::cerr << "Failed to generate " << source << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<std::filesystem::path> files;
+	for(std::size_t zone = 0; zone < options.zones; ++zone)
+	{
+		const std::filesystem::path copy =
+		  folder / ("zone_" + std::to_string(zone) + source.extension().string());
+		std::filesystem::copy_file(
+		  source, copy, std::filesystem::copy_options::overwrite_existing, error);
+		if(error)
+		{
+			std::cerr << "Failed to copy " << source << ": " << error.message() << std::endl;
+			return EXIT_FAILURE;
+		}
+		files.push_back(copy);
+	}
+
+	const auto logger = std::make_shared<spdlog::logger>(
+	  "zone_benchmark", std::make_shared<spdlog::sinks::null_sink_mt>());
+
+	std::cout << std::fixed << std::setprecision(2);
+	for(bool shared: {false, true})
+	{
+		std::cout << (shared ? "same track" : "distinct tracks") << " (CPU ms per second of audio):"
+		          << std::endl;
+		double previous_cpu = 0;
+		for(std::size_t zones = 1; zones <= options.zones; ++zones)
+		{
+			Measure result;
+			const std::vector<std::filesystem::path> zone_files(files.cbegin(),
+			                                                    files.cbegin() + zones);
+			if(!measure(zone_files, shared, logger, result))
+			{
+				std::cerr << "Failed to play " << source << std::endl;
+				return EXIT_FAILURE;
+			}
+			const double audio_seconds = options.duration_seconds;
+			const double cpu_ms = result.cpu_seconds / audio_seconds * 1000;
+			std::cout << "  " << zones << " zones: " << cpu_ms << "ms total, "
+			          << cpu_ms / static_cast<double>(zones) << "ms per zone, +"
+			          << cpu_ms - previous_cpu << "ms for the last zone, "
+			          << static_cast<double>(result.memory_bytes) / (1 << 20) << "MB decoded audio"
+			          << std::endl;
+			previous_cpu = cpu_ms;
+		}
+	}
+
+	std::filesystem::remove_all(folder, error);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+# Auxiliary executables (tests, benchmarks): <name>.cpp of the calling folder and the project
+# sources it uses, configured like MagicPlayer.
+#   magicplayer_add_executable(<name> <ide folder>
+#                              [SOURCES project relative paths...] [LIBS libraries...])
+function(magicplayer_add_executable name ide_folder)
+	cmake_parse_arguments(ARG "" "" "SOURCES;LIBS" ${ARGN})
+	set(sources "${CMAKE_CURRENT_SOURCE_DIR}/${name}.cpp")
+	foreach(source IN LISTS ARG_SOURCES)
+		list(APPEND sources "${PROJECT_SOURCE_DIR}/${source}")
+	endforeach()
+
+	add_executable(${name} ${sources})
+	target_include_directories(${name} PRIVATE "${PROJECT_SOURCE_DIR}/include")
+	if(ARG_LIBS)
+		target_link_libraries(${name} PRIVATE ${ARG_LIBS})
+		if(COMPILER_CLANG OR (COMPILER_GCC AND (CMAKE_CXX_COMPILER_VERSION VERSION_LESS 9.0)))
+			target_link_libraries(${name} PRIVATE stdc++fs)
+		endif()
+	endif()
+	cmutils_target_configure_compile_options(${name})
+	cmutils_target_enable_warnings(${name})
+	cmutils_target_set_standard(${name} CXX 17)
+	cmutils_target_set_ide_folder(${name} "${ide_folder}")
+endfunction()
+
+# <name>_test executable, registered to CTest as <name>
+#   magicplayer_add_test(<name> [SOURCES ...] [LIBS ...])
+function(magicplayer_add_test name)
+	magicplayer_add_executable(${name}_test "MagicPlayer/tests" ${ARGN})
+	add_test(NAME ${name} COMMAND ${name}_test)
+endfunction()
+
+# <name>_benchmark executable
+#   magicplayer_add_benchmark(<name> [SOURCES ...] [LIBS ...])
+function(magicplayer_add_benchmark name)
+	magicplayer_add_executable(${name}_benchmark "MagicPlayer/benchmarks" ${ARGN})
+endfunction()
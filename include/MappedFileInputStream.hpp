@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////
+//
+// SFML Extension - MappedFileInputStream
+// Copyright (C) 2019 Maxime Pinard
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+#ifndef SFML_EXTENSION_MAPPEDFILEINPUTSTREAM_HPP
+#define SFML_EXTENSION_MAPPEDFILEINPUTSTREAM_HPP
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <SFML/System/InputStream.hpp>
+#include <SFML/System/FileInputStream.hpp>
+
+#include <memory>
+#include <string>
+
+class MappedFileInputStream : public sf::InputStream
+{
+
+public:
+	////////////////////////////////////////////////////////////
+	/// \brief Default constructor
+	///
+	////////////////////////////////////////////////////////////
+	MappedFileInputStream();
+
+	////////////////////////////////////////////////////////////
+	/// \brief Deleted copy constructor
+	///
+	////////////////////////////////////////////////////////////
+	MappedFileInputStream(const MappedFileInputStream&) = delete;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Deleted copy assignment operator
+	///
+	////////////////////////////////////////////////////////////
+	MappedFileInputStream& operator=(const MappedFileInputStream&) = delete;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Destructor
+	///
+	////////////////////////////////////////////////////////////
+	~MappedFileInputStream() override;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Open the stream from a file path
+	///
+	/// The file is memory-mapped when possible, if the file
+	/// can't be mapped (special file, unsupported platform...)
+	/// the stream falls back to buffered reads.
+	///
+	/// \param filename Name of the file to open
+	///
+	/// \return True on success, false on error
+	///
+	////////////////////////////////////////////////////////////
+	bool open(const std::string& filename);
+
+	////////////////////////////////////////////////////////////
+	/// \brief Close the stream, unmapping the file or closing the
+	///        buffered reads file if needed
+	///
+	////////////////////////////////////////////////////////////
+	void close();
+
+	////////////////////////////////////////////////////////////
+	/// \brief Tell if the opened file is memory-mapped
+	///
+	/// \return True if the file is mapped, false if it uses buffered reads
+	///
+	////////////////////////////////////////////////////////////
+	bool isMapped() const;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Get the mapped content of the file
+	///
+	/// \return Pointer to the beginning of the file content,
+	///         nullptr if the file is not mapped
+	///
+	////////////////////////////////////////////////////////////
+	const char* getData() const;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Read data from the stream
+	///
+	/// \param data Buffer where to copy the read data
+	/// \param size Desired number of bytes to read
+	///
+	/// \return The number of bytes actually read, or -1 on error
+	///
+	////////////////////////////////////////////////////////////
+	sf::Int64 read(void* data, sf::Int64 size) override;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Change the current reading position
+	///
+	/// \param position The position to seek to, from the beginning
+	///
+	/// \return The position actually sought to, or -1 on error
+	///
+	////////////////////////////////////////////////////////////
+	sf::Int64 seek(sf::Int64 position) override;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Get the current reading position in the stream
+	///
+	/// \return The current position, or -1 on error.
+	///
+	////////////////////////////////////////////////////////////
+	sf::Int64 tell() override;
+
+	////////////////////////////////////////////////////////////
+	/// \brief Return the size of the stream
+	///
+	/// \return The total number of bytes available in the stream, or -1 on error
+	///
+	////////////////////////////////////////////////////////////
+	sf::Int64 getSize() override;
+
+private:
+	////////////////////////////////////////////////////////////
+	/// \brief Try to map the file in memory
+	///
+	/// \param filename Name of the file to map
+	///
+	/// \return True if the file was mapped
+	///
+	////////////////////////////////////////////////////////////
+	bool map(const std::string& filename);
+
+	////////////////////////////////////////////////////////////
+	/// \brief Unmap the file if mapped
+	///
+	////////////////////////////////////////////////////////////
+	void unmap();
+
+	////////////////////////////////////////////////////////////
+	// Member data
+	////////////////////////////////////////////////////////////
+	const char* m_data;
+	sf::Int64 m_size;
+	sf::Int64 m_offset;
+	bool m_mapped;
+	std::unique_ptr<sf::FileInputStream> m_fallback;
+};
+
+#endif //SFML_EXTENSION_MAPPEDFILEINPUTSTREAM_HPP
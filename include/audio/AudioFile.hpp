@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_AUDIOFILE_HPP
+#define MAGICPLAYER_AUDIOFILE_HPP
+
+#include "audio/decoders/Reader.hpp"
+
+#include <SFML/System/InputStream.hpp>
+#include <SFML/System/Time.hpp>
+
+#include <memory>
+
+namespace audio
+{
+	// Audio file decoded by the reader the decoders registry picked from its content.
+	// The stream must outlive the file.
+	class AudioFile final
+	{
+	public:
+		AudioFile() noexcept;
+
+		// only the metadata is read
+		[[nodiscard]] bool openFromStream(sf::InputStream& stream);
+
+		[[nodiscard]] decoders::Format getFormat() const noexcept;
+		[[nodiscard]] unsigned int getChannelCount() const noexcept;
+		[[nodiscard]] unsigned int getSampleRate() const noexcept;
+		[[nodiscard]] sf::Uint64 getFrameCount() const noexcept;
+		// all channels
+		[[nodiscard]] sf::Uint64 getSampleCount() const noexcept;
+		[[nodiscard]] sf::Time getDuration() const noexcept;
+
+		// whole frames only, return the number of samples read
+		sf::Uint64 read(sf::Int16* samples, sf::Uint64 max_count);
+		sf::Uint64 read(float* samples, sf::Uint64 max_count);
+
+		// sample accurate
+		void seek(sf::Time offset);
+		void seekFrame(sf::Uint64 frame);
+
+	private:
+		std::unique_ptr<decoders::Reader> m_reader;
+		decoders::Info m_info;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_AUDIOFILE_HPP
@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_BUFFEREDMUSIC_HPP
+#define MAGICPLAYER_BUFFEREDMUSIC_HPP
+
+#include "audio/Mixer.hpp"
+#include "audio/PlaybackState.hpp"
+#include "audio/SpectrumAnalyzer.hpp"
+#include "audio/dsp/Chain.hpp"
+#include "audio/dsp/Equalizer.hpp"
+#include "audio/dsp/Limiter.hpp"
+#include "data/Settings.hpp"
+#include "utils/path_utils.hpp"
+
+#include <SFML/Audio/SoundStream.hpp>
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace audio
+{
+	// sf::Music replacement streaming from a decode-ahead buffer:
+	// the SFML streaming thread only copies already decoded samples
+	// A queued track is chained gapless or with a crossfade when the current one ends.
+	// Samples go through a float DSP chain (resampler, equalizer, limiter) when it's active.
+	class BufferedMusic final : public sf::SoundStream
+	{
+	public:
+		// Called from the streaming thread when the current track ends,
+		// next_started is true if the queued track took over
+		using TrackEndCallback = std::function<void(bool next_started, std::uint64_t track_id)>;
+
+		explicit BufferedMusic(std::shared_ptr<spdlog::logger> logger) noexcept;
+
+		BufferedMusic(const BufferedMusic&) = delete;
+		BufferedMusic& operator=(const BufferedMusic&) = delete;
+
+		BufferedMusic(BufferedMusic&&) = delete;
+		BufferedMusic& operator=(BufferedMusic&&) = delete;
+
+		~BufferedMusic() override;
+
+		// gain: linear gain of the track (loudness normalization)
+		[[nodiscard]] bool openFromFile(const utf8_path& path,
+		                                float decode_ahead_seconds,
+		                                float gain);
+
+		[[nodiscard]] bool queueNext(const utf8_path& path, float decode_ahead_seconds, float gain);
+		[[nodiscard]] bool hasQueuedNext() const noexcept;
+
+		void setCrossfade(float seconds, data::CrossfadeCurve curve) noexcept;
+
+		// 0 to keep the rate of the music, applied when the next file is opened
+		void setOutputSampleRate(unsigned int sample_rate) noexcept;
+
+		// applied on the fly
+		void setEqualizer(const std::vector<data::EqualizerBand>& bands, bool enabled);
+		void setLimiter(bool enabled, float threshold_db) noexcept;
+
+		// must be set while the music is stopped
+		void setTrackEndCallback(TrackEndCallback callback);
+
+		// output samples are tapped to the analyzer, must be set while the music is stopped
+		void setSpectrumAnalyzer(SpectrumAnalyzer* analyzer) noexcept;
+
+		// the streaming thread publishes the playback position in the state while playing,
+		// must be set while the music is stopped
+		void setPlaybackState(PlaybackState* state) noexcept;
+
+		// decoded tracks are read from and added to the cache, must outlive the music
+		void setPcmCache(PcmCache* cache) noexcept;
+
+		// controlling thread, after play(), pause(), stop() or setPlayingOffset()
+		void publishPlaybackState();
+
+		// duration of the current track
+		[[nodiscard]] sf::Time getDuration() const noexcept;
+
+		// playing offset in the current track
+		[[nodiscard]] sf::Time getTrackOffset() const;
+
+		// incremented each time a file is opened or a queued track takes over
+		[[nodiscard]] std::uint64_t getTrackId() const noexcept;
+
+		// monitoring, can be called from any thread
+		[[nodiscard]] std::uint64_t getUnderrunCount() const noexcept;
+		[[nodiscard]] std::uint64_t getUnderrunSamples() const noexcept;
+		[[nodiscard]] float getBufferFillRatio() const noexcept;
+		[[nodiscard]] std::vector<dsp::Chain::StageCost> getDspCosts() const;
+
+	protected:
+		bool onGetData(Chunk& data) override;
+
+		void onSeek(sf::Time timeOffset) override;
+
+	private:
+		[[nodiscard]] PlaybackState::Snapshot
+		playbackSnapshot(sf::SoundSource::Status status) const;
+
+		Mixer m_mixer;
+		std::vector<sf::Int16> m_samples;
+		std::vector<sf::Int16> m_silence;
+
+		dsp::Chain m_dsp;
+		dsp::Equalizer& m_equalizer;
+		dsp::Limiter& m_limiter;
+		unsigned int m_output_sample_rate;
+		std::vector<float> m_dsp_input;
+		std::vector<float> m_dsp_output;
+		std::vector<sf::Int16> m_output;
+
+		TrackEndCallback m_track_end_callback;
+		SpectrumAnalyzer* m_spectrum_analyzer;
+		PlaybackState* m_playback_state;
+
+		// stream timeline, in output frames
+		sf::Uint64 m_streamed_frames;
+		std::atomic<sf::Uint64> m_track_start_frame;
+		std::atomic<std::uint64_t> m_track_id;
+
+		std::atomic<std::uint64_t> m_underrun_count;
+		std::atomic<std::uint64_t> m_underrun_samples;
+
+		std::shared_ptr<spdlog::logger> m_logger;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_BUFFEREDMUSIC_HPP
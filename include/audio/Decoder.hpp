@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DECODER_HPP
+#define MAGICPLAYER_DECODER_HPP
+
+#include "audio/AudioFile.hpp"
+#include "audio/PcmCache.hpp"
+#include "utils/spsc_ring_buffer.hpp"
+#include "utils/path_utils.hpp"
+#include "MappedFileInputStream.hpp"
+
+#include <SFML/System/Time.hpp>
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace audio
+{
+	// Decode an audio file ahead of playback in a dedicated thread.
+	// Decoded samples are stored in a lock-free ring buffer: read() never blocks and can be
+	// called from the audio thread, everything else must be called from the controlling thread.
+	// With a cache, cached tracks are read from memory without decoding, and tracks decoded from
+	// the start to the end are added to the cache.
+	class Decoder final
+	{
+	public:
+		explicit Decoder(std::shared_ptr<spdlog::logger> logger) noexcept;
+
+		Decoder(const Decoder&) = delete;
+		Decoder& operator=(const Decoder&) = delete;
+
+		Decoder(Decoder&&) = delete;
+		Decoder& operator=(Decoder&&) = delete;
+
+		~Decoder() noexcept;
+
+		// must outlive the decoder, nullptr to disable, used on the next open()
+		void setCache(PcmCache* cache) noexcept;
+
+		[[nodiscard]] bool open(const utf8_path& path, float decode_ahead_seconds);
+		void close() noexcept;
+
+		// audio thread
+		std::size_t read(sf::Int16* samples, std::size_t max_count) noexcept;
+		[[nodiscard]] bool finished() const noexcept;
+
+		// no concurrent read() allowed, except for cached tracks
+		void seek(sf::Time offset);
+
+		[[nodiscard]] bool isOpen() const noexcept;
+		[[nodiscard]] unsigned int getChannelCount() const noexcept;
+		[[nodiscard]] unsigned int getSampleRate() const noexcept;
+		[[nodiscard]] sf::Time getDuration() const noexcept;
+		[[nodiscard]] sf::Uint64 getSampleCount() const noexcept;
+
+		// monitoring, can be called from any thread
+		[[nodiscard]] std::size_t getBufferedSamples() const noexcept;
+		[[nodiscard]] std::size_t getBufferCapacity() const noexcept;
+
+	private:
+		void run() noexcept;
+
+		// decode one chunk, m_mutex must be locked
+		bool decodeChunk();
+		void cacheDecodedTrack();
+
+		MappedFileInputStream m_stream;
+		std::unique_ptr<AudioFile> m_file;
+		bool m_open;
+		unsigned int m_channel_count;
+		unsigned int m_sample_rate;
+		sf::Time m_duration;
+		sf::Uint64 m_sample_count;
+
+		spsc_ring_buffer<sf::Int16> m_buffer;
+		std::vector<sf::Int16> m_chunk;
+
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		bool m_stop;
+		std::atomic<bool> m_control_pending;
+		std::atomic<bool> m_end_of_file;
+
+		PcmCache* m_cache;
+		// read from memory if the track was cached
+		std::shared_ptr<const PcmTrack> m_cached_track;
+		std::atomic<std::size_t> m_cached_position;
+		// samples decoded since the start, to be cached at the end
+		bool m_capturing;
+		utf8_path m_path;
+		std::uint64_t m_fingerprint;
+		std::vector<sf::Int16> m_captured;
+
+		std::shared_ptr<spdlog::logger> m_logger;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_DECODER_HPP
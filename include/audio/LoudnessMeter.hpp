@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_LOUDNESSMETER_HPP
+#define MAGICPLAYER_LOUDNESSMETER_HPP
+
+#include "audio/dsp/Resampler.hpp"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace audio
+{
+	// Integrated loudness (ITU-R BS.1770-4 / EBU R128) and true peak of a signal:
+	// K-weighting, 400ms gating blocks with 75% overlap, absolute and relative gates,
+	// true peak measured on the signal oversampled to at least 176.4kHz.
+	class LoudnessMeter final
+	{
+	public:
+		static constexpr double SILENCE_LUFS = -70.0;
+
+		LoudnessMeter() noexcept;
+
+		void prepare(unsigned int channels, unsigned int sample_rate, std::size_t max_frames);
+
+		// interleaved samples in [-1, 1], frames <= max_frames given to prepare()
+		void process(const float* samples, std::size_t frames);
+
+		// LUFS, SILENCE_LUFS if no block is above the absolute gate
+		[[nodiscard]] double integratedLoudness() const noexcept;
+
+		// dBTP
+		[[nodiscard]] double truePeak() const noexcept;
+
+	private:
+		// transposed direct form II states of the two K-weighting stages for one channel
+		struct ChannelState
+		{
+			double shelf_z1;
+			double shelf_z2;
+			double highpass_z1;
+			double highpass_z2;
+		};
+
+		struct Biquad
+		{
+			double b0;
+			double b1;
+			double b2;
+			double a1;
+			double a2;
+		};
+
+		// accumulate the K-weighted energy of the frames in m_channel_energies
+		void filter(const float* samples, std::size_t frames) noexcept;
+
+		void endSubBlock();
+
+		unsigned int m_channels;
+		Biquad m_shelf;
+		Biquad m_highpass;
+		std::vector<ChannelState> m_states;
+		std::vector<double> m_weights;
+
+		// 100ms sub-blocks, a gating block is made of the last 4
+		std::size_t m_subblock_frames;
+		std::size_t m_subblock_position;
+		std::vector<double> m_channel_energies;
+		std::array<double, 4> m_subblocks;
+		std::size_t m_subblock_count;
+
+		// mean square of each gating block
+		std::vector<double> m_blocks;
+
+		dsp::Resampler m_oversampler;
+		std::vector<float> m_oversampled;
+		float m_peak;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_LOUDNESSMETER_HPP
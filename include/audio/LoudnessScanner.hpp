@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_LOUDNESSSCANNER_HPP
+#define MAGICPLAYER_LOUDNESSSCANNER_HPP
+
+#include "data/Loudness.hpp"
+#include "utils/path_utils.hpp"
+
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace audio
+{
+	// Background loudness analysis of a list of tracks, decoded in parallel on all cores but one.
+	// Tracks already in the loudness database are skipped and the results are saved
+	// periodically, so an interrupted analysis resumes where it stopped.
+	// While throttled (music playing), a single worker runs at a reduced duty cycle.
+	class LoudnessScanner final
+	{
+	public:
+		LoudnessScanner(std::shared_ptr<spdlog::logger> logger,
+		                data::LoudnessDatabase& database) noexcept;
+
+		LoudnessScanner(const LoudnessScanner&) = delete;
+		LoudnessScanner& operator=(const LoudnessScanner&) = delete;
+
+		LoudnessScanner(LoudnessScanner&&) = delete;
+		LoudnessScanner& operator=(LoudnessScanner&&) = delete;
+
+		~LoudnessScanner() noexcept;
+
+		// any thread, the tracks of paths not analyzed yet or modified since the analysis,
+		// reads the file signatures: called by a background task for large lists
+		[[nodiscard]] std::vector<utf8_path> filterAnalyzed(std::vector<utf8_path> paths) const;
+
+		// controlling thread, replace the running analysis by the one of paths,
+		// already filtered by filterAnalyzed()
+		void start(std::vector<utf8_path> paths);
+
+		// controlling thread, wait for the workers and save the results
+		void stop() noexcept;
+
+		// any thread
+		void setThrottled(bool throttled) noexcept;
+		[[nodiscard]] bool isRunning() const noexcept;
+
+	private:
+		void work(unsigned int worker) noexcept;
+
+		// return false if the track can't be decoded or the analysis was stopped
+		[[nodiscard]] bool analyze(unsigned int worker,
+		                           const utf8_path& path,
+		                           data::TrackLoudness& loudness);
+
+		// sleep or wait according to the throttling, return false if stopped
+		bool throttle(unsigned int worker, std::chrono::steady_clock::duration busy);
+
+		void saveIfDue(bool force) noexcept;
+
+		data::LoudnessDatabase& m_database;
+
+		std::vector<utf8_path> m_paths;
+		std::atomic<std::size_t> m_next_path;
+		std::atomic<std::size_t> m_analyzed;
+		std::atomic<std::size_t> m_failed;
+		std::atomic<unsigned int> m_running_workers;
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::atomic<bool> m_stop;
+		std::atomic<bool> m_throttled;
+
+		std::mutex m_save_mutex;
+		std::chrono::steady_clock::time_point m_last_save;
+		std::size_t m_saved_analyzed;
+
+		std::shared_ptr<spdlog::logger> m_logger;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_LOUDNESSSCANNER_HPP
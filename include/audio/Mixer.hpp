@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_MIXER_HPP
+#define MAGICPLAYER_MIXER_HPP
+
+#include "audio/Decoder.hpp"
+#include "data/Settings.hpp"
+#include "utils/path_utils.hpp"
+
+#include <SFML/System/Time.hpp>
+#include <spdlog/logger.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace audio
+{
+	// Play a track and chain the next queued one, gapless or with a crossfade.
+	// read() is called from the audio thread and never blocks, the other functions must be
+	// called from the controlling thread. Tracks can only be chained if they have the same
+	// channel count and sample rate as the current one.
+	class Mixer final
+	{
+	public:
+		explicit Mixer(std::shared_ptr<spdlog::logger> logger) noexcept;
+
+		Mixer(const Mixer&) = delete;
+		Mixer& operator=(const Mixer&) = delete;
+
+		Mixer(Mixer&&) = delete;
+		Mixer& operator=(Mixer&&) = delete;
+
+		~Mixer() noexcept = default;
+
+		// no concurrent read() allowed, drop the queued track
+		// gain is the linear gain applied to the samples of the track
+		[[nodiscard]] bool open(const utf8_path& path, float decode_ahead_seconds, float gain);
+
+		// prepare the track played after the current one
+		// return false if a track is already queued or the track can't be chained
+		[[nodiscard]] bool queue(const utf8_path& path, float decode_ahead_seconds, float gain);
+		[[nodiscard]] bool hasQueued() const noexcept;
+
+		// decoded tracks cache of both decoders, used from the next open() or queue()
+		void setPcmCache(PcmCache* cache) noexcept;
+
+		// applied from the next crossfade, can be called from any thread
+		void setCrossfade(float seconds, data::CrossfadeCurve curve) noexcept;
+
+		// audio thread
+		// track_changed is set if the queued track became the current one during the read
+		std::size_t read(sf::Int16* samples, std::size_t max_count, bool& track_changed) noexcept;
+		[[nodiscard]] bool finished() const noexcept;
+		[[nodiscard]] sf::Uint64 getTrackFrames() const noexcept;
+
+		// no concurrent read() allowed, cancel the current crossfade
+		void seek(sf::Time offset);
+
+		[[nodiscard]] unsigned int getChannelCount() const noexcept;
+		[[nodiscard]] unsigned int getSampleRate() const noexcept;
+		[[nodiscard]] sf::Time getDuration() const noexcept;
+
+		// monitoring, can be called from any thread
+		[[nodiscard]] std::size_t getBufferedSamples() const noexcept;
+		[[nodiscard]] std::size_t getBufferCapacity() const noexcept;
+
+	private:
+		[[nodiscard]] Decoder& current() noexcept;
+		[[nodiscard]] const Decoder& current() const noexcept;
+		[[nodiscard]] Decoder& next() noexcept;
+
+		// audio thread, the queued track becomes the current one
+		void swap(sf::Uint64 track_frames) noexcept;
+
+		// audio thread, mix the end of the current track with the beginning of the next one
+		std::size_t readCrossfade(sf::Int16* samples,
+		                          std::size_t max_frames,
+		                          bool& track_changed) noexcept;
+
+		std::array<std::unique_ptr<Decoder>, 2> m_decoders;
+		std::array<float, 2> m_gains;
+		std::atomic<unsigned int> m_current;
+		std::atomic<bool> m_next_ready;
+		unsigned int m_channel_count;
+		unsigned int m_sample_rate;
+
+		std::atomic<float> m_crossfade_seconds;
+		std::atomic<data::CrossfadeCurve> m_crossfade_curve;
+
+		// audio thread state
+		sf::Uint64 m_track_frames;
+		bool m_fading;
+		std::size_t m_fade_frames;
+		std::size_t m_fade_position;
+		data::CrossfadeCurve m_fade_curve;
+		std::vector<sf::Int16> m_fade_buffer;
+
+		std::shared_ptr<spdlog::logger> m_logger;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_MIXER_HPP
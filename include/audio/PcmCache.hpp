@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_PCMCACHE_HPP
+#define MAGICPLAYER_PCMCACHE_HPP
+
+#include "utils/path_utils.hpp"
+
+#include <SFML/Config.hpp>
+#include <SFML/System/Time.hpp>
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace audio
+{
+	// Whole decoded track
+	struct PcmTrack
+	{
+		std::uint64_t fingerprint = 0;
+		unsigned int channel_count = 0;
+		unsigned int sample_rate = 0;
+		sf::Time duration;
+		std::vector<sf::Int16> samples;
+
+		[[nodiscard]] std::size_t bytes() const noexcept;
+	};
+
+	// Memory budgeted LRU cache of decoded tracks, so replaying and skipping between recent
+	// tracks doesn't decode them again.
+	// Tracks are keyed by path and dropped when the file fingerprint changed. The cache is
+	// filled by the decoders reaching the end of a track and by a worker decoding the upcoming
+	// tracks. Thread safe.
+	class PcmCache final
+	{
+	public:
+		struct Statistics
+		{
+			std::size_t budget_bytes = 0;
+			std::size_t used_bytes = 0;
+			std::size_t tracks = 0;
+			std::uint64_t hits = 0;
+			std::uint64_t misses = 0;
+		};
+
+		explicit PcmCache(std::shared_ptr<spdlog::logger> logger);
+
+		PcmCache(const PcmCache&) = delete;
+		PcmCache& operator=(const PcmCache&) = delete;
+
+		PcmCache(PcmCache&&) = delete;
+		PcmCache& operator=(PcmCache&&) = delete;
+
+		~PcmCache() noexcept;
+
+		// 0 disables the cache, least recently used tracks are evicted to fit the new budget
+		void setBudget(std::size_t bytes);
+		[[nodiscard]] bool fits(sf::Uint64 sample_count) const noexcept;
+
+		// counted in the statistics, nullptr if not cached
+		[[nodiscard]] std::shared_ptr<const PcmTrack> find(const utf8_path& path);
+		void insert(const utf8_path& path, std::shared_ptr<const PcmTrack> track);
+
+		// replace the tracks to decode in the background, in priority order
+		void prefetch(std::vector<utf8_path> paths);
+
+		[[nodiscard]] Statistics getStatistics() const;
+
+	private:
+		struct Entry
+		{
+			std::string path;
+			std::shared_ptr<const PcmTrack> track;
+		};
+
+		void run() noexcept;
+		void decode(const utf8_path& path, std::uint64_t request);
+
+		// m_mutex must be locked
+		[[nodiscard]] bool contains(const std::string& path, std::uint64_t fingerprint) const;
+		void erase(std::list<Entry>::iterator entry);
+		void evict(std::size_t budget);
+
+		mutable std::mutex m_mutex;
+		std::list<Entry> m_entries; // most recently used first
+		std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+		std::atomic<std::size_t> m_budget;
+		std::size_t m_used;
+		std::uint64_t m_hits;
+		std::uint64_t m_misses;
+
+		std::thread m_thread;
+		std::condition_variable m_cond;
+		bool m_stop;
+		std::deque<utf8_path> m_prefetch;
+		// incremented on each prefetch(), cancels the track being prefetched
+		std::atomic<std::uint64_t> m_request;
+
+		std::shared_ptr<spdlog::logger> m_logger;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_PCMCACHE_HPP
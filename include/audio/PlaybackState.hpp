@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_PLAYBACKSTATE_HPP
+#define MAGICPLAYER_PLAYBACKSTATE_HPP
+
+#include <SFML/Audio/SoundSource.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace audio
+{
+	// Playback position shared by the audio side with the view.
+	// Snapshots are published with a sequence lock: readers never block the writers and retry
+	// while a snapshot is being written. The streaming thread never waits: its update is dropped
+	// if the controlling thread is publishing, or published since the update was prepared.
+	class PlaybackState final
+	{
+	public:
+		struct Snapshot
+		{
+			std::uint64_t track_id = 0;
+			std::uint64_t position_frames = 0; // in the current track
+			unsigned int sample_rate = 0;
+			sf::SoundSource::Status status = sf::SoundSource::Stopped;
+			std::chrono::steady_clock::time_point timestamp{};
+
+			// position at the given time, extrapolated while playing
+			[[nodiscard]] double positionSeconds(std::chrono::steady_clock::time_point now) const
+			  noexcept;
+		};
+
+		PlaybackState() noexcept;
+
+		PlaybackState(const PlaybackState&) = delete;
+		PlaybackState& operator=(const PlaybackState&) = delete;
+
+		PlaybackState(PlaybackState&&) = delete;
+		PlaybackState& operator=(PlaybackState&&) = delete;
+
+		~PlaybackState() noexcept = default;
+
+		// controlling thread (play, pause, stop, seek)
+		void publish(const Snapshot& snapshot) noexcept;
+
+		// streaming thread, epoch read before preparing the snapshot
+		[[nodiscard]] std::uint64_t epoch() const noexcept;
+		bool tryPublish(const Snapshot& snapshot, std::uint64_t epoch) noexcept;
+
+		// readers
+		[[nodiscard]] Snapshot load() const noexcept;
+
+	private:
+		[[nodiscard]] bool tryBeginWrite(std::uint32_t& sequence) noexcept;
+		void write(const Snapshot& snapshot, std::uint32_t sequence) noexcept;
+
+		// odd while a snapshot is written
+		std::atomic<std::uint32_t> m_sequence;
+		// incremented by each publish()
+		std::atomic<std::uint64_t> m_epoch;
+
+		std::atomic<std::uint64_t> m_track_id;
+		std::atomic<std::uint64_t> m_position_frames;
+		std::atomic<unsigned int> m_sample_rate;
+		std::atomic<int> m_status;
+		std::atomic<std::chrono::steady_clock::rep> m_timestamp;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_PLAYBACKSTATE_HPP
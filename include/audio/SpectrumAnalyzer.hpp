@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_SPECTRUMANALYZER_HPP
+#define MAGICPLAYER_SPECTRUMANALYZER_HPP
+
+#include "audio/dsp/Fft.hpp"
+#include "data/Spectrum.hpp"
+#include "utils/spsc_ring_buffer.hpp"
+#include "utils/triple_buffer.hpp"
+
+#include <SFML/Config.hpp>
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace audio
+{
+	// Spectrum and levels of the output stream.
+	// The audio thread copies its output with tap(), which never blocks nor allocates: samples
+	// are dropped when the worker is late. The worker runs windowed FFTs and publishes the
+	// results in a triple buffer. Nothing is done while the view doesn't enable the analysis.
+	class SpectrumAnalyzer final
+	{
+	public:
+		SpectrumAnalyzer(std::shared_ptr<spdlog::logger> logger,
+		                 triple_buffer<data::Spectrum>& output,
+		                 const std::atomic<bool>& enabled);
+
+		SpectrumAnalyzer(const SpectrumAnalyzer&) = delete;
+		SpectrumAnalyzer& operator=(const SpectrumAnalyzer&) = delete;
+
+		SpectrumAnalyzer(SpectrumAnalyzer&&) = delete;
+		SpectrumAnalyzer& operator=(SpectrumAnalyzer&&) = delete;
+
+		~SpectrumAnalyzer() noexcept;
+
+		// audio thread, interleaved samples
+		void tap(const sf::Int16* samples,
+		         std::size_t frames,
+		         unsigned int channels,
+		         unsigned int sample_rate) noexcept;
+
+	private:
+		void run() noexcept;
+
+		void setFormat(unsigned int channels, unsigned int sample_rate) noexcept;
+
+		// pop one hop of frames and publish the analysis
+		void analyzeHop() noexcept;
+
+		void discard(std::size_t samples) noexcept;
+
+		triple_buffer<data::Spectrum>& m_output;
+		const std::atomic<bool>& m_enabled;
+
+		spsc_ring_buffer<sf::Int16> m_input;
+		std::atomic<unsigned int> m_input_channels;
+		std::atomic<unsigned int> m_input_sample_rate;
+
+		// worker state
+		unsigned int m_channels;
+		unsigned int m_sample_rate;
+		dsp::RealFft m_fft;
+		std::vector<float> m_window;
+		std::vector<sf::Int16> m_hop;
+		std::vector<float> m_history; // last FFT size mono frames
+		std::vector<float> m_frame;
+		std::vector<float> m_real;
+		std::vector<float> m_imag;
+		std::vector<std::pair<std::size_t, std::size_t>> m_band_bins; // [first, last]
+		data::Spectrum m_spectrum;
+
+		std::thread m_thread;
+		std::atomic<bool> m_stop;
+
+		std::shared_ptr<spdlog::logger> m_logger;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_SPECTRUMANALYZER_HPP
@@ -0,0 +1,73 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_WAVEFORMGENERATOR_HPP
+#define MAGICPLAYER_WAVEFORMGENERATOR_HPP
+
+#include "data/Waveform.hpp"
+#include "utils/path_utils.hpp"
+
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace audio
+{
+	// Summarize tracks into waveforms on a background worker.
+	// Waveforms are loaded from the cache when possible, otherwise the track is decoded and
+	// partial waveforms are published while decoding, the complete one is then cached.
+	class WaveformGenerator final
+	{
+	public:
+		// Called from the worker thread, never for a request replaced by a newer one
+		using Callback = std::function<void(std::shared_ptr<const data::Waveform> waveform)>;
+
+		WaveformGenerator(std::shared_ptr<spdlog::logger> logger, Callback callback);
+
+		WaveformGenerator(const WaveformGenerator&) = delete;
+		WaveformGenerator& operator=(const WaveformGenerator&) = delete;
+
+		WaveformGenerator(WaveformGenerator&&) = delete;
+		WaveformGenerator& operator=(WaveformGenerator&&) = delete;
+
+		~WaveformGenerator() noexcept;
+
+		// replace the current request
+		void request(const utf8_path& path);
+		void cancel();
+
+	private:
+		void run() noexcept;
+
+		void generate(const utf8_path& path, std::uint64_t request);
+
+		// return false if the request was replaced
+		bool publish(std::shared_ptr<const data::Waveform> waveform, std::uint64_t request);
+
+		[[nodiscard]] bool isCurrent(std::uint64_t request) const noexcept;
+
+		Callback m_callback;
+
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		bool m_stop;
+		std::optional<utf8_path> m_pending;
+		std::atomic<std::uint64_t> m_request;
+
+		std::shared_ptr<spdlog::logger> m_logger;
+	};
+} // namespace audio
+
+#endif //MAGICPLAYER_WAVEFORMGENERATOR_HPP
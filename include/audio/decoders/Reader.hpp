@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DECODERS_READER_HPP
+#define MAGICPLAYER_DECODERS_READER_HPP
+
+#include <SFML/Config.hpp>
+#include <SFML/System/InputStream.hpp>
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace audio::decoders
+{
+	enum class Format
+	{
+		UNKNOWN,
+		WAV,
+		FLAC,
+		VORBIS,
+		MP3,
+	};
+	std::ostream& operator<<(std::ostream& os, const Format& format);
+
+	struct Info
+	{
+		Format format = Format::UNKNOWN;
+		unsigned int channel_count = 0;
+		unsigned int sample_rate = 0;
+		sf::Uint64 frame_count = 0;
+	};
+
+	// Decoder of one audio format reading from a stream, samples are interleaved.
+	// The stream must outlive the reader.
+	class Reader
+	{
+	public:
+		virtual ~Reader() noexcept = default;
+
+		// only the metadata is read, nothing is decoded before the first read
+		[[nodiscard]] virtual bool open(sf::InputStream& stream, Info& info) = 0;
+
+		// sample accurate, past the end jumps to the end
+		virtual void seek(sf::Uint64 frame) = 0;
+
+		// whole frames only, return the number of samples read, 0 at the end
+		virtual std::size_t read(sf::Int16* samples, std::size_t max_count) = 0;
+
+		// float samples in [-1, 1], converted from the int16 samples if not overridden
+		virtual std::size_t read(float* samples, std::size_t max_count);
+
+	private:
+		std::vector<sf::Int16> m_conversion;
+	};
+} // namespace audio::decoders
+
+#endif //MAGICPLAYER_DECODERS_READER_HPP
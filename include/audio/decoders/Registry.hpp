@@ -0,0 +1,55 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DECODERS_REGISTRY_HPP
+#define MAGICPLAYER_DECODERS_REGISTRY_HPP
+
+#include "audio/decoders/Reader.hpp"
+#include "utils/path_utils.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace audio::decoders
+{
+	// Pick the reader of a file from its content, whatever its extension.
+	// Signatures are checked from the most to the least specific on the first bytes of the file,
+	// read once. Shared by the database scanner and the playback.
+	class Registry final
+	{
+	public:
+		using Check = bool (*)(const std::uint8_t* header, std::size_t size) noexcept;
+		using Create = std::unique_ptr<Reader> (*)();
+
+		struct Entry
+		{
+			Format format;
+			Check check;
+			Create create;
+		};
+
+		// WAV, FLAC, Vorbis and MP3 readers
+		[[nodiscard]] static const Registry& get();
+
+		// the stream is left at its start
+		[[nodiscard]] Format probe(sf::InputStream& stream) const;
+		[[nodiscard]] Format probe(const utf8_path& path) const;
+
+		// metadata only, nullptr if the format is not supported
+		[[nodiscard]] std::unique_ptr<Reader> open(sf::InputStream& stream, Info& info) const;
+
+	private:
+		Registry();
+
+		[[nodiscard]] const Entry* find(Format format) const noexcept;
+
+		std::vector<Entry> m_entries;
+	};
+} // namespace audio::decoders
+
+#endif //MAGICPLAYER_DECODERS_REGISTRY_HPP
@@ -0,0 +1,38 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DECODERS_SFMLREADER_HPP
+#define MAGICPLAYER_DECODERS_SFMLREADER_HPP
+
+#include "audio/decoders/Reader.hpp"
+
+#include <SFML/Audio/SoundFileReader.hpp>
+
+#include <memory>
+
+namespace audio::decoders
+{
+	// Reader backed by a SFML sound file reader: libFLAC, libvorbisfile, or mpg123 for MP3.
+	// The format is known from the registry probe, so the reader is created without running
+	// the checks of the other SFML readers.
+	class SfmlReader final : public Reader
+	{
+	public:
+		explicit SfmlReader(Format format) noexcept;
+
+		[[nodiscard]] bool open(sf::InputStream& stream, Info& info) override;
+		void seek(sf::Uint64 frame) override;
+		std::size_t read(sf::Int16* samples, std::size_t max_count) override;
+
+	private:
+		Format m_format;
+		std::unique_ptr<sf::SoundFileReader> m_reader;
+		unsigned int m_channel_count;
+	};
+} // namespace audio::decoders
+
+#endif //MAGICPLAYER_DECODERS_SFMLREADER_HPP
@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DECODERS_WAVREADER_HPP
+#define MAGICPLAYER_DECODERS_WAVREADER_HPP
+
+#include "audio/decoders/Reader.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace audio::decoders
+{
+	// RIFF WAVE reader: 8, 16, 24 and 32 bits integer PCM and 32 bits float.
+	// Samples are converted by blocks straight from the file bytes, 16 bits samples are read
+	// in place, float output keeps the full resolution of 24 and 32 bits files.
+	class WavReader final : public Reader
+	{
+	public:
+		// RIFF header
+		[[nodiscard]] static bool check(const std::uint8_t* header, std::size_t size) noexcept;
+
+		WavReader() noexcept;
+
+		[[nodiscard]] bool open(sf::InputStream& stream, Info& info) override;
+		void seek(sf::Uint64 frame) override;
+		std::size_t read(sf::Int16* samples, std::size_t max_count) override;
+		std::size_t read(float* samples, std::size_t max_count) override;
+
+	private:
+		enum class Encoding
+		{
+			PCM_U8,
+			PCM_S16,
+			PCM_S24,
+			PCM_S32,
+			FLOAT32,
+		};
+
+		template<typename Sample>
+		std::size_t readConverted(Sample* samples, std::size_t max_count);
+
+		sf::InputStream* m_stream;
+		Encoding m_encoding;
+		unsigned int m_channel_count;
+		unsigned int m_bytes_per_sample;
+		sf::Int64 m_data_offset;
+		sf::Uint64 m_frame_count;
+		sf::Uint64 m_position; // in frames
+		std::vector<std::uint8_t> m_bytes;
+		std::vector<float> m_floats; // float files read as int16
+	};
+} // namespace audio::decoders
+
+#endif //MAGICPLAYER_DECODERS_WAVREADER_HPP
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DSP_CHAIN_HPP
+#define MAGICPLAYER_DSP_CHAIN_HPP
+
+#include "audio/dsp/Processor.hpp"
+#include "audio/dsp/Resampler.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace audio::dsp
+{
+	// Float processing between the decoder and the output:
+	// resampling to the output rate, then the processors in insertion order.
+	// Structure changes (add(), prepare()) must be done while the stream is stopped.
+	class Chain final
+	{
+	public:
+		struct StageCost
+		{
+			std::string name;
+			std::uint64_t blocks;
+			double average_us;
+			double max_us;
+			double realtime_load; // processing time / audio duration
+		};
+
+		Chain() noexcept;
+
+		template<typename T, typename... Args>
+		T& add(Args&&... args);
+
+		void prepare(unsigned int channels,
+		             unsigned int input_rate,
+		             unsigned int output_rate,
+		             std::size_t max_input_frames);
+
+		[[nodiscard]] unsigned int getOutputRate() const noexcept;
+		[[nodiscard]] std::size_t maxOutputFrames(std::size_t input_frames) const noexcept;
+
+		// false if the chain would leave the samples untouched
+		[[nodiscard]] bool active() const noexcept;
+
+		// audio thread
+		void reset() noexcept;
+		std::size_t process(const float* input, std::size_t input_frames, float* output) noexcept;
+
+		// any thread, costs since the last prepare()
+		[[nodiscard]] std::vector<StageCost> getCosts() const;
+
+	private:
+		struct Statistics
+		{
+			std::atomic<std::uint64_t> blocks{0};
+			std::atomic<std::uint64_t> total_ns{0};
+			std::atomic<std::uint64_t> max_ns{0};
+			std::atomic<std::uint64_t> audio_ns{0};
+
+			void record(std::uint64_t cost_ns, std::uint64_t block_ns) noexcept;
+			void clear() noexcept;
+		};
+
+		unsigned int m_channels;
+		unsigned int m_output_rate;
+		Resampler m_resampler;
+		std::vector<std::unique_ptr<Processor>> m_processors;
+
+		// resampler first, then one per processor
+		std::vector<std::unique_ptr<Statistics>> m_statistics;
+	};
+} // namespace audio::dsp
+
+template<typename T, typename... Args>
+T& audio::dsp::Chain::add(Args&&... args)
+{
+	static_assert(std::is_base_of<Processor, T>::value, "T must be a processor");
+	auto processor = std::make_unique<T>(std::forward<Args>(args)...);
+	T& reference = *processor;
+	m_processors.push_back(std::move(processor));
+	m_statistics.push_back(std::make_unique<Statistics>());
+	return reference;
+}
+
+#endif //MAGICPLAYER_DSP_CHAIN_HPP
@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DSP_EQUALIZER_HPP
+#define MAGICPLAYER_DSP_EQUALIZER_HPP
+
+#include "audio/dsp/Processor.hpp"
+#include "data/Settings.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace audio::dsp
+{
+	// Parametric equalizer: cascade of biquad filters (RBJ cookbook), one per band
+	class Equalizer final : public Processor
+	{
+	public:
+		Equalizer() noexcept;
+
+		// controlling thread, applied by the audio thread at the beginning of the next block
+		void setBands(const std::vector<data::EqualizerBand>& bands, bool enabled);
+
+		[[nodiscard]] const char* name() const noexcept override;
+		[[nodiscard]] bool enabled() const noexcept override;
+
+		void prepare(unsigned int channels, unsigned int sample_rate) override;
+		void reset() noexcept override;
+		void process(float* samples, std::size_t frames) noexcept override;
+
+	private:
+		struct Coefficients
+		{
+			float b0;
+			float b1;
+			float b2;
+			float a1;
+			float a2;
+			bool identity;
+		};
+
+		// audio thread, never blocks
+		void updateBands() noexcept;
+
+		void computeCoefficients() noexcept;
+
+		unsigned int m_channels;
+		unsigned int m_sample_rate;
+		std::atomic<bool> m_enabled;
+
+		// written by the controlling thread, swapped with m_bands by the audio thread
+		std::mutex m_pending_mutex;
+		std::vector<data::EqualizerBand> m_pending_bands;
+		std::atomic<bool> m_pending;
+
+		std::vector<data::EqualizerBand> m_bands;
+		std::array<Coefficients, data::Settings::MAX_EQUALIZER_BANDS> m_coefficients;
+		std::size_t m_band_count;
+
+		// z1, z2 per channel per band
+		std::vector<float> m_state;
+	};
+} // namespace audio::dsp
+
+#endif //MAGICPLAYER_DSP_EQUALIZER_HPP
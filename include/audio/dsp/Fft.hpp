@@ -0,0 +1,51 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DSP_FFT_HPP
+#define MAGICPLAYER_DSP_FFT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audio::dsp
+{
+	// Forward FFT of real samples, the size is a power of two.
+	// Computed as a complex FFT of half the size in split format (a radix-4 first pass,
+	// then radix-2 passes vectorized four butterflies at a time) followed by a split step.
+	// Tables are computed by prepare(), forward() doesn't allocate.
+	class RealFft final
+	{
+	public:
+		RealFft() noexcept;
+
+		void prepare(std::size_t size);
+
+		[[nodiscard]] std::size_t size() const noexcept;
+
+		// size real samples to size / 2 + 1 complex bins
+		void forward(const float* input, float* real, float* imag) noexcept;
+
+	private:
+		void complexForward() noexcept;
+
+		std::size_t m_size;
+
+		// complex FFT of m_size / 2 points
+		std::vector<std::uint32_t> m_bit_reverse;
+		std::vector<float> m_twiddles_real; // the twiddles of the pass of half size h start at h
+		std::vector<float> m_twiddles_imag;
+		std::vector<float> m_work_real;
+		std::vector<float> m_work_imag;
+
+		// exp(-2i pi k / m_size)
+		std::vector<float> m_split_real;
+		std::vector<float> m_split_imag;
+	};
+} // namespace audio::dsp
+
+#endif //MAGICPLAYER_DSP_FFT_HPP
@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DSP_LIMITER_HPP
+#define MAGICPLAYER_DSP_LIMITER_HPP
+
+#include "audio/dsp/Processor.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace audio::dsp
+{
+	// Look-ahead peak limiter: the signal is delayed so the gain reduction is complete
+	// when a peak is output, the output never exceeds the threshold.
+	class Limiter final : public Processor
+	{
+	public:
+		Limiter() noexcept;
+
+		// any thread
+		void setParameters(bool enabled, float threshold_db) noexcept;
+
+		[[nodiscard]] const char* name() const noexcept override;
+		[[nodiscard]] bool enabled() const noexcept override;
+
+		void prepare(unsigned int channels, unsigned int sample_rate) override;
+		void reset() noexcept override;
+		void process(float* samples, std::size_t frames) noexcept override;
+
+	private:
+		struct WindowEntry
+		{
+			std::uint64_t frame;
+			float gain;
+		};
+
+		std::atomic<bool> m_enabled;
+		std::atomic<float> m_threshold;
+
+		unsigned int m_channels;
+		std::size_t m_lookahead;
+		float m_release;
+
+		// delayed samples and smoothed gains, m_lookahead frames
+		std::vector<float> m_delay;
+		std::vector<float> m_gains;
+		std::size_t m_position;
+		double m_gains_sum;
+		float m_release_gain;
+
+		// sliding window minimum of the required gains (monotonic queue, ring buffer)
+		std::vector<WindowEntry> m_window;
+		std::size_t m_window_begin;
+		std::size_t m_window_size;
+		std::uint64_t m_frame;
+	};
+} // namespace audio::dsp
+
+#endif //MAGICPLAYER_DSP_LIMITER_HPP
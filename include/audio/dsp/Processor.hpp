@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DSP_PROCESSOR_HPP
+#define MAGICPLAYER_DSP_PROCESSOR_HPP
+
+#include <cstddef>
+
+namespace audio::dsp
+{
+	// In-place stage of the DSP chain, working on interleaved float samples.
+	// prepare() is called from the controlling thread while the stream is stopped,
+	// process() and reset() from the audio thread and must not block.
+	class Processor
+	{
+	public:
+		virtual ~Processor() noexcept = default;
+
+		[[nodiscard]] virtual const char* name() const noexcept = 0;
+
+		// disabled processors are skipped by the chain
+		[[nodiscard]] virtual bool enabled() const noexcept = 0;
+
+		virtual void prepare(unsigned int channels, unsigned int sample_rate) = 0;
+
+		// drop the state depending on previous samples (after a seek)
+		virtual void reset() noexcept = 0;
+
+		virtual void process(float* samples, std::size_t frames) noexcept = 0;
+	};
+} // namespace audio::dsp
+
+#endif //MAGICPLAYER_DSP_PROCESSOR_HPP
@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_DSP_RESAMPLER_HPP
+#define MAGICPLAYER_DSP_RESAMPLER_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace audio::dsp
+{
+	// Polyphase windowed-sinc resampler for a rational ratio output_rate / input_rate.
+	// The filter bank is computed by prepare(), process() doesn't allocate as long as
+	// the number of input frames doesn't exceed the max_input_frames given to prepare().
+	class Resampler final
+	{
+	public:
+		Resampler() noexcept;
+
+		// controlling thread
+		void prepare(unsigned int channels,
+		             unsigned int input_rate,
+		             unsigned int output_rate,
+		             std::size_t max_input_frames);
+
+		[[nodiscard]] bool active() const noexcept;
+
+		// upper bound of the frames produced by process() for input_frames
+		[[nodiscard]] std::size_t maxOutputFrames(std::size_t input_frames) const noexcept;
+
+		// audio thread
+		void reset() noexcept;
+
+		// interleaved samples, return the number of output frames
+		std::size_t process(const float* input, std::size_t input_frames, float* output) noexcept;
+
+	private:
+		unsigned int m_channels;
+		unsigned int m_interpolation; // L
+		unsigned int m_decimation;    // M
+		std::size_t m_taps;
+
+		// m_interpolation phases of m_taps coefficients, in reading order
+		std::vector<float> m_filters;
+
+		// planar input history, m_taps - 1 frames kept between calls
+		std::vector<std::vector<float>> m_history;
+		std::size_t m_history_frames;
+		std::size_t m_position;
+		unsigned int m_phase;
+	};
+} // namespace audio::dsp
+
+#endif //MAGICPLAYER_DSP_RESAMPLER_HPP
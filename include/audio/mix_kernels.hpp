@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_MIX_KERNELS_HPP
+#define MAGICPLAYER_MIX_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace audio::kernels
+{
+	// Gain of the frame f: start + step * f
+	struct GainRamp
+	{
+		float start;
+		float step;
+	};
+
+	// Mix two interleaved buffers of the same format, applying a gain ramp on each:
+	// out[f][c] = a[f][c] * a_gain(f) + b[f][c] * b_gain(f)
+	// int16 output is rounded to nearest and saturated, out can alias a or b.
+	// Uses the best available implementation (AVX2, SSE2 or scalar).
+	void mix_ramp(const std::int16_t* a,
+	              GainRamp a_gain,
+	              const std::int16_t* b,
+	              GainRamp b_gain,
+	              std::int16_t* out,
+	              std::size_t frames,
+	              unsigned int channels) noexcept;
+
+	void mix_ramp(const float* a,
+	              GainRamp a_gain,
+	              const float* b,
+	              GainRamp b_gain,
+	              float* out,
+	              std::size_t frames,
+	              unsigned int channels) noexcept;
+
+	// Running minimum, maximum and sum of squares of int16 samples
+	struct SampleSummary
+	{
+		std::int16_t min;
+		std::int16_t max;
+		std::uint64_t sum_squares;
+	};
+	constexpr SampleSummary EMPTY_SUMMARY = {32767, -32768, 0};
+
+	// Accumulate the samples in summary (SSE2 or scalar)
+	void summarize(const std::int16_t* samples, std::size_t count, SampleSummary& summary) noexcept;
+
+	// Sample format conversions, float samples are in [-1, 1]
+	// int16 output is rounded to nearest and saturated.
+	void to_float(const std::int16_t* in, float* out, std::size_t count) noexcept;
+	void to_int16(const float* in, std::int16_t* out, std::size_t count) noexcept;
+
+	// Reference implementations, the vectorized ones are compared to them by the
+	// mix_kernels_test test
+	namespace scalar
+	{
+		void mix_ramp(const std::int16_t* a,
+		              GainRamp a_gain,
+		              const std::int16_t* b,
+		              GainRamp b_gain,
+		              std::int16_t* out,
+		              std::size_t frames,
+		              unsigned int channels) noexcept;
+
+		void mix_ramp(const float* a,
+		              GainRamp a_gain,
+		              const float* b,
+		              GainRamp b_gain,
+		              float* out,
+		              std::size_t frames,
+		              unsigned int channels) noexcept;
+
+		void summarize(const std::int16_t* samples,
+		               std::size_t count,
+		               SampleSummary& summary) noexcept;
+
+		void to_float(const std::int16_t* in, float* out, std::size_t count) noexcept;
+		void to_int16(const float* in, std::int16_t* out, std::size_t count) noexcept;
+	} // namespace scalar
+} // namespace audio::kernels
+
+#endif //MAGICPLAYER_MIX_KERNELS_HPP
@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_CONTROLSERVER_HPP
+#define MAGICPLAYER_CONTROLSERVER_HPP
+
+#include "model/Messages.hpp"
+#include "utils/event_poller.hpp"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace control
+{
+	// Drive the logic from local clients of a Unix domain socket and/or a loopback TCP port,
+	// speaking the control protocol (see control/Protocol.hpp). The server takes the place of
+	// the view: it is the only consumer of the out messages, sent to the subscribed clients.
+	// A single thread runs an event loop on the sockets and on a pipe written when out messages
+	// are queued, nothing runs while there is nothing to do. All the requests read at once are
+	// handled before their answers are written back with a single write per client.
+	class ControlServer final
+	{
+	public:
+		explicit ControlServer(std::shared_ptr<spdlog::logger> logger) noexcept;
+
+		ControlServer(const ControlServer&) = delete;
+		ControlServer& operator=(const ControlServer&) = delete;
+
+		ControlServer(ControlServer&&) = delete;
+		ControlServer& operator=(ControlServer&&) = delete;
+
+		// must outlive every thread sending out messages to the com
+		~ControlServer() noexcept;
+
+		// before the logic runs, empty socket path: no Unix socket, 0 TCP port: no TCP socket,
+		// a stale socket file (refusing connections) is replaced, fails if it is in use.
+		// Any local user can connect to the TCP port: its clients must first send the token
+		// written to token_path, readable by the user only, removed when the server ends
+		[[nodiscard]] bool open(Msg::Com& com,
+		                        const std::filesystem::path& socket_path,
+		                        std::uint16_t tcp_port = 0,
+		                        const std::filesystem::path& token_path = {});
+
+		// serve until a close request or stop(), then ask the logic to close
+		void run();
+
+		// async-signal-safe
+		void stop() noexcept;
+
+		// before run(), called on the server thread for every out message
+		void setOutMessageHandler(std::function<void(const Msg::Com::OutMessage&)> handler);
+
+	private:
+		struct Client
+		{
+			int fd;
+			std::string input;
+			std::string output;
+			bool watch_writable;
+			std::uint32_t subscriptions; // bit per Msg::Com::OutMessage alternative
+			bool authenticated; // Unix socket clients are authenticated by the file permissions
+		};
+
+		[[nodiscard]] bool listenUnix(const std::filesystem::path& socket_path);
+		[[nodiscard]] bool listenTcp(std::uint16_t port, const std::filesystem::path& token_path);
+		[[nodiscard]] bool writeToken(const std::filesystem::path& token_path);
+		[[nodiscard]] bool addListener(int fd);
+
+		void wake() noexcept;
+
+		void acceptClients(int listen_fd);
+		void disconnect(Client& client);
+
+		// return false if the client must be disconnected
+		bool readClient(Client& client);
+		bool writeClient(Client& client);
+
+		void handleLine(Client& client, std::string_view line);
+		[[nodiscard]] nlohmann::json handleRequest(Client& client, const nlohmann::json& request);
+
+		// out messages queued since the last call
+		void sendNotifications();
+
+		std::shared_ptr<spdlog::logger> m_logger;
+
+		Msg::Com* m_com;
+		event_poller m_poller;
+		std::filesystem::path m_socket_path;
+		std::vector<int> m_listen_fds;
+		int m_tcp_listen_fd;
+		std::string m_token;
+		std::filesystem::path m_token_path;
+		int m_wake_fds[2];
+		std::atomic<bool> m_wake_pending;
+		std::atomic<bool> m_stop;
+		std::unordered_map<int, Client> m_clients;
+		std::function<void(const Msg::Com::OutMessage&)> m_out_message_handler;
+		// swapped with the out queue on each wake up
+		Msg::Com::OutMessages m_out_messages;
+		// requests read at once are pushed to the logic together
+		std::vector<Msg::Com::InEnvelope> m_pending_messages;
+	};
+} // namespace control
+
+#endif //MAGICPLAYER_CONTROLSERVER_HPP
@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_HTTPSERVER_HPP
+#define MAGICPLAYER_HTTPSERVER_HPP
+
+#include "data/Database.hpp"
+#include "utils/event_poller.hpp"
+
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace control
+{
+	// HTTP/1.1 file server streaming the database musics to other devices:
+	//  GET/HEAD /library      JSON listing of the database artists, albums and tracks
+	//  GET/HEAD /tracks/<id>  content of the music file, single byte ranges supported
+	// Only the musics of the database are served, by id. A single thread runs an event loop on
+	// the sockets, the files are sent by the kernel (sendfile) without being copied to the server.
+	// Keep-alive connections are supported, pipelined requests are answered in order.
+	class HttpServer final
+	{
+	public:
+		explicit HttpServer(std::shared_ptr<spdlog::logger> logger) noexcept;
+
+		HttpServer(const HttpServer&) = delete;
+		HttpServer& operator=(const HttpServer&) = delete;
+
+		HttpServer(HttpServer&&) = delete;
+		HttpServer& operator=(HttpServer&&) = delete;
+
+		~HttpServer() noexcept;
+
+		// IPv4 address to listen on, 127.0.0.1 to stay local, 0.0.0.0 to serve the LAN
+		[[nodiscard]] bool open(const std::string& address, std::uint16_t port);
+
+		// thread safe, the musics and listing of the database are indexed by the caller thread,
+		// the connections keep streaming the files of the previous database
+		void setDatabase(std::shared_ptr<const data::Database> database);
+
+		// serve until stop()
+		void run();
+
+		// async-signal-safe
+		void stop() noexcept;
+
+	private:
+		// immutable, replaced as a whole when the database changes
+		struct Library
+		{
+			std::shared_ptr<const data::Database> database;
+			std::unordered_map<std::uint64_t, const data::Music*> musics;
+			std::string listing;
+		};
+
+		struct Connection
+		{
+			int fd;
+			std::string input;
+			// headers and generated bodies
+			std::string output;
+			std::size_t output_offset;
+			// file body, sent after the output
+			int file_fd;
+			std::uint64_t file_offset;
+			std::uint64_t file_remaining;
+			bool keep_alive;
+			bool watch_writable;
+			std::chrono::steady_clock::time_point last_activity;
+			// start of the response in progress or last progress of its sending
+			std::chrono::steady_clock::time_point last_write;
+		};
+
+		void acceptConnections();
+		// add the listening socket back to the poller
+		void resumeAccepting();
+		void closeConnection(Connection& connection);
+		void closeIdleConnections(std::chrono::steady_clock::time_point now);
+
+		// return false if the connection must be closed
+		bool readConnection(Connection& connection);
+		bool writeConnection(Connection& connection);
+
+		// answer the complete requests of the input while no response is being sent,
+		// return false if the connection must be closed
+		bool handleRequests(Connection& connection);
+		void handleRequest(Connection& connection,
+		                   std::string_view method,
+		                   std::string_view target,
+		                   std::string_view headers);
+		void sendTrack(Connection& connection,
+		               bool head,
+		               std::string_view target,
+		               std::string_view headers);
+
+		void appendHeaders(Connection& connection,
+		                   int status,
+		                   std::string_view content_type,
+		                   std::uint64_t content_length,
+		                   std::string_view extra_headers = {});
+		void appendResponse(Connection& connection,
+		                    int status,
+		                    bool head,
+		                    std::string_view content_type,
+		                    std::string_view body,
+		                    std::string_view extra_headers = {});
+
+		std::shared_ptr<spdlog::logger> m_logger;
+
+		event_poller m_poller;
+		int m_listen_fd;
+		bool m_accept_paused;
+		std::chrono::steady_clock::time_point m_accept_paused_time;
+		int m_wake_fds[2];
+		std::atomic<bool> m_stop;
+		std::shared_ptr<const Library> m_library; // atomic access
+		std::unordered_map<int, Connection> m_connections;
+	};
+} // namespace control
+
+#endif //MAGICPLAYER_HTTPSERVER_HPP
@@ -0,0 +1,88 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_CONTROL_PROTOCOL_HPP
+#define MAGICPLAYER_CONTROL_PROTOCOL_HPP
+
+#include "model/Messages.hpp"
+#include "audio/PlaybackState.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// Control protocol: newline delimited JSON objects.
+//
+// Requests mirror Msg::In, the type is the snake case name of the message:
+//   {"type": "open", "path": "/music/track.flac"}
+//   {"type": "enqueue", "path": "/music/next.flac"}
+//   {"type": "control", "action": "play" | "pause" | "stop"}
+//   {"type": "volume", "volume": 80, "muted": false}
+//   {"type": "music_offset", "seconds": 42.5}
+// The playback requests (open, enqueue, control, volume, music_offset and state) take an
+// optional "zone" member, from 0 (main zone, default) to Msg::MAX_ZONES - 1.
+//   {"type": "settings", "settings": {same as the settings file}, "save": true}
+//   {"type": "request_database", "generate_new": false}
+//   {"type": "close"}
+// and are answered in order by {"ok": true} or {"ok": false, "error": "..."}, an optional "id"
+// member of the request is copied to the answer. The answer means the message was queued to
+// the logic, requests can be pipelined without waiting for the answers.
+//
+// Requests answered by the server itself:
+//   {"type": "auth", "token": "..."}: required before any other request on the TCP port, the
+//     token is read from the token file written by the player (readable by its user only)
+//   {"type": "state"}: playback state of the zone,
+//     {"ok": true, "state": {"track_id": 3, "status": "playing", "position_seconds": 12.3}}
+//   {"type": "subscribe", "events": ["music_info", ...]}: receive these events, all if omitted
+//   {"type": "unsubscribe", "events": [...]}
+//   {"type": "batch", "requests": [...]}: several requests in one round trip, answered by
+//     {"ok": true, "results": [answers in order]}
+//   {"type": "tracing"}: message latencies by direction and type, if built with the
+//     MAGICPLAYER_MESSAGE_TRACING option: {"ok": true, "messages": [{"direction": "in",
+//     "type": "Open", "depth": {...}, "wait_ns": {...}, "handler_ns": {...}}, ...]}, each with
+//     {"count", "mean", "p50", "p99", "p999", "max"}
+//
+// Msg::Out messages are sent to the subscribed clients as events: {"event": "music_info", ...}
+namespace control
+{
+	// names of the Msg::Com::OutMessage alternatives, in order
+	constexpr const char* EVENT_NAMES[] = {
+	  "music_info",
+	  "folder_content",
+	  "database",
+	  "settings",
+	  "waveform",
+	};
+	static_assert(std::size(EVENT_NAMES) == std::variant_size_v<Msg::Com::OutMessage>);
+
+	// index of the Msg::Com::OutMessage alternative, nullopt if unknown
+	[[nodiscard]] std::optional<std::size_t> event_index(std::string_view name) noexcept;
+
+	// zone member of the request, main zone if absent, nullopt with the error set if invalid
+	[[nodiscard]] std::optional<Msg::ZoneId> parse_zone(const nlohmann::json& request,
+	                                                    std::string& error);
+
+	// nullopt with the error set if the request is invalid
+	[[nodiscard]] std::optional<Msg::Com::InMessage> parse_request(const nlohmann::json& request,
+	                                                               std::string& error);
+
+	[[nodiscard]] nlohmann::json to_json(const Msg::Com::OutMessage& message);
+
+	[[nodiscard]] nlohmann::json to_json(const audio::PlaybackState::Snapshot& state,
+	                                     std::chrono::steady_clock::time_point now);
+
+	[[nodiscard]] nlohmann::json to_json(const std::vector<Msg::tracing::Entry>& entries);
+} // namespace control
+
+#endif //MAGICPLAYER_CONTROL_PROTOCOL_HPP
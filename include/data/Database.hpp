@@ -32,8 +32,14 @@ namespace data
 
 		~Database() noexcept = default;
 
+		// all the musics, the database id may be invalid (database not generated)
+		std::vector<const Music*> musics() const noexcept;
+
 		std::vector<const Music*> findMusics(std::uint64_t id) const noexcept;
 
+		// linear search
+		const Music* findMusic(const utf8_path& path) const noexcept;
+
 	private:
 		friend class DataManager;
 
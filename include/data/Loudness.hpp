@@ -0,0 +1,91 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_LOUDNESS_HPP
+#define MAGICPLAYER_LOUDNESS_HPP
+
+#include "utils/log.hpp"
+#include "utils/path_utils.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace data
+{
+	// ReplayGain 2.0 reference level
+	constexpr double REFERENCE_LOUDNESS_LUFS = -18.0;
+
+	struct TrackLoudness
+	{
+		// file state when analyzed
+		std::uintmax_t file_size;
+		std::int64_t modification_time;
+
+		double integrated_lufs;
+		double true_peak_db;
+		double duration_seconds;
+	};
+	std::ostream& operator<<(std::ostream& os, const TrackLoudness& loudness);
+
+	// Size and modification time of a file, identifying the analyzed version of a track
+	[[nodiscard]] bool get_file_signature(const utf8_path& path,
+	                                      std::uintmax_t& file_size,
+	                                      std::int64_t& modification_time) noexcept;
+
+	// Hash identifying a version of a file: path, size and modification time
+	[[nodiscard]] bool get_file_fingerprint(const utf8_path& path,
+	                                        std::uint64_t& fingerprint) noexcept;
+
+	// Loudness of a set of tracks played one after the other: energy average of the tracks
+	// weighted by their duration, highest true peak (approximation of the gated loudness of
+	// the concatenated tracks)
+	[[nodiscard]] TrackLoudness combine_loudness(const std::vector<TrackLoudness>& tracks) noexcept;
+
+	// Gain bringing the loudness to the reference level plus the preamp,
+	// reduced so the true peak doesn't exceed 0 dBTP
+	[[nodiscard]] float normalization_gain_db(const TrackLoudness& loudness,
+	                                          float preamp_db) noexcept;
+
+	// Loudness analysis results, keyed by track path.
+	// Stored in its own file: the results survive database regenerations and an interrupted
+	// analysis resumes where it stopped. Can be used from any thread.
+	class LoudnessDatabase final
+	{
+	public:
+		LoudnessDatabase() noexcept;
+
+		LoudnessDatabase(const LoudnessDatabase&) = delete;
+		LoudnessDatabase& operator=(const LoudnessDatabase&) = delete;
+
+		// result of the analysis of the current version of the file, if any
+		[[nodiscard]] std::optional<TrackLoudness> find(const utf8_path& path) const;
+
+		// true if the track was analyzed in the given version
+		[[nodiscard]] bool contains(const utf8_path& path,
+		                            std::uintmax_t file_size,
+		                            std::int64_t modification_time) const;
+
+		void insert(const utf8_path& path, const TrackLoudness& loudness);
+
+		[[nodiscard]] std::size_t size() const;
+
+		bool save(const std::shared_ptr<spdlog::logger>& logger = NULL_LOGGER) const noexcept;
+
+		void load(const std::shared_ptr<spdlog::logger>& logger = NULL_LOGGER) noexcept;
+
+	private:
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, TrackLoudness> m_tracks;
+	};
+} // namespace data
+
+#endif //MAGICPLAYER_LOUDNESS_HPP
@@ -11,15 +11,70 @@
 #include "utils/log.hpp"
 #include "utils/path_utils.hpp"
 
+#include <nlohmann/json_fwd.hpp>
+
 #include <vector>
 #include <ostream>
 
 namespace data
 {
+	enum class CrossfadeCurve
+	{
+		LINEAR,
+		EQUAL_POWER,
+		LOGARITHMIC,
+	};
+	std::ostream& operator<<(std::ostream& os, const CrossfadeCurve& curve);
+
+	enum class VolumeNormalization
+	{
+		OFF,
+		TRACK,
+		ALBUM,
+	};
+	std::ostream& operator<<(std::ostream& os, const VolumeNormalization& normalization);
+
+	struct EqualizerBand
+	{
+		enum class Type
+		{
+			LOW_SHELF,
+			PEAK,
+			HIGH_SHELF,
+		};
+		Type type;
+		float frequency;
+		float gain_db;
+		float q;
+	};
+	std::ostream& operator<<(std::ostream& os, const EqualizerBand::Type& type);
+	std::ostream& operator<<(std::ostream& os, const EqualizerBand& band);
+
 	struct Settings
 	{
+		static constexpr float MIN_DECODE_AHEAD_SECONDS = 1.f;
+		static constexpr float MAX_DECODE_AHEAD_SECONDS = 30.f;
+		static constexpr unsigned int MAX_PCM_CACHE_MEGABYTES = 4096;
+		static constexpr float MAX_CROSSFADE_SECONDS = 12.f;
+		static constexpr unsigned int OUTPUT_SAMPLE_RATES[] = {44100, 48000, 96000, 192000};
+		static constexpr std::size_t MAX_EQUALIZER_BANDS = 16;
+		static constexpr float MAX_EQUALIZER_GAIN_DB = 12.f;
+		static constexpr float MIN_LIMITER_THRESHOLD_DB = -12.f;
+		static constexpr float MAX_NORMALIZATION_PREAMP_DB = 12.f;
+
 		utf8_path explorer_folder;
 		std::vector<utf8_path> music_sources;
+		float decode_ahead_seconds;
+		unsigned int pcm_cache_megabytes; // 0: disabled
+		float crossfade_seconds; // 0: gapless
+		CrossfadeCurve crossfade_curve;
+		unsigned int output_sample_rate; // 0: rate of the music
+		bool equalizer_enabled;
+		std::vector<EqualizerBand> equalizer_bands;
+		bool limiter_enabled;
+		float limiter_threshold_db;
+		VolumeNormalization volume_normalization;
+		float normalization_preamp_db;
 
 		Settings() noexcept;
 	};
@@ -30,6 +85,12 @@ namespace data
 
 	Settings loadSettings(const std::shared_ptr<spdlog::logger>& logger = NULL_LOGGER) noexcept;
 
+	// same format as the settings file, invalid values are read as the default ones
+	[[nodiscard]] nlohmann::json settings_to_json(const Settings& settings);
+	Settings
+	settings_from_json(const nlohmann::json& settings_json,
+	                   const std::shared_ptr<spdlog::logger>& logger = NULL_LOGGER) noexcept;
+
 	bool equivalent_sources(const std::vector<utf8_path>& sources_a,
 	                        const std::vector<utf8_path>& sources_b,
 	                        const std::shared_ptr<spdlog::logger>& logger = NULL_LOGGER) noexcept;
@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_SPECTRUM_HPP
+#define MAGICPLAYER_SPECTRUM_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace data
+{
+	// Analysis of the output stream, levels in dB relative to full scale
+	struct Spectrum
+	{
+		static constexpr std::size_t BANDS = 64;
+		static constexpr std::size_t LEVEL_CHANNELS = 2;
+		static constexpr float FLOOR_DB = -90.f;
+
+		// log-spaced bands between min_frequency and max_frequency
+		std::array<float, BANDS> bands_db;
+		float min_frequency;
+		float max_frequency;
+
+		// levels of the first channels
+		unsigned int channels;
+		std::array<float, LEVEL_CHANNELS> peak_db;
+		std::array<float, LEVEL_CHANNELS> rms_db;
+
+		// analysis cost
+		std::size_t fft_size;
+		float analysis_us;
+		float realtime_load;
+
+		Spectrum() noexcept;
+
+		// center frequency of a band
+		[[nodiscard]] float bandFrequency(std::size_t band) const noexcept;
+	};
+} // namespace data
+
+#endif //MAGICPLAYER_SPECTRUM_HPP
@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_WAVEFORM_HPP
+#define MAGICPLAYER_WAVEFORM_HPP
+
+#include "utils/log.hpp"
+#include "utils/path_utils.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace data
+{
+	// Summary of a range of frames, all channels mixed, in int16 sample units
+	struct WaveformBin
+	{
+		std::int16_t min;
+		std::int16_t max;
+		std::uint16_t rms;
+	};
+
+	// Min/max/RMS overview of a track at several resolutions: level 0 summarizes
+	// BASE_BIN_FRAMES frames per bin, each next level merges the bins of the previous one by pairs
+	struct Waveform
+	{
+		static constexpr std::size_t BASE_BIN_FRAMES = 1024;
+
+		std::uint64_t fingerprint;
+		std::uint64_t total_frames;
+		bool complete; // false while the track is being summarized
+		std::vector<std::vector<WaveformBin>> levels;
+
+		Waveform() noexcept;
+
+		// rebuild the coarser levels from level 0
+		void buildLevels();
+
+		// index of the coarsest level having at least min_bins bins, 0 if there is none,
+		// its bins summarize BASE_BIN_FRAMES << index frames
+		[[nodiscard]] std::size_t levelFor(std::size_t min_bins) const noexcept;
+	};
+	std::ostream& operator<<(std::ostream& os, const Waveform& waveform);
+
+	// Binary cache, one file per fingerprint
+	bool saveWaveform(const Waveform& waveform,
+	                  const std::shared_ptr<spdlog::logger>& logger = NULL_LOGGER) noexcept;
+
+	std::shared_ptr<Waveform>
+	loadWaveform(std::uint64_t fingerprint,
+	             const std::shared_ptr<spdlog::logger>& logger = NULL_LOGGER) noexcept;
+} // namespace data
+
+#endif //MAGICPLAYER_WAVEFORM_HPP
@@ -9,14 +9,27 @@
 #define MAGICPLAYER_LOGIC_HPP
 
 #include "model/Messages.hpp"
+#include "audio/BufferedMusic.hpp"
+#include "audio/LoudnessScanner.hpp"
+#include "audio/PcmCache.hpp"
+#include "audio/SpectrumAnalyzer.hpp"
+#include "audio/WaveformGenerator.hpp"
 #include "data/Database.hpp"
 #include "data/DataManager.hpp"
+#include "data/Loudness.hpp"
 #include "utils/path_utils.hpp"
+#include "utils/shared_queue.hpp"
+#include "utils/slot_map.hpp"
+#include "utils/task_executor.hpp"
+#include "utils/task_flow.hpp"
 
-#include <SFML/Audio/Music.hpp>
 #include <spdlog/logger.h>
 
-#include <future>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
 
 class Logic final
 {
@@ -31,12 +44,92 @@ public:
 	void run();
 
 private:
+	// Playback zone, the decoders of all the zones share the decoded audio cache and its
+	// prefetch worker: a track played or queued in several zones is decoded once
+	struct Zone
+	{
+		const Msg::ZoneId id;
+		audio::BufferedMusic music;
+		std::deque<utf8_path> play_queue;
+
+		Zone(Msg::ZoneId id, std::shared_ptr<spdlog::logger> logger) noexcept;
+	};
+
+	// in messages waiting for their dispatch, by lane
+	struct MessageLane
+	{
+		std::deque<Msg::Com::InEnvelope> messages;
+		// dispatched messages since the start
+		std::uint64_t dispatched = 0;
+		std::size_t max_depth = 0;
+		// between the sending and the dispatch of the messages
+		std::chrono::steady_clock::duration total_wait{};
+		std::chrono::steady_clock::duration max_wait{};
+	};
+
+	// move the messages of the in queue to their lane
+	void collectMessages();
+
+	// dispatch a bounded batch of the highest priority lane with messages (the events lane if
+	// they waited too long), return false if the lanes are empty
+	bool dispatchMessages();
+
+	void logLaneStatistics() const;
+
+	// created on first use, nullptr if the id is invalid
+	Zone* getZone(Msg::ZoneId id);
+
 	// input checked
 	template<typename Message>
 	void handleMessage(Message& message) = delete;
 
 	// input not checked
-	void loadFile(const utf8_path& path);
+	void loadFile(Zone& zone, const utf8_path& path);
+
+	// prepare the front of the play queue to be chained to the current music
+	void queueNextFile(Zone& zone);
+
+	// decode the next tracks of the play queues in the background
+	void prefetchQueues();
+
+	void applyPlaybackSettings();
+	void applyPlaybackSettings(Zone& zone);
+
+	// linear gain of the music according to the volume normalization settings
+	[[nodiscard]] float normalizationGain(const utf8_path& path) const;
+
+	// database loaded or generated by a background flow
+	struct DatabaseUpdate
+	{
+		std::shared_ptr<const data::Database> database;
+		std::vector<utf8_path> not_analyzed_musics;
+	};
+
+	// any thread, the database musics whose loudness is not analyzed yet
+	[[nodiscard]] std::vector<utf8_path>
+	notAnalyzedMusics(const std::shared_ptr<const data::Database>& database) const;
+
+	// replace the database and analyze the loudness of its new musics, the lists are built by
+	// the background flows: the logic thread is not blocked by large databases
+	void installDatabase(DatabaseUpdate update);
+
+	// the loudness analysis slows down while a zone is playing
+	void updateLoudnessThrottling();
+
+	// background flow, owned by the logic thread until it ends. Its worker steps run on the
+	// executor, its logic steps when the logic thread takes its id from the continuations queued
+	// by the previous worker step. The flow and its times are used by one side at a time, the
+	// hand over between the sides (executor or continuations queue) orders the accesses.
+	struct PendingTask
+	{
+		const char* name;
+		task_executor::priority priority;
+		std::unique_ptr<task_flow_base> flow;
+		std::chrono::steady_clock::time_point queued;
+		std::chrono::steady_clock::duration worker_time{};
+		std::chrono::steady_clock::duration logic_time{};
+		std::uint32_t switches = 0;
+	};
 
 	void sendFolderContent(const std::filesystem::path& path);
 
@@ -48,19 +141,44 @@ private:
 
 	void async_generateDatabase(std::vector<utf8_path> music_sources);
 
-	template<typename Lambda, typename... Parameters>
-	void async_task(Lambda lambda, Parameters... parameters);
+	// run the flow, its worker steps on the executor and its owner steps on the logic thread,
+	// the name identifies the flow in the latency logs
+	template<typename... Steps>
+	void async_flow(const char* name, task_executor::priority priority, task_flow<Steps...> flow);
+
+	// any thread, run the steps of the side and schedule the following ones,
+	// the task is destroyed when its flow ends
+	void resumeTask(std::uint64_t task_id, PendingTask& task, flow_side side) noexcept;
+
+	// run the logic steps of the continuations queued by the worker steps,
+	// return false if there was none
+	bool resumeContinuations();
 
 	// variables
 	std::shared_ptr<spdlog::logger> m_logger;
 
 	Msg::Com m_com;
 	bool m_end;
-	sf::Music m_music;
-	std::vector<std::future<std::packaged_task<void()>>> m_pending_futures;
+	std::array<MessageLane, Msg::LANE_COUNT> m_lanes;
+	Msg::LaneRouter m_lane_router;
+	std::vector<Msg::Com::InEnvelope> m_collected_messages;
+	std::chrono::steady_clock::time_point m_lane_statistics_logged;
+	audio::SpectrumAnalyzer m_spectrum_analyzer; // outlives the music streaming thread
+	audio::PcmCache m_pcm_cache;                 // outlives the music decoders
+	std::array<std::unique_ptr<Zone>, Msg::MAX_ZONES> m_zones;
+	// stable addresses, used by the executor threads
+	slot_map<std::unique_ptr<PendingTask>> m_pending_tasks;
+	// ids of the tasks whose next steps run on the logic thread, drained at each loop iteration
+	// instead of waiting behind the in messages
+	shared_queue<std::uint64_t> m_continuations;
+	std::deque<std::uint64_t> m_resumed_tasks;
 	data::Settings m_settings;
 	data::DataManager m_data_manager;
 	std::shared_ptr<const data::Database> m_database;
+	data::LoudnessDatabase m_loudness;
+	audio::LoudnessScanner m_loudness_scanner;
+	audio::WaveformGenerator m_waveform_generator;
+	task_executor m_executor; // stopped first, its tasks use the other members
 };
 
 #endif //MAGICPLAYER_LOGIC_HPP
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_MESSAGETRACING_HPP
+#define MAGICPLAYER_MESSAGETRACING_HPP
+
+#include "utils/latency_histogram.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Latency tracing of the messages between the view and the logic, enabled at build time by the
+// MAGICPLAYER_MESSAGE_TRACING CMake option. By direction and message type: queue depth after
+// the message is queued, time spent in the queue and handler duration.
+// Each thread records in its own histograms, without lock, merged when dumped.
+// When disabled, the calls are discarded by "if constexpr(Msg::tracing::ENABLED)" and the out
+// messages carry no timestamp.
+namespace Msg::tracing
+{
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+	constexpr bool ENABLED = true;
+#else
+	constexpr bool ENABLED = false;
+#endif
+
+	using clock = std::chrono::steady_clock;
+
+	enum class Direction
+	{
+		IN,
+		OUT,
+	};
+
+	// construction time of a message, empty when disabled
+	class Stamp
+	{
+	public:
+		Stamp() noexcept;
+
+		// clock epoch when disabled
+		[[nodiscard]] clock::time_point enqueued() const noexcept;
+
+	private:
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+		clock::time_point m_enqueued;
+#endif
+	};
+
+	// calling thread, the type is the index of the message in its variant
+	void recordEnqueue(Direction direction, std::size_t type, std::size_t depth) noexcept;
+	void recordDequeue(Direction direction, std::size_t type, clock::time_point enqueued) noexcept;
+	void recordHandler(Direction direction, std::size_t type, clock::duration duration) noexcept;
+
+	// all threads, the durations are in nanoseconds
+	struct Entry
+	{
+		Direction direction;
+		const char* type;
+		latency_histogram::summary depth;
+		latency_histogram::summary wait;
+		latency_histogram::summary handler;
+	};
+
+	// types with at least one message, empty when disabled
+	[[nodiscard]] std::vector<Entry> dump();
+
+	void log(spdlog::logger& logger);
+} // namespace Msg::tracing
+
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+inline Msg::tracing::Stamp::Stamp() noexcept: m_enqueued(clock::now())
+{
+}
+
+inline Msg::tracing::clock::time_point Msg::tracing::Stamp::enqueued() const noexcept
+{
+	return m_enqueued;
+}
+#else
+inline Msg::tracing::Stamp::Stamp() noexcept = default;
+
+inline Msg::tracing::clock::time_point Msg::tracing::Stamp::enqueued() const noexcept
+{
+	return {};
+}
+#endif
+
+#endif //MAGICPLAYER_MESSAGETRACING_HPP
@@ -9,24 +9,60 @@
 #define MAGICPLAYER_MESSAGES_HPP
 
 #include "utils/shared_queue.hpp"
+#include "utils/triple_buffer.hpp"
 #include "utils/ostream_config_guard.hpp"
 #include "utils/path_utils.hpp"
 #include "model/PathInfo.hpp"
+#include "model/MessageTracing.hpp"
+#include "audio/PlaybackState.hpp"
 #include "data/Database.hpp"
 #include "data/Settings.hpp"
+#include "data/Spectrum.hpp"
+#include "data/Waveform.hpp"
 
 #include <spdlog/spdlog.h>
 #include <spdlog/fmt/ostr.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <type_traits>
 #include <variant>
+#include <vector>
 
 //TODO: add id to messages to make request/answer connection
 
 namespace Msg
 {
+	// Independent playback zones, each with its own music, play queue, volume and position.
+	// The view controls the main zone, the other ones are created by their first message.
+	using ZoneId = std::uint32_t;
+	constexpr ZoneId MAIN_ZONE = 0;
+	constexpr std::size_t MAX_ZONES = 8;
+
+	// Dispatch lanes of the in messages, by strict priority: the playback controls (play, pause,
+	// volume, position), the playback events, then the other requests of the view and the control
+	// clients in their sending order (a request may depend on the previous ones, like an open on
+	// the settings or the close on their saving). A control never overtakes a request of its zone
+	// sent before it, see LaneRouter.
+	enum class Lane
+	{
+		CONTROL,
+		EVENTS,
+		REQUESTS,
+	};
+	constexpr std::size_t LANE_COUNT = 3;
+	std::ostream& operator<<(std::ostream& os, const Lane& l);
+
 	namespace In
 	{
 
@@ -36,14 +72,25 @@ namespace Msg
 		};
 		std::ostream& operator<<(std::ostream& os, const Close& m);
 
+		// a file is played in the zone, a folder content is sent whatever the zone
 		struct Open
 		{
 			utf8_path path;
+			ZoneId zone;
 
-			explicit Open(utf8_path path);
+			explicit Open(utf8_path path, ZoneId zone = MAIN_ZONE);
 		};
 		std::ostream& operator<<(std::ostream& os, const Open& m);
 
+		struct Enqueue
+		{
+			utf8_path path;
+			ZoneId zone;
+
+			explicit Enqueue(utf8_path path, ZoneId zone = MAIN_ZONE);
+		};
+		std::ostream& operator<<(std::ostream& os, const Enqueue& m);
+
 		struct Control
 		{
 			enum class Action
@@ -53,8 +100,9 @@ namespace Msg
 				STOP,
 			};
 			Action action;
+			ZoneId zone;
 
-			explicit Control(Action action);
+			explicit Control(Action action, ZoneId zone = MAIN_ZONE);
 		};
 		std::ostream& operator<<(std::ostream& os, const Control::Action& a);
 		std::ostream& operator<<(std::ostream& os, const Control& m);
@@ -63,24 +111,21 @@ namespace Msg
 		{
 			bool muted;
 			float volume;
+			ZoneId zone;
 
-			Volume(bool muted, float volume);
+			Volume(bool muted, float volume, ZoneId zone = MAIN_ZONE);
 		};
 		std::ostream& operator<<(std::ostream& os, const Volume& m);
 
 		struct MusicOffset
 		{
 			float seconds;
+			ZoneId zone;
 
-			explicit MusicOffset(float seconds);
+			explicit MusicOffset(float seconds, ZoneId zone = MAIN_ZONE);
 		};
 		std::ostream& operator<<(std::ostream& os, const MusicOffset& m);
 
-		struct RequestMusicOffset
-		{
-		};
-		std::ostream& operator<<(std::ostream& os, const RequestMusicOffset& m);
-
 		struct Settings
 		{
 			data::Settings settings;
@@ -98,29 +143,88 @@ namespace Msg
 		};
 		std::ostream& operator<<(std::ostream& os, const RequestDatabase& m);
 
-		struct InnerTaskEnded
+		struct InnerTrackEnded
 		{
+			bool next_started;
+			std::uint64_t track_id;
+			ZoneId zone;
+
+			InnerTrackEnded(bool next_started, std::uint64_t track_id, ZoneId zone);
 		};
-		std::ostream& operator<<(std::ostream& os, const InnerTaskEnded& m);
+		std::ostream& operator<<(std::ostream& os, const InnerTrackEnded& m);
 	} // namespace In
 
-	namespace Out
+	// "Latest wins" in messages: while one of them is the last message queued for a zone, the
+	// newer ones replace its content instead of being queued behind it (slider drags send one
+	// message per frame). Once another message of the zone is queued, they are queued after it.
+	template<typename Message>
+	struct is_latest_wins : std::false_type
+	{
+	};
+	template<>
+	struct is_latest_wins<In::Volume> : std::true_type
 	{
+	};
+	template<>
+	struct is_latest_wins<In::MusicOffset> : std::true_type
+	{
+	};
 
-		struct MusicOffset
-		{
-			float seconds;
+	template<typename Message, typename = void>
+	struct has_zone : std::false_type
+	{
+	};
+	template<typename Message>
+	struct has_zone<Message, std::void_t<decltype(std::declval<Message&>().zone)>>
+	  : std::true_type
+	{
+	};
 
-			explicit MusicOffset(float seconds);
-		};
-		std::ostream& operator<<(std::ostream& os, const MusicOffset& m);
+	// requests of a zone dispatched in the queue order with its latest wins messages, the newer
+	// latest wins messages are queued after them (the events have their own lane)
+	template<typename Message>
+	struct closes_coalescing
+	  : std::bool_constant<has_zone<Message>::value && !is_latest_wins<Message>::value
+	                       && !std::is_same<Message, In::InnerTrackEnded>::value>
+	{
+	};
+
+	// requests ordering the controls of every zone: a control sent after them is dispatched after
+	template<typename Message>
+	struct orders_all_zones
+	  : std::bool_constant<std::is_same<Message, In::Close>::value
+	                       || std::is_same<Message, In::Settings>::value>
+	{
+	};
+
+	// index of the alternative Message of a message variant
+	template<typename Variant, typename Message>
+	struct variant_index;
+	template<typename Message, typename... Alternatives>
+	struct variant_index<std::variant<Alternatives...>, Message>
+	{
+		static constexpr std::size_t value = []() {
+			constexpr bool same[] = {std::is_same<Alternatives, Message>::value...};
+			std::size_t index = 0;
+			while(index < sizeof...(Alternatives) && !same[index])
+			{
+				++index;
+			}
+			return index;
+		}();
+		static_assert(value < sizeof...(Alternatives), "Message is not an alternative");
+	};
+
+	namespace Out
+	{
 
 		struct MusicInfo
 		{
 			bool valid;
 			float durationSeconds;
+			ZoneId zone;
 
-			MusicInfo(bool valid, float durationSeconds);
+			MusicInfo(bool valid, float durationSeconds, ZoneId zone = MAIN_ZONE);
 		};
 		std::ostream& operator<<(std::ostream& os, const MusicInfo& m);
 
@@ -149,34 +253,132 @@ namespace Msg
 			explicit Settings(data::Settings settings);
 		};
 		std::ostream& operator<<(std::ostream& os, const Settings& m);
+
+		struct Waveform
+		{
+			std::shared_ptr<const data::Waveform> waveform;
+
+			explicit Waveform(std::shared_ptr<const data::Waveform> waveform);
+		};
+		std::ostream& operator<<(std::ostream& os, const Waveform& m);
 	} // namespace Out
 
 	struct Com final
 	{
 		typedef std::variant<In::Close,
 		                     In::Open,
+		                     In::Enqueue,
 		                     In::Control,
 		                     In::Volume,
 		                     In::MusicOffset,
-		                     In::RequestMusicOffset,
 		                     In::Settings,
 		                     In::RequestDatabase,
-		                     In::InnerTaskEnded>
+		                     In::InnerTrackEnded>
 		  InMessage;
-		typedef std::variant<Out::MusicOffset,
-		                     Out::MusicInfo,
+		typedef std::variant<Out::MusicInfo,
 		                     Out::FolderContent,
 		                     Out::Database,
-		                     Out::Settings>
+		                     Out::Settings,
+		                     Out::Waveform>
 		  OutMessage;
-		shared_queue<InMessage> in;
-		shared_queue<OutMessage, true> out;
+
+		// in message and its sending time, for the dispatch metrics
+		struct InEnvelope
+		{
+			InMessage message;
+			std::chrono::steady_clock::time_point sent;
+
+			template<typename Message, typename... Args>
+			explicit InEnvelope(std::in_place_type_t<Message> type, Args&&... args);
+			explicit InEnvelope(InMessage message);
+		};
+
+		// out message and its queuing time when the message tracing is enabled
+		struct OutEnvelope : tracing::Stamp
+		{
+			OutMessage message;
+
+			template<typename Message, typename... Args>
+			explicit OutEnvelope(std::in_place_type_t<Message> type, Args&&... args);
+		};
+
+		[[nodiscard]] static Lane lane(const InMessage& message) noexcept;
+
+		// posted by the view, the control server and the background tasks, read by the logic
+		shared_queue<InEnvelope, true, lock_free_mpsc> in;
+		typedef std::deque<OutEnvelope> OutMessages;
+		shared_queue<OutEnvelope, true, OutMessages> out;
+
+		// lock-free playback position of each zone, published by the audio side
+		std::array<audio::PlaybackState, MAX_ZONES> playback;
+
+		// lock-free output analysis, only computed while the view enables it
+		triple_buffer<data::Spectrum> spectrum;
+		std::atomic<bool> spectrum_enabled{false};
+
+		// optional, called by the sender thread after each out message is queued,
+		// set before the logic runs for consumers waiting on something else than the queue
+		std::function<void()> out_listener;
 
 		template<typename Message, typename... Args>
 		void sendInMessage(Args&&... args);
 
+		// one push for all the messages, the latest wins ones are coalesced, messages is cleared
+		void sendInMessages(std::vector<InEnvelope>& messages);
+
 		template<typename Message, typename... Args>
 		void sendOutMessage(Args&&... args);
+
+		// logic thread, before handling a dispatched message: a latest wins message takes the
+		// content of the newer ones coalesced while it was queued
+		void takeLatest(InEnvelope& envelope);
+
+		// in messages replaced by a newer one since the start
+		[[nodiscard]] std::uint64_t coalescedCount() const noexcept;
+
+	private:
+		struct CoalescingSlot
+		{
+			std::mutex mutex;
+			// newer content of each queued message of the slot, in the queue order
+			std::deque<std::optional<InMessage>> queued;
+			// the last queued message of the slot is still the last one of its zone
+			bool open = false;
+		};
+
+		// nullptr if the message is not latest wins
+		[[nodiscard]] CoalescingSlot* coalescingSlot(const InMessage& message) noexcept;
+
+		// return true if the message replaced the content of a queued one
+		bool coalesce(InEnvelope& envelope);
+
+		// before queuing a message closing the coalescing: the latest wins messages of its zone
+		// queued before it no longer take the content of the newer ones
+		void closeCoalescing(const InMessage& message);
+
+		// by message type and zone
+		std::array<CoalescingSlot, std::variant_size<InMessage>::value * MAX_ZONES>
+		  m_coalescing_slots;
+		std::atomic<std::uint64_t> m_coalesced{0};
+	};
+
+	// Logic thread, lane of the collected in messages. A control is queued in the requests lane,
+	// behind them, while a request of its zone (or of all zones) collected before it waits there:
+	// the open of a music is not overtaken by the position sent for the new music.
+	struct LaneRouter final
+	{
+		[[nodiscard]] Lane route(const Com::InMessage& message) noexcept;
+
+		// the message of the lane was dispatched
+		void dispatched(Lane lane, const Com::InMessage& message) noexcept;
+
+	private:
+		// add (or remove) a message of the requests lane
+		void count(const Com::InMessage& message, bool queued) noexcept;
+
+		// messages of the requests lane not yet dispatched, by zone
+		std::array<std::size_t, MAX_ZONES> m_zone_requests{};
+		std::size_t m_all_zones_requests = 0;
 	};
 
 	// Com proxy for sending messages
@@ -195,16 +397,62 @@ namespace Msg
 	};
 } // namespace Msg
 
+template<typename Message, typename... Args>
+Msg::Com::InEnvelope::InEnvelope(std::in_place_type_t<Message> type, Args&&... args)
+  : message(type, std::forward<Args>(args)...), sent(std::chrono::steady_clock::now())
+{
+}
+
+template<typename Message, typename... Args>
+Msg::Com::OutEnvelope::OutEnvelope(std::in_place_type_t<Message> type, Args&&... args)
+  : tracing::Stamp(), message(type, std::forward<Args>(args)...)
+{
+}
+
 template<typename Message, typename... Args>
 void Msg::Com::sendInMessage(Args&&... args)
 {
-	in.emplace_back(std::in_place_type_t<Message>{}, std::forward<Args>(args)...);
+	if constexpr(is_latest_wins<Message>::value)
+	{
+		InEnvelope envelope(std::in_place_type_t<Message>{}, std::forward<Args>(args)...);
+		if(coalesce(envelope))
+		{
+			return;
+		}
+		in.push_back(std::move(envelope));
+	}
+	else if constexpr(closes_coalescing<Message>::value)
+	{
+		InEnvelope envelope(std::in_place_type_t<Message>{}, std::forward<Args>(args)...);
+		closeCoalescing(envelope.message);
+		in.push_back(std::move(envelope));
+	}
+	else
+	{
+		in.emplace_back(std::in_place_type_t<Message>{}, std::forward<Args>(args)...);
+	}
+	if constexpr(tracing::ENABLED)
+	{
+		tracing::recordEnqueue(tracing::Direction::IN,
+		                       variant_index<InMessage, Message>::value,
+		                       in.size());
+	}
 }
 
 template<typename Message, typename... Args>
 void Msg::Com::sendOutMessage(Args&&... args)
 {
 	out.emplace_back(std::in_place_type_t<Message>{}, std::forward<Args>(args)...);
+	if constexpr(tracing::ENABLED)
+	{
+		tracing::recordEnqueue(tracing::Direction::OUT,
+		                       variant_index<OutMessage, Message>::value,
+		                       out.size());
+	}
+	if(out_listener)
+	{
+		out_listener();
+	}
 }
 
 template<typename Message, typename... Args>
@@ -14,7 +14,9 @@
 #include <array>
 #include <filesystem>
 
-constexpr std::array<std::string_view, 4> SUPPORTED_AUDIO_EXTENSIONS = {".vaw",
+// Hint for the file explorer, which doesn't open the listed files.
+// The database generation and the playback probe the content of the files.
+constexpr std::array<std::string_view, 4> SUPPORTED_AUDIO_EXTENSIONS = {".wav",
                                                                         ".ogg",
                                                                         ".flac",
                                                                         ".mp3"};
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_EVENT_POLLER_HPP
+#define MAGICPLAYER_EVENT_POLLER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#if defined(__linux__)
+#	define MAGICPLAYER_EVENT_POLLER_EPOLL
+#elif defined(__unix__) || defined(__APPLE__)
+#	define MAGICPLAYER_EVENT_POLLER_POLL
+#endif
+
+// Readiness of non-blocking file descriptors: epoll on Linux, poll() on other Unix systems.
+// Level triggered, all registered descriptors are watched for reading, writing is only watched
+// when asked (while there is pending output). Not thread safe, used by one event loop thread.
+class event_poller final
+{
+public:
+	struct event
+	{
+		int fd;
+		bool readable;
+		bool writable;
+		bool error; // error or hang up, reading gives the details
+	};
+
+	event_poller() noexcept;
+
+	event_poller(const event_poller&) = delete;
+	event_poller& operator=(const event_poller&) = delete;
+
+	event_poller(event_poller&&) = delete;
+	event_poller& operator=(event_poller&&) = delete;
+
+	~event_poller() noexcept;
+
+	// false if the platform has no poller or its creation failed
+	[[nodiscard]] bool valid() const noexcept;
+
+	bool add(int fd, bool watch_writable = false);
+	bool modify(int fd, bool watch_writable);
+	void remove(int fd);
+
+	// wait for events (timeout in ms, -1: no timeout), return false on failure,
+	// true with no events if interrupted by a signal
+	bool wait(std::vector<event>& events, int timeout_ms = -1);
+
+private:
+#if defined(MAGICPLAYER_EVENT_POLLER_EPOLL)
+	int m_epoll_fd;
+	std::size_t m_fd_count;
+#elif defined(MAGICPLAYER_EVENT_POLLER_POLL)
+	struct watched
+	{
+		int fd;
+		bool writable;
+	};
+	std::vector<watched> m_watched;
+#endif
+};
+
+#endif //MAGICPLAYER_EVENT_POLLER_HPP
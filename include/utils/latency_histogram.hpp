@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_LATENCY_HISTOGRAM_HPP
+#define MAGICPLAYER_LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Histogram of values (durations in ns, queue depths) with power of two buckets.
+// record() must only be called by one thread, without lock nor read-modify-write: each thread
+// records in its own histograms. Any thread can read them concurrently with add_to().
+class latency_histogram final
+{
+public:
+	static constexpr std::size_t BUCKET_COUNT = 64;
+
+	// sum of histograms, percentiles are the upper bounds of their buckets
+	struct summary
+	{
+		std::uint64_t count = 0;
+		std::uint64_t sum = 0;
+		std::uint64_t max = 0;
+		std::array<std::uint64_t, BUCKET_COUNT> buckets{};
+
+		[[nodiscard]] std::uint64_t mean() const noexcept;
+		[[nodiscard]] std::uint64_t percentile(double ratio) const noexcept;
+	};
+
+	latency_histogram() noexcept;
+
+	latency_histogram(const latency_histogram&) = delete;
+	latency_histogram& operator=(const latency_histogram&) = delete;
+
+	latency_histogram(latency_histogram&&) = delete;
+	latency_histogram& operator=(latency_histogram&&) = delete;
+
+	~latency_histogram() noexcept = default;
+
+	// writer thread
+	void record(std::uint64_t value) noexcept;
+
+	// any thread
+	void add_to(summary& summary_) const noexcept;
+
+private:
+	// bucket b > 0 holds the values of [2^(b-1), 2^b)
+	[[nodiscard]] static std::size_t bucket(std::uint64_t value) noexcept;
+
+	static void increase(std::atomic<std::uint64_t>& counter, std::uint64_t value) noexcept;
+
+	std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> m_buckets;
+	std::atomic<std::uint64_t> m_count;
+	std::atomic<std::uint64_t> m_sum;
+	std::atomic<std::uint64_t> m_max;
+};
+
+inline std::uint64_t latency_histogram::summary::mean() const noexcept
+{
+	return count != 0 ? sum / count : 0;
+}
+
+inline std::uint64_t latency_histogram::summary::percentile(double ratio) const noexcept
+{
+	if(count == 0)
+	{
+		return 0;
+	}
+	const auto rank = static_cast<std::uint64_t>(ratio * static_cast<double>(count - 1)) + 1;
+	std::uint64_t seen = 0;
+	for(std::size_t b = 0; b < BUCKET_COUNT; ++b)
+	{
+		seen += buckets[b];
+		if(seen >= rank)
+		{
+			const std::uint64_t upper_bound = b == 0 ? 0 : (std::uint64_t(1) << b) - 1;
+			return std::min(upper_bound, max);
+		}
+	}
+	return max;
+}
+
+inline latency_histogram::latency_histogram() noexcept
+  : m_buckets(), m_count(0), m_sum(0), m_max(0)
+{
+	for(std::atomic<std::uint64_t>& bucket_: m_buckets)
+	{
+		bucket_.store(0, std::memory_order_relaxed);
+	}
+}
+
+inline void latency_histogram::record(std::uint64_t value) noexcept
+{
+	increase(m_buckets[bucket(value)], 1);
+	increase(m_count, 1);
+	increase(m_sum, value);
+	if(value > m_max.load(std::memory_order_relaxed))
+	{
+		m_max.store(value, std::memory_order_relaxed);
+	}
+}
+
+inline void latency_histogram::add_to(summary& summary_) const noexcept
+{
+	for(std::size_t b = 0; b < BUCKET_COUNT; ++b)
+	{
+		summary_.buckets[b] += m_buckets[b].load(std::memory_order_relaxed);
+	}
+	summary_.count += m_count.load(std::memory_order_relaxed);
+	summary_.sum += m_sum.load(std::memory_order_relaxed);
+	summary_.max = std::max(summary_.max, m_max.load(std::memory_order_relaxed));
+}
+
+inline std::size_t latency_histogram::bucket(std::uint64_t value) noexcept
+{
+	std::size_t b = 0;
+	while(value != 0 && b < BUCKET_COUNT - 1)
+	{
+		value >>= 1u;
+		++b;
+	}
+	return b;
+}
+
+inline void latency_histogram::increase(std::atomic<std::uint64_t>& counter,
+                                        std::uint64_t value) noexcept
+{
+	// single writer: no read-modify-write needed
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+#endif //MAGICPLAYER_LATENCY_HISTOGRAM_HPP
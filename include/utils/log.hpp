@@ -18,8 +18,10 @@
 constexpr const char* GENERAL_LOGGER_NAME = "general";
 constexpr const char* LOGIC_LOGGER_NAME = "logic";
 constexpr const char* VIEW_LOGGER_NAME = "view";
+constexpr const char* CONTROL_LOGGER_NAME = "control";
 
-constexpr const char* LOGGERS_NAMES[] = {GENERAL_LOGGER_NAME, LOGIC_LOGGER_NAME, VIEW_LOGGER_NAME};
+constexpr const char* LOGGERS_NAMES[] = {
+  GENERAL_LOGGER_NAME, LOGIC_LOGGER_NAME, VIEW_LOGGER_NAME, CONTROL_LOGGER_NAME};
 
 extern const std::shared_ptr<spdlog::logger> NULL_LOGGER;
 
@@ -30,6 +32,7 @@ inline std::ostream& operator<<(std::ostream& os, const std::filesystem::path& p
 	return os << '\"' << path_to_generic_utf8_string(p) << '\"';
 }
 
-bool init_logger();
+// the stored logs are only displayed by the view logs console
+bool init_logger(bool store_logs = true);
 
 #endif //MAGICPLAYER_LOG_HPP
@@ -8,11 +8,24 @@
 #ifndef MAGICPLAYER_SHARED_QUEUE_HPP
 #define MAGICPLAYER_SHARED_QUEUE_HPP
 
+#include "utils/wake_signal.hpp"
+
 #include <deque>
+#include <iterator>
 #include <atomic>
 #include <mutex>
+#include <optional>
+#include <type_traits>
 #include <condition_variable>
 
+// Container tag selecting the lock-free multiple producers/single consumer implementation:
+// push_back() and emplace_back() from any thread never lock, front() and pop_front() must
+// only be called by one consumer thread, which sleeps on a futex while the queue is empty.
+// The size is always atomic: shared_queue<T, true, lock_free_mpsc>.
+struct lock_free_mpsc final
+{
+};
+
 template<typename T, bool atomic_size = false, typename Container = std::deque<T>>
 class shared_queue
 {
@@ -21,6 +34,9 @@ class shared_queue
 template<typename T, typename Container>
 class shared_queue<T, false, Container>
 {
+	static_assert(!std::is_same<Container, lock_free_mpsc>::value,
+	              "the lock-free queue size is always atomic");
+
 public:
 	typedef T value_type;
 	typedef typename Container::size_type size_type;
@@ -33,9 +49,21 @@ public:
 	void push_back(const value_type& item);
 	void push_back(value_type&& item);
 
+	// one lock and one notification for all the items
+	template<typename InputIt>
+	void push_back(InputIt first, InputIt last);
+
 	template<typename... Args>
 	void emplace_back(Args&&... args);
 
+	// one lock for all the items: move them at the end of items, return their count
+	template<typename OutputContainer>
+	size_type drain(OutputContainer& items);
+
+	// one lock, constant time: exchange the content of the queue and items,
+	// an empty items takes all the queued items and gives its memory to the queue
+	void swap_all(Container& items);
+
 	size_type size();
 	bool empty();
 
@@ -60,9 +88,21 @@ public:
 	void push_back(const value_type& item);
 	void push_back(value_type&& item);
 
+	// one lock and one notification for all the items
+	template<typename InputIt>
+	void push_back(InputIt first, InputIt last);
+
 	template<typename... Args>
 	void emplace_back(Args&&... args);
 
+	// one lock for all the items: move them at the end of items, return their count
+	template<typename OutputContainer>
+	size_type drain(OutputContainer& items);
+
+	// one lock, constant time: exchange the content of the queue and items,
+	// an empty items takes all the queued items and gives its memory to the queue
+	void swap_all(Container& items);
+
 	size_type size();
 	bool empty();
 
@@ -73,6 +113,80 @@ private:
 	std::condition_variable m_cond;
 };
 
+template<typename T>
+class shared_queue<T, true, lock_free_mpsc>
+{
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+
+	shared_queue();
+
+	shared_queue(const shared_queue&) = delete;
+	shared_queue& operator=(const shared_queue&) = delete;
+
+	shared_queue(shared_queue&&) = delete;
+	shared_queue& operator=(shared_queue&&) = delete;
+
+	~shared_queue() noexcept;
+
+	// consumer side
+	value_type& front();
+	void pop_front();
+
+	// producer side
+	void push_back(const value_type& item);
+	void push_back(value_type&& item);
+
+	// one exchange and one notification for all the items
+	template<typename InputIt>
+	void push_back(InputIt first, InputIt last);
+
+	template<typename... Args>
+	void emplace_back(Args&&... args);
+
+	// consumer side, no wait: move the available items at the end of items, return their count
+	template<typename OutputContainer>
+	size_type drain(OutputContainer& items);
+
+	// consumer side, return when the queue is not empty
+	void wait();
+
+	// consumer side, also return when ready() is true: the consumer waits for another source,
+	// whose producers make ready() true then call notify()
+	template<typename Ready>
+	void wait(Ready&& ready);
+
+	// producer side of the other source of wait(ready)
+	void notify() noexcept;
+
+	size_type size() noexcept;
+	bool empty() noexcept;
+
+private:
+	static constexpr size_type CACHE_LINE_SIZE = 64;
+	// polls before sleeping, bursts of messages are consumed without system calls
+	static constexpr int SPIN_COUNT = 64;
+
+	// the consumer tail is a stub whose value was consumed, the items are in the next nodes
+	struct node
+	{
+		std::atomic<node*> next{nullptr};
+		std::optional<value_type> value;
+	};
+
+	// link the producer chain [first, last] after the current head
+	void link(node* first, node* last, size_type count) noexcept;
+	node* wait_next();
+
+	// producers
+	alignas(CACHE_LINE_SIZE) std::atomic<node*> m_head;
+	std::atomic<size_type> m_size;
+	// consumer
+	alignas(CACHE_LINE_SIZE) node* m_tail;
+	wake_signal m_signal;
+};
+
 template<typename T, typename Container>
 shared_queue<T, true, Container>::shared_queue() noexcept(noexcept(Container{}))
   : m_size(m_queue.size())
@@ -154,6 +268,28 @@ void shared_queue<T, true, Container>::push_back(
 	m_cond.notify_one();
 }
 
+template<typename T, typename Container>
+template<typename InputIt>
+void shared_queue<T, false, Container>::push_back(InputIt first, InputIt last)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queue.insert(m_queue.end(), first, last);
+	lock.unlock();
+	m_cond.notify_one();
+}
+
+template<typename T, typename Container>
+template<typename InputIt>
+void shared_queue<T, true, Container>::push_back(InputIt first, InputIt last)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	const size_type previous_size = m_queue.size();
+	m_queue.insert(m_queue.end(), first, last);
+	m_size += m_queue.size() - previous_size;
+	lock.unlock();
+	m_cond.notify_one();
+}
+
 template<typename T, typename Container>
 template<typename... Args>
 void shared_queue<T, false, Container>::emplace_back(Args&&... args)
@@ -175,6 +311,62 @@ void shared_queue<T, true, Container>::emplace_back(Args&&... args)
 	m_cond.notify_one();
 }
 
+template<typename T, typename Container>
+template<typename OutputContainer>
+typename shared_queue<T, false, Container>::size_type
+shared_queue<T, false, Container>::drain(OutputContainer& items)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	const size_type count = m_queue.size();
+	items.insert(items.end(),
+	             std::make_move_iterator(m_queue.begin()),
+	             std::make_move_iterator(m_queue.end()));
+	m_queue.clear();
+	return count;
+}
+
+template<typename T, typename Container>
+template<typename OutputContainer>
+typename shared_queue<T, true, Container>::size_type
+shared_queue<T, true, Container>::drain(OutputContainer& items)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	const size_type count = m_queue.size();
+	items.insert(items.end(),
+	             std::make_move_iterator(m_queue.begin()),
+	             std::make_move_iterator(m_queue.end()));
+	m_queue.clear();
+	m_size = 0;
+	return count;
+}
+
+template<typename T, typename Container>
+void shared_queue<T, false, Container>::swap_all(Container& items)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queue.swap(items);
+	const bool notify = !m_queue.empty();
+	lock.unlock();
+	if(notify)
+	{
+		m_cond.notify_one();
+	}
+}
+
+template<typename T, typename Container>
+void shared_queue<T, true, Container>::swap_all(Container& items)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queue.swap(items);
+	m_size = m_queue.size();
+	const bool notify = !m_queue.empty();
+	lock.unlock();
+	if(notify)
+	{
+		m_cond.notify_one();
+	}
+}
+
 template<typename T, typename Container>
 typename shared_queue<T, false, Container>::size_type shared_queue<T, false, Container>::size()
 {
@@ -201,4 +393,205 @@ bool shared_queue<T, true, Container>::empty()
 	return m_size == 0;
 }
 
+template<typename T>
+shared_queue<T, true, lock_free_mpsc>::shared_queue()
+  : m_head(new node), m_size(0), m_tail(m_head.load(std::memory_order_relaxed)), m_signal()
+{
+}
+
+template<typename T>
+shared_queue<T, true, lock_free_mpsc>::~shared_queue() noexcept
+{
+	while(m_tail != nullptr)
+	{
+		node* next = m_tail->next.load(std::memory_order_relaxed);
+		delete m_tail;
+		m_tail = next;
+	}
+}
+
+template<typename T>
+typename shared_queue<T, true, lock_free_mpsc>::value_type&
+shared_queue<T, true, lock_free_mpsc>::front()
+{
+	return *wait_next()->value;
+}
+
+template<typename T>
+void shared_queue<T, true, lock_free_mpsc>::pop_front()
+{
+	node* next = wait_next();
+	next->value.reset();
+	delete m_tail;
+	m_tail = next;
+	m_size.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+void shared_queue<T, true, lock_free_mpsc>::push_back(
+  const typename shared_queue<T, true, lock_free_mpsc>::value_type& item)
+{
+	emplace_back(item);
+}
+
+template<typename T>
+void shared_queue<T, true, lock_free_mpsc>::push_back(
+  typename shared_queue<T, true, lock_free_mpsc>::value_type&& item)
+{
+	emplace_back(std::move(item));
+}
+
+template<typename T>
+template<typename InputIt>
+void shared_queue<T, true, lock_free_mpsc>::push_back(InputIt first, InputIt last)
+{
+	if(first == last)
+	{
+		return;
+	}
+
+	// private chain, published at once
+	node* chain_first = new node;
+	node* chain_last = chain_first;
+	size_type count = 1;
+	try
+	{
+		chain_first->value.emplace(*first);
+		for(++first; first != last; ++first)
+		{
+			node* item = new node;
+			chain_last->next.store(item, std::memory_order_relaxed);
+			chain_last = item;
+			item->value.emplace(*first);
+			++count;
+		}
+	}
+	catch(...)
+	{
+		while(chain_first != nullptr)
+		{
+			node* next = chain_first->next.load(std::memory_order_relaxed);
+			delete chain_first;
+			chain_first = next;
+		}
+		throw;
+	}
+	link(chain_first, chain_last, count);
+}
+
+template<typename T>
+template<typename... Args>
+void shared_queue<T, true, lock_free_mpsc>::emplace_back(Args&&... args)
+{
+	node* item = new node;
+	try
+	{
+		item->value.emplace(std::forward<Args>(args)...);
+	}
+	catch(...)
+	{
+		delete item;
+		throw;
+	}
+	link(item, item, 1);
+}
+
+template<typename T>
+template<typename OutputContainer>
+typename shared_queue<T, true, lock_free_mpsc>::size_type
+shared_queue<T, true, lock_free_mpsc>::drain(OutputContainer& items)
+{
+	size_type count = 0;
+	for(node* next = m_tail->next.load(std::memory_order_acquire); next != nullptr;
+	    next = m_tail->next.load(std::memory_order_acquire))
+	{
+		items.push_back(std::move(*next->value));
+		next->value.reset();
+		delete m_tail;
+		m_tail = next;
+		++count;
+	}
+	m_size.fetch_sub(count, std::memory_order_relaxed);
+	return count;
+}
+
+template<typename T>
+void shared_queue<T, true, lock_free_mpsc>::wait()
+{
+	wait_next();
+}
+
+template<typename T>
+template<typename Ready>
+void shared_queue<T, true, lock_free_mpsc>::wait(Ready&& ready)
+{
+	for(;;)
+	{
+		const std::uint32_t token = m_signal.prepare();
+		if(m_tail->next.load(std::memory_order_seq_cst) != nullptr || ready())
+		{
+			m_signal.cancel();
+			return;
+		}
+		m_signal.wait(token);
+	}
+}
+
+template<typename T>
+void shared_queue<T, true, lock_free_mpsc>::notify() noexcept
+{
+	m_signal.notify();
+}
+
+template<typename T>
+typename shared_queue<T, true, lock_free_mpsc>::size_type
+shared_queue<T, true, lock_free_mpsc>::size() noexcept
+{
+	return m_size.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+bool shared_queue<T, true, lock_free_mpsc>::empty() noexcept
+{
+	return m_size.load(std::memory_order_relaxed) == 0;
+}
+
+template<typename T>
+void shared_queue<T, true, lock_free_mpsc>::link(node* first,
+                                                 node* last,
+                                                 size_type count) noexcept
+{
+	m_size.fetch_add(count, std::memory_order_relaxed);
+	node* previous = m_head.exchange(last, std::memory_order_acq_rel);
+	// until this store the consumer sees the queue empty at previous and waits,
+	// seq_cst: ordered with the wake signal check of the sleeping consumer
+	previous->next.store(first, std::memory_order_seq_cst);
+	m_signal.notify();
+}
+
+template<typename T>
+typename shared_queue<T, true, lock_free_mpsc>::node*
+shared_queue<T, true, lock_free_mpsc>::wait_next()
+{
+	for(int i = 0; i < SPIN_COUNT; ++i)
+	{
+		node* next = m_tail->next.load(std::memory_order_acquire);
+		if(next != nullptr)
+		{
+			return next;
+		}
+	}
+	for(;;)
+	{
+		const std::uint32_t token = m_signal.prepare();
+		node* next = m_tail->next.load(std::memory_order_seq_cst);
+		if(next != nullptr)
+		{
+			m_signal.cancel();
+			return next;
+		}
+		m_signal.wait(token);
+	}
+}
+
 #endif //MAGICPLAYER_SHARED_QUEUE_HPP
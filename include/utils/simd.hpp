@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_SIMD_HPP
+#define MAGICPLAYER_SIMD_HPP
+
+// SSE2 is selected at compile time (always available on x86-64),
+// AVX2 at run time: AVX2 functions are compiled with a target attribute and only called
+// when simd::has_avx2() is true, the rest of the program keeps the default instruction set.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define MAGICPLAYER_SIMD_SSE2
+#endif
+
+#if defined(MAGICPLAYER_SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#	define MAGICPLAYER_SIMD_AVX2
+#endif
+
+#if defined(MAGICPLAYER_SIMD_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#	define MAGICPLAYER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#	define MAGICPLAYER_TARGET_AVX2
+#endif
+
+namespace simd
+{
+	bool has_sse2() noexcept;
+
+	bool has_avx2() noexcept;
+} // namespace simd
+
+#endif //MAGICPLAYER_SIMD_HPP
@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_SLOT_MAP_HPP
+#define MAGICPLAYER_SLOT_MAP_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Values indexed by generated keys, insertion, lookup and removal in constant time.
+// A key is the slot index and the slot generation, incremented when the value is erased:
+// the key of an erased value is never valid again, even if its slot is reused.
+// Not thread safe, values move when the slots grow.
+template<typename T>
+class slot_map final
+{
+public:
+	typedef T value_type;
+	typedef std::uint64_t key_type;
+	typedef std::size_t size_type;
+
+	static constexpr key_type INVALID_KEY = 0;
+
+	slot_map() noexcept = default;
+
+	template<typename... Args>
+	[[nodiscard]] key_type emplace(Args&&... args);
+
+	// nullptr if the key is invalid or erased
+	[[nodiscard]] value_type* find(key_type key) noexcept;
+	[[nodiscard]] const value_type* find(key_type key) const noexcept;
+
+	// false if the key is invalid or erased
+	bool erase(key_type key) noexcept;
+
+	void clear() noexcept;
+
+	[[nodiscard]] size_type size() const noexcept;
+	[[nodiscard]] bool empty() const noexcept;
+
+private:
+	struct slot
+	{
+		// odd while the slot holds a value, the first key has generation 1 and is never 0
+		std::uint32_t generation = 0;
+		std::optional<value_type> value;
+	};
+
+	[[nodiscard]] slot* find_slot(key_type key) noexcept;
+
+	std::vector<slot> m_slots;
+	std::vector<std::uint32_t> m_free_slots;
+	size_type m_size = 0;
+};
+
+template<typename T>
+template<typename... Args>
+typename slot_map<T>::key_type slot_map<T>::emplace(Args&&... args)
+{
+	std::uint32_t index;
+	if(m_free_slots.empty())
+	{
+		assert(m_slots.size() < UINT32_MAX);
+		index = static_cast<std::uint32_t>(m_slots.size());
+		// erase() can always free the slot
+		m_free_slots.reserve(m_slots.size() + 1);
+		m_slots.emplace_back();
+	}
+	else
+	{
+		index = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+
+	slot& slot_ = m_slots[index];
+	try
+	{
+		slot_.value.emplace(std::forward<Args>(args)...);
+	}
+	catch(...)
+	{
+		m_free_slots.push_back(index);
+		throw;
+	}
+	++slot_.generation;
+	++m_size;
+	return (static_cast<key_type>(slot_.generation) << 32u) | index;
+}
+
+template<typename T>
+typename slot_map<T>::value_type* slot_map<T>::find(key_type key) noexcept
+{
+	slot* slot_ = find_slot(key);
+	return slot_ != nullptr ? &*slot_->value : nullptr;
+}
+
+template<typename T>
+const typename slot_map<T>::value_type* slot_map<T>::find(key_type key) const noexcept
+{
+	return const_cast<slot_map<T>*>(this)->find(key);
+}
+
+template<typename T>
+bool slot_map<T>::erase(key_type key) noexcept
+{
+	slot* slot_ = find_slot(key);
+	if(slot_ == nullptr)
+	{
+		return false;
+	}
+	slot_->value.reset();
+	++slot_->generation;
+	--m_size;
+	// capacity reserved by emplace(), never throws
+	m_free_slots.push_back(static_cast<std::uint32_t>(key));
+	return true;
+}
+
+template<typename T>
+void slot_map<T>::clear() noexcept
+{
+	for(std::size_t index = 0; index < m_slots.size(); ++index)
+	{
+		slot& slot_ = m_slots[index];
+		if(slot_.value.has_value())
+		{
+			slot_.value.reset();
+			++slot_.generation;
+			m_free_slots.push_back(static_cast<std::uint32_t>(index));
+		}
+	}
+	m_size = 0;
+}
+
+template<typename T>
+typename slot_map<T>::size_type slot_map<T>::size() const noexcept
+{
+	return m_size;
+}
+
+template<typename T>
+bool slot_map<T>::empty() const noexcept
+{
+	return m_size == 0;
+}
+
+template<typename T>
+typename slot_map<T>::slot* slot_map<T>::find_slot(key_type key) noexcept
+{
+	const auto index = static_cast<std::uint32_t>(key);
+	const auto generation = static_cast<std::uint32_t>(key >> 32u);
+	if(index >= m_slots.size() || m_slots[index].generation != generation
+	   || !m_slots[index].value.has_value())
+	{
+		return nullptr;
+	}
+	return &m_slots[index];
+}
+
+#endif //MAGICPLAYER_SLOT_MAP_HPP
@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_SPSC_RING_BUFFER_HPP
+#define MAGICPLAYER_SPSC_RING_BUFFER_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+// Lock-free single-producer/single-consumer ring buffer of trivially copyable elements.
+// push() must only be called by the producer thread, pop() only by the consumer thread.
+// clear() and resize() require that neither of them is running.
+template<typename T>
+class spsc_ring_buffer final
+{
+	static_assert(std::is_trivially_copyable<T>::value, "spsc_ring_buffer requires trivial types");
+
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+
+	spsc_ring_buffer() noexcept;
+	explicit spsc_ring_buffer(size_type min_capacity);
+
+	spsc_ring_buffer(const spsc_ring_buffer&) = delete;
+	spsc_ring_buffer& operator=(const spsc_ring_buffer&) = delete;
+
+	spsc_ring_buffer(spsc_ring_buffer&&) = delete;
+	spsc_ring_buffer& operator=(spsc_ring_buffer&&) = delete;
+
+	~spsc_ring_buffer() noexcept = default;
+
+	// capacity is rounded up to the next power of two
+	void resize(size_type min_capacity);
+	void clear() noexcept;
+
+	size_type capacity() const noexcept;
+
+	// producer side
+	size_type write_available() const noexcept;
+	size_type push(const value_type* data, size_type count) noexcept;
+
+	// consumer side
+	size_type read_available() const noexcept;
+	size_type pop(value_type* data, size_type count) noexcept;
+
+private:
+	static constexpr size_type CACHE_LINE_SIZE = 64;
+
+	std::unique_ptr<value_type[]> m_buffer;
+	size_type m_capacity;
+	size_type m_mask;
+
+	// indexes are never wrapped, only masked on access
+	alignas(CACHE_LINE_SIZE) std::atomic<size_type> m_write_index;
+	alignas(CACHE_LINE_SIZE) std::atomic<size_type> m_read_index;
+};
+
+template<typename T>
+spsc_ring_buffer<T>::spsc_ring_buffer() noexcept
+  : m_buffer(), m_capacity(0), m_mask(0), m_write_index(0), m_read_index(0)
+{
+}
+
+template<typename T>
+spsc_ring_buffer<T>::spsc_ring_buffer(size_type min_capacity): spsc_ring_buffer()
+{
+	resize(min_capacity);
+}
+
+template<typename T>
+void spsc_ring_buffer<T>::resize(size_type min_capacity)
+{
+	size_type capacity = 1;
+	while(capacity < min_capacity)
+	{
+		capacity <<= 1;
+	}
+	if(capacity != m_capacity)
+	{
+		m_buffer = std::make_unique<value_type[]>(capacity);
+		m_capacity = capacity;
+		m_mask = capacity - 1;
+	}
+	clear();
+}
+
+template<typename T>
+void spsc_ring_buffer<T>::clear() noexcept
+{
+	m_write_index.store(0, std::memory_order_relaxed);
+	m_read_index.store(0, std::memory_order_release);
+}
+
+template<typename T>
+typename spsc_ring_buffer<T>::size_type spsc_ring_buffer<T>::capacity() const noexcept
+{
+	return m_capacity;
+}
+
+template<typename T>
+typename spsc_ring_buffer<T>::size_type spsc_ring_buffer<T>::write_available() const noexcept
+{
+	const size_type write_index = m_write_index.load(std::memory_order_relaxed);
+	const size_type read_index = m_read_index.load(std::memory_order_acquire);
+	return m_capacity - (write_index - read_index);
+}
+
+template<typename T>
+typename spsc_ring_buffer<T>::size_type spsc_ring_buffer<T>::push(const value_type* data,
+                                                                  size_type count) noexcept
+{
+	const size_type write_index = m_write_index.load(std::memory_order_relaxed);
+	const size_type read_index = m_read_index.load(std::memory_order_acquire);
+	count = std::min(count, m_capacity - (write_index - read_index));
+
+	const size_type offset = write_index & m_mask;
+	const size_type first_part = std::min(count, m_capacity - offset);
+	std::copy_n(data, first_part, m_buffer.get() + offset);
+	std::copy_n(data + first_part, count - first_part, m_buffer.get());
+
+	m_write_index.store(write_index + count, std::memory_order_release);
+	return count;
+}
+
+template<typename T>
+typename spsc_ring_buffer<T>::size_type spsc_ring_buffer<T>::read_available() const noexcept
+{
+	const size_type read_index = m_read_index.load(std::memory_order_relaxed);
+	const size_type write_index = m_write_index.load(std::memory_order_acquire);
+	return write_index - read_index;
+}
+
+template<typename T>
+typename spsc_ring_buffer<T>::size_type spsc_ring_buffer<T>::pop(value_type* data,
+                                                                 size_type count) noexcept
+{
+	const size_type read_index = m_read_index.load(std::memory_order_relaxed);
+	const size_type write_index = m_write_index.load(std::memory_order_acquire);
+	count = std::min(count, write_index - read_index);
+
+	const size_type offset = read_index & m_mask;
+	const size_type first_part = std::min(count, m_capacity - offset);
+	std::copy_n(m_buffer.get() + offset, first_part, data);
+	std::copy_n(m_buffer.get(), count - first_part, data + first_part);
+
+	m_read_index.store(read_index + count, std::memory_order_release);
+	return count;
+}
+
+#endif //MAGICPLAYER_SPSC_RING_BUFFER_HPP
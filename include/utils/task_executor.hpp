@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_TASK_EXECUTOR_HPP
+#define MAGICPLAYER_TASK_EXECUTOR_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed-size pool of worker threads running background tasks, created once.
+// Each worker has its own queues, tasks submitted from outside are distributed round-robin and
+// tasks submitted by a task go to the queue of its worker. A worker runs the oldest task of its
+// queue and steals the newest task of the others when its queue is empty. Priorities are strict
+// over the whole pool: no normal task starts while a high priority task is queued.
+// Tasks are move-only callables that must not throw.
+class task_executor final
+{
+public:
+	enum class priority
+	{
+		HIGH,
+		NORMAL,
+		LOW
+	};
+
+	explicit task_executor(std::size_t thread_count);
+
+	task_executor(const task_executor&) = delete;
+	task_executor& operator=(const task_executor&) = delete;
+
+	task_executor(task_executor&&) = delete;
+	task_executor& operator=(task_executor&&) = delete;
+
+	~task_executor() noexcept;
+
+	// thread safe, ignored once stopped
+	template<typename Function>
+	void submit(Function&& function, priority priority_ = priority::NORMAL);
+
+	// wait for the running tasks and drop the queued ones, no task can be submitted afterwards
+	void stop() noexcept;
+
+	[[nodiscard]] std::size_t threadCount() const noexcept;
+
+	// queued tasks, not started yet
+	[[nodiscard]] std::size_t pendingCount() const noexcept;
+
+private:
+	static constexpr std::size_t PRIORITY_COUNT = 3;
+
+	struct task
+	{
+		virtual ~task() noexcept = default;
+		virtual void run() noexcept = 0;
+	};
+
+	template<typename Function>
+	struct function_task final : task
+	{
+		explicit function_task(Function&& function_): function(std::move(function_))
+		{
+		}
+
+		void run() noexcept override
+		{
+			function();
+		}
+
+		Function function;
+	};
+
+	struct worker_queue
+	{
+		std::mutex mutex;
+		std::array<std::deque<std::unique_ptr<task>>, PRIORITY_COUNT> tasks;
+	};
+
+	void push(std::unique_ptr<task> task_, priority priority_);
+	[[nodiscard]] std::unique_ptr<task> take(std::size_t worker);
+	void work(std::size_t worker) noexcept;
+
+	std::vector<std::unique_ptr<worker_queue>> m_queues;
+	std::vector<std::thread> m_threads;
+	std::atomic<std::size_t> m_next_queue;
+	std::atomic<std::size_t> m_pending;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::atomic<bool> m_stopped;
+};
+
+template<typename Function>
+void task_executor::submit(Function&& function, priority priority_)
+{
+	using function_type = std::decay_t<Function>;
+	push(std::make_unique<function_task<function_type>>(
+	       function_type(std::forward<Function>(function))),
+	     priority_);
+}
+
+#endif //MAGICPLAYER_TASK_EXECUTOR_HPP
@@ -0,0 +1,243 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_TASK_FLOW_HPP
+#define MAGICPLAYER_TASK_FLOW_HPP
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Asynchronous flow of steps alternating between the thread owning the flow (an event loop)
+// and the worker threads, as a coroutine resumed on either side:
+//   task_flow<>()
+//     .on_worker([]() noexcept { return scan(); })
+//     .on_worker([](Result result) noexcept { save(result); return result; })
+//     .on_owner([](Result result) noexcept { publish(std::move(result)); });
+// Each step receives the value returned by the previous one. The steps and their values are
+// stored by value in the flow object: one allocation for the whole flow, no std::function.
+// The owner runs the flow with run(), the consecutive steps of the same side run in a row and
+// the side of the next step is returned, the owner schedules it. Steps must not throw.
+enum class flow_side
+{
+	OWNER,
+	WORKER,
+};
+
+class task_flow_base
+{
+public:
+	virtual ~task_flow_base() noexcept = default;
+
+	// run the next steps while they are on this side,
+	// return the side of the following step, nullopt once the flow ended
+	[[nodiscard]] virtual std::optional<flow_side> run(flow_side side) noexcept = 0;
+};
+
+template<flow_side Side, typename Function>
+struct flow_step
+{
+	static constexpr flow_side side = Side;
+	Function function;
+};
+
+namespace task_flow_detail
+{
+	// value returned by a step and moved to the next one
+	template<typename T>
+	struct step_value
+	{
+		std::optional<T> value;
+	};
+	template<>
+	struct step_value<void>
+	{
+	};
+
+	template<typename Input, typename Function>
+	struct invoke_result
+	{
+		using type = std::invoke_result_t<Function&, Input>;
+	};
+	template<typename Function>
+	struct invoke_result<void, Function>
+	{
+		using type = std::invoke_result_t<Function&>;
+	};
+
+	// tuple of the values returned by the steps
+	template<typename Input, typename... Steps>
+	struct values;
+	template<typename Input>
+	struct values<Input>
+	{
+		using type = std::tuple<>;
+	};
+	template<typename Input, typename Step, typename... Steps>
+	struct values<Input, Step, Steps...>
+	{
+		using result = typename invoke_result<Input, decltype(Step::function)>::type;
+		using next_values = typename values<result, Steps...>::type;
+		using type = decltype(std::tuple_cat(std::declval<std::tuple<step_value<result>>>(),
+		                                     std::declval<next_values>()));
+	};
+} // namespace task_flow_detail
+
+template<typename... Steps>
+class task_flow final : public task_flow_base
+{
+public:
+	task_flow() noexcept;
+
+	task_flow(const task_flow&) = delete;
+	task_flow& operator=(const task_flow&) = delete;
+
+	task_flow(task_flow&&) = default;
+	task_flow& operator=(task_flow&&) = default;
+
+	~task_flow() noexcept override = default;
+
+	// builders, the flow must not be started
+	template<typename Function>
+	[[nodiscard]] task_flow<Steps..., flow_step<flow_side::WORKER, std::decay_t<Function>>>
+	on_worker(Function&& function) &&;
+
+	template<typename Function>
+	[[nodiscard]] task_flow<Steps..., flow_step<flow_side::OWNER, std::decay_t<Function>>>
+	on_owner(Function&& function) &&;
+
+	[[nodiscard]] std::optional<flow_side> run(flow_side side) noexcept override;
+
+private:
+	template<typename...>
+	friend class task_flow;
+
+	static constexpr std::size_t STEP_COUNT = sizeof...(Steps);
+	static constexpr std::array<flow_side, STEP_COUNT> SIDES = {Steps::side...};
+
+	explicit task_flow(std::tuple<Steps...>&& steps);
+
+	template<std::size_t... Indexes>
+	void run(flow_side side, std::index_sequence<Indexes...>) noexcept;
+
+	// false if the step is on the other side
+	template<std::size_t Index>
+	[[nodiscard]] bool run_step(flow_side side) noexcept;
+
+	std::tuple<Steps...> m_steps;
+	typename task_flow_detail::values<void, Steps...>::type m_values;
+	// index of the next step to run
+	std::size_t m_next;
+};
+
+template<typename... Steps>
+task_flow<Steps...>::task_flow() noexcept: m_steps(), m_values(), m_next(0)
+{
+	static_assert(STEP_COUNT == 0, "Flows are built from an empty flow");
+}
+
+template<typename... Steps>
+task_flow<Steps...>::task_flow(std::tuple<Steps...>&& steps)
+  : m_steps(std::move(steps)), m_values(), m_next(0)
+{
+}
+
+template<typename... Steps>
+template<typename Function>
+task_flow<Steps..., flow_step<flow_side::WORKER, std::decay_t<Function>>>
+task_flow<Steps...>::on_worker(Function&& function) &&
+{
+	assert(m_next == 0);
+	using step = flow_step<flow_side::WORKER, std::decay_t<Function>>;
+	return task_flow<Steps..., step>(
+	  std::tuple_cat(std::move(m_steps), std::make_tuple(step{std::forward<Function>(function)})));
+}
+
+template<typename... Steps>
+template<typename Function>
+task_flow<Steps..., flow_step<flow_side::OWNER, std::decay_t<Function>>>
+task_flow<Steps...>::on_owner(Function&& function) &&
+{
+	assert(m_next == 0);
+	using step = flow_step<flow_side::OWNER, std::decay_t<Function>>;
+	return task_flow<Steps..., step>(
+	  std::tuple_cat(std::move(m_steps), std::make_tuple(step{std::forward<Function>(function)})));
+}
+
+template<typename... Steps>
+std::optional<flow_side> task_flow<Steps...>::run(flow_side side) noexcept
+{
+	run(side, std::index_sequence_for<Steps...>{});
+	if(m_next == STEP_COUNT)
+	{
+		return std::nullopt;
+	}
+	return SIDES[m_next];
+}
+
+template<typename... Steps>
+template<std::size_t... Indexes>
+void task_flow<Steps...>::run([[maybe_unused]] flow_side side,
+                              std::index_sequence<Indexes...>) noexcept
+{
+	// in order, stops at the first step of the other side
+	static_cast<void>((run_step<Indexes>(side) && ...));
+}
+
+template<typename... Steps>
+template<std::size_t Index>
+bool task_flow<Steps...>::run_step(flow_side side) noexcept
+{
+	if(Index < m_next)
+	{
+		return true;
+	}
+	if(SIDES[Index] != side)
+	{
+		return false;
+	}
+
+	auto& function = std::get<Index>(m_steps).function;
+	auto& result = std::get<Index>(m_values);
+	auto invoke = [&]() {
+		if constexpr(Index == 0)
+		{
+			return function();
+		}
+		else
+		{
+			auto& input = std::get<Index - 1>(m_values);
+			if constexpr(std::is_empty<std::decay_t<decltype(input)>>::value)
+			{
+				return function();
+			}
+			else
+			{
+				// the input is freed by the step, not kept until the end of the flow
+				auto input_value = std::move(*input.value);
+				input.value.reset();
+				return function(std::move(input_value));
+			}
+		}
+	};
+	if constexpr(std::is_empty<std::decay_t<decltype(result)>>::value)
+	{
+		invoke();
+	}
+	else
+	{
+		result.value.emplace(invoke());
+	}
+	m_next = Index + 1;
+	return true;
+}
+
+#endif //MAGICPLAYER_TASK_FLOW_HPP
@@ -0,0 +1,91 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_TRIPLE_BUFFER_HPP
+#define MAGICPLAYER_TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Lock-free single-producer/single-consumer latest value exchange.
+// The producer fills write_buffer() then publish() it, the consumer calls update() then reads
+// read_buffer(): it always gets the last published value, intermediate ones are skipped.
+// Neither side ever waits for the other.
+template<typename T>
+class triple_buffer final
+{
+public:
+	typedef T value_type;
+
+	triple_buffer();
+
+	triple_buffer(const triple_buffer&) = delete;
+	triple_buffer& operator=(const triple_buffer&) = delete;
+
+	triple_buffer(triple_buffer&&) = delete;
+	triple_buffer& operator=(triple_buffer&&) = delete;
+
+	~triple_buffer() noexcept = default;
+
+	// producer side
+	value_type& write_buffer() noexcept;
+	void publish() noexcept;
+
+	// consumer side, return true if a value was published since the last update
+	bool update() noexcept;
+	const value_type& read_buffer() const noexcept;
+
+private:
+	static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+	// the shared index holds this flag while its buffer wasn't read
+	static constexpr unsigned char NEW_VALUE = 4;
+	static constexpr unsigned char INDEX_MASK = 3;
+
+	std::array<value_type, 3> m_buffers;
+	unsigned char m_write_index;
+	alignas(CACHE_LINE_SIZE) std::atomic<unsigned char> m_shared_index;
+	alignas(CACHE_LINE_SIZE) unsigned char m_read_index;
+};
+
+template<typename T>
+triple_buffer<T>::triple_buffer(): m_buffers(), m_write_index(0), m_shared_index(1), m_read_index(2)
+{
+}
+
+template<typename T>
+typename triple_buffer<T>::value_type& triple_buffer<T>::write_buffer() noexcept
+{
+	return m_buffers[m_write_index];
+}
+
+template<typename T>
+void triple_buffer<T>::publish() noexcept
+{
+	m_write_index =
+	  m_shared_index.exchange(m_write_index | NEW_VALUE, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+template<typename T>
+bool triple_buffer<T>::update() noexcept
+{
+	if((m_shared_index.load(std::memory_order_relaxed) & NEW_VALUE) == 0)
+	{
+		return false;
+	}
+	m_read_index = m_shared_index.exchange(m_read_index, std::memory_order_acq_rel) & INDEX_MASK;
+	return true;
+}
+
+template<typename T>
+const typename triple_buffer<T>::value_type& triple_buffer<T>::read_buffer() const noexcept
+{
+	return m_buffers[m_read_index];
+}
+
+#endif //MAGICPLAYER_TRIPLE_BUFFER_HPP
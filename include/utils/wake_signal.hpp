@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_WAKE_SIGNAL_HPP
+#define MAGICPLAYER_WAKE_SIGNAL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__linux__)
+#	define MAGICPLAYER_WAKE_SIGNAL_FUTEX
+#else
+#	include <condition_variable>
+#	include <mutex>
+#endif
+
+// Sleep of one waiting thread until notified by other threads, for lock-free structures:
+// futex on Linux, mutex and condition variable elsewhere. notify() costs one atomic load and
+// no system call while the waiter is not sleeping.
+// Waiter side, to avoid lost wake ups:
+//   token = prepare(); if(condition) cancel(); else wait(token);
+// Notifier side: make the condition true (seq_cst store or read-modify-write), then notify().
+class wake_signal final
+{
+public:
+	wake_signal() noexcept;
+
+	wake_signal(const wake_signal&) = delete;
+	wake_signal& operator=(const wake_signal&) = delete;
+
+	wake_signal(wake_signal&&) = delete;
+	wake_signal& operator=(wake_signal&&) = delete;
+
+	~wake_signal() noexcept = default;
+
+	// waiter side, a single waiter at a time
+	[[nodiscard]] std::uint32_t prepare() noexcept;
+	void cancel() noexcept;
+	void wait(std::uint32_t token) noexcept;
+	// also returns after the timeout
+	void wait_for(std::uint32_t token, std::chrono::nanoseconds timeout) noexcept;
+
+	// notifier side, any thread
+	void notify() noexcept;
+
+private:
+	void wake() noexcept;
+
+	std::atomic<std::uint32_t> m_sequence;
+	std::atomic<bool> m_sleeping;
+#if !defined(MAGICPLAYER_WAKE_SIGNAL_FUTEX)
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+#endif
+};
+
+inline void wake_signal::notify() noexcept
+{
+	// only the first notifier of a sleep makes the system call
+	if(m_sleeping.load(std::memory_order_seq_cst)
+	   && m_sleeping.exchange(false, std::memory_order_acq_rel))
+	{
+		wake();
+	}
+}
+
+#endif //MAGICPLAYER_WAKE_SIGNAL_HPP
@@ -9,22 +9,29 @@
 #define MAGICPLAYER_GUI_HPP
 
 #include "model/Messages.hpp"
+#include "utils/wake_signal.hpp"
 #include "view/imgui_easy_theming.hpp"
 #include "view/windows/Explorer.hpp"
 #include "view/windows/Player.hpp"
 #include "view/windows/LogViewer.hpp"
 #include "view/windows/SettingsEditor.hpp"
+#include "view/windows/SpectrumViewer.hpp"
 
 #include <imgui.h>
 #include <spdlog/logger.h>
 
 #include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
 
 class GUI final
 {
 
 public:
-	explicit GUI(Msg::Com& com);
+	// must be created before the logic runs, it listens to the out messages. With idle rendering,
+	// frames are only rendered for the inputs, the messages and the animations
+	explicit GUI(Msg::Com& com, bool idle_rendering = true);
 
 	int run();
 
@@ -41,9 +48,19 @@ private:
 	void setupFonts();
 	void setupStyle();
 
-	void processMessages();
+	// return false if there was no message
+	bool processMessages();
+
+	// period of the animated elements, nullopt if nothing is animated
+	[[nodiscard]] std::optional<std::chrono::steady_clock::duration> animationPeriod() const;
+
+	// sleep until an out message is sent or the timeout expires
+	void waitMessages(std::chrono::steady_clock::duration timeout);
 
 	Msg::Com& m_com;
+	bool m_idle_rendering;
+	// shared with the out listener, called by the logic threads until the logic is destroyed
+	std::shared_ptr<wake_signal> m_wake;
 	bool m_showThemeConfigWindow;
 	bool m_showLogViewerWindow;
 	bool m_showSettingsEditor;
@@ -53,6 +70,10 @@ private:
 	Player m_player;
 	LogViewer m_log_viewer;
 	SettingsEditor m_settingsEditor;
+	SpectrumViewer m_spectrum_viewer;
+
+	// swapped with the out queue each frame
+	Msg::Com::OutMessages m_messages;
 
 	std::shared_ptr<spdlog::logger> m_logger;
 };
@@ -8,14 +8,18 @@
 #ifndef MAGICPLAYER_IMGUI_CUSTOM_WIDGETS_HPP
 #define MAGICPLAYER_IMGUI_CUSTOM_WIDGETS_HPP
 
+#include "data/Waveform.hpp"
+
 #include <imgui.h>
 
 namespace ImGuiCW
 {
+	// Draw the waveform instead of a flat bar if not null
 	bool PlayerBar(const char* label,
 	               float* v,
 	               float min,
 	               float max,
+	               const data::Waveform* waveform = nullptr,
 	               const ImVec2& size_arg = ImVec2(-1, 0));
 }
 
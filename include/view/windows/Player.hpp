@@ -9,8 +9,8 @@
 #define MAGICPLAYER_PLAYER_HPP
 
 #include "model/Messages.hpp"
+#include "audio/PlaybackState.hpp"
 
-#include <SFML/System/Clock.hpp>
 #include <spdlog/logger.h>
 
 #include <memory>
@@ -19,14 +19,14 @@
 class Player
 {
 public:
-	Player(std::string name, Msg::Sender sender);
+	Player(std::string name, Msg::Sender sender, const audio::PlaybackState& playback);
 
 	void init();
 
 	void show();
 
-	void processMessage(Msg::Out::MusicOffset& message);
 	void processMessage(Msg::Out::MusicInfo& message);
+	void processMessage(Msg::Out::Waveform& message);
 
 private:
 	struct MusicInfos
@@ -42,8 +42,9 @@ private:
 
 	std::string m_name;
 	MusicInfos m_musicInfos;
+	std::shared_ptr<const data::Waveform> m_waveform;
 	float m_volume;
-	sf::Clock m_musicOffsetClock;
+	const audio::PlaybackState& m_playback;
 
 	std::shared_ptr<spdlog::logger> m_logger;
 };
@@ -52,6 +52,8 @@ private:
 
 	void showMusicsSourcesConfigOptions() noexcept;
 
+	void showPlaybackConfigOptions() noexcept;
+
 	void showDatabaseConfigOptions() noexcept;
 
 	void showErrorPopupModal() noexcept;
@@ -64,6 +66,7 @@ private:
 	{
 		FILES_EXPLORER,
 		MUSICS_SOURCES,
+		PLAYBACK,
 		DATABASE
 	};
 	std::string_view SettingsPanelsTxt(SettingsPanels settingsPanels) const noexcept;
@@ -73,6 +76,17 @@ private:
 	std::string m_name;
 	std::array<char, 2048> m_explorer_folder_buffer;
 	std::vector<std::array<char, 2048>> m_musics_sources_buffers;
+	float m_decode_ahead_seconds_input;
+	int m_pcm_cache_megabytes_input;
+	float m_crossfade_seconds_input;
+	int m_crossfade_curve_input;
+	int m_output_sample_rate_input;
+	bool m_equalizer_enabled_input;
+	std::vector<data::EqualizerBand> m_equalizer_bands_input;
+	bool m_limiter_enabled_input;
+	float m_limiter_threshold_db_input;
+	int m_volume_normalization_input;
+	float m_normalization_preamp_db_input;
 	data::Settings m_settings;
 	DatabaseInfo m_database_info;
 	SettingsPanels m_selectedPanel;
@@ -0,0 +1,43 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_SPECTRUMVIEWER_HPP
+#define MAGICPLAYER_SPECTRUMVIEWER_HPP
+
+#include "data/Spectrum.hpp"
+#include "utils/triple_buffer.hpp"
+
+#include <spdlog/logger.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+class SpectrumViewer
+{
+public:
+	// the analysis is enabled while the window is visible
+	SpectrumViewer(std::string name,
+	               triple_buffer<data::Spectrum>& spectrum,
+	               std::atomic<bool>& enabled);
+
+	void init();
+
+	void show();
+
+private:
+	void showLevels(const data::Spectrum& spectrum, float width, float height);
+	void showBands(const data::Spectrum& spectrum, float width, float height);
+
+	std::string m_name;
+	triple_buffer<data::Spectrum>& m_spectrum;
+	std::atomic<bool>& m_enabled;
+
+	std::shared_ptr<spdlog::logger> m_logger;
+};
+
+#endif //MAGICPLAYER_SPECTRUMVIEWER_HPP
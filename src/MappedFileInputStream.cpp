@@ -0,0 +1,288 @@
+////////////////////////////////////////////////////////////
+//
+// SFML Extension - MappedFileInputStream
+// Copyright (C) 2019 Maxime Pinard
+//
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it freely,
+// subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented;
+//    you must not claim that you wrote the original software.
+//    If you use this software in a product, an acknowledgment
+//    in the product documentation would be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such,
+//    and must not be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source distribution.
+//
+////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <MappedFileInputStream.hpp>
+#include <SFML/System/Err.hpp>
+
+#if defined(_WIN32)
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#	define MAPPED_FILE_USE_MMAP
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+////////////////////////////////////////////////////////////
+MappedFileInputStream::MappedFileInputStream()
+  : m_data(nullptr)
+  , m_size(0)
+  , m_offset(0)
+  , m_mapped(false)
+  , m_fallback()
+{
+}
+
+////////////////////////////////////////////////////////////
+MappedFileInputStream::~MappedFileInputStream()
+{
+	unmap();
+}
+
+////////////////////////////////////////////////////////////
+bool MappedFileInputStream::open(const std::string& filename)
+{
+	close();
+
+	if(map(filename))
+	{
+		return true;
+	}
+
+	// Non-mappable file, use buffered reads
+	auto fallback = std::make_unique<sf::FileInputStream>();
+	if(!fallback->open(filename))
+	{
+		return false;
+	}
+	m_fallback = std::move(fallback);
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+void MappedFileInputStream::close()
+{
+	unmap();
+	// sf::FileInputStream has no close, destroying it closes the file
+	m_fallback.reset();
+}
+
+////////////////////////////////////////////////////////////
+bool MappedFileInputStream::isMapped() const
+{
+	return m_mapped;
+}
+
+////////////////////////////////////////////////////////////
+const char* MappedFileInputStream::getData() const
+{
+	return m_data;
+}
+
+////////////////////////////////////////////////////////////
+sf::Int64 MappedFileInputStream::read(void* data, sf::Int64 size)
+{
+	if(!m_mapped)
+	{
+		return m_fallback ? m_fallback->read(data, size) : -1;
+	}
+
+	const sf::Int64 count = std::max(sf::Int64{0}, std::min(size, m_size - m_offset));
+	std::memcpy(data, m_data + m_offset, static_cast<std::size_t>(count));
+	m_offset += count;
+	return count;
+}
+
+////////////////////////////////////////////////////////////
+sf::Int64 MappedFileInputStream::seek(sf::Int64 position)
+{
+	if(!m_mapped)
+	{
+		return m_fallback ? m_fallback->seek(position) : -1;
+	}
+
+	m_offset = std::clamp(position, sf::Int64{0}, m_size);
+	return m_offset;
+}
+
+////////////////////////////////////////////////////////////
+sf::Int64 MappedFileInputStream::tell()
+{
+	if(!m_mapped)
+	{
+		return m_fallback ? m_fallback->tell() : -1;
+	}
+
+	return m_offset;
+}
+
+////////////////////////////////////////////////////////////
+sf::Int64 MappedFileInputStream::getSize()
+{
+	if(!m_mapped)
+	{
+		return m_fallback ? m_fallback->getSize() : -1;
+	}
+
+	return m_size;
+}
+
+#if defined(MAPPED_FILE_USE_MMAP)
+
+////////////////////////////////////////////////////////////
+bool MappedFileInputStream::map(const std::string& filename)
+{
+	const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		return false;
+	}
+
+	struct stat file_stat;
+	if(::fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size <= 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	const auto size = static_cast<std::size_t>(file_stat.st_size);
+	void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if(address == MAP_FAILED)
+	{
+		return false;
+	}
+
+	// Audio files are decoded front to back: aggressive read-ahead, early page release
+	if(::madvise(address, size, MADV_SEQUENTIAL) != 0)
+	{
+		sf::err() << "madvise failed on " << filename << ", continuing without access hint"
+		          << std::endl;
+	}
+
+	m_data = static_cast<const char*>(address);
+	m_size = static_cast<sf::Int64>(size);
+	m_offset = 0;
+	m_mapped = true;
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+void MappedFileInputStream::unmap()
+{
+	if(m_mapped)
+	{
+		::munmap(const_cast<char*>(m_data), static_cast<std::size_t>(m_size));
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_offset = 0;
+	m_mapped = false;
+}
+
+#elif defined(_WIN32)
+
+////////////////////////////////////////////////////////////
+bool MappedFileInputStream::map(const std::string& filename)
+{
+	HANDLE file = ::CreateFileA(filename.c_str(),
+	                            GENERIC_READ,
+	                            FILE_SHARE_READ,
+	                            nullptr,
+	                            OPEN_EXISTING,
+	                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+	                            nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if(!::GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+	{
+		::CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	::CloseHandle(file);
+	if(mapping == nullptr)
+	{
+		return false;
+	}
+
+	const void* address = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	// the view keeps its own reference to the mapping
+	::CloseHandle(mapping);
+	if(address == nullptr)
+	{
+		return false;
+	}
+
+	m_data = static_cast<const char*>(address);
+	m_size = static_cast<sf::Int64>(size.QuadPart);
+	m_offset = 0;
+	m_mapped = true;
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+void MappedFileInputStream::unmap()
+{
+	if(m_mapped)
+	{
+		::UnmapViewOfFile(m_data);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_offset = 0;
+	m_mapped = false;
+}
+
+#else
+
+////////////////////////////////////////////////////////////
+bool MappedFileInputStream::map(const std::string& filename)
+{
+	// No memory mapping support on this platform, always use buffered reads
+	(void)filename;
+	return false;
+}
+
+////////////////////////////////////////////////////////////
+void MappedFileInputStream::unmap()
+{
+	m_data = nullptr;
+	m_size = 0;
+	m_offset = 0;
+	m_mapped = false;
+}
+
+#endif
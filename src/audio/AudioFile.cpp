@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/AudioFile.hpp"
+#include "audio/decoders/Registry.hpp"
+
+#include <algorithm>
+
+audio::AudioFile::AudioFile() noexcept: m_reader(), m_info()
+{
+}
+
+bool audio::AudioFile::openFromStream(sf::InputStream& stream)
+{
+	m_info = decoders::Info();
+	m_reader = decoders::Registry::get().open(stream, m_info);
+	if(!m_reader)
+	{
+		m_info = decoders::Info();
+		return false;
+	}
+	return true;
+}
+
+audio::decoders::Format audio::AudioFile::getFormat() const noexcept
+{
+	return m_info.format;
+}
+
+unsigned int audio::AudioFile::getChannelCount() const noexcept
+{
+	return m_info.channel_count;
+}
+
+unsigned int audio::AudioFile::getSampleRate() const noexcept
+{
+	return m_info.sample_rate;
+}
+
+sf::Uint64 audio::AudioFile::getFrameCount() const noexcept
+{
+	return m_info.frame_count;
+}
+
+sf::Uint64 audio::AudioFile::getSampleCount() const noexcept
+{
+	return m_info.frame_count * m_info.channel_count;
+}
+
+sf::Time audio::AudioFile::getDuration() const noexcept
+{
+	if(m_info.sample_rate == 0)
+	{
+		return sf::Time::Zero;
+	}
+	return sf::microseconds(
+	  static_cast<sf::Int64>(m_info.frame_count * 1000000 / m_info.sample_rate));
+}
+
+sf::Uint64 audio::AudioFile::read(sf::Int16* samples, sf::Uint64 max_count)
+{
+	if(!m_reader || max_count == 0)
+	{
+		return 0;
+	}
+	return m_reader->read(samples, static_cast<std::size_t>(max_count));
+}
+
+sf::Uint64 audio::AudioFile::read(float* samples, sf::Uint64 max_count)
+{
+	if(!m_reader || max_count == 0)
+	{
+		return 0;
+	}
+	return m_reader->read(samples, static_cast<std::size_t>(max_count));
+}
+
+void audio::AudioFile::seek(sf::Time offset)
+{
+	const sf::Int64 microseconds = std::max<sf::Int64>(offset.asMicroseconds(), 0);
+	seekFrame(static_cast<sf::Uint64>(microseconds) * m_info.sample_rate / 1000000);
+}
+
+void audio::AudioFile::seekFrame(sf::Uint64 frame)
+{
+	if(m_reader)
+	{
+		m_reader->seek(std::min(frame, m_info.frame_count));
+	}
+}
@@ -0,0 +1,299 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/BufferedMusic.hpp"
+#include "audio/mix_kernels.hpp"
+#include "utils/log.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace
+{
+	// Duration of the samples chunks given to SFML
+	constexpr float STREAM_CHUNK_SECONDS = 0.25f;
+
+	// Duration of the silence played when the decoder is late
+	constexpr float UNDERRUN_SILENCE_SECONDS = 0.01f;
+} // namespace
+
+audio::BufferedMusic::BufferedMusic(std::shared_ptr<spdlog::logger> logger) noexcept
+  : sf::SoundStream()
+  , m_mixer(logger)
+  , m_samples()
+  , m_silence()
+  , m_dsp()
+  , m_equalizer(m_dsp.add<dsp::Equalizer>())
+  , m_limiter(m_dsp.add<dsp::Limiter>())
+  , m_output_sample_rate(0)
+  , m_dsp_input()
+  , m_dsp_output()
+  , m_output()
+  , m_track_end_callback()
+  , m_spectrum_analyzer(nullptr)
+  , m_playback_state(nullptr)
+  , m_streamed_frames(0)
+  , m_track_start_frame(0)
+  , m_track_id(0)
+  , m_underrun_count(0)
+  , m_underrun_samples(0)
+  , m_logger(std::move(logger))
+{
+}
+
+audio::BufferedMusic::~BufferedMusic()
+{
+	// the streaming thread must not outlive the decoders
+	stop();
+}
+
+bool audio::BufferedMusic::openFromFile(const utf8_path& path,
+                                        float decode_ahead_seconds,
+                                        float gain)
+{
+	stop();
+
+	m_track_id.fetch_add(1, std::memory_order_relaxed);
+	if(!m_mixer.open(path, decode_ahead_seconds, gain))
+	{
+		return false;
+	}
+
+	const unsigned int channel_count = m_mixer.getChannelCount();
+	const unsigned int sample_rate = m_mixer.getSampleRate();
+	const unsigned int output_rate = m_output_sample_rate != 0 ? m_output_sample_rate : sample_rate;
+	const auto frames_for = [](float seconds, unsigned int rate) {
+		const auto frames = static_cast<std::size_t>(seconds * static_cast<float>(rate));
+		return std::max(frames, std::size_t{1});
+	};
+	const std::size_t chunk_frames = frames_for(STREAM_CHUNK_SECONDS, sample_rate);
+	m_samples.resize(chunk_frames * channel_count);
+	m_silence.assign(frames_for(UNDERRUN_SILENCE_SECONDS, output_rate) * channel_count, 0);
+
+	m_dsp.prepare(channel_count, sample_rate, output_rate, chunk_frames);
+	m_dsp_input.resize(m_samples.size());
+	m_dsp_output.resize(m_dsp.maxOutputFrames(chunk_frames) * channel_count);
+	m_output.resize(m_dsp_output.size());
+	if(output_rate != sample_rate)
+	{
+		SPDLOG_DEBUG(m_logger, "Resampling {} from {} Hz to {} Hz", path, sample_rate, output_rate);
+	}
+
+	m_underrun_count = 0;
+	m_underrun_samples = 0;
+	m_streamed_frames = 0;
+	m_track_start_frame = 0;
+
+	initialize(channel_count, output_rate);
+	return true;
+}
+
+bool audio::BufferedMusic::queueNext(const utf8_path& path, float decode_ahead_seconds, float gain)
+{
+	return m_mixer.queue(path, decode_ahead_seconds, gain);
+}
+
+bool audio::BufferedMusic::hasQueuedNext() const noexcept
+{
+	return m_mixer.hasQueued();
+}
+
+void audio::BufferedMusic::setCrossfade(float seconds, data::CrossfadeCurve curve) noexcept
+{
+	m_mixer.setCrossfade(seconds, curve);
+}
+
+void audio::BufferedMusic::setOutputSampleRate(unsigned int sample_rate) noexcept
+{
+	m_output_sample_rate = sample_rate;
+}
+
+void audio::BufferedMusic::setEqualizer(const std::vector<data::EqualizerBand>& bands, bool enabled)
+{
+	m_equalizer.setBands(bands, enabled);
+}
+
+void audio::BufferedMusic::setLimiter(bool enabled, float threshold_db) noexcept
+{
+	m_limiter.setParameters(enabled, threshold_db);
+}
+
+void audio::BufferedMusic::setTrackEndCallback(TrackEndCallback callback)
+{
+	m_track_end_callback = std::move(callback);
+}
+
+void audio::BufferedMusic::setSpectrumAnalyzer(SpectrumAnalyzer* analyzer) noexcept
+{
+	m_spectrum_analyzer = analyzer;
+}
+
+void audio::BufferedMusic::setPlaybackState(PlaybackState* state) noexcept
+{
+	m_playback_state = state;
+}
+
+void audio::BufferedMusic::setPcmCache(PcmCache* cache) noexcept
+{
+	m_mixer.setPcmCache(cache);
+}
+
+void audio::BufferedMusic::publishPlaybackState()
+{
+	if(m_playback_state != nullptr)
+	{
+		m_playback_state->publish(playbackSnapshot(getStatus()));
+	}
+}
+
+sf::Time audio::BufferedMusic::getDuration() const noexcept
+{
+	return m_mixer.getDuration();
+}
+
+sf::Time audio::BufferedMusic::getTrackOffset() const
+{
+	const unsigned int sample_rate = getSampleRate();
+	if(sample_rate == 0)
+	{
+		return sf::Time::Zero;
+	}
+
+	// the stream offset counts the samples of all the tracks played since the last seek
+	const sf::Time start = sf::seconds(
+	  static_cast<float>(m_track_start_frame.load(std::memory_order_relaxed)) / sample_rate);
+	const sf::Time offset = getPlayingOffset();
+	return offset > start ? offset - start : sf::Time::Zero;
+}
+
+audio::PlaybackState::Snapshot
+audio::BufferedMusic::playbackSnapshot(sf::SoundSource::Status status) const
+{
+	PlaybackState::Snapshot snapshot;
+	snapshot.track_id = m_track_id.load(std::memory_order_relaxed);
+	snapshot.sample_rate = getSampleRate();
+	snapshot.position_frames = static_cast<std::uint64_t>(getTrackOffset().asMicroseconds())
+	                           * snapshot.sample_rate / 1000000;
+	snapshot.status = status;
+	snapshot.timestamp = std::chrono::steady_clock::now();
+	return snapshot;
+}
+
+std::uint64_t audio::BufferedMusic::getTrackId() const noexcept
+{
+	return m_track_id.load(std::memory_order_relaxed);
+}
+
+std::uint64_t audio::BufferedMusic::getUnderrunCount() const noexcept
+{
+	return m_underrun_count.load(std::memory_order_relaxed);
+}
+
+std::uint64_t audio::BufferedMusic::getUnderrunSamples() const noexcept
+{
+	return m_underrun_samples.load(std::memory_order_relaxed);
+}
+
+float audio::BufferedMusic::getBufferFillRatio() const noexcept
+{
+	const std::size_t capacity = m_mixer.getBufferCapacity();
+	if(capacity == 0)
+	{
+		return 0.f;
+	}
+	return static_cast<float>(m_mixer.getBufferedSamples()) / static_cast<float>(capacity);
+}
+
+std::vector<audio::dsp::Chain::StageCost> audio::BufferedMusic::getDspCosts() const
+{
+	return m_dsp.getCosts();
+}
+
+bool audio::BufferedMusic::onGetData(sf::SoundStream::Chunk& data)
+{
+	const unsigned int channel_count = m_mixer.getChannelCount();
+	bool track_changed = false;
+	const std::size_t count = m_mixer.read(m_samples.data(), m_samples.size(), track_changed);
+
+	const sf::Int16* samples = m_samples.data();
+	std::size_t frames = count / channel_count;
+	if(count != 0 && m_dsp.active())
+	{
+		kernels::to_float(m_samples.data(), m_dsp_input.data(), count);
+		frames = m_dsp.process(m_dsp_input.data(), frames, m_dsp_output.data());
+		kernels::to_int16(m_dsp_output.data(), m_output.data(), frames * channel_count);
+		samples = m_output.data();
+	}
+	m_streamed_frames += frames;
+
+	if(track_changed)
+	{
+		const sf::Uint64 track_frames =
+		  m_mixer.getTrackFrames() * m_dsp.getOutputRate() / m_mixer.getSampleRate();
+		m_track_start_frame.store(m_streamed_frames - std::min(m_streamed_frames, track_frames),
+		                          std::memory_order_relaxed);
+		const std::uint64_t track_id = m_track_id.fetch_add(1, std::memory_order_relaxed) + 1;
+		if(m_track_end_callback)
+		{
+			m_track_end_callback(true, track_id);
+		}
+	}
+
+	// SoundStream::getStatus() locks the streaming thread mutex, the source state is enough here:
+	// stopped while the first buffers are filled, stops are published by the controlling thread
+	if(m_playback_state != nullptr)
+	{
+		const std::uint64_t epoch = m_playback_state->epoch();
+		const sf::SoundSource::Status status = SoundSource::getStatus();
+		if(status != sf::SoundSource::Stopped)
+		{
+			m_playback_state->tryPublish(playbackSnapshot(status), epoch);
+		}
+	}
+
+	if(frames != 0)
+	{
+		if(m_spectrum_analyzer != nullptr)
+		{
+			m_spectrum_analyzer->tap(samples, frames, channel_count, m_dsp.getOutputRate());
+		}
+		data.samples = samples;
+		data.sampleCount = frames * channel_count;
+		return true;
+	}
+
+	if(count == 0 && m_mixer.finished())
+	{
+		if(m_track_end_callback)
+		{
+			m_track_end_callback(false, m_track_id.load(std::memory_order_relaxed));
+		}
+		return false;
+	}
+
+	// Decoder is late (or resampler still filling): keep the stream alive with a short silence
+	if(count == 0)
+	{
+		m_underrun_count.fetch_add(1, std::memory_order_relaxed);
+		m_underrun_samples.fetch_add(m_silence.size(), std::memory_order_relaxed);
+	}
+	m_streamed_frames += m_silence.size() / channel_count;
+	data.samples = m_silence.data();
+	data.sampleCount = m_silence.size();
+	return true;
+}
+
+void audio::BufferedMusic::onSeek(sf::Time timeOffset)
+{
+	// SFML stops the streaming thread before seeking, no concurrent onGetData()
+	m_mixer.seek(timeOffset);
+	m_dsp.reset();
+	m_streamed_frames = static_cast<sf::Uint64>(std::max(0.f, timeOffset.asSeconds())
+	                                            * static_cast<float>(m_dsp.getOutputRate()));
+	m_track_start_frame.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,328 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/Decoder.hpp"
+#include "data/Loudness.hpp"
+#include "data/Settings.hpp"
+#include "utils/log.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	constexpr std::size_t DECODE_CHUNK_FRAMES = 4096;
+	constexpr std::chrono::milliseconds REFILL_PERIOD(20);
+} // namespace
+
+audio::Decoder::Decoder(std::shared_ptr<spdlog::logger> logger) noexcept
+  : m_stream()
+  , m_file()
+  , m_open(false)
+  , m_channel_count(0)
+  , m_sample_rate(0)
+  , m_duration()
+  , m_sample_count(0)
+  , m_buffer()
+  , m_chunk()
+  , m_thread()
+  , m_mutex()
+  , m_cond()
+  , m_stop(false)
+  , m_control_pending(false)
+  , m_end_of_file(false)
+  , m_cache(nullptr)
+  , m_cached_track()
+  , m_cached_position(0)
+  , m_capturing(false)
+  , m_path()
+  , m_fingerprint(0)
+  , m_captured()
+  , m_logger(std::move(logger))
+{
+}
+
+audio::Decoder::~Decoder() noexcept
+{
+	close();
+}
+
+void audio::Decoder::setCache(PcmCache* cache) noexcept
+{
+	m_cache = cache;
+}
+
+bool audio::Decoder::open(const utf8_path& path, float decode_ahead_seconds)
+{
+	close();
+
+	if(m_cache != nullptr)
+	{
+		m_cached_track = m_cache->find(path);
+		if(m_cached_track)
+		{
+			m_channel_count = m_cached_track->channel_count;
+			m_sample_rate = m_cached_track->sample_rate;
+			m_duration = m_cached_track->duration;
+			m_sample_count = m_cached_track->samples.size();
+			m_cached_position.store(0, std::memory_order_relaxed);
+			SPDLOG_DEBUG(m_logger, "Decoder opened {} from the decoded audio cache", path);
+			m_open = true;
+			return true;
+		}
+	}
+
+	// the sound file reader references the stream: destroy it before reopening the stream
+	m_file.reset();
+	if(!m_stream.open(path.str_cref()))
+	{
+		return false;
+	}
+	if(!m_stream.isMapped())
+	{
+		SPDLOG_DEBUG(m_logger, "Failed to map {} in memory, using buffered reads", path);
+	}
+
+	m_file = std::make_unique<AudioFile>();
+	if(!m_file->openFromStream(m_stream))
+	{
+		return false;
+	}
+	m_channel_count = m_file->getChannelCount();
+	m_sample_rate = m_file->getSampleRate();
+	m_duration = m_file->getDuration();
+	m_sample_count = m_file->getSampleCount();
+	if(m_channel_count == 0 || m_sample_rate == 0)
+	{
+		m_logger->warn("Invalid audio format for {}", path);
+		return false;
+	}
+
+	decode_ahead_seconds = std::clamp(decode_ahead_seconds,
+	                                  data::Settings::MIN_DECODE_AHEAD_SECONDS,
+	                                  data::Settings::MAX_DECODE_AHEAD_SECONDS);
+	m_chunk.resize(DECODE_CHUNK_FRAMES * m_channel_count);
+	m_buffer.resize(std::max(
+	  static_cast<std::size_t>(decode_ahead_seconds * static_cast<float>(m_sample_rate))
+	    * m_channel_count,
+	  m_chunk.size()));
+	m_stop = false;
+	m_end_of_file = false;
+
+	m_capturing = m_cache != nullptr && m_cache->fits(m_sample_count)
+	              && data::get_file_fingerprint(path, m_fingerprint);
+	if(m_capturing)
+	{
+		m_path = path;
+		m_captured.reserve(static_cast<std::size_t>(m_sample_count));
+	}
+	SPDLOG_DEBUG(m_logger,
+	             "Decoder opened {}: {} channels, {} Hz, {} samples buffer",
+	             path,
+	             m_channel_count,
+	             m_sample_rate,
+	             m_buffer.capacity());
+
+	// Have samples available as soon as the playback starts
+	decodeChunk();
+
+	m_thread = std::thread(&Decoder::run, this);
+	m_open = true;
+	return true;
+}
+
+void audio::Decoder::close() noexcept
+{
+	if(m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cond.notify_one();
+		m_thread.join();
+		SPDLOG_TRACE(m_logger, "Decoder thread joined");
+	}
+	m_open = false;
+	m_cached_track.reset();
+	m_capturing = false;
+	m_captured = std::vector<sf::Int16>();
+}
+
+std::size_t audio::Decoder::read(sf::Int16* samples, std::size_t max_count) noexcept
+{
+	if(!m_open)
+	{
+		return 0;
+	}
+	if(m_cached_track)
+	{
+		const std::vector<sf::Int16>& cached = m_cached_track->samples;
+		std::size_t position = m_cached_position.load(std::memory_order_acquire);
+		std::size_t count;
+		// a seek between the load and the update is not overwritten: read again from it
+		do
+		{
+			count = std::min(max_count - max_count % m_channel_count, cached.size() - position);
+			std::copy_n(cached.data() + position, count, samples);
+		} while(!m_cached_position.compare_exchange_weak(
+		  position, position + count, std::memory_order_acq_rel, std::memory_order_acquire));
+		return count;
+	}
+	return m_buffer.pop(samples, max_count - max_count % m_channel_count);
+}
+
+bool audio::Decoder::finished() const noexcept
+{
+	if(m_open && m_cached_track)
+	{
+		return m_cached_position.load(std::memory_order_acquire) == m_cached_track->samples.size();
+	}
+	return !m_open
+	       || (m_end_of_file.load(std::memory_order_acquire) && m_buffer.read_available() == 0);
+}
+
+void audio::Decoder::seek(sf::Time offset)
+{
+	if(!m_open)
+	{
+		return;
+	}
+	if(m_cached_track)
+	{
+		const auto frame = static_cast<std::size_t>(
+		  std::max<sf::Int64>(offset.asMicroseconds(), 0) * m_sample_rate / 1000000);
+		m_cached_position.store(
+		  std::min(frame * m_channel_count, m_cached_track->samples.size()),
+		  std::memory_order_release);
+		return;
+	}
+
+	m_control_pending.store(true, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_file->seek(offset);
+		m_buffer.clear();
+		// the track won't be decoded from the start to the end
+		if(m_capturing)
+		{
+			m_capturing = false;
+			m_captured = std::vector<sf::Int16>();
+		}
+		m_end_of_file.store(false, std::memory_order_release);
+		m_control_pending.store(false, std::memory_order_relaxed);
+	}
+	m_cond.notify_one();
+}
+
+bool audio::Decoder::isOpen() const noexcept
+{
+	return m_open;
+}
+
+unsigned int audio::Decoder::getChannelCount() const noexcept
+{
+	return m_channel_count;
+}
+
+unsigned int audio::Decoder::getSampleRate() const noexcept
+{
+	return m_sample_rate;
+}
+
+sf::Time audio::Decoder::getDuration() const noexcept
+{
+	return m_duration;
+}
+
+sf::Uint64 audio::Decoder::getSampleCount() const noexcept
+{
+	return m_sample_count;
+}
+
+std::size_t audio::Decoder::getBufferedSamples() const noexcept
+{
+	if(m_cached_track)
+	{
+		return m_cached_track->samples.size()
+		       - m_cached_position.load(std::memory_order_relaxed);
+	}
+	return m_buffer.read_available();
+}
+
+std::size_t audio::Decoder::getBufferCapacity() const noexcept
+{
+	if(m_cached_track)
+	{
+		return m_cached_track->samples.size();
+	}
+	return m_buffer.capacity();
+}
+
+void audio::Decoder::run() noexcept
+{
+	SPDLOG_TRACE(m_logger, "Decoder thread started");
+	while(true)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if(m_control_pending.load(std::memory_order_relaxed))
+		{
+			// let the controlling thread take the lock, notified once it is done
+			m_cond.wait(lock, [this]() {
+				return m_stop || !m_control_pending.load(std::memory_order_relaxed);
+			});
+		}
+		if(m_stop)
+		{
+			break;
+		}
+		if(m_end_of_file.load(std::memory_order_relaxed)
+		   || m_buffer.write_available() < m_chunk.size())
+		{
+			m_cond.wait_for(lock, REFILL_PERIOD);
+			continue;
+		}
+		decodeChunk();
+	}
+	SPDLOG_TRACE(m_logger, "Decoder thread ended");
+}
+
+bool audio::Decoder::decodeChunk()
+{
+	const std::size_t count = std::min(m_chunk.size(), m_buffer.write_available());
+	const sf::Uint64 read = m_file->read(m_chunk.data(), count - count % m_channel_count);
+	if(read == 0)
+	{
+		m_end_of_file.store(true, std::memory_order_release);
+		if(m_capturing)
+		{
+			cacheDecodedTrack();
+		}
+		return false;
+	}
+	m_buffer.push(m_chunk.data(), static_cast<std::size_t>(read));
+	if(m_capturing)
+	{
+		m_captured.insert(m_captured.end(), m_chunk.data(), m_chunk.data() + read);
+	}
+	return true;
+}
+
+void audio::Decoder::cacheDecodedTrack()
+{
+	m_capturing = false;
+	auto track = std::make_shared<PcmTrack>();
+	track->fingerprint = m_fingerprint;
+	track->channel_count = m_channel_count;
+	track->sample_rate = m_sample_rate;
+	track->duration = m_duration;
+	track->samples = std::move(m_captured);
+	m_captured = std::vector<sf::Int16>();
+	m_cache->insert(m_path, std::move(track));
+}
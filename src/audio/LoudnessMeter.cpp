@@ -0,0 +1,290 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/LoudnessMeter.hpp"
+#include "utils/simd.hpp"
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+#	include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	constexpr double SUBBLOCK_SECONDS = 0.1;
+	constexpr double RELATIVE_GATE_LU = -10.0;
+
+	// True peak is measured at this rate or above (4x oversampling of 44.1kHz)
+	constexpr unsigned int TRUE_PEAK_RATE = 176400;
+
+	// Reported for digital silence
+	constexpr float MIN_PEAK = 1e-5f; // -100 dBTP
+
+	// Weights of the surround channels, LFE excluded (SMPTE channel order)
+	constexpr double SURROUND_WEIGHT = 1.41;
+
+	double loudness(double mean_square) noexcept
+	{
+		return -0.691 + 10 * std::log10(mean_square);
+	}
+
+	double mean_square(double loudness) noexcept
+	{
+		return std::pow(10.0, (loudness + 0.691) / 10);
+	}
+} // namespace
+
+audio::LoudnessMeter::LoudnessMeter() noexcept
+  : m_channels(0)
+  , m_shelf()
+  , m_highpass()
+  , m_states()
+  , m_weights()
+  , m_subblock_frames(0)
+  , m_subblock_position(0)
+  , m_channel_energies()
+  , m_subblocks()
+  , m_subblock_count(0)
+  , m_blocks()
+  , m_oversampler()
+  , m_oversampled()
+  , m_peak(0)
+{
+}
+
+void audio::LoudnessMeter::prepare(unsigned int channels,
+                                   unsigned int sample_rate,
+                                   std::size_t max_frames)
+{
+	assert(channels != 0 && sample_rate != 0);
+	m_channels = channels;
+
+	// K-weighting filters of BS.1770 given for 48kHz, recomputed from their analog prototypes
+	// for any sample rate
+	const auto rate = static_cast<double>(sample_rate);
+	{
+		const double f0 = 1681.974450955533;
+		const double gain_db = 3.999843853973347;
+		const double q = 0.7071752369554196;
+		const double k = std::tan(PI * f0 / rate);
+		const double vh = std::pow(10.0, gain_db / 20);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1 + k / q + k * k;
+		m_shelf = {(vh + vb * k / q + k * k) / a0,
+		           2 * (k * k - vh) / a0,
+		           (vh - vb * k / q + k * k) / a0,
+		           2 * (k * k - 1) / a0,
+		           (1 - k / q + k * k) / a0};
+	}
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+		const double k = std::tan(PI * f0 / rate);
+		const double a0 = 1 + k / q + k * k;
+		m_highpass = {1, -2, 1, 2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0};
+	}
+	m_states.assign(channels, ChannelState{});
+
+	m_weights.assign(channels, 1.0);
+	if(channels == 5)
+	{
+		m_weights[3] = SURROUND_WEIGHT;
+		m_weights[4] = SURROUND_WEIGHT;
+	}
+	else if(channels == 6)
+	{
+		m_weights[3] = 0;
+		m_weights[4] = SURROUND_WEIGHT;
+		m_weights[5] = SURROUND_WEIGHT;
+	}
+
+	m_subblock_frames = std::max(static_cast<std::size_t>(rate * SUBBLOCK_SECONDS), std::size_t{1});
+	m_subblock_position = 0;
+	m_channel_energies.assign(channels, 0.0);
+	m_subblocks.fill(0);
+	m_subblock_count = 0;
+	m_blocks.clear();
+
+	unsigned int oversampling = 1;
+	while(sample_rate * oversampling < TRUE_PEAK_RATE)
+	{
+		oversampling *= 2;
+	}
+	m_oversampler.prepare(channels, sample_rate, sample_rate * oversampling, max_frames);
+	m_oversampled.resize(m_oversampler.maxOutputFrames(max_frames) * channels);
+	m_peak = 0;
+}
+
+void audio::LoudnessMeter::process(const float* samples, std::size_t frames)
+{
+	// true peak
+	const float* peak_samples = samples;
+	std::size_t peak_count = frames * m_channels;
+	if(m_oversampler.active())
+	{
+		peak_samples = m_oversampled.data();
+		peak_count = m_oversampler.process(samples, frames, m_oversampled.data()) * m_channels;
+	}
+	float peak = m_peak;
+	for(std::size_t i = 0; i < peak_count; ++i)
+	{
+		peak = std::max(peak, std::abs(peak_samples[i]));
+	}
+	m_peak = peak;
+
+	// loudness
+	std::size_t position = 0;
+	while(position < frames)
+	{
+		const std::size_t count =
+		  std::min(frames - position, m_subblock_frames - m_subblock_position);
+		filter(samples + position * m_channels, count);
+		position += count;
+		m_subblock_position += count;
+		if(m_subblock_position == m_subblock_frames)
+		{
+			endSubBlock();
+		}
+	}
+}
+
+double audio::LoudnessMeter::integratedLoudness() const noexcept
+{
+	const double absolute_gate = mean_square(SILENCE_LUFS);
+	auto gated_mean = [this](double gate) noexcept {
+		double sum = 0;
+		std::size_t count = 0;
+		for(double block: m_blocks)
+		{
+			if(block > gate)
+			{
+				sum += block;
+				++count;
+			}
+		}
+		return count == 0 ? 0.0 : sum / static_cast<double>(count);
+	};
+
+	const double absolute_mean = gated_mean(absolute_gate);
+	if(absolute_mean == 0)
+	{
+		return SILENCE_LUFS;
+	}
+	const double relative_gate = absolute_mean * std::pow(10.0, RELATIVE_GATE_LU / 10);
+	const double integrated = gated_mean(std::max(absolute_gate, relative_gate));
+	return std::max(loudness(integrated), SILENCE_LUFS);
+}
+
+double audio::LoudnessMeter::truePeak() const noexcept
+{
+	return 20 * std::log10(static_cast<double>(std::max(m_peak, MIN_PEAK)));
+}
+
+void audio::LoudnessMeter::filter(const float* samples, std::size_t frames) noexcept
+{
+	unsigned int channel = 0;
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	// two channels per vector, in double precision: the high-pass pole is very close to the
+	// unit circle
+	const __m128d shelf_b0 = _mm_set1_pd(m_shelf.b0);
+	const __m128d shelf_b1 = _mm_set1_pd(m_shelf.b1);
+	const __m128d shelf_b2 = _mm_set1_pd(m_shelf.b2);
+	const __m128d shelf_a1 = _mm_set1_pd(m_shelf.a1);
+	const __m128d shelf_a2 = _mm_set1_pd(m_shelf.a2);
+	const __m128d highpass_b0 = _mm_set1_pd(m_highpass.b0);
+	const __m128d highpass_b1 = _mm_set1_pd(m_highpass.b1);
+	const __m128d highpass_b2 = _mm_set1_pd(m_highpass.b2);
+	const __m128d highpass_a1 = _mm_set1_pd(m_highpass.a1);
+	const __m128d highpass_a2 = _mm_set1_pd(m_highpass.a2);
+	for(; channel + 2 <= m_channels; channel += 2)
+	{
+		ChannelState& first = m_states[channel];
+		ChannelState& second = m_states[channel + 1];
+		__m128d s1 = _mm_set_pd(second.shelf_z1, first.shelf_z1);
+		__m128d s2 = _mm_set_pd(second.shelf_z2, first.shelf_z2);
+		__m128d h1 = _mm_set_pd(second.highpass_z1, first.highpass_z1);
+		__m128d h2 = _mm_set_pd(second.highpass_z2, first.highpass_z2);
+		__m128d energy = _mm_setzero_pd();
+
+		const float* in = samples + channel;
+		for(std::size_t frame = 0; frame < frames; ++frame, in += m_channels)
+		{
+			const __m128d x = _mm_set_pd(in[1], in[0]);
+			const __m128d y = _mm_add_pd(_mm_mul_pd(shelf_b0, x), s1);
+			s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(shelf_b1, x), _mm_mul_pd(shelf_a1, y)), s2);
+			s2 = _mm_sub_pd(_mm_mul_pd(shelf_b2, x), _mm_mul_pd(shelf_a2, y));
+			const __m128d z = _mm_add_pd(_mm_mul_pd(highpass_b0, y), h1);
+			h1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(highpass_b1, y), _mm_mul_pd(highpass_a1, z)), h2);
+			h2 = _mm_sub_pd(_mm_mul_pd(highpass_b2, y), _mm_mul_pd(highpass_a2, z));
+			energy = _mm_add_pd(energy, _mm_mul_pd(z, z));
+		}
+
+		double values[2];
+		_mm_storeu_pd(values, s1);
+		first.shelf_z1 = values[0];
+		second.shelf_z1 = values[1];
+		_mm_storeu_pd(values, s2);
+		first.shelf_z2 = values[0];
+		second.shelf_z2 = values[1];
+		_mm_storeu_pd(values, h1);
+		first.highpass_z1 = values[0];
+		second.highpass_z1 = values[1];
+		_mm_storeu_pd(values, h2);
+		first.highpass_z2 = values[0];
+		second.highpass_z2 = values[1];
+		_mm_storeu_pd(values, energy);
+		m_channel_energies[channel] += values[0];
+		m_channel_energies[channel + 1] += values[1];
+	}
+#endif
+
+	for(; channel < m_channels; ++channel)
+	{
+		ChannelState& state = m_states[channel];
+		double energy = 0;
+		const float* in = samples + channel;
+		for(std::size_t frame = 0; frame < frames; ++frame, in += m_channels)
+		{
+			const auto x = static_cast<double>(*in);
+			const double y = m_shelf.b0 * x + state.shelf_z1;
+			state.shelf_z1 = m_shelf.b1 * x - m_shelf.a1 * y + state.shelf_z2;
+			state.shelf_z2 = m_shelf.b2 * x - m_shelf.a2 * y;
+			const double z = m_highpass.b0 * y + state.highpass_z1;
+			state.highpass_z1 = m_highpass.b1 * y - m_highpass.a1 * z + state.highpass_z2;
+			state.highpass_z2 = m_highpass.b2 * y - m_highpass.a2 * z;
+			energy += z * z;
+		}
+		m_channel_energies[channel] += energy;
+	}
+}
+
+void audio::LoudnessMeter::endSubBlock()
+{
+	double energy = 0;
+	for(unsigned int channel = 0; channel < m_channels; ++channel)
+	{
+		energy += m_weights[channel] * m_channel_energies[channel];
+		m_channel_energies[channel] = 0;
+	}
+	m_subblocks[m_subblock_count % m_subblocks.size()] =
+	  energy / static_cast<double>(m_subblock_frames);
+	++m_subblock_count;
+	m_subblock_position = 0;
+
+	if(m_subblock_count >= m_subblocks.size())
+	{
+		m_blocks.push_back(std::accumulate(m_subblocks.cbegin(), m_subblocks.cend(), 0.0)
+		                   / static_cast<double>(m_subblocks.size()));
+	}
+}
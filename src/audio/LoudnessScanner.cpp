@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/LoudnessScanner.hpp"
+#include "audio/AudioFile.hpp"
+#include "audio/LoudnessMeter.hpp"
+#include "utils/log.hpp"
+
+#include "MappedFileInputStream.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace
+{
+	constexpr std::size_t ANALYSIS_CHUNK_FRAMES = 16384;
+
+	// While throttled, the remaining worker sleeps this many times its processing time
+	constexpr int THROTTLED_SLEEP_RATIO = 3;
+
+	constexpr std::chrono::seconds SAVE_INTERVAL{30};
+} // namespace
+
+audio::LoudnessScanner::LoudnessScanner(std::shared_ptr<spdlog::logger> logger,
+                                        data::LoudnessDatabase& database) noexcept
+  : m_database(database)
+  , m_paths()
+  , m_next_path(0)
+  , m_analyzed(0)
+  , m_failed(0)
+  , m_running_workers(0)
+  , m_workers()
+  , m_mutex()
+  , m_cond()
+  , m_stop(false)
+  , m_throttled(false)
+  , m_save_mutex()
+  , m_last_save()
+  , m_saved_analyzed(0)
+  , m_logger(std::move(logger))
+{
+}
+
+audio::LoudnessScanner::~LoudnessScanner() noexcept
+{
+	stop();
+}
+
+std::vector<utf8_path> audio::LoudnessScanner::filterAnalyzed(std::vector<utf8_path> paths) const
+{
+	std::vector<utf8_path> pending;
+	for(utf8_path& path: paths)
+	{
+		std::uintmax_t file_size;
+		std::int64_t modification_time;
+		if(!data::get_file_signature(path, file_size, modification_time))
+		{
+			m_logger->warn("Failed to get size and modification time of {}, loudness not analyzed",
+			               path);
+			continue;
+		}
+		if(!m_database.contains(path, file_size, modification_time))
+		{
+			pending.push_back(std::move(path));
+		}
+	}
+	m_logger->info("Loudness of {} of the {} tracks already analyzed",
+	               paths.size() - pending.size(),
+	               paths.size());
+	return pending;
+}
+
+void audio::LoudnessScanner::start(std::vector<utf8_path> paths)
+{
+	stop();
+	if(paths.empty())
+	{
+		return;
+	}
+
+	// one core left to the playback and the interface
+	const unsigned int cores = std::max(std::thread::hardware_concurrency(), 2u);
+	const auto workers = static_cast<unsigned int>(
+	  std::min(static_cast<std::size_t>(cores - 1), paths.size()));
+	m_logger->info("Analyzing loudness of {} tracks with {} workers", paths.size(), workers);
+
+	m_paths = std::move(paths);
+	m_next_path = 0;
+	m_analyzed = 0;
+	m_failed = 0;
+	m_stop = false;
+	m_last_save = std::chrono::steady_clock::now();
+	m_saved_analyzed = 0;
+	m_running_workers = workers;
+	for(unsigned int worker = 0; worker < workers; ++worker)
+	{
+		m_workers.emplace_back(&LoudnessScanner::work, this, worker);
+	}
+}
+
+void audio::LoudnessScanner::stop() noexcept
+{
+	if(m_workers.empty())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+	for(std::thread& worker: m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+
+	if(m_analyzed + m_failed < m_paths.size())
+	{
+		m_logger->info("Loudness analysis interrupted after {} of {} tracks, it will resume later",
+		               m_analyzed.load(),
+		               m_paths.size());
+	}
+	saveIfDue(true);
+}
+
+void audio::LoudnessScanner::setThrottled(bool throttled) noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_throttled = throttled;
+	}
+	m_cond.notify_all();
+}
+
+bool audio::LoudnessScanner::isRunning() const noexcept
+{
+	return m_running_workers.load() != 0;
+}
+
+void audio::LoudnessScanner::work(unsigned int worker) noexcept
+{
+	while(!m_stop)
+	{
+		const std::size_t index = m_next_path.fetch_add(1);
+		if(index >= m_paths.size())
+		{
+			break;
+		}
+
+		const utf8_path& path = m_paths[index];
+		data::TrackLoudness loudness{};
+		if(analyze(worker, path, loudness))
+		{
+			m_database.insert(path, loudness);
+			++m_analyzed;
+			SPDLOG_DEBUG(m_logger,
+			             "Analyzed {}: {:.2f} LUFS, {:.2f} dBTP",
+			             path,
+			             loudness.integrated_lufs,
+			             loudness.true_peak_db);
+			saveIfDue(false);
+		}
+		else if(!m_stop)
+		{
+			++m_failed;
+			m_logger->warn("Failed to analyze loudness of {}", path);
+		}
+	}
+
+	if(m_running_workers.fetch_sub(1) == 1 && !m_stop)
+	{
+		saveIfDue(true);
+		m_logger->info("Loudness analysis ended: {} tracks analyzed, {} failed",
+		               m_analyzed.load(),
+		               m_failed.load());
+	}
+}
+
+bool audio::LoudnessScanner::analyze(unsigned int worker,
+                                     const utf8_path& path,
+                                     data::TrackLoudness& loudness)
+{
+	if(!data::get_file_signature(path, loudness.file_size, loudness.modification_time))
+	{
+		return false;
+	}
+
+	// the sound file reader references the stream: declared after it
+	MappedFileInputStream stream;
+	if(!stream.open(path.str_cref()))
+	{
+		return false;
+	}
+	AudioFile file;
+	if(!file.openFromStream(stream))
+	{
+		return false;
+	}
+	const unsigned int channel_count = file.getChannelCount();
+	const unsigned int sample_rate = file.getSampleRate();
+	if(channel_count == 0 || sample_rate == 0)
+	{
+		return false;
+	}
+
+	// read as float: full resolution of 24 bits files
+	std::vector<float> samples(ANALYSIS_CHUNK_FRAMES * channel_count);
+	LoudnessMeter meter;
+	meter.prepare(channel_count, sample_rate, ANALYSIS_CHUNK_FRAMES);
+
+	sf::Uint64 total_frames = 0;
+	for(;;)
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		const auto frames = static_cast<std::size_t>(file.read(samples.data(), samples.size()))
+		                    / channel_count;
+		if(frames == 0)
+		{
+			break;
+		}
+		meter.process(samples.data(), frames);
+		total_frames += frames;
+
+		if(!throttle(worker, std::chrono::steady_clock::now() - begin))
+		{
+			return false;
+		}
+	}
+
+	loudness.integrated_lufs = meter.integratedLoudness();
+	loudness.true_peak_db = meter.truePeak();
+	loudness.duration_seconds = static_cast<double>(total_frames) / sample_rate;
+	return true;
+}
+
+bool audio::LoudnessScanner::throttle(unsigned int worker, std::chrono::steady_clock::duration busy)
+{
+	if(!m_throttled.load(std::memory_order_relaxed))
+	{
+		return !m_stop;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if(worker == 0)
+	{
+		// keep analyzing, but leave the cores to the playback
+		m_cond.wait_for(lock, busy * THROTTLED_SLEEP_RATIO, [this] { return m_stop.load(); });
+	}
+	else
+	{
+		m_cond.wait(lock, [this] { return m_stop || !m_throttled; });
+	}
+	return !m_stop;
+}
+
+void audio::LoudnessScanner::saveIfDue(bool force) noexcept
+{
+	std::unique_lock<std::mutex> lock(m_save_mutex, std::defer_lock);
+	if(force)
+	{
+		lock.lock();
+	}
+	else if(!lock.try_lock())
+	{
+		// another worker is saving
+		return;
+	}
+
+	const std::size_t analyzed = m_analyzed;
+	const auto now = std::chrono::steady_clock::now();
+	if(analyzed == m_saved_analyzed || (!force && now - m_last_save < SAVE_INTERVAL))
+	{
+		return;
+	}
+	m_database.save(m_logger);
+	m_last_save = now;
+	m_saved_analyzed = analyzed;
+}
@@ -0,0 +1,343 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/Mixer.hpp"
+#include "audio/mix_kernels.hpp"
+#include "utils/log.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Gains are computed per block and linearly interpolated inside it
+	constexpr std::size_t FADE_BLOCK_FRAMES = 256;
+
+	// Attenuation at the start of a logarithmic fade in
+	constexpr float LOGARITHMIC_FADE_RANGE_DB = -60.f;
+
+	constexpr float PI = 3.14159265358979f;
+
+	// t in [0, 1], fade out gain is fade_in_gain(1 - t)
+	float fade_in_gain(data::CrossfadeCurve curve, float t) noexcept
+	{
+		switch(curve)
+		{
+			case data::CrossfadeCurve::LINEAR:
+				return t;
+			case data::CrossfadeCurve::EQUAL_POWER:
+				return std::sin(t * PI / 2);
+			case data::CrossfadeCurve::LOGARITHMIC:
+				if(t <= 0)
+				{
+					return 0;
+				}
+				return std::pow(10.f, (1 - t) * LOGARITHMIC_FADE_RANGE_DB / 20);
+		}
+		return t;
+	}
+
+	audio::kernels::GainRamp gain_ramp(float start_gain, float end_gain, std::size_t frames) noexcept
+	{
+		return {start_gain, (end_gain - start_gain) / static_cast<float>(frames)};
+	}
+} // namespace
+
+audio::Mixer::Mixer(std::shared_ptr<spdlog::logger> logger) noexcept
+  : m_decoders{std::make_unique<Decoder>(logger), std::make_unique<Decoder>(logger)}
+  , m_gains{1.f, 1.f}
+  , m_current(0)
+  , m_next_ready(false)
+  , m_channel_count(0)
+  , m_sample_rate(0)
+  , m_crossfade_seconds(0)
+  , m_crossfade_curve(data::CrossfadeCurve::EQUAL_POWER)
+  , m_track_frames(0)
+  , m_fading(false)
+  , m_fade_frames(0)
+  , m_fade_position(0)
+  , m_fade_curve(data::CrossfadeCurve::EQUAL_POWER)
+  , m_fade_buffer()
+  , m_logger(std::move(logger))
+{
+}
+
+bool audio::Mixer::open(const utf8_path& path, float decode_ahead_seconds, float gain)
+{
+	m_next_ready.store(false, std::memory_order_relaxed);
+	m_fading = false;
+	m_track_frames = 0;
+	m_current.store(0, std::memory_order_relaxed);
+	m_decoders[1]->close();
+
+	if(!m_decoders[0]->open(path, decode_ahead_seconds))
+	{
+		m_channel_count = 0;
+		m_sample_rate = 0;
+		return false;
+	}
+	m_gains[0] = gain;
+	m_channel_count = m_decoders[0]->getChannelCount();
+	m_sample_rate = m_decoders[0]->getSampleRate();
+	m_fade_buffer.resize(FADE_BLOCK_FRAMES * m_channel_count);
+	return true;
+}
+
+bool audio::Mixer::queue(const utf8_path& path, float decode_ahead_seconds, float gain)
+{
+	if(m_channel_count == 0 || m_next_ready.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+
+	// the audio thread doesn't use the next decoder until m_next_ready is set
+	Decoder& decoder = next();
+	if(!decoder.open(path, decode_ahead_seconds))
+	{
+		return false;
+	}
+	if(decoder.getChannelCount() != m_channel_count || decoder.getSampleRate() != m_sample_rate)
+	{
+		m_logger->info("{} can't be chained: {} channels at {} Hz after {} channels at {} Hz",
+		               path,
+		               decoder.getChannelCount(),
+		               decoder.getSampleRate(),
+		               m_channel_count,
+		               m_sample_rate);
+		decoder.close();
+		return false;
+	}
+	m_gains[1 - m_current.load(std::memory_order_relaxed)] = gain;
+
+	m_next_ready.store(true, std::memory_order_release);
+	SPDLOG_DEBUG(m_logger, "Queued {} after the current track", path);
+	return true;
+}
+
+bool audio::Mixer::hasQueued() const noexcept
+{
+	return m_next_ready.load(std::memory_order_acquire);
+}
+
+void audio::Mixer::setPcmCache(PcmCache* cache) noexcept
+{
+	for(std::unique_ptr<Decoder>& decoder : m_decoders)
+	{
+		decoder->setCache(cache);
+	}
+}
+
+void audio::Mixer::setCrossfade(float seconds, data::CrossfadeCurve curve) noexcept
+{
+	m_crossfade_seconds.store(std::clamp(seconds, 0.f, data::Settings::MAX_CROSSFADE_SECONDS),
+	                          std::memory_order_relaxed);
+	m_crossfade_curve.store(curve, std::memory_order_relaxed);
+}
+
+std::size_t audio::Mixer::read(sf::Int16* samples, std::size_t max_count, bool& track_changed) noexcept
+{
+	track_changed = false;
+	if(m_channel_count == 0)
+	{
+		return 0;
+	}
+
+	const std::size_t max_frames = max_count / m_channel_count;
+	std::size_t frames = 0;
+	while(frames < max_frames)
+	{
+		sf::Int16* out = samples + frames * m_channel_count;
+		std::size_t wanted = max_frames - frames;
+
+		if(m_fading)
+		{
+			const std::size_t read = readCrossfade(out, wanted, track_changed);
+			if(read == 0 && m_fading)
+			{
+				// next decoder is late
+				break;
+			}
+			frames += read;
+			continue;
+		}
+
+		Decoder& decoder = current();
+		const bool next_ready = m_next_ready.load(std::memory_order_acquire);
+		if(next_ready)
+		{
+			const auto fade_frames = static_cast<std::size_t>(
+			  m_crossfade_seconds.load(std::memory_order_relaxed) * static_cast<float>(m_sample_rate));
+			const sf::Uint64 track_frames = decoder.getSampleCount() / m_channel_count;
+			const sf::Uint64 remaining = track_frames > m_track_frames ? track_frames - m_track_frames : 0;
+			if(fade_frames != 0 && remaining != 0)
+			{
+				if(remaining <= fade_frames)
+				{
+					m_fading = true;
+					m_fade_frames = static_cast<std::size_t>(remaining);
+					m_fade_position = 0;
+					m_fade_curve = m_crossfade_curve.load(std::memory_order_relaxed);
+					continue;
+				}
+				// stop exactly where the crossfade starts
+				wanted = static_cast<std::size_t>(
+				  std::min(static_cast<sf::Uint64>(wanted), remaining - fade_frames));
+			}
+		}
+
+		const std::size_t read = decoder.read(out, wanted * m_channel_count) / m_channel_count;
+		const float gain = m_gains[m_current.load(std::memory_order_relaxed)];
+		if(gain != 1.f && read != 0)
+		{
+			kernels::mix_ramp(out, {gain, 0}, out, {0, 0}, out, read, m_channel_count);
+		}
+		m_track_frames += read;
+		frames += read;
+		if(read != 0)
+		{
+			continue;
+		}
+
+		if(next_ready && decoder.finished())
+		{
+			// gapless transition
+			swap(0);
+			track_changed = true;
+			continue;
+		}
+
+		// end of the track or decoder late
+		break;
+	}
+	return frames * m_channel_count;
+}
+
+bool audio::Mixer::finished() const noexcept
+{
+	return !m_fading && !m_next_ready.load(std::memory_order_acquire) && current().finished();
+}
+
+sf::Uint64 audio::Mixer::getTrackFrames() const noexcept
+{
+	return m_track_frames;
+}
+
+void audio::Mixer::seek(sf::Time offset)
+{
+	if(m_fading)
+	{
+		// the seek applies to the outgoing track, the crossfade restarts from its beginning
+		m_fading = false;
+		next().seek(sf::Time::Zero);
+	}
+	current().seek(offset);
+	m_track_frames =
+	  static_cast<sf::Uint64>(std::max(0.f, offset.asSeconds()) * static_cast<float>(m_sample_rate));
+}
+
+unsigned int audio::Mixer::getChannelCount() const noexcept
+{
+	return m_channel_count;
+}
+
+unsigned int audio::Mixer::getSampleRate() const noexcept
+{
+	return m_sample_rate;
+}
+
+sf::Time audio::Mixer::getDuration() const noexcept
+{
+	return current().getDuration();
+}
+
+std::size_t audio::Mixer::getBufferedSamples() const noexcept
+{
+	return current().getBufferedSamples();
+}
+
+std::size_t audio::Mixer::getBufferCapacity() const noexcept
+{
+	return current().getBufferCapacity();
+}
+
+audio::Decoder& audio::Mixer::current() noexcept
+{
+	return *m_decoders[m_current.load(std::memory_order_relaxed)];
+}
+
+const audio::Decoder& audio::Mixer::current() const noexcept
+{
+	return *m_decoders[m_current.load(std::memory_order_relaxed)];
+}
+
+audio::Decoder& audio::Mixer::next() noexcept
+{
+	return *m_decoders[1 - m_current.load(std::memory_order_relaxed)];
+}
+
+void audio::Mixer::swap(sf::Uint64 track_frames) noexcept
+{
+	m_fading = false;
+	m_track_frames = track_frames;
+	m_current.store(1 - m_current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	// the previous decoder can now be reopened by queue()
+	m_next_ready.store(false, std::memory_order_release);
+}
+
+std::size_t audio::Mixer::readCrossfade(sf::Int16* samples,
+                                        std::size_t max_frames,
+                                        bool& track_changed) noexcept
+{
+	const std::size_t wanted =
+	  std::min({max_frames, m_fade_frames - m_fade_position, FADE_BLOCK_FRAMES});
+
+	Decoder& incoming = next();
+	const std::size_t frames = incoming.read(samples, wanted * m_channel_count) / m_channel_count;
+	if(frames == 0)
+	{
+		if(incoming.finished())
+		{
+			// next track shorter than the crossfade
+			swap(m_fade_position);
+			track_changed = true;
+		}
+		return 0;
+	}
+
+	// a late outgoing decoder is replaced by silence, the fade must keep its pace
+	const std::size_t count = frames * m_channel_count;
+	const std::size_t outgoing_count = current().read(m_fade_buffer.data(), count);
+	std::fill(m_fade_buffer.begin() + outgoing_count, m_fade_buffer.begin() + count, 0);
+
+	const auto fade_frames = static_cast<float>(m_fade_frames);
+	const float start = static_cast<float>(m_fade_position) / fade_frames;
+	const float end = static_cast<float>(m_fade_position + frames) / fade_frames;
+	const unsigned int current_index = m_current.load(std::memory_order_relaxed);
+	const float outgoing_gain = m_gains[current_index];
+	const float incoming_gain = m_gains[1 - current_index];
+	kernels::mix_ramp(m_fade_buffer.data(),
+	                  gain_ramp(outgoing_gain * fade_in_gain(m_fade_curve, 1 - start),
+	                            outgoing_gain * fade_in_gain(m_fade_curve, 1 - end),
+	                            frames),
+	                  samples,
+	                  gain_ramp(incoming_gain * fade_in_gain(m_fade_curve, start),
+	                            incoming_gain * fade_in_gain(m_fade_curve, end),
+	                            frames),
+	                  samples,
+	                  frames,
+	                  m_channel_count);
+
+	m_fade_position += frames;
+	if(m_fade_position == m_fade_frames)
+	{
+		swap(m_fade_frames);
+		track_changed = true;
+	}
+	return frames;
+}
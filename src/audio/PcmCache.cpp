@@ -0,0 +1,259 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/PcmCache.hpp"
+#include "audio/AudioFile.hpp"
+#include "data/Loudness.hpp"
+#include "utils/log.hpp"
+
+#include "MappedFileInputStream.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+	constexpr std::size_t PREFETCH_CHUNK_SAMPLES = 65536;
+} // namespace
+
+std::size_t audio::PcmTrack::bytes() const noexcept
+{
+	return samples.size() * sizeof(sf::Int16);
+}
+
+audio::PcmCache::PcmCache(std::shared_ptr<spdlog::logger> logger)
+  : m_mutex()
+  , m_entries()
+  , m_index()
+  , m_budget(0)
+  , m_used(0)
+  , m_hits(0)
+  , m_misses(0)
+  , m_thread()
+  , m_cond()
+  , m_stop(false)
+  , m_prefetch()
+  , m_request(0)
+  , m_logger(std::move(logger))
+{
+	m_thread = std::thread(&PcmCache::run, this);
+}
+
+audio::PcmCache::~PcmCache() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		++m_request;
+	}
+	m_cond.notify_one();
+	m_thread.join();
+}
+
+void audio::PcmCache::setBudget(std::size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budget.store(bytes, std::memory_order_relaxed);
+	evict(bytes);
+}
+
+bool audio::PcmCache::fits(sf::Uint64 sample_count) const noexcept
+{
+	const std::size_t budget = m_budget.load(std::memory_order_relaxed);
+	return sample_count != 0 && sample_count <= budget / sizeof(sf::Int16);
+}
+
+std::shared_ptr<const audio::PcmTrack> audio::PcmCache::find(const utf8_path& path)
+{
+	if(m_budget.load(std::memory_order_relaxed) == 0)
+	{
+		return nullptr;
+	}
+
+	std::uint64_t fingerprint;
+	const bool has_fingerprint = data::get_file_fingerprint(path, fingerprint);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto it = m_index.find(path.str_cref());
+	if(it == m_index.end())
+	{
+		++m_misses;
+		return nullptr;
+	}
+	if(!has_fingerprint || it->second->track->fingerprint != fingerprint)
+	{
+		SPDLOG_DEBUG(m_logger, "{} changed since it was cached", path);
+		erase(it->second);
+		++m_misses;
+		return nullptr;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, it->second);
+	++m_hits;
+	return m_entries.front().track;
+}
+
+void audio::PcmCache::insert(const utf8_path& path, std::shared_ptr<const PcmTrack> track)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const std::size_t budget = m_budget.load(std::memory_order_relaxed);
+	if(track->bytes() > budget)
+	{
+		return;
+	}
+
+	if(const auto it = m_index.find(path.str_cref()); it != m_index.end())
+	{
+		erase(it->second);
+	}
+	m_used += track->bytes();
+	m_entries.push_front({path.str_cref(), std::move(track)});
+	m_index.emplace(path.str_cref(), m_entries.begin());
+	evict(budget);
+	SPDLOG_DEBUG(m_logger,
+	             "Cached decoded samples of {}, {} tracks using {} bytes",
+	             path,
+	             m_entries.size(),
+	             m_used);
+}
+
+void audio::PcmCache::prefetch(std::vector<utf8_path> paths)
+{
+	if(m_budget.load(std::memory_order_relaxed) == 0)
+	{
+		paths.clear();
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_prefetch.assign(std::make_move_iterator(paths.begin()),
+		                  std::make_move_iterator(paths.end()));
+		++m_request;
+	}
+	m_cond.notify_one();
+}
+
+audio::PcmCache::Statistics audio::PcmCache::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Statistics statistics;
+	statistics.budget_bytes = m_budget.load(std::memory_order_relaxed);
+	statistics.used_bytes = m_used;
+	statistics.tracks = m_entries.size();
+	statistics.hits = m_hits;
+	statistics.misses = m_misses;
+	return statistics;
+}
+
+void audio::PcmCache::run() noexcept
+{
+	for(;;)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [this] { return m_stop || !m_prefetch.empty(); });
+		if(m_stop)
+		{
+			return;
+		}
+		const utf8_path path = std::move(m_prefetch.front());
+		m_prefetch.pop_front();
+		const std::uint64_t request = m_request;
+		lock.unlock();
+
+		decode(path, request);
+	}
+}
+
+void audio::PcmCache::decode(const utf8_path& path, std::uint64_t request)
+{
+	std::uint64_t fingerprint;
+	if(!data::get_file_fingerprint(path, fingerprint))
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(contains(path.str_cref(), fingerprint))
+		{
+			return;
+		}
+	}
+
+	// the sound file reader references the stream: declared after it
+	MappedFileInputStream stream;
+	AudioFile file;
+	if(!stream.open(path.str_cref()) || !file.openFromStream(stream) || file.getChannelCount() == 0)
+	{
+		SPDLOG_DEBUG(m_logger, "Failed to decode {}, not prefetched", path);
+		return;
+	}
+	if(!fits(file.getSampleCount()))
+	{
+		SPDLOG_DEBUG(m_logger, "{} exceeds the decoded audio cache budget, not prefetched", path);
+		return;
+	}
+
+	auto track = std::make_shared<PcmTrack>();
+	track->fingerprint = fingerprint;
+	track->channel_count = file.getChannelCount();
+	track->sample_rate = file.getSampleRate();
+	track->duration = file.getDuration();
+	track->samples.resize(static_cast<std::size_t>(file.getSampleCount()));
+	std::size_t decoded = 0;
+	for(;;)
+	{
+		if(m_request.load(std::memory_order_relaxed) != request)
+		{
+			SPDLOG_DEBUG(m_logger, "Prefetch of {} cancelled", path);
+			return;
+		}
+
+		// the sample count of some formats is an estimate
+		if(track->samples.size() - decoded < track->channel_count)
+		{
+			track->samples.resize(decoded + PREFETCH_CHUNK_SAMPLES);
+		}
+		const std::size_t count =
+		  std::min(track->samples.size() - decoded, PREFETCH_CHUNK_SAMPLES);
+		const auto read = static_cast<std::size_t>(
+		  file.read(track->samples.data() + decoded, count - count % track->channel_count));
+		if(read == 0)
+		{
+			break;
+		}
+		decoded += read;
+	}
+	track->samples.resize(decoded);
+	track->samples.shrink_to_fit();
+
+	SPDLOG_DEBUG(m_logger, "Prefetched {}", path);
+	insert(path, std::move(track));
+}
+
+bool audio::PcmCache::contains(const std::string& path, std::uint64_t fingerprint) const
+{
+	const auto it = m_index.find(path);
+	return it != m_index.end() && it->second->track->fingerprint == fingerprint;
+}
+
+void audio::PcmCache::erase(std::list<Entry>::iterator entry)
+{
+	m_used -= entry->track->bytes();
+	m_index.erase(entry->path);
+	m_entries.erase(entry);
+}
+
+void audio::PcmCache::evict(std::size_t budget)
+{
+	while(m_used > budget && !m_entries.empty())
+	{
+		SPDLOG_DEBUG(
+		  m_logger, "Evicted decoded samples of {} from the cache", m_entries.back().path);
+		erase(std::prev(m_entries.end()));
+	}
+}
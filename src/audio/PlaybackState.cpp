@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/PlaybackState.hpp"
+
+#include <thread>
+
+double audio::PlaybackState::Snapshot::positionSeconds(
+  std::chrono::steady_clock::time_point now) const noexcept
+{
+	if(sample_rate == 0)
+	{
+		return 0;
+	}
+
+	double seconds = static_cast<double>(position_frames) / sample_rate;
+	if(status == sf::SoundSource::Playing && now > timestamp)
+	{
+		seconds += std::chrono::duration<double>(now - timestamp).count();
+	}
+	return seconds;
+}
+
+audio::PlaybackState::PlaybackState() noexcept
+  : m_sequence(0)
+  , m_epoch(0)
+  , m_track_id(0)
+  , m_position_frames(0)
+  , m_sample_rate(0)
+  , m_status(sf::SoundSource::Stopped)
+  , m_timestamp(0)
+{
+}
+
+void audio::PlaybackState::publish(const Snapshot& snapshot) noexcept
+{
+	std::uint32_t sequence;
+	while(!tryBeginWrite(sequence))
+	{
+		std::this_thread::yield();
+	}
+	m_epoch.fetch_add(1, std::memory_order_relaxed);
+	write(snapshot, sequence);
+}
+
+std::uint64_t audio::PlaybackState::epoch() const noexcept
+{
+	return m_epoch.load(std::memory_order_acquire);
+}
+
+bool audio::PlaybackState::tryPublish(const Snapshot& snapshot, std::uint64_t epoch) noexcept
+{
+	std::uint32_t sequence;
+	if(!tryBeginWrite(sequence))
+	{
+		return false;
+	}
+	if(m_epoch.load(std::memory_order_relaxed) != epoch)
+	{
+		// outdated by a publish(), nothing written
+		m_sequence.store(sequence + 2, std::memory_order_release);
+		return false;
+	}
+	write(snapshot, sequence);
+	return true;
+}
+
+audio::PlaybackState::Snapshot audio::PlaybackState::load() const noexcept
+{
+	Snapshot snapshot;
+	for(;;)
+	{
+		const std::uint32_t sequence = m_sequence.load(std::memory_order_acquire);
+		if((sequence & 1) != 0)
+		{
+			continue;
+		}
+
+		snapshot.track_id = m_track_id.load(std::memory_order_relaxed);
+		snapshot.position_frames = m_position_frames.load(std::memory_order_relaxed);
+		snapshot.sample_rate = m_sample_rate.load(std::memory_order_relaxed);
+		snapshot.status =
+		  static_cast<sf::SoundSource::Status>(m_status.load(std::memory_order_relaxed));
+		snapshot.timestamp = std::chrono::steady_clock::time_point(
+		  std::chrono::steady_clock::duration(m_timestamp.load(std::memory_order_relaxed)));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(m_sequence.load(std::memory_order_relaxed) == sequence)
+		{
+			return snapshot;
+		}
+	}
+}
+
+bool audio::PlaybackState::tryBeginWrite(std::uint32_t& sequence) noexcept
+{
+	sequence = m_sequence.load(std::memory_order_relaxed);
+	return (sequence & 1) == 0
+	       && m_sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acq_rel);
+}
+
+void audio::PlaybackState::write(const Snapshot& snapshot, std::uint32_t sequence) noexcept
+{
+	m_track_id.store(snapshot.track_id, std::memory_order_relaxed);
+	m_position_frames.store(snapshot.position_frames, std::memory_order_relaxed);
+	m_sample_rate.store(snapshot.sample_rate, std::memory_order_relaxed);
+	m_status.store(snapshot.status, std::memory_order_relaxed);
+	m_timestamp.store(snapshot.timestamp.time_since_epoch().count(), std::memory_order_relaxed);
+	m_sequence.store(sequence + 2, std::memory_order_release);
+}
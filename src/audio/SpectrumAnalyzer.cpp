@@ -0,0 +1,273 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/SpectrumAnalyzer.hpp"
+#include "utils/log.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+	// ~93ms at 44.1kHz, a new analysis every ~23ms
+	constexpr std::size_t FFT_SIZE = 4096;
+	constexpr std::size_t HOP_FRAMES = 1024;
+
+	constexpr unsigned int MAX_TAP_CHANNELS = 8;
+	constexpr std::size_t INPUT_FRAMES = 16384;
+
+	// Older samples are dropped to stay in sync with the playback
+	constexpr std::size_t MAX_LAG_FRAMES = 4 * HOP_FRAMES;
+
+	constexpr float MIN_FREQUENCY = 20.f;
+	constexpr float MAX_FREQUENCY = 20000.f;
+
+	// Fall speed of the bands and peaks
+	constexpr float DECAY_DB_PER_SECOND = 48.f;
+
+	// Weight of a new measure in the average analysis cost
+	constexpr float COST_SMOOTHING = 0.05f;
+
+	constexpr std::chrono::milliseconds POLL_PERIOD{5};
+	constexpr std::chrono::milliseconds IDLE_PERIOD{100};
+
+	constexpr double PI = 3.14159265358979323846;
+	constexpr float SAMPLE_SCALE = 32768.f;
+
+	float power_to_db(float power) noexcept
+	{
+		if(power <= 0)
+		{
+			return data::Spectrum::FLOOR_DB;
+		}
+		return std::max(10.f * std::log10(power), data::Spectrum::FLOOR_DB);
+	}
+} // namespace
+
+audio::SpectrumAnalyzer::SpectrumAnalyzer(std::shared_ptr<spdlog::logger> logger,
+                                          triple_buffer<data::Spectrum>& output,
+                                          const std::atomic<bool>& enabled)
+  : m_output(output)
+  , m_enabled(enabled)
+  , m_input(INPUT_FRAMES * MAX_TAP_CHANNELS)
+  , m_input_channels(0)
+  , m_input_sample_rate(0)
+  , m_channels(0)
+  , m_sample_rate(0)
+  , m_fft()
+  , m_window(FFT_SIZE)
+  , m_hop(HOP_FRAMES * MAX_TAP_CHANNELS)
+  , m_history(FFT_SIZE, 0.f)
+  , m_frame(FFT_SIZE)
+  , m_real(FFT_SIZE / 2 + 1)
+  , m_imag(FFT_SIZE / 2 + 1)
+  , m_band_bins(data::Spectrum::BANDS)
+  , m_spectrum()
+  , m_thread()
+  , m_stop(false)
+  , m_logger(std::move(logger))
+{
+	m_fft.prepare(FFT_SIZE);
+	// periodic Hann window
+	for(std::size_t n = 0; n < FFT_SIZE; ++n)
+	{
+		m_window[n] = static_cast<float>(0.5 - 0.5 * std::cos(2 * PI * n / FFT_SIZE));
+	}
+	m_spectrum.fft_size = FFT_SIZE;
+
+	m_thread = std::thread(&SpectrumAnalyzer::run, this);
+}
+
+audio::SpectrumAnalyzer::~SpectrumAnalyzer() noexcept
+{
+	m_stop = true;
+	m_thread.join();
+}
+
+void audio::SpectrumAnalyzer::tap(const sf::Int16* samples,
+                                  std::size_t frames,
+                                  unsigned int channels,
+                                  unsigned int sample_rate) noexcept
+{
+	if(!m_enabled.load(std::memory_order_relaxed) || channels == 0
+	   || channels > MAX_TAP_CHANNELS)
+	{
+		return;
+	}
+
+	// the format is published before the samples using it
+	if(m_input_channels.load(std::memory_order_relaxed) != channels)
+	{
+		m_input_channels.store(channels, std::memory_order_release);
+	}
+	if(m_input_sample_rate.load(std::memory_order_relaxed) != sample_rate)
+	{
+		m_input_sample_rate.store(sample_rate, std::memory_order_release);
+	}
+
+	// whole frames only, the remaining ones are dropped
+	const std::size_t writable_frames = m_input.write_available() / channels;
+	m_input.push(samples, std::min(frames, writable_frames) * channels);
+}
+
+void audio::SpectrumAnalyzer::run() noexcept
+{
+	while(!m_stop.load(std::memory_order_relaxed))
+	{
+		if(!m_enabled.load(std::memory_order_relaxed))
+		{
+			discard(m_input.read_available());
+			std::this_thread::sleep_for(IDLE_PERIOD);
+			continue;
+		}
+
+		const unsigned int channels = m_input_channels.load(std::memory_order_acquire);
+		const unsigned int sample_rate = m_input_sample_rate.load(std::memory_order_acquire);
+		if(channels == 0 || sample_rate == 0)
+		{
+			std::this_thread::sleep_for(POLL_PERIOD);
+			continue;
+		}
+		if(channels != m_channels || sample_rate != m_sample_rate)
+		{
+			// samples of the previous format may remain, the following ones are aligned
+			discard(m_input.read_available());
+			setFormat(channels, sample_rate);
+			continue;
+		}
+
+		const std::size_t available_frames = m_input.read_available() / channels;
+		if(available_frames < HOP_FRAMES)
+		{
+			std::this_thread::sleep_for(POLL_PERIOD);
+			continue;
+		}
+		if(available_frames > MAX_LAG_FRAMES)
+		{
+			discard((available_frames - HOP_FRAMES) * channels);
+		}
+		analyzeHop();
+	}
+}
+
+void audio::SpectrumAnalyzer::setFormat(unsigned int channels, unsigned int sample_rate) noexcept
+{
+	m_channels = channels;
+	m_sample_rate = sample_rate;
+	std::fill(m_history.begin(), m_history.end(), 0.f);
+
+	const data::Spectrum previous = m_spectrum;
+	m_spectrum = data::Spectrum();
+	m_spectrum.fft_size = FFT_SIZE;
+	m_spectrum.analysis_us = previous.analysis_us;
+	m_spectrum.channels = channels;
+	m_spectrum.min_frequency = MIN_FREQUENCY;
+	m_spectrum.max_frequency = std::min(MAX_FREQUENCY, sample_rate / 2.f);
+
+	// narrow low bands share the same bin
+	const float bin_width = static_cast<float>(sample_rate) / FFT_SIZE;
+	const float ratio = m_spectrum.max_frequency / m_spectrum.min_frequency;
+	for(std::size_t band = 0; band < data::Spectrum::BANDS; ++band)
+	{
+		const float low = m_spectrum.min_frequency
+		                  * std::pow(ratio, static_cast<float>(band) / data::Spectrum::BANDS);
+		const float high = m_spectrum.min_frequency
+		                   * std::pow(ratio, static_cast<float>(band + 1) / data::Spectrum::BANDS);
+		const auto first = std::min(static_cast<std::size_t>(low / bin_width + 0.5f), FFT_SIZE / 2);
+		const auto end = std::min(static_cast<std::size_t>(high / bin_width + 0.5f), FFT_SIZE / 2);
+		m_band_bins[band] = {first, std::max(first, end == 0 ? 0 : end - 1)};
+	}
+	SPDLOG_DEBUG(m_logger,
+	             "Spectrum analysis of {} channels at {}Hz, {} points FFT",
+	             channels,
+	             sample_rate,
+	             FFT_SIZE);
+}
+
+void audio::SpectrumAnalyzer::analyzeHop() noexcept
+{
+	const auto begin = std::chrono::steady_clock::now();
+	m_input.pop(m_hop.data(), HOP_FRAMES * m_channels);
+
+	// downmix to the end of the history, measure the levels of the first channels
+	std::move(m_history.begin() + HOP_FRAMES, m_history.end(), m_history.begin());
+	float* mono = m_history.data() + FFT_SIZE - HOP_FRAMES;
+	const unsigned int level_channels =
+	  std::min(m_channels, static_cast<unsigned int>(data::Spectrum::LEVEL_CHANNELS));
+	std::array<int, data::Spectrum::LEVEL_CHANNELS> peaks{};
+	std::array<double, data::Spectrum::LEVEL_CHANNELS> sum_squares{};
+	const float mono_scale = 1.f / (SAMPLE_SCALE * m_channels);
+	for(std::size_t frame = 0; frame < HOP_FRAMES; ++frame)
+	{
+		const sf::Int16* samples = m_hop.data() + frame * m_channels;
+		int sum = 0;
+		for(unsigned int channel = 0; channel < m_channels; ++channel)
+		{
+			sum += samples[channel];
+		}
+		for(unsigned int channel = 0; channel < level_channels; ++channel)
+		{
+			peaks[channel] = std::max(peaks[channel], std::abs(static_cast<int>(samples[channel])));
+			sum_squares[channel] += static_cast<double>(samples[channel]) * samples[channel];
+		}
+		mono[frame] = static_cast<float>(sum) * mono_scale;
+	}
+
+	for(std::size_t n = 0; n < FFT_SIZE; ++n)
+	{
+		m_frame[n] = m_history[n] * m_window[n];
+	}
+	m_fft.forward(m_frame.data(), m_real.data(), m_imag.data());
+
+	// a full scale sine reaches FFT_SIZE / 4 with the Hann window: 0dB
+	constexpr float POWER_SCALE = (4.f / FFT_SIZE) * (4.f / FFT_SIZE);
+	const float decay = DECAY_DB_PER_SECOND * HOP_FRAMES / m_sample_rate;
+	for(std::size_t band = 0; band < data::Spectrum::BANDS; ++band)
+	{
+		float power = 0;
+		for(std::size_t bin = m_band_bins[band].first; bin <= m_band_bins[band].second; ++bin)
+		{
+			power = std::max(power, m_real[bin] * m_real[bin] + m_imag[bin] * m_imag[bin]);
+		}
+		m_spectrum.bands_db[band] =
+		  std::max(power_to_db(power * POWER_SCALE), m_spectrum.bands_db[band] - decay);
+	}
+	for(unsigned int channel = 0; channel < level_channels; ++channel)
+	{
+		const float peak = static_cast<float>(peaks[channel]) / SAMPLE_SCALE;
+		m_spectrum.peak_db[channel] =
+		  std::max(power_to_db(peak * peak), m_spectrum.peak_db[channel] - decay);
+		m_spectrum.rms_db[channel] = power_to_db(static_cast<float>(
+		  sum_squares[channel] / HOP_FRAMES / (SAMPLE_SCALE * SAMPLE_SCALE)));
+	}
+
+	const std::chrono::duration<float, std::micro> elapsed =
+	  std::chrono::steady_clock::now() - begin;
+	m_spectrum.analysis_us += COST_SMOOTHING * (elapsed.count() - m_spectrum.analysis_us);
+	m_spectrum.realtime_load =
+	  m_spectrum.analysis_us * 1e-6f * m_sample_rate / static_cast<float>(HOP_FRAMES);
+
+	m_output.write_buffer() = m_spectrum;
+	m_output.publish();
+}
+
+void audio::SpectrumAnalyzer::discard(std::size_t samples) noexcept
+{
+	while(samples != 0)
+	{
+		const std::size_t count = m_input.pop(m_hop.data(), std::min(samples, m_hop.size()));
+		if(count == 0)
+		{
+			return;
+		}
+		samples -= count;
+	}
+}
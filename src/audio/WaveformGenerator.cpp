@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/WaveformGenerator.hpp"
+#include "audio/AudioFile.hpp"
+#include "audio/mix_kernels.hpp"
+#include "data/Loudness.hpp"
+#include "utils/log.hpp"
+
+#include "MappedFileInputStream.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	constexpr std::size_t READ_BINS = 64;
+
+	// Partial waveforms are published at this interval while decoding
+	constexpr std::chrono::milliseconds PUBLISH_INTERVAL{250};
+
+	data::WaveformBin to_bin(const audio::kernels::SampleSummary& summary,
+	                         std::size_t count) noexcept
+	{
+		const double rms = std::sqrt(static_cast<double>(summary.sum_squares) / count);
+		return {summary.min,
+		        summary.max,
+		        static_cast<std::uint16_t>(
+		          std::min(rms, static_cast<double>(std::numeric_limits<std::uint16_t>::max())))};
+	}
+} // namespace
+
+audio::WaveformGenerator::WaveformGenerator(std::shared_ptr<spdlog::logger> logger,
+                                            Callback callback)
+  : m_callback(std::move(callback))
+  , m_thread()
+  , m_mutex()
+  , m_cond()
+  , m_stop(false)
+  , m_pending()
+  , m_request(0)
+  , m_logger(std::move(logger))
+{
+	m_thread = std::thread(&WaveformGenerator::run, this);
+}
+
+audio::WaveformGenerator::~WaveformGenerator() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		++m_request;
+	}
+	m_cond.notify_one();
+	m_thread.join();
+}
+
+void audio::WaveformGenerator::request(const utf8_path& path)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending = path;
+		++m_request;
+	}
+	m_cond.notify_one();
+}
+
+void audio::WaveformGenerator::cancel()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pending.reset();
+	++m_request;
+}
+
+void audio::WaveformGenerator::run() noexcept
+{
+	for(;;)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [this] { return m_stop || m_pending.has_value(); });
+		if(m_stop)
+		{
+			return;
+		}
+		const utf8_path path = std::move(*m_pending);
+		m_pending.reset();
+		const std::uint64_t request = m_request;
+		lock.unlock();
+
+		generate(path, request);
+	}
+}
+
+void audio::WaveformGenerator::generate(const utf8_path& path, std::uint64_t request)
+{
+	std::uint64_t fingerprint;
+	if(!data::get_file_fingerprint(path, fingerprint))
+	{
+		m_logger->warn("Failed to get fingerprint of {}, no waveform generated", path);
+		return;
+	}
+
+	if(std::shared_ptr<const data::Waveform> cached = data::loadWaveform(fingerprint, m_logger))
+	{
+		SPDLOG_DEBUG(m_logger, "Loaded waveform of {} from cache", path);
+		publish(std::move(cached), request);
+		return;
+	}
+
+	// the sound file reader references the stream: declared after it
+	MappedFileInputStream stream;
+	AudioFile file;
+	if(!stream.open(path.str_cref()) || !file.openFromStream(stream) || file.getChannelCount() == 0)
+	{
+		m_logger->warn("Failed to decode {}, no waveform generated", path);
+		return;
+	}
+	const unsigned int channel_count = file.getChannelCount();
+	const std::size_t bin_samples = data::Waveform::BASE_BIN_FRAMES * channel_count;
+
+	auto waveform = std::make_shared<data::Waveform>();
+	waveform->fingerprint = fingerprint;
+	waveform->total_frames = file.getSampleCount() / channel_count;
+	std::vector<data::WaveformBin>& bins = waveform->levels.front();
+	bins.reserve(
+	  static_cast<std::size_t>(waveform->total_frames / data::Waveform::BASE_BIN_FRAMES + 1));
+
+	std::vector<sf::Int16> samples(bin_samples * READ_BINS);
+	kernels::SampleSummary summary = kernels::EMPTY_SUMMARY;
+	std::size_t summarized = 0;
+	std::uint64_t decoded_frames = 0;
+	auto last_publish = std::chrono::steady_clock::now();
+	for(;;)
+	{
+		if(!isCurrent(request))
+		{
+			SPDLOG_DEBUG(m_logger, "Waveform generation of {} cancelled", path);
+			return;
+		}
+
+		const auto count = static_cast<std::size_t>(file.read(samples.data(), samples.size()));
+		if(count == 0)
+		{
+			break;
+		}
+		decoded_frames += count / channel_count;
+
+		// reads may not end on a bin boundary
+		for(std::size_t offset = 0; offset < count;)
+		{
+			const std::size_t size = std::min(count - offset, bin_samples - summarized);
+			kernels::summarize(samples.data() + offset, size, summary);
+			summarized += size;
+			offset += size;
+			if(summarized == bin_samples)
+			{
+				bins.push_back(to_bin(summary, summarized));
+				summary = kernels::EMPTY_SUMMARY;
+				summarized = 0;
+			}
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		if(now - last_publish >= PUBLISH_INTERVAL)
+		{
+			auto partial = std::make_shared<data::Waveform>(*waveform);
+			partial->buildLevels();
+			publish(std::move(partial), request);
+			last_publish = now;
+		}
+	}
+	if(summarized != 0)
+	{
+		bins.push_back(to_bin(summary, summarized));
+	}
+
+	waveform->total_frames = decoded_frames;
+	waveform->complete = true;
+	waveform->buildLevels();
+	SPDLOG_DEBUG(m_logger, "Generated waveform of {}: {}", path, *waveform);
+	data::saveWaveform(*waveform, m_logger);
+	publish(std::move(waveform), request);
+}
+
+bool audio::WaveformGenerator::publish(std::shared_ptr<const data::Waveform> waveform,
+                                       std::uint64_t request)
+{
+	// under lock: a request() or cancel() returning guarantees the previous waveforms
+	// won't be published anymore
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_request != request)
+	{
+		return false;
+	}
+	m_callback(std::move(waveform));
+	return true;
+}
+
+bool audio::WaveformGenerator::isCurrent(std::uint64_t request) const noexcept
+{
+	return m_request.load(std::memory_order_relaxed) == request;
+}
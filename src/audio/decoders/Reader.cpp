@@ -0,0 +1,43 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/decoders/Reader.hpp"
+#include "audio/mix_kernels.hpp"
+
+std::ostream& audio::decoders::operator<<(std::ostream& os, const Format& format)
+{
+	switch(format)
+	{
+		case Format::UNKNOWN:
+			os << "UNKNOWN";
+			break;
+		case Format::WAV:
+			os << "WAV";
+			break;
+		case Format::FLAC:
+			os << "FLAC";
+			break;
+		case Format::VORBIS:
+			os << "VORBIS";
+			break;
+		case Format::MP3:
+			os << "MP3";
+			break;
+	}
+	return os;
+}
+
+std::size_t audio::decoders::Reader::read(float* samples, std::size_t max_count)
+{
+	if(m_conversion.size() < max_count)
+	{
+		m_conversion.resize(max_count);
+	}
+	const std::size_t count = read(m_conversion.data(), max_count);
+	kernels::to_float(m_conversion.data(), samples, count);
+	return count;
+}
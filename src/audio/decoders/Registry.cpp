@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/decoders/Registry.hpp"
+#include "audio/decoders/SfmlReader.hpp"
+#include "audio/decoders/WavReader.hpp"
+
+#include "MappedFileInputStream.hpp"
+
+#include <cstring>
+
+namespace
+{
+	using audio::decoders::Format;
+
+	// enough for the Vorbis identification header in the first Ogg page
+	constexpr std::size_t HEADER_SIZE = 64;
+
+	constexpr std::size_t ID3V2_HEADER_SIZE = 10;
+	constexpr std::uint8_t ID3V2_FOOTER_FLAG = 0x10;
+
+	bool check_flac(const std::uint8_t* header, std::size_t size) noexcept
+	{
+		return size >= 4 && std::memcmp(header, "fLaC", 4) == 0;
+	}
+
+	bool check_vorbis(const std::uint8_t* header, std::size_t size) noexcept
+	{
+		// the identification packet is alone in the first page, after a single lacing value
+		return size >= 35 && std::memcmp(header, "OggS", 4) == 0
+		       && std::memcmp(header + 28, "\x01vorbis", 7) == 0;
+	}
+
+	bool check_mp3(const std::uint8_t* header, std::size_t size) noexcept
+	{
+		// MPEG audio frame header: sync word, valid layer, bitrate and sample rate
+		return size >= 3 && header[0] == 0xFF && (header[1] & 0xE0) == 0xE0
+		       && (header[1] & 0x06) != 0 && (header[2] & 0xF0) != 0xF0
+		       && (header[2] & 0x0C) != 0x0C;
+	}
+
+	// size of the ID3v2 tag prepended to the audio data, 0 if none
+	std::size_t id3v2_size(const std::uint8_t* header, std::size_t size) noexcept
+	{
+		if(size < ID3V2_HEADER_SIZE || std::memcmp(header, "ID3", 3) != 0)
+		{
+			return 0;
+		}
+		// synchsafe integer: 7 bits per byte
+		const std::size_t tag_size = (static_cast<std::size_t>(header[6] & 0x7F) << 21)
+		                             | (static_cast<std::size_t>(header[7] & 0x7F) << 14)
+		                             | (static_cast<std::size_t>(header[8] & 0x7F) << 7)
+		                             | static_cast<std::size_t>(header[9] & 0x7F);
+		return ID3V2_HEADER_SIZE + tag_size
+		       + ((header[5] & ID3V2_FOOTER_FLAG) != 0 ? ID3V2_HEADER_SIZE : 0);
+	}
+
+	std::size_t read_header(sf::InputStream& stream, sf::Int64 offset, std::uint8_t* header)
+	{
+		if(stream.seek(offset) != offset)
+		{
+			return 0;
+		}
+		const sf::Int64 read = stream.read(header, HEADER_SIZE);
+		return read > 0 ? static_cast<std::size_t>(read) : 0;
+	}
+
+	std::unique_ptr<audio::decoders::Reader> create_wav_reader()
+	{
+		return std::make_unique<audio::decoders::WavReader>();
+	}
+
+	template<Format format>
+	std::unique_ptr<audio::decoders::Reader> create_sfml_reader()
+	{
+		return std::make_unique<audio::decoders::SfmlReader>(format);
+	}
+} // namespace
+
+const audio::decoders::Registry& audio::decoders::Registry::get()
+{
+	static const Registry registry;
+	return registry;
+}
+
+audio::decoders::Format audio::decoders::Registry::probe(sf::InputStream& stream) const
+{
+	std::uint8_t header[HEADER_SIZE];
+	std::size_t size = read_header(stream, 0, header);
+
+	const std::size_t tag_size = id3v2_size(header, size);
+	if(tag_size != 0)
+	{
+		size = read_header(stream, static_cast<sf::Int64>(tag_size), header);
+	}
+
+	Format format = Format::UNKNOWN;
+	for(const Entry& entry: m_entries)
+	{
+		if(entry.check(header, size))
+		{
+			format = entry.format;
+			break;
+		}
+	}
+	// ID3v2 tags are mostly used by MP3 files, mpg123 skips the padding before the first frame
+	if(format == Format::UNKNOWN && tag_size != 0)
+	{
+		format = Format::MP3;
+	}
+
+	stream.seek(0);
+	return format;
+}
+
+audio::decoders::Format audio::decoders::Registry::probe(const utf8_path& path) const
+{
+	MappedFileInputStream stream;
+	if(!stream.open(path.str_cref()))
+	{
+		return Format::UNKNOWN;
+	}
+	return probe(stream);
+}
+
+std::unique_ptr<audio::decoders::Reader> audio::decoders::Registry::open(sf::InputStream& stream,
+                                                                          Info& info) const
+{
+	const Entry* entry = find(probe(stream));
+	if(entry == nullptr)
+	{
+		return nullptr;
+	}
+	std::unique_ptr<Reader> reader = entry->create();
+	if(!reader->open(stream, info) || info.sample_rate == 0)
+	{
+		return nullptr;
+	}
+	return reader;
+}
+
+audio::decoders::Registry::Registry()
+  : m_entries{{Format::WAV, &WavReader::check, &create_wav_reader},
+              {Format::FLAC, &check_flac, &create_sfml_reader<Format::FLAC>},
+              {Format::VORBIS, &check_vorbis, &create_sfml_reader<Format::VORBIS>},
+              // weakest signature last
+              {Format::MP3, &check_mp3, &create_sfml_reader<Format::MP3>}}
+{
+}
+
+const audio::decoders::Registry::Entry*
+audio::decoders::Registry::find(Format format) const noexcept
+{
+	for(const Entry& entry: m_entries)
+	{
+		if(entry.format == format)
+		{
+			return &entry;
+		}
+	}
+	return nullptr;
+}
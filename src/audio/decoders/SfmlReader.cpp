@@ -0,0 +1,57 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/decoders/SfmlReader.hpp"
+
+#include "SoundFileReaderMp3.hpp"
+
+#include <SFML/Audio/SoundFileFactory.hpp>
+
+audio::decoders::SfmlReader::SfmlReader(Format format) noexcept
+  : m_format(format), m_reader(), m_channel_count(0)
+{
+}
+
+bool audio::decoders::SfmlReader::open(sf::InputStream& stream, Info& info)
+{
+	if(m_format == Format::MP3)
+	{
+		// the check of the MP3 reader scans the whole file
+		m_reader = std::make_unique<SoundFileReaderMp3>();
+	}
+	else
+	{
+		// FLAC and Vorbis readers are not public, their checks only read the headers
+		m_reader.reset(sf::SoundFileFactory::createReaderFromStream(stream));
+	}
+
+	sf::SoundFileReader::Info sfml_info{};
+	if(!m_reader || stream.seek(0) != 0 || !m_reader->open(stream, sfml_info)
+	   || sfml_info.channelCount == 0)
+	{
+		m_reader.reset();
+		return false;
+	}
+
+	m_channel_count = sfml_info.channelCount;
+	info.format = m_format;
+	info.channel_count = sfml_info.channelCount;
+	info.sample_rate = sfml_info.sampleRate;
+	info.frame_count = sfml_info.sampleCount / sfml_info.channelCount;
+	return true;
+}
+
+void audio::decoders::SfmlReader::seek(sf::Uint64 frame)
+{
+	m_reader->seek(frame * m_channel_count);
+}
+
+std::size_t audio::decoders::SfmlReader::read(sf::Int16* samples, std::size_t max_count)
+{
+	return static_cast<std::size_t>(
+	  m_reader->read(samples, max_count - max_count % m_channel_count));
+}
@@ -0,0 +1,330 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/decoders/WavReader.hpp"
+#include "audio/mix_kernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+	constexpr std::size_t BLOCK_FRAMES = 4096;
+
+	constexpr std::uint16_t WAVE_FORMAT_PCM = 0x0001;
+	constexpr std::uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+	constexpr std::uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+	constexpr std::size_t FMT_SIZE = 16;
+	// the sub format GUID starts with the format tag
+	constexpr std::size_t FMT_EXTENSIBLE_SIZE = 26;
+
+	constexpr float INT8_SCALE = 1.f / 128;
+	constexpr float INT16_SCALE = 1.f / 32768;
+	constexpr float INT32_SCALE = 1.f / 2147483648.f;
+
+	bool little_endian() noexcept
+	{
+		const std::uint16_t value = 1;
+		std::uint8_t first_byte;
+		std::memcpy(&first_byte, &value, 1);
+		return first_byte == 1;
+	}
+
+	std::uint16_t read_u16(const std::uint8_t* bytes) noexcept
+	{
+		return static_cast<std::uint16_t>(bytes[0] | (bytes[1] << 8));
+	}
+
+	std::uint32_t read_u32(const std::uint8_t* bytes) noexcept
+	{
+		return static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8)
+		       | (static_cast<std::uint32_t>(bytes[2]) << 16)
+		       | (static_cast<std::uint32_t>(bytes[3]) << 24);
+	}
+
+	// left aligned in 32 bits
+	std::int32_t read_s24(const std::uint8_t* bytes) noexcept
+	{
+		return static_cast<std::int32_t>((static_cast<std::uint32_t>(bytes[0]) << 8)
+		                                 | (static_cast<std::uint32_t>(bytes[1]) << 16)
+		                                 | (static_cast<std::uint32_t>(bytes[2]) << 24));
+	}
+
+	float read_f32(const std::uint8_t* bytes) noexcept
+	{
+		const std::uint32_t bits = read_u32(bytes);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	bool read_exact(sf::InputStream& stream, void* data, sf::Int64 size)
+	{
+		return stream.read(data, size) == size;
+	}
+} // namespace
+
+bool audio::decoders::WavReader::check(const std::uint8_t* header, std::size_t size) noexcept
+{
+	return size >= 12 && std::memcmp(header, "RIFF", 4) == 0
+	       && std::memcmp(header + 8, "WAVE", 4) == 0;
+}
+
+audio::decoders::WavReader::WavReader() noexcept
+  : m_stream(nullptr)
+  , m_encoding(Encoding::PCM_S16)
+  , m_channel_count(0)
+  , m_bytes_per_sample(0)
+  , m_data_offset(0)
+  , m_frame_count(0)
+  , m_position(0)
+  , m_bytes()
+  , m_floats()
+{
+}
+
+bool audio::decoders::WavReader::open(sf::InputStream& stream, Info& info)
+{
+	std::uint8_t header[12];
+	if(stream.seek(0) != 0 || !read_exact(stream, header, sizeof(header))
+	   || !check(header, sizeof(header)))
+	{
+		return false;
+	}
+
+	bool has_format = false;
+	std::uint16_t block_align = 0;
+	unsigned int sample_rate = 0;
+	for(;;)
+	{
+		std::uint8_t chunk_header[8];
+		if(!read_exact(stream, chunk_header, sizeof(chunk_header)))
+		{
+			// no data chunk
+			return false;
+		}
+		const std::uint32_t chunk_size = read_u32(chunk_header + 4);
+		const sf::Int64 chunk_start = stream.tell();
+
+		if(std::memcmp(chunk_header, "fmt ", 4) == 0)
+		{
+			std::uint8_t fmt[FMT_EXTENSIBLE_SIZE] = {};
+			if(chunk_size < FMT_SIZE
+			   || !read_exact(stream, fmt, std::min<std::uint32_t>(chunk_size, sizeof(fmt))))
+			{
+				return false;
+			}
+			std::uint16_t format_tag = read_u16(fmt);
+			m_channel_count = read_u16(fmt + 2);
+			sample_rate = read_u32(fmt + 4);
+			block_align = read_u16(fmt + 12);
+			const std::uint16_t bits_per_sample = read_u16(fmt + 14);
+			if(format_tag == WAVE_FORMAT_EXTENSIBLE && chunk_size >= FMT_EXTENSIBLE_SIZE)
+			{
+				format_tag = read_u16(fmt + 24);
+			}
+
+			if(format_tag == WAVE_FORMAT_PCM && bits_per_sample == 8)
+			{
+				m_encoding = Encoding::PCM_U8;
+			}
+			else if(format_tag == WAVE_FORMAT_PCM && bits_per_sample == 16)
+			{
+				m_encoding = Encoding::PCM_S16;
+			}
+			else if(format_tag == WAVE_FORMAT_PCM && bits_per_sample == 24)
+			{
+				m_encoding = Encoding::PCM_S24;
+			}
+			else if(format_tag == WAVE_FORMAT_PCM && bits_per_sample == 32)
+			{
+				m_encoding = Encoding::PCM_S32;
+			}
+			else if(format_tag == WAVE_FORMAT_IEEE_FLOAT && bits_per_sample == 32)
+			{
+				m_encoding = Encoding::FLOAT32;
+			}
+			else
+			{
+				return false;
+			}
+			m_bytes_per_sample = bits_per_sample / 8u;
+			if(m_channel_count == 0 || sample_rate == 0
+			   || block_align != m_channel_count * m_bytes_per_sample)
+			{
+				return false;
+			}
+			has_format = true;
+		}
+		else if(std::memcmp(chunk_header, "data", 4) == 0)
+		{
+			if(!has_format)
+			{
+				return false;
+			}
+			// the size of streamed files may be left unset
+			m_data_offset = chunk_start;
+			const sf::Int64 available = std::max<sf::Int64>(stream.getSize() - chunk_start, 0);
+			m_frame_count = std::min<sf::Uint64>(chunk_size, static_cast<sf::Uint64>(available))
+			                / block_align;
+			break;
+		}
+
+		// chunks are word aligned
+		if(stream.seek(chunk_start + chunk_size + (chunk_size & 1u)) < 0)
+		{
+			return false;
+		}
+	}
+
+	m_stream = &stream;
+	m_position = 0;
+	m_bytes.resize(BLOCK_FRAMES * block_align);
+	if(m_encoding == Encoding::FLOAT32)
+	{
+		m_floats.resize(BLOCK_FRAMES * m_channel_count);
+	}
+	info.format = Format::WAV;
+	info.channel_count = m_channel_count;
+	info.sample_rate = sample_rate;
+	info.frame_count = m_frame_count;
+	return true;
+}
+
+void audio::decoders::WavReader::seek(sf::Uint64 frame)
+{
+	m_position = std::min(frame, m_frame_count);
+	m_stream->seek(m_data_offset
+	               + static_cast<sf::Int64>(m_position * m_channel_count * m_bytes_per_sample));
+}
+
+std::size_t audio::decoders::WavReader::read(sf::Int16* samples, std::size_t max_count)
+{
+	return readConverted(samples, max_count);
+}
+
+std::size_t audio::decoders::WavReader::read(float* samples, std::size_t max_count)
+{
+	return readConverted(samples, max_count);
+}
+
+template<typename Sample>
+std::size_t audio::decoders::WavReader::readConverted(Sample* samples, std::size_t max_count)
+{
+	static_assert(std::is_same_v<Sample, sf::Int16> || std::is_same_v<Sample, float>);
+
+	// samples already in the output format are read in place
+	const bool in_place =
+	  little_endian()
+	  && ((std::is_same_v<Sample, sf::Int16> && m_encoding == Encoding::PCM_S16)
+	      || (std::is_same_v<Sample, float> && m_encoding == Encoding::FLOAT32));
+
+	const std::size_t frame_bytes = m_channel_count * m_bytes_per_sample;
+	const auto max_frames = static_cast<std::size_t>(
+	  std::min<sf::Uint64>(max_count / m_channel_count, m_frame_count - m_position));
+	std::size_t frames_read = 0;
+	while(frames_read < max_frames)
+	{
+		const std::size_t frames = std::min(max_frames - frames_read, BLOCK_FRAMES);
+		Sample* output = samples + frames_read * m_channel_count;
+		std::uint8_t* bytes = in_place ? reinterpret_cast<std::uint8_t*>(output) : m_bytes.data();
+		const sf::Int64 read = m_stream->read(bytes, static_cast<sf::Int64>(frames * frame_bytes));
+		const std::size_t block_frames = read > 0 ? static_cast<std::size_t>(read) / frame_bytes : 0;
+		const std::size_t count = block_frames * m_channel_count;
+
+		if(!in_place)
+		{
+			switch(m_encoding)
+			{
+				case Encoding::PCM_U8:
+					for(std::size_t i = 0; i < count; ++i)
+					{
+						const int value = static_cast<int>(bytes[i]) - 128;
+						if constexpr(std::is_same_v<Sample, float>)
+						{
+							output[i] = static_cast<float>(value) * INT8_SCALE;
+						}
+						else
+						{
+							output[i] = static_cast<sf::Int16>(value * 256);
+						}
+					}
+					break;
+				case Encoding::PCM_S16:
+					for(std::size_t i = 0; i < count; ++i)
+					{
+						const auto value = static_cast<sf::Int16>(read_u16(bytes + 2 * i));
+						if constexpr(std::is_same_v<Sample, float>)
+						{
+							output[i] = static_cast<float>(value) * INT16_SCALE;
+						}
+						else
+						{
+							output[i] = value;
+						}
+					}
+					break;
+				case Encoding::PCM_S24:
+					for(std::size_t i = 0; i < count; ++i)
+					{
+						const std::int32_t value = read_s24(bytes + 3 * i);
+						if constexpr(std::is_same_v<Sample, float>)
+						{
+							output[i] = static_cast<float>(value) * INT32_SCALE;
+						}
+						else
+						{
+							output[i] = static_cast<sf::Int16>(value >> 16);
+						}
+					}
+					break;
+				case Encoding::PCM_S32:
+					for(std::size_t i = 0; i < count; ++i)
+					{
+						const auto value = static_cast<std::int32_t>(read_u32(bytes + 4 * i));
+						if constexpr(std::is_same_v<Sample, float>)
+						{
+							output[i] = static_cast<float>(value) * INT32_SCALE;
+						}
+						else
+						{
+							output[i] = static_cast<sf::Int16>(value >> 16);
+						}
+					}
+					break;
+				case Encoding::FLOAT32:
+					if constexpr(std::is_same_v<Sample, float>)
+					{
+						for(std::size_t i = 0; i < count; ++i)
+						{
+							output[i] = read_f32(bytes + 4 * i);
+						}
+					}
+					else
+					{
+						for(std::size_t i = 0; i < count; ++i)
+						{
+							m_floats[i] = read_f32(bytes + 4 * i);
+						}
+						kernels::to_int16(m_floats.data(), output, count);
+					}
+					break;
+			}
+		}
+
+		frames_read += block_frames;
+		m_position += block_frames;
+		if(block_frames < frames)
+		{
+			// truncated file
+			break;
+		}
+	}
+	return frames_read * m_channel_count;
+}
@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/dsp/Chain.hpp"
+#include "utils/simd.hpp"
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+#	include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	using steady_clock = std::chrono::steady_clock;
+
+	std::uint64_t elapsed_ns(steady_clock::time_point start, steady_clock::time_point end) noexcept
+	{
+		return static_cast<std::uint64_t>(
+		  std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+} // namespace
+
+void audio::dsp::Chain::Statistics::record(std::uint64_t cost_ns, std::uint64_t block_ns) noexcept
+{
+	// single writer (audio thread)
+	blocks.store(blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	total_ns.store(total_ns.load(std::memory_order_relaxed) + cost_ns, std::memory_order_relaxed);
+	audio_ns.store(audio_ns.load(std::memory_order_relaxed) + block_ns, std::memory_order_relaxed);
+	if(cost_ns > max_ns.load(std::memory_order_relaxed))
+	{
+		max_ns.store(cost_ns, std::memory_order_relaxed);
+	}
+}
+
+void audio::dsp::Chain::Statistics::clear() noexcept
+{
+	blocks = 0;
+	total_ns = 0;
+	max_ns = 0;
+	audio_ns = 0;
+}
+
+audio::dsp::Chain::Chain() noexcept
+  : m_channels(0), m_output_rate(0), m_resampler(), m_processors(), m_statistics()
+{
+	m_statistics.push_back(std::make_unique<Statistics>());
+}
+
+void audio::dsp::Chain::prepare(unsigned int channels,
+                                unsigned int input_rate,
+                                unsigned int output_rate,
+                                std::size_t max_input_frames)
+{
+	m_channels = channels;
+	m_output_rate = output_rate;
+	m_resampler.prepare(channels, input_rate, output_rate, max_input_frames);
+	for(const std::unique_ptr<Processor>& processor: m_processors)
+	{
+		processor->prepare(channels, output_rate);
+	}
+	for(const std::unique_ptr<Statistics>& statistics: m_statistics)
+	{
+		statistics->clear();
+	}
+}
+
+unsigned int audio::dsp::Chain::getOutputRate() const noexcept
+{
+	return m_output_rate;
+}
+
+std::size_t audio::dsp::Chain::maxOutputFrames(std::size_t input_frames) const noexcept
+{
+	return m_resampler.maxOutputFrames(input_frames);
+}
+
+bool audio::dsp::Chain::active() const noexcept
+{
+	return m_resampler.active()
+	       || std::any_of(m_processors.cbegin(), m_processors.cend(), [](const auto& processor) {
+		          return processor->enabled();
+	          });
+}
+
+void audio::dsp::Chain::reset() noexcept
+{
+	m_resampler.reset();
+	for(const std::unique_ptr<Processor>& processor: m_processors)
+	{
+		processor->reset();
+	}
+}
+
+std::size_t audio::dsp::Chain::process(const float* input,
+                                       std::size_t input_frames,
+                                       float* output) noexcept
+{
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	// denormals in the filters tails are very slow and inaudible
+	_MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+#endif
+
+	steady_clock::time_point start = steady_clock::now();
+	const std::size_t frames = m_resampler.process(input, input_frames, output);
+	steady_clock::time_point end = steady_clock::now();
+	const auto block_ns = static_cast<std::uint64_t>(frames) * 1'000'000'000u / m_output_rate;
+	if(m_resampler.active())
+	{
+		m_statistics[0]->record(elapsed_ns(start, end), block_ns);
+	}
+
+	for(std::size_t i = 0; i < m_processors.size(); ++i)
+	{
+		Processor& processor = *m_processors[i];
+		if(!processor.enabled())
+		{
+			continue;
+		}
+		start = end;
+		processor.process(output, frames);
+		end = steady_clock::now();
+		m_statistics[i + 1]->record(elapsed_ns(start, end), block_ns);
+	}
+	return frames;
+}
+
+std::vector<audio::dsp::Chain::StageCost> audio::dsp::Chain::getCosts() const
+{
+	std::vector<StageCost> costs;
+	for(std::size_t i = 0; i < m_statistics.size(); ++i)
+	{
+		const Statistics& statistics = *m_statistics[i];
+		const std::uint64_t blocks = statistics.blocks.load(std::memory_order_relaxed);
+		if(blocks == 0)
+		{
+			continue;
+		}
+		const auto total_ns = static_cast<double>(statistics.total_ns.load(std::memory_order_relaxed));
+		const auto audio_ns = static_cast<double>(statistics.audio_ns.load(std::memory_order_relaxed));
+		costs.push_back({i == 0 ? "Resampler" : m_processors[i - 1]->name(),
+		                 blocks,
+		                 total_ns / static_cast<double>(blocks) / 1000,
+		                 static_cast<double>(statistics.max_ns.load(std::memory_order_relaxed)) / 1000,
+		                 audio_ns > 0 ? total_ns / audio_ns : 0});
+	}
+	return costs;
+}
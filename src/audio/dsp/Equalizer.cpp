@@ -0,0 +1,235 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/dsp/Equalizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	// Keep the filters stable and meaningful near the Nyquist frequency
+	constexpr double MAX_RELATIVE_FREQUENCY = 0.45;
+
+	template<typename Coefficients>
+	Coefficients biquad(const data::EqualizerBand& band, unsigned int sample_rate) noexcept
+	{
+		using Type = data::EqualizerBand::Type;
+
+		const double frequency =
+		  std::min(static_cast<double>(band.frequency), MAX_RELATIVE_FREQUENCY * sample_rate);
+		const double a = std::pow(10.0, band.gain_db / 40.0);
+		const double w0 = 2 * PI * frequency / sample_rate;
+		const double cos_w0 = std::cos(w0);
+		const double alpha = std::sin(w0) / (2 * band.q);
+		const double sqrt_a_alpha = 2 * std::sqrt(a) * alpha;
+
+		double b0, b1, b2, a0, a1, a2;
+		switch(band.type)
+		{
+			case Type::LOW_SHELF:
+				b0 = a * ((a + 1) - (a - 1) * cos_w0 + sqrt_a_alpha);
+				b1 = 2 * a * ((a - 1) - (a + 1) * cos_w0);
+				b2 = a * ((a + 1) - (a - 1) * cos_w0 - sqrt_a_alpha);
+				a0 = (a + 1) + (a - 1) * cos_w0 + sqrt_a_alpha;
+				a1 = -2 * ((a - 1) + (a + 1) * cos_w0);
+				a2 = (a + 1) + (a - 1) * cos_w0 - sqrt_a_alpha;
+				break;
+			case Type::HIGH_SHELF:
+				b0 = a * ((a + 1) + (a - 1) * cos_w0 + sqrt_a_alpha);
+				b1 = -2 * a * ((a - 1) + (a + 1) * cos_w0);
+				b2 = a * ((a + 1) + (a - 1) * cos_w0 - sqrt_a_alpha);
+				a0 = (a + 1) - (a - 1) * cos_w0 + sqrt_a_alpha;
+				a1 = 2 * ((a - 1) - (a + 1) * cos_w0);
+				a2 = (a + 1) - (a - 1) * cos_w0 - sqrt_a_alpha;
+				break;
+			case Type::PEAK:
+			default:
+				b0 = 1 + alpha * a;
+				b1 = -2 * cos_w0;
+				b2 = 1 - alpha * a;
+				a0 = 1 + alpha / a;
+				a1 = -2 * cos_w0;
+				a2 = 1 - alpha / a;
+				break;
+		}
+
+		return {static_cast<float>(b0 / a0),
+		        static_cast<float>(b1 / a0),
+		        static_cast<float>(b2 / a0),
+		        static_cast<float>(a1 / a0),
+		        static_cast<float>(a2 / a0),
+		        band.gain_db == 0.f};
+	}
+
+	// Transposed direct form II, the channel count is known at compile time for the common
+	// layouts so the per frame channel loop is unrolled/vectorized
+	template<unsigned int Channels, typename Coefficients>
+	void process_band(const Coefficients& c, float* state, float* samples, std::size_t frames) noexcept
+	{
+		float z1[Channels];
+		float z2[Channels];
+		for(unsigned int channel = 0; channel < Channels; ++channel)
+		{
+			z1[channel] = state[channel * 2];
+			z2[channel] = state[channel * 2 + 1];
+		}
+		for(std::size_t frame = 0; frame < frames; ++frame)
+		{
+			float* sample = samples + frame * Channels;
+			for(unsigned int channel = 0; channel < Channels; ++channel)
+			{
+				const float x = sample[channel];
+				const float y = c.b0 * x + z1[channel];
+				z1[channel] = c.b1 * x - c.a1 * y + z2[channel];
+				z2[channel] = c.b2 * x - c.a2 * y;
+				sample[channel] = y;
+			}
+		}
+		for(unsigned int channel = 0; channel < Channels; ++channel)
+		{
+			state[channel * 2] = z1[channel];
+			state[channel * 2 + 1] = z2[channel];
+		}
+	}
+
+	template<typename Coefficients>
+	void process_band(const Coefficients& c,
+	                  float* state,
+	                  float* samples,
+	                  std::size_t frames,
+	                  unsigned int channels) noexcept
+	{
+		for(unsigned int channel = 0; channel < channels; ++channel)
+		{
+			float z1 = state[channel * 2];
+			float z2 = state[channel * 2 + 1];
+			for(std::size_t frame = 0; frame < frames; ++frame)
+			{
+				float& sample = samples[frame * channels + channel];
+				const float x = sample;
+				const float y = c.b0 * x + z1;
+				z1 = c.b1 * x - c.a1 * y + z2;
+				z2 = c.b2 * x - c.a2 * y;
+				sample = y;
+			}
+			state[channel * 2] = z1;
+			state[channel * 2 + 1] = z2;
+		}
+	}
+} // namespace
+
+audio::dsp::Equalizer::Equalizer() noexcept
+  : m_channels(0)
+  , m_sample_rate(0)
+  , m_enabled(false)
+  , m_pending_mutex()
+  , m_pending_bands()
+  , m_pending(false)
+  , m_bands()
+  , m_coefficients()
+  , m_band_count(0)
+  , m_state()
+{
+}
+
+void audio::dsp::Equalizer::setBands(const std::vector<data::EqualizerBand>& bands, bool enabled)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_pending_mutex);
+		m_pending_bands = bands;
+		m_pending.store(true, std::memory_order_release);
+	}
+	m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+const char* audio::dsp::Equalizer::name() const noexcept
+{
+	return "Equalizer";
+}
+
+bool audio::dsp::Equalizer::enabled() const noexcept
+{
+	return m_enabled.load(std::memory_order_relaxed);
+}
+
+void audio::dsp::Equalizer::prepare(unsigned int channels, unsigned int sample_rate)
+{
+	m_channels = channels;
+	m_sample_rate = sample_rate;
+	m_state.assign(data::Settings::MAX_EQUALIZER_BANDS * channels * 2, 0.f);
+	updateBands();
+	computeCoefficients();
+}
+
+void audio::dsp::Equalizer::reset() noexcept
+{
+	std::fill(m_state.begin(), m_state.end(), 0.f);
+}
+
+void audio::dsp::Equalizer::process(float* samples, std::size_t frames) noexcept
+{
+	if(m_pending.load(std::memory_order_acquire))
+	{
+		updateBands();
+	}
+
+	for(std::size_t band = 0; band < m_band_count; ++band)
+	{
+		const Coefficients& coefficients = m_coefficients[band];
+		if(coefficients.identity)
+		{
+			continue;
+		}
+		float* state = m_state.data() + band * m_channels * 2;
+		switch(m_channels)
+		{
+			case 1:
+				process_band<1>(coefficients, state, samples, frames);
+				break;
+			case 2:
+				process_band<2>(coefficients, state, samples, frames);
+				break;
+			default:
+				process_band(coefficients, state, samples, frames, m_channels);
+				break;
+		}
+	}
+}
+
+void audio::dsp::Equalizer::updateBands() noexcept
+{
+	std::unique_lock<std::mutex> lock(m_pending_mutex, std::try_to_lock);
+	if(!lock.owns_lock() || !m_pending.load(std::memory_order_relaxed))
+	{
+		// the controlling thread is writing, retry on the next block
+		return;
+	}
+	// swap doesn't allocate
+	std::swap(m_bands, m_pending_bands);
+	m_pending.store(false, std::memory_order_relaxed);
+	lock.unlock();
+
+	computeCoefficients();
+}
+
+void audio::dsp::Equalizer::computeCoefficients() noexcept
+{
+	if(m_sample_rate == 0)
+	{
+		m_band_count = 0;
+		return;
+	}
+
+	m_band_count = std::min(m_bands.size(), m_coefficients.size());
+	for(std::size_t band = 0; band < m_band_count; ++band)
+	{
+		m_coefficients[band] = biquad<Coefficients>(m_bands[band], m_sample_rate);
+	}
+}
@@ -0,0 +1,207 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/dsp/Fft.hpp"
+#include "utils/simd.hpp"
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+#	include <emmintrin.h>
+#endif
+
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	// Radix-2 pass on blocks of 2 * half points, half >= 4
+	void radix2_pass(float* real,
+	                 float* imag,
+	                 std::size_t size,
+	                 std::size_t half,
+	                 const float* twiddles_real,
+	                 const float* twiddles_imag) noexcept
+	{
+		for(std::size_t block = 0; block < size; block += 2 * half)
+		{
+			float* a_real = real + block;
+			float* a_imag = imag + block;
+			float* b_real = a_real + half;
+			float* b_imag = a_imag + half;
+			std::size_t k = 0;
+#if defined(MAGICPLAYER_SIMD_SSE2)
+			for(; k + 4 <= half; k += 4)
+			{
+				const __m128 w_real = _mm_loadu_ps(twiddles_real + k);
+				const __m128 w_imag = _mm_loadu_ps(twiddles_imag + k);
+				const __m128 x_real = _mm_loadu_ps(b_real + k);
+				const __m128 x_imag = _mm_loadu_ps(b_imag + k);
+				const __m128 t_real =
+				  _mm_sub_ps(_mm_mul_ps(x_real, w_real), _mm_mul_ps(x_imag, w_imag));
+				const __m128 t_imag =
+				  _mm_add_ps(_mm_mul_ps(x_real, w_imag), _mm_mul_ps(x_imag, w_real));
+				const __m128 u_real = _mm_loadu_ps(a_real + k);
+				const __m128 u_imag = _mm_loadu_ps(a_imag + k);
+				_mm_storeu_ps(a_real + k, _mm_add_ps(u_real, t_real));
+				_mm_storeu_ps(a_imag + k, _mm_add_ps(u_imag, t_imag));
+				_mm_storeu_ps(b_real + k, _mm_sub_ps(u_real, t_real));
+				_mm_storeu_ps(b_imag + k, _mm_sub_ps(u_imag, t_imag));
+			}
+#endif
+			for(; k < half; ++k)
+			{
+				const float t_real = b_real[k] * twiddles_real[k] - b_imag[k] * twiddles_imag[k];
+				const float t_imag = b_real[k] * twiddles_imag[k] + b_imag[k] * twiddles_real[k];
+				const float u_real = a_real[k];
+				const float u_imag = a_imag[k];
+				a_real[k] = u_real + t_real;
+				a_imag[k] = u_imag + t_imag;
+				b_real[k] = u_real - t_real;
+				b_imag[k] = u_imag - t_imag;
+			}
+		}
+	}
+
+	// First two radix-2 passes merged, their twiddles are 1 and -i
+	void radix4_pass(float* real, float* imag, std::size_t size) noexcept
+	{
+		for(std::size_t block = 0; block < size; block += 4)
+		{
+			float* r = real + block;
+			float* i = imag + block;
+			const float a0_real = r[0] + r[1];
+			const float a0_imag = i[0] + i[1];
+			const float a1_real = r[0] - r[1];
+			const float a1_imag = i[0] - i[1];
+			const float a2_real = r[2] + r[3];
+			const float a2_imag = i[2] + i[3];
+			// (r[2] - r[3]) * -i
+			const float t_real = i[2] - i[3];
+			const float t_imag = r[3] - r[2];
+			r[0] = a0_real + a2_real;
+			i[0] = a0_imag + a2_imag;
+			r[2] = a0_real - a2_real;
+			i[2] = a0_imag - a2_imag;
+			r[1] = a1_real + t_real;
+			i[1] = a1_imag + t_imag;
+			r[3] = a1_real - t_real;
+			i[3] = a1_imag - t_imag;
+		}
+	}
+} // namespace
+
+audio::dsp::RealFft::RealFft() noexcept
+  : m_size(0)
+  , m_bit_reverse()
+  , m_twiddles_real()
+  , m_twiddles_imag()
+  , m_work_real()
+  , m_work_imag()
+  , m_split_real()
+  , m_split_imag()
+{
+}
+
+void audio::dsp::RealFft::prepare(std::size_t size)
+{
+	assert(size >= 8 && (size & (size - 1)) == 0);
+	m_size = size;
+	const std::size_t complex_size = size / 2;
+
+	std::size_t bits = 0;
+	while((std::size_t{1} << bits) < complex_size)
+	{
+		++bits;
+	}
+	m_bit_reverse.resize(complex_size);
+	for(std::size_t n = 0; n < complex_size; ++n)
+	{
+		std::size_t reversed = 0;
+		for(std::size_t bit = 0; bit < bits; ++bit)
+		{
+			reversed |= ((n >> bit) & 1) << (bits - 1 - bit);
+		}
+		m_bit_reverse[n] = static_cast<std::uint32_t>(reversed);
+	}
+
+	m_twiddles_real.assign(complex_size, 0.f);
+	m_twiddles_imag.assign(complex_size, 0.f);
+	for(std::size_t half = 1; half < complex_size; half *= 2)
+	{
+		for(std::size_t k = 0; k < half; ++k)
+		{
+			const double angle = -PI * static_cast<double>(k) / static_cast<double>(half);
+			m_twiddles_real[half + k] = static_cast<float>(std::cos(angle));
+			m_twiddles_imag[half + k] = static_cast<float>(std::sin(angle));
+		}
+	}
+	m_work_real.assign(complex_size, 0.f);
+	m_work_imag.assign(complex_size, 0.f);
+
+	m_split_real.resize(complex_size + 1);
+	m_split_imag.resize(complex_size + 1);
+	for(std::size_t k = 0; k <= complex_size; ++k)
+	{
+		const double angle = -2 * PI * static_cast<double>(k) / static_cast<double>(size);
+		m_split_real[k] = static_cast<float>(std::cos(angle));
+		m_split_imag[k] = static_cast<float>(std::sin(angle));
+	}
+}
+
+std::size_t audio::dsp::RealFft::size() const noexcept
+{
+	return m_size;
+}
+
+void audio::dsp::RealFft::forward(const float* input, float* real, float* imag) noexcept
+{
+	assert(m_size != 0);
+	const std::size_t complex_size = m_size / 2;
+
+	// even samples as real part, odd ones as imaginary part
+	for(std::size_t n = 0; n < complex_size; ++n)
+	{
+		m_work_real[m_bit_reverse[n]] = input[2 * n];
+		m_work_imag[m_bit_reverse[n]] = input[2 * n + 1];
+	}
+	complexForward();
+
+	// X[k] = E[k] + exp(-2i pi k / N) O[k] with E and O the spectrums of the even and odd samples:
+	// E[k] = (Z[k] + conj(Z[M - k])) / 2, O[k] = -i (Z[k] - conj(Z[M - k])) / 2
+	for(std::size_t k = 0; k <= complex_size; ++k)
+	{
+		const std::size_t index = k == complex_size ? 0 : k;
+		const std::size_t mirror = k == 0 ? 0 : complex_size - k;
+		const float z_real = m_work_real[index];
+		const float z_imag = m_work_imag[index];
+		const float c_real = m_work_real[mirror];
+		const float c_imag = -m_work_imag[mirror];
+
+		const float even_real = (z_real + c_real) * 0.5f;
+		const float even_imag = (z_imag + c_imag) * 0.5f;
+		const float odd_real = (z_imag - c_imag) * 0.5f;
+		const float odd_imag = (c_real - z_real) * 0.5f;
+		real[k] = even_real + m_split_real[k] * odd_real - m_split_imag[k] * odd_imag;
+		imag[k] = even_imag + m_split_real[k] * odd_imag + m_split_imag[k] * odd_real;
+	}
+}
+
+void audio::dsp::RealFft::complexForward() noexcept
+{
+	const std::size_t complex_size = m_size / 2;
+	radix4_pass(m_work_real.data(), m_work_imag.data(), complex_size);
+	for(std::size_t half = 4; half < complex_size; half *= 2)
+	{
+		radix2_pass(m_work_real.data(),
+		            m_work_imag.data(),
+		            complex_size,
+		            half,
+		            m_twiddles_real.data() + half,
+		            m_twiddles_imag.data() + half);
+	}
+}
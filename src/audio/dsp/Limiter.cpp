@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/dsp/Limiter.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	constexpr float LOOKAHEAD_SECONDS = 0.005f;
+	constexpr float RELEASE_SECONDS = 0.1f;
+} // namespace
+
+audio::dsp::Limiter::Limiter() noexcept
+  : m_enabled(false)
+  , m_threshold(1)
+  , m_channels(0)
+  , m_lookahead(0)
+  , m_release(0)
+  , m_delay()
+  , m_gains()
+  , m_position(0)
+  , m_gains_sum(0)
+  , m_release_gain(1)
+  , m_window()
+  , m_window_begin(0)
+  , m_window_size(0)
+  , m_frame(0)
+{
+}
+
+void audio::dsp::Limiter::setParameters(bool enabled, float threshold_db) noexcept
+{
+	m_threshold.store(std::pow(10.f, threshold_db / 20), std::memory_order_relaxed);
+	m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+const char* audio::dsp::Limiter::name() const noexcept
+{
+	return "Limiter";
+}
+
+bool audio::dsp::Limiter::enabled() const noexcept
+{
+	return m_enabled.load(std::memory_order_relaxed);
+}
+
+void audio::dsp::Limiter::prepare(unsigned int channels, unsigned int sample_rate)
+{
+	m_channels = channels;
+	m_lookahead = std::max(
+	  static_cast<std::size_t>(LOOKAHEAD_SECONDS * static_cast<float>(sample_rate)), std::size_t{1});
+	m_release = 1 - std::exp(-1 / (RELEASE_SECONDS * static_cast<float>(sample_rate)));
+	m_delay.resize(m_lookahead * channels);
+	m_gains.resize(m_lookahead);
+	m_window.resize(m_lookahead + 1);
+	reset();
+}
+
+void audio::dsp::Limiter::reset() noexcept
+{
+	std::fill(m_delay.begin(), m_delay.end(), 0.f);
+	std::fill(m_gains.begin(), m_gains.end(), 1.f);
+	m_position = 0;
+	m_gains_sum = static_cast<double>(m_lookahead);
+	m_release_gain = 1;
+	m_window_begin = 0;
+	m_window_size = 0;
+	m_frame = 0;
+}
+
+void audio::dsp::Limiter::process(float* samples, std::size_t frames) noexcept
+{
+	const float threshold = m_threshold.load(std::memory_order_relaxed);
+	const std::size_t window_capacity = m_window.size();
+	for(std::size_t i = 0; i < frames; ++i, ++m_frame)
+	{
+		float* frame = samples + i * m_channels;
+
+		// gain needed by the incoming frame
+		float peak = 0;
+		for(unsigned int channel = 0; channel < m_channels; ++channel)
+		{
+			peak = std::max(peak, std::abs(frame[channel]));
+		}
+		const float required = peak > threshold ? threshold / peak : 1.f;
+
+		// minimum of the gains required by the last m_lookahead + 1 frames,
+		// expired entries are removed before the push: at most m_lookahead remain
+		while(m_window_size != 0 && m_window[m_window_begin].frame + m_lookahead < m_frame)
+		{
+			m_window_begin = (m_window_begin + 1) % window_capacity;
+			--m_window_size;
+		}
+		while(m_window_size != 0
+		      && m_window[(m_window_begin + m_window_size - 1) % window_capacity].gain >= required)
+		{
+			--m_window_size;
+		}
+		assert(m_window_size < window_capacity);
+		m_window[(m_window_begin + m_window_size) % window_capacity] = {m_frame, required};
+		++m_window_size;
+		const float window_min = m_window[m_window_begin].gain;
+
+		// instant attack, exponential release
+		m_release_gain = std::min(window_min, m_release_gain + (1 - m_release_gain) * m_release);
+
+		// moving average over the look-ahead: the gain reaches the required value when the
+		// frame leaves the delay line, without discontinuity
+		m_gains_sum += m_release_gain - m_gains[m_position];
+		m_gains[m_position] = m_release_gain;
+		const auto gain = static_cast<float>(m_gains_sum / static_cast<double>(m_lookahead));
+
+		float* delayed = m_delay.data() + m_position * m_channels;
+		for(unsigned int channel = 0; channel < m_channels; ++channel)
+		{
+			const float sample = frame[channel];
+			frame[channel] = delayed[channel] * gain;
+			delayed[channel] = sample;
+		}
+		m_position = (m_position + 1) % m_lookahead;
+	}
+}
@@ -0,0 +1,253 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/dsp/Resampler.hpp"
+#include "utils/simd.hpp"
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+#	include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+	// Filter length per phase for a ratio >= 1, scaled by the decimation for down-sampling
+	constexpr std::size_t BASE_TAPS = 64;
+	constexpr std::size_t MAX_TAPS = 512;
+
+	// Ratios needing more phases are approximated
+	constexpr unsigned int MAX_PHASES = 1024;
+
+	// Cutoff relative to the lowest Nyquist frequency, and Kaiser window shape (~80dB stop-band)
+	constexpr double ROLLOFF = 0.92;
+	constexpr double KAISER_BETA = 8.0;
+
+	constexpr double PI = 3.14159265358979323846;
+
+	// Zeroth order modified Bessel function of the first kind
+	double bessel_i0(double x) noexcept
+	{
+		double sum = 1;
+		double term = 1;
+		for(int k = 1; k < 50 && term > sum * 1e-12; ++k)
+		{
+			term *= (x / (2 * k)) * (x / (2 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	double sinc(double x) noexcept
+	{
+		if(std::abs(x) < 1e-12)
+		{
+			return 1;
+		}
+		return std::sin(PI * x) / (PI * x);
+	}
+
+	// taps is a multiple of 8
+	float dot_product(const float* coefficients, const float* samples, std::size_t taps) noexcept
+	{
+#if defined(MAGICPLAYER_SIMD_SSE2)
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 sum1 = _mm_setzero_ps();
+		for(std::size_t i = 0; i < taps; i += 8)
+		{
+			sum0 = _mm_add_ps(
+			  sum0, _mm_mul_ps(_mm_loadu_ps(coefficients + i), _mm_loadu_ps(samples + i)));
+			sum1 = _mm_add_ps(
+			  sum1, _mm_mul_ps(_mm_loadu_ps(coefficients + i + 4), _mm_loadu_ps(samples + i + 4)));
+		}
+		__m128 sum = _mm_add_ps(sum0, sum1);
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+#else
+		float sum = 0;
+		for(std::size_t i = 0; i < taps; ++i)
+		{
+			sum += coefficients[i] * samples[i];
+		}
+		return sum;
+#endif
+	}
+} // namespace
+
+audio::dsp::Resampler::Resampler() noexcept
+  : m_channels(0)
+  , m_interpolation(1)
+  , m_decimation(1)
+  , m_taps(0)
+  , m_filters()
+  , m_history()
+  , m_history_frames(0)
+  , m_position(0)
+  , m_phase(0)
+{
+}
+
+void audio::dsp::Resampler::prepare(unsigned int channels,
+                                    unsigned int input_rate,
+                                    unsigned int output_rate,
+                                    std::size_t max_input_frames)
+{
+	m_channels = channels;
+	m_interpolation = 1;
+	m_decimation = 1;
+	m_taps = 0;
+	m_filters.clear();
+	m_history.clear();
+	if(channels == 0 || input_rate == 0 || output_rate == 0 || input_rate == output_rate)
+	{
+		return;
+	}
+
+	const unsigned int divisor = std::gcd(input_rate, output_rate);
+	m_interpolation = output_rate / divisor;
+	m_decimation = input_rate / divisor;
+	if(m_interpolation > MAX_PHASES)
+	{
+		const double ratio = static_cast<double>(m_decimation) / m_interpolation;
+		m_decimation = static_cast<unsigned int>(std::lround(ratio * MAX_PHASES));
+		m_interpolation = MAX_PHASES;
+		const unsigned int approximation_divisor = std::gcd(m_interpolation, m_decimation);
+		m_interpolation /= approximation_divisor;
+		m_decimation /= approximation_divisor;
+	}
+
+	const std::size_t scale = (m_decimation + m_interpolation - 1) / m_interpolation;
+	m_taps = std::min(BASE_TAPS * scale, MAX_TAPS);
+
+	// Prototype low-pass filter at the up-sampled rate
+	const std::size_t length = m_taps * m_interpolation;
+	const double cutoff = ROLLOFF * 0.5 / std::max(m_interpolation, m_decimation);
+	const double center = static_cast<double>(length - 1) / 2;
+	const double window_norm = bessel_i0(KAISER_BETA);
+	std::vector<double> prototype(length);
+	for(std::size_t i = 0; i < length; ++i)
+	{
+		const double x = (static_cast<double>(i) - center) / center;
+		const double window = bessel_i0(KAISER_BETA * std::sqrt(std::max(0.0, 1 - x * x)))
+		                      / window_norm;
+		prototype[i] = 2 * cutoff * sinc(2 * cutoff * (static_cast<double>(i) - center)) * window;
+	}
+
+	// Split in phases, reversed to be applied on the history in reading order,
+	// each phase normalized to a unit gain
+	m_filters.resize(length);
+	for(unsigned int phase = 0; phase < m_interpolation; ++phase)
+	{
+		double sum = 0;
+		for(std::size_t tap = 0; tap < m_taps; ++tap)
+		{
+			sum += prototype[(m_taps - 1 - tap) * m_interpolation + phase];
+		}
+		for(std::size_t tap = 0; tap < m_taps; ++tap)
+		{
+			m_filters[phase * m_taps + tap] =
+			  static_cast<float>(prototype[(m_taps - 1 - tap) * m_interpolation + phase] / sum);
+		}
+	}
+
+	m_history.assign(channels, std::vector<float>(m_taps - 1 + max_input_frames));
+	reset();
+}
+
+bool audio::dsp::Resampler::active() const noexcept
+{
+	return m_taps != 0;
+}
+
+std::size_t audio::dsp::Resampler::maxOutputFrames(std::size_t input_frames) const noexcept
+{
+	if(!active())
+	{
+		return input_frames;
+	}
+	return (input_frames + m_taps) * m_interpolation / m_decimation + 1;
+}
+
+void audio::dsp::Resampler::reset() noexcept
+{
+	// start with a silent history: the first output frame is centered on the first input frame
+	for(std::vector<float>& history: m_history)
+	{
+		std::fill(history.begin(), history.end(), 0.f);
+	}
+	m_history_frames = m_taps > 0 ? m_taps / 2 : 0;
+	m_position = 0;
+	m_phase = 0;
+}
+
+std::size_t audio::dsp::Resampler::process(const float* input,
+                                           std::size_t input_frames,
+                                           float* output) noexcept
+{
+	if(!active())
+	{
+		std::copy(input, input + input_frames * m_channels, output);
+		return input_frames;
+	}
+
+	std::size_t output_frames = 0;
+	while(input_frames != 0)
+	{
+		// append to the planar history
+		const std::size_t capacity = m_history.front().size();
+		const std::size_t count = std::min(input_frames, capacity - m_history_frames);
+		for(unsigned int channel = 0; channel < m_channels; ++channel)
+		{
+			float* history = m_history[channel].data() + m_history_frames;
+			for(std::size_t frame = 0; frame < count; ++frame)
+			{
+				history[frame] = input[frame * m_channels + channel];
+			}
+		}
+		m_history_frames += count;
+		input += count * m_channels;
+		input_frames -= count;
+
+		while(m_position + m_taps <= m_history_frames)
+		{
+			const float* coefficients = m_filters.data() + m_phase * m_taps;
+			for(unsigned int channel = 0; channel < m_channels; ++channel)
+			{
+				output[output_frames * m_channels + channel] =
+				  dot_product(coefficients, m_history[channel].data() + m_position, m_taps);
+			}
+			++output_frames;
+			m_phase += m_decimation;
+			m_position += m_phase / m_interpolation;
+			m_phase %= m_interpolation;
+		}
+
+		// keep the frames still needed
+		if(m_position >= m_history_frames)
+		{
+			m_position -= m_history_frames;
+			m_history_frames = 0;
+		}
+		else
+		{
+			for(std::vector<float>& history: m_history)
+			{
+				std::copy(history.begin() + static_cast<std::ptrdiff_t>(m_position),
+				          history.begin() + static_cast<std::ptrdiff_t>(m_history_frames),
+				          history.begin());
+			}
+			m_history_frames -= m_position;
+			m_position = 0;
+		}
+		assert(m_history_frames < m_taps);
+	}
+	return output_frames;
+}
@@ -0,0 +1,474 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "audio/mix_kernels.hpp"
+#include "utils/simd.hpp"
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+#	include <emmintrin.h>
+#endif
+#if defined(MAGICPLAYER_SIMD_AVX2)
+#	include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <type_traits>
+
+namespace
+{
+	using audio::kernels::GainRamp;
+
+	constexpr float INT16_MIN_F = -32768.f;
+	constexpr float INT16_MAX_F = 32767.f;
+	constexpr float INT16_SCALE = 32768.f;
+
+	inline float to_float(std::int16_t sample) noexcept
+	{
+		return static_cast<float>(sample);
+	}
+
+	inline float to_float(float sample) noexcept
+	{
+		return sample;
+	}
+
+	inline void store(float value, std::int16_t& sample) noexcept
+	{
+		// same rounding (nearest even) and saturation as the vectorized versions
+		value = std::min(std::max(value, INT16_MIN_F), INT16_MAX_F);
+		sample = static_cast<std::int16_t>(std::lrintf(value));
+	}
+
+	inline void store(float value, float& sample) noexcept
+	{
+		sample = value;
+	}
+
+	// Mix frames [first_frame, last_frame)
+	template<typename T>
+	void scalar_mix_ramp(const T* a,
+	                     GainRamp a_gain,
+	                     const T* b,
+	                     GainRamp b_gain,
+	                     T* out,
+	                     std::size_t first_frame,
+	                     std::size_t last_frame,
+	                     unsigned int channels) noexcept
+	{
+		for(std::size_t f = first_frame; f < last_frame; ++f)
+		{
+			const float frame = static_cast<float>(f);
+			const float a_g = a_gain.start + a_gain.step * frame;
+			const float b_g = b_gain.start + b_gain.step * frame;
+			for(std::size_t i = f * channels; i < (f + 1) * channels; ++i)
+			{
+				const float a_s = to_float(a[i]) * a_g;
+				const float b_s = to_float(b[i]) * b_g;
+				store(a_s + b_s, out[i]);
+			}
+		}
+	}
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	// 8 samples per iteration, channels must divide 8
+	std::size_t sse2_mix_ramp(const std::int16_t* a,
+	                          GainRamp a_gain,
+	                          const std::int16_t* b,
+	                          GainRamp b_gain,
+	                          std::int16_t* out,
+	                          std::size_t frames,
+	                          unsigned int channels) noexcept
+	{
+		const std::size_t frames_per_iteration = 8 / channels;
+		const std::size_t iterations = frames / frames_per_iteration;
+		const float c = static_cast<float>(channels);
+		const __m128 lo_offsets = _mm_set_ps(std::floor(3 / c), std::floor(2 / c), std::floor(1 / c), 0);
+		const __m128 hi_offsets =
+		  _mm_set_ps(std::floor(7 / c), std::floor(6 / c), std::floor(5 / c), std::floor(4 / c));
+		const __m128 a_start = _mm_set1_ps(a_gain.start);
+		const __m128 a_step = _mm_set1_ps(a_gain.step);
+		const __m128 b_start = _mm_set1_ps(b_gain.start);
+		const __m128 b_step = _mm_set1_ps(b_gain.step);
+		const __m128 min = _mm_set1_ps(INT16_MIN_F);
+		const __m128 max = _mm_set1_ps(INT16_MAX_F);
+
+		for(std::size_t it = 0; it < iterations; ++it)
+		{
+			const __m128 base = _mm_set1_ps(static_cast<float>(it * frames_per_iteration));
+			const __m128 lo_frames = _mm_add_ps(base, lo_offsets);
+			const __m128 hi_frames = _mm_add_ps(base, hi_offsets);
+
+			const __m128i a_i16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + it * 8));
+			const __m128i b_i16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + it * 8));
+			const __m128 a_lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a_i16, a_i16), 16));
+			const __m128 a_hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a_i16, a_i16), 16));
+			const __m128 b_lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(b_i16, b_i16), 16));
+			const __m128 b_hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(b_i16, b_i16), 16));
+
+			const __m128 a_g_lo = _mm_add_ps(a_start, _mm_mul_ps(a_step, lo_frames));
+			const __m128 a_g_hi = _mm_add_ps(a_start, _mm_mul_ps(a_step, hi_frames));
+			const __m128 b_g_lo = _mm_add_ps(b_start, _mm_mul_ps(b_step, lo_frames));
+			const __m128 b_g_hi = _mm_add_ps(b_start, _mm_mul_ps(b_step, hi_frames));
+
+			__m128 lo = _mm_add_ps(_mm_mul_ps(a_lo, a_g_lo), _mm_mul_ps(b_lo, b_g_lo));
+			__m128 hi = _mm_add_ps(_mm_mul_ps(a_hi, a_g_hi), _mm_mul_ps(b_hi, b_g_hi));
+			lo = _mm_min_ps(_mm_max_ps(lo, min), max);
+			hi = _mm_min_ps(_mm_max_ps(hi, min), max);
+
+			const __m128i result = _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + it * 8), result);
+		}
+		return iterations * frames_per_iteration;
+	}
+
+	// 4 samples per iteration, channels must divide 4
+	std::size_t sse2_mix_ramp(const float* a,
+	                          GainRamp a_gain,
+	                          const float* b,
+	                          GainRamp b_gain,
+	                          float* out,
+	                          std::size_t frames,
+	                          unsigned int channels) noexcept
+	{
+		const std::size_t frames_per_iteration = 4 / channels;
+		const std::size_t iterations = frames / frames_per_iteration;
+		const float c = static_cast<float>(channels);
+		const __m128 offsets = _mm_set_ps(std::floor(3 / c), std::floor(2 / c), std::floor(1 / c), 0);
+		const __m128 a_start = _mm_set1_ps(a_gain.start);
+		const __m128 a_step = _mm_set1_ps(a_gain.step);
+		const __m128 b_start = _mm_set1_ps(b_gain.start);
+		const __m128 b_step = _mm_set1_ps(b_gain.step);
+
+		for(std::size_t it = 0; it < iterations; ++it)
+		{
+			const __m128 base = _mm_set1_ps(static_cast<float>(it * frames_per_iteration));
+			const __m128 frames_v = _mm_add_ps(base, offsets);
+			const __m128 a_g = _mm_add_ps(a_start, _mm_mul_ps(a_step, frames_v));
+			const __m128 b_g = _mm_add_ps(b_start, _mm_mul_ps(b_step, frames_v));
+			const __m128 a_v = _mm_loadu_ps(a + it * 4);
+			const __m128 b_v = _mm_loadu_ps(b + it * 4);
+			_mm_storeu_ps(out + it * 4, _mm_add_ps(_mm_mul_ps(a_v, a_g), _mm_mul_ps(b_v, b_g)));
+		}
+		return iterations * frames_per_iteration;
+	}
+#endif
+
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	std::size_t sse2_to_float(const std::int16_t* in, float* out, std::size_t count) noexcept
+	{
+		const __m128 scale = _mm_set1_ps(1 / INT16_SCALE);
+		const std::size_t iterations = count / 8;
+		for(std::size_t it = 0; it < iterations; ++it)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + it * 8));
+			const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+			const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+			_mm_storeu_ps(out + it * 8, _mm_mul_ps(lo, scale));
+			_mm_storeu_ps(out + it * 8 + 4, _mm_mul_ps(hi, scale));
+		}
+		return iterations * 8;
+	}
+
+	std::size_t sse2_to_int16(const float* in, std::int16_t* out, std::size_t count) noexcept
+	{
+		const __m128 scale = _mm_set1_ps(INT16_SCALE);
+		const __m128 min = _mm_set1_ps(INT16_MIN_F);
+		const __m128 max = _mm_set1_ps(INT16_MAX_F);
+		const std::size_t iterations = count / 8;
+		for(std::size_t it = 0; it < iterations; ++it)
+		{
+			__m128 lo = _mm_mul_ps(_mm_loadu_ps(in + it * 8), scale);
+			__m128 hi = _mm_mul_ps(_mm_loadu_ps(in + it * 8 + 4), scale);
+			lo = _mm_min_ps(_mm_max_ps(lo, min), max);
+			hi = _mm_min_ps(_mm_max_ps(hi, min), max);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + it * 8),
+			                 _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+		}
+		return iterations * 8;
+	}
+
+	std::size_t sse2_summarize(const std::int16_t* in,
+	                           std::size_t count,
+	                           audio::kernels::SampleSummary& summary) noexcept
+	{
+		const std::size_t iterations = count / 8;
+		if(iterations == 0)
+		{
+			return 0;
+		}
+
+		const __m128i zero = _mm_setzero_si128();
+		__m128i min = _mm_set1_epi16(summary.min);
+		__m128i max = _mm_set1_epi16(summary.max);
+		__m128i sum = _mm_setzero_si128();
+		for(std::size_t it = 0; it < iterations; ++it)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + it * 8));
+			min = _mm_min_epi16(min, v);
+			max = _mm_max_epi16(max, v);
+			// sums of two squares are at most 2^31: unsigned, widened to 64 bits
+			const __m128i squares = _mm_madd_epi16(v, v);
+			sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(squares, zero));
+			sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(squares, zero));
+		}
+
+		alignas(16) std::int16_t mins[8];
+		alignas(16) std::int16_t maxs[8];
+		alignas(16) std::uint64_t sums[2];
+		_mm_store_si128(reinterpret_cast<__m128i*>(mins), min);
+		_mm_store_si128(reinterpret_cast<__m128i*>(maxs), max);
+		_mm_store_si128(reinterpret_cast<__m128i*>(sums), sum);
+		summary.min = *std::min_element(std::cbegin(mins), std::cend(mins));
+		summary.max = *std::max_element(std::cbegin(maxs), std::cend(maxs));
+		summary.sum_squares += sums[0] + sums[1];
+		return iterations * 8;
+	}
+#endif
+
+#if defined(MAGICPLAYER_SIMD_AVX2)
+	// 8 samples per iteration, channels must divide 8
+	MAGICPLAYER_TARGET_AVX2 std::size_t avx2_mix_ramp(const std::int16_t* a,
+	                                                  GainRamp a_gain,
+	                                                  const std::int16_t* b,
+	                                                  GainRamp b_gain,
+	                                                  std::int16_t* out,
+	                                                  std::size_t frames,
+	                                                  unsigned int channels) noexcept
+	{
+		const std::size_t frames_per_iteration = 8 / channels;
+		const std::size_t iterations = frames / frames_per_iteration;
+		const float c = static_cast<float>(channels);
+		const __m256 offsets = _mm256_set_ps(std::floor(7 / c),
+		                                     std::floor(6 / c),
+		                                     std::floor(5 / c),
+		                                     std::floor(4 / c),
+		                                     std::floor(3 / c),
+		                                     std::floor(2 / c),
+		                                     std::floor(1 / c),
+		                                     0);
+		const __m256 a_start = _mm256_set1_ps(a_gain.start);
+		const __m256 a_step = _mm256_set1_ps(a_gain.step);
+		const __m256 b_start = _mm256_set1_ps(b_gain.start);
+		const __m256 b_step = _mm256_set1_ps(b_gain.step);
+		const __m256 min = _mm256_set1_ps(INT16_MIN_F);
+		const __m256 max = _mm256_set1_ps(INT16_MAX_F);
+
+		for(std::size_t it = 0; it < iterations; ++it)
+		{
+			const __m256 base = _mm256_set1_ps(static_cast<float>(it * frames_per_iteration));
+			const __m256 frames_v = _mm256_add_ps(base, offsets);
+			const __m256 a_g = _mm256_add_ps(a_start, _mm256_mul_ps(a_step, frames_v));
+			const __m256 b_g = _mm256_add_ps(b_start, _mm256_mul_ps(b_step, frames_v));
+
+			const __m256 a_v = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			  _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + it * 8))));
+			const __m256 b_v = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			  _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + it * 8))));
+
+			__m256 v = _mm256_add_ps(_mm256_mul_ps(a_v, a_g), _mm256_mul_ps(b_v, b_g));
+			v = _mm256_min_ps(_mm256_max_ps(v, min), max);
+
+			const __m256i result = _mm256_cvtps_epi32(v);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + it * 8),
+			                 _mm_packs_epi32(_mm256_castsi256_si128(result),
+			                                 _mm256_extracti128_si256(result, 1)));
+		}
+		return iterations * frames_per_iteration;
+	}
+
+	// 8 samples per iteration, channels must divide 8
+	MAGICPLAYER_TARGET_AVX2 std::size_t avx2_mix_ramp(const float* a,
+	                                                  GainRamp a_gain,
+	                                                  const float* b,
+	                                                  GainRamp b_gain,
+	                                                  float* out,
+	                                                  std::size_t frames,
+	                                                  unsigned int channels) noexcept
+	{
+		const std::size_t frames_per_iteration = 8 / channels;
+		const std::size_t iterations = frames / frames_per_iteration;
+		const float c = static_cast<float>(channels);
+		const __m256 offsets = _mm256_set_ps(std::floor(7 / c),
+		                                     std::floor(6 / c),
+		                                     std::floor(5 / c),
+		                                     std::floor(4 / c),
+		                                     std::floor(3 / c),
+		                                     std::floor(2 / c),
+		                                     std::floor(1 / c),
+		                                     0);
+		const __m256 a_start = _mm256_set1_ps(a_gain.start);
+		const __m256 a_step = _mm256_set1_ps(a_gain.step);
+		const __m256 b_start = _mm256_set1_ps(b_gain.start);
+		const __m256 b_step = _mm256_set1_ps(b_gain.step);
+
+		for(std::size_t it = 0; it < iterations; ++it)
+		{
+			const __m256 base = _mm256_set1_ps(static_cast<float>(it * frames_per_iteration));
+			const __m256 frames_v = _mm256_add_ps(base, offsets);
+			const __m256 a_g = _mm256_add_ps(a_start, _mm256_mul_ps(a_step, frames_v));
+			const __m256 b_g = _mm256_add_ps(b_start, _mm256_mul_ps(b_step, frames_v));
+			const __m256 a_v = _mm256_loadu_ps(a + it * 8);
+			const __m256 b_v = _mm256_loadu_ps(b + it * 8);
+			_mm256_storeu_ps(out + it * 8,
+			                 _mm256_add_ps(_mm256_mul_ps(a_v, a_g), _mm256_mul_ps(b_v, b_g)));
+		}
+		return iterations * frames_per_iteration;
+	}
+#endif
+
+	template<typename T>
+	void dispatch_mix_ramp(const T* a,
+	                       GainRamp a_gain,
+	                       const T* b,
+	                       GainRamp b_gain,
+	                       T* out,
+	                       std::size_t frames,
+	                       unsigned int channels) noexcept
+	{
+		if(channels == 0)
+		{
+			return;
+		}
+
+		std::size_t done = 0;
+#if defined(MAGICPLAYER_SIMD_AVX2)
+		if(done == 0 && 8 % channels == 0 && simd::has_avx2())
+		{
+			done = avx2_mix_ramp(a, a_gain, b, b_gain, out, frames, channels);
+		}
+#endif
+#if defined(MAGICPLAYER_SIMD_SSE2)
+		constexpr unsigned int SSE2_LANES = std::is_same<T, float>::value ? 4 : 8;
+		if(done == 0 && SSE2_LANES % channels == 0)
+		{
+			done = sse2_mix_ramp(a, a_gain, b, b_gain, out, frames, channels);
+		}
+#endif
+		scalar_mix_ramp(a, a_gain, b, b_gain, out, done, frames, channels);
+	}
+
+	void scalar_summarize(const std::int16_t* in,
+	                      std::size_t first,
+	                      std::size_t last,
+	                      audio::kernels::SampleSummary& summary) noexcept
+	{
+		for(std::size_t i = first; i < last; ++i)
+		{
+			summary.min = std::min(summary.min, in[i]);
+			summary.max = std::max(summary.max, in[i]);
+			summary.sum_squares += static_cast<std::uint64_t>(std::int32_t{in[i]} * in[i]);
+		}
+	}
+
+	void scalar_to_float(const std::int16_t* in, float* out, std::size_t first, std::size_t last) noexcept
+	{
+		for(std::size_t i = first; i < last; ++i)
+		{
+			out[i] = to_float(in[i]) * (1 / INT16_SCALE);
+		}
+	}
+
+	void scalar_to_int16(const float* in, std::int16_t* out, std::size_t first, std::size_t last) noexcept
+	{
+		for(std::size_t i = first; i < last; ++i)
+		{
+			store(in[i] * INT16_SCALE, out[i]);
+		}
+	}
+} // namespace
+
+void audio::kernels::mix_ramp(const std::int16_t* a,
+                              GainRamp a_gain,
+                              const std::int16_t* b,
+                              GainRamp b_gain,
+                              std::int16_t* out,
+                              std::size_t frames,
+                              unsigned int channels) noexcept
+{
+	dispatch_mix_ramp(a, a_gain, b, b_gain, out, frames, channels);
+}
+
+void audio::kernels::mix_ramp(const float* a,
+                              GainRamp a_gain,
+                              const float* b,
+                              GainRamp b_gain,
+                              float* out,
+                              std::size_t frames,
+                              unsigned int channels) noexcept
+{
+	dispatch_mix_ramp(a, a_gain, b, b_gain, out, frames, channels);
+}
+
+void audio::kernels::scalar::mix_ramp(const std::int16_t* a,
+                                      GainRamp a_gain,
+                                      const std::int16_t* b,
+                                      GainRamp b_gain,
+                                      std::int16_t* out,
+                                      std::size_t frames,
+                                      unsigned int channels) noexcept
+{
+	scalar_mix_ramp(a, a_gain, b, b_gain, out, 0, frames, channels);
+}
+
+void audio::kernels::scalar::mix_ramp(const float* a,
+                                      GainRamp a_gain,
+                                      const float* b,
+                                      GainRamp b_gain,
+                                      float* out,
+                                      std::size_t frames,
+                                      unsigned int channels) noexcept
+{
+	scalar_mix_ramp(a, a_gain, b, b_gain, out, 0, frames, channels);
+}
+
+void audio::kernels::summarize(const std::int16_t* samples,
+                               std::size_t count,
+                               SampleSummary& summary) noexcept
+{
+	std::size_t done = 0;
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	done = sse2_summarize(samples, count, summary);
+#endif
+	scalar_summarize(samples, done, count, summary);
+}
+
+void audio::kernels::to_float(const std::int16_t* in, float* out, std::size_t count) noexcept
+{
+	std::size_t done = 0;
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	done = sse2_to_float(in, out, count);
+#endif
+	scalar_to_float(in, out, done, count);
+}
+
+void audio::kernels::to_int16(const float* in, std::int16_t* out, std::size_t count) noexcept
+{
+	std::size_t done = 0;
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	done = sse2_to_int16(in, out, count);
+#endif
+	scalar_to_int16(in, out, done, count);
+}
+
+void audio::kernels::scalar::summarize(const std::int16_t* samples,
+                                       std::size_t count,
+                                       SampleSummary& summary) noexcept
+{
+	scalar_summarize(samples, 0, count, summary);
+}
+
+void audio::kernels::scalar::to_float(const std::int16_t* in, float* out, std::size_t count) noexcept
+{
+	scalar_to_float(in, out, 0, count);
+}
+
+void audio::kernels::scalar::to_int16(const float* in, std::int16_t* out, std::size_t count) noexcept
+{
+	scalar_to_int16(in, out, 0, count);
+}
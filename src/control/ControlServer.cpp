@@ -0,0 +1,807 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "control/ControlServer.hpp"
+#include "control/Protocol.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <variant>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <arpa/inet.h>
+#	include <fcntl.h>
+#	include <netinet/in.h>
+#	include <netinet/tcp.h>
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <sys/un.h>
+#	include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr std::size_t READ_SIZE = 64 * 1024;
+	// clients sending longer lines or not reading their answers are disconnected
+	constexpr std::size_t MAX_REQUEST_SIZE = 16 * 1024 * 1024;
+	constexpr std::size_t MAX_PENDING_OUTPUT = 64 * 1024 * 1024;
+
+	constexpr std::uint32_t ALL_EVENTS = (1u << std::size(control::EVENT_NAMES)) - 1;
+
+#if defined(__unix__) || defined(__APPLE__)
+	bool set_flags(int fd) noexcept
+	{
+		const int flags = ::fcntl(fd, F_GETFL);
+		return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0
+		       && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+	}
+#endif
+
+	void append_line(std::string& output, const nlohmann::json& json)
+	{
+		output += json.dump();
+		output += '\n';
+	}
+
+	nlohmann::json make_error(const char* error)
+	{
+		return {{"ok", false}, {"error", error}};
+	}
+
+	// 128 random bits in hexadecimal
+	std::string generate_token()
+	{
+		std::random_device random;
+		std::ostringstream token;
+		token << std::hex << std::setfill('0');
+		for(int i = 0; i < 4; ++i)
+		{
+			token << std::setw(8) << static_cast<std::uint32_t>(random());
+		}
+		return token.str();
+	}
+
+	// without early exit, the comparison duration doesn't depend on the matching prefix
+	bool tokens_equal(std::string_view expected, std::string_view actual) noexcept
+	{
+		if(expected.size() != actual.size())
+		{
+			return false;
+		}
+		unsigned char difference = 0;
+		for(std::size_t i = 0; i < expected.size(); ++i)
+		{
+			difference |= static_cast<unsigned char>(expected[i] ^ actual[i]);
+		}
+		return difference == 0;
+	}
+
+	// nullopt if the request events are invalid
+	std::optional<std::uint32_t> get_events(const nlohmann::json& request)
+	{
+		const auto events = request.find("events");
+		if(events == request.end())
+		{
+			return ALL_EVENTS;
+		}
+		if(!events->is_array())
+		{
+			return std::nullopt;
+		}
+		std::uint32_t mask = 0;
+		for(const nlohmann::json& event: *events)
+		{
+			const std::optional<std::size_t> index =
+			  event.is_string() ? control::event_index(event.get_ref<const std::string&>())
+			                    : std::nullopt;
+			if(!index)
+			{
+				return std::nullopt;
+			}
+			mask |= 1u << *index;
+		}
+		return mask;
+	}
+} // namespace
+
+control::ControlServer::ControlServer(std::shared_ptr<spdlog::logger> logger) noexcept
+  : m_logger(std::move(logger))
+  , m_com(nullptr)
+  , m_poller()
+  , m_socket_path()
+  , m_listen_fds()
+  , m_tcp_listen_fd(-1)
+  , m_token()
+  , m_token_path()
+  , m_wake_fds{-1, -1}
+  , m_wake_pending(false)
+  , m_stop(false)
+  , m_clients()
+  , m_out_message_handler()
+  , m_out_messages()
+  , m_pending_messages()
+{
+}
+
+void control::ControlServer::setOutMessageHandler(
+  std::function<void(const Msg::Com::OutMessage&)> handler)
+{
+	m_out_message_handler = std::move(handler);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+control::ControlServer::~ControlServer() noexcept
+{
+	for(const auto& [fd, client]: m_clients)
+	{
+		::close(fd);
+	}
+	for(int fd: m_listen_fds)
+	{
+		::close(fd);
+	}
+	if(!m_socket_path.empty())
+	{
+		std::error_code error;
+		std::filesystem::remove(m_socket_path, error);
+	}
+	if(!m_token_path.empty())
+	{
+		std::error_code error;
+		std::filesystem::remove(m_token_path, error);
+	}
+	for(int fd: m_wake_fds)
+	{
+		if(fd >= 0)
+		{
+			::close(fd);
+		}
+	}
+}
+
+bool control::ControlServer::open(Msg::Com& com,
+                                  const std::filesystem::path& socket_path,
+                                  std::uint16_t tcp_port,
+                                  const std::filesystem::path& token_path)
+{
+	assert(m_listen_fds.empty());
+	if(!m_poller.valid())
+	{
+		m_logger->error("Failed to create the control server poller: {}", std::strerror(errno));
+		return false;
+	}
+	if(::pipe(m_wake_fds) != 0 || !set_flags(m_wake_fds[0]) || !set_flags(m_wake_fds[1])
+	   || !m_poller.add(m_wake_fds[0]))
+	{
+		m_logger->error("Failed to create the control server wake pipe: {}", std::strerror(errno));
+		return false;
+	}
+	if(!socket_path.empty() && !listenUnix(socket_path))
+	{
+		return false;
+	}
+	if(tcp_port != 0 && !listenTcp(tcp_port, token_path))
+	{
+		return false;
+	}
+	if(m_listen_fds.empty())
+	{
+		m_logger->error("No control socket to listen on");
+		return false;
+	}
+
+	m_com = &com;
+	m_com->out_listener = [this]() { wake(); };
+	return true;
+}
+
+void control::ControlServer::run()
+{
+	assert(m_com != nullptr);
+	std::vector<event_poller::event> events;
+	while(!m_stop.load(std::memory_order_acquire))
+	{
+		if(!m_poller.wait(events))
+		{
+			m_logger->error("Control server event loop failed: {}", std::strerror(errno));
+			break;
+		}
+
+		for(const event_poller::event& event: events)
+		{
+			if(event.fd == m_wake_fds[0])
+			{
+				char buffer[64];
+				while(::read(m_wake_fds[0], buffer, sizeof(buffer)) > 0)
+				{
+				}
+				m_wake_pending.store(false, std::memory_order_release);
+				sendNotifications();
+				continue;
+			}
+			if(std::find(m_listen_fds.cbegin(), m_listen_fds.cend(), event.fd)
+			   != m_listen_fds.cend())
+			{
+				acceptClients(event.fd);
+				continue;
+			}
+
+			const auto it = m_clients.find(event.fd);
+			if(it == m_clients.end())
+			{
+				// disconnected while handling a previous event
+				continue;
+			}
+			Client& client = it->second;
+			bool connected = true;
+			if(event.readable || event.error)
+			{
+				connected = readClient(client);
+			}
+			if(connected && !client.output.empty())
+			{
+				connected = writeClient(client);
+			}
+			if(!connected)
+			{
+				disconnect(client);
+			}
+		}
+
+		if(!m_pending_messages.empty())
+		{
+			m_com->sendInMessages(m_pending_messages);
+		}
+	}
+
+	SPDLOG_DEBUG(m_logger, "Control server stopped");
+	m_com->sendInMessage<Msg::In::Control>(Msg::In::Control::Action::STOP);
+	m_com->sendInMessage<Msg::In::Close>();
+}
+
+void control::ControlServer::stop() noexcept
+{
+	m_stop.store(true, std::memory_order_release);
+	if(m_wake_fds[1] >= 0)
+	{
+		const char byte = 0;
+		[[maybe_unused]] const ssize_t written = ::write(m_wake_fds[1], &byte, 1);
+	}
+}
+
+bool control::ControlServer::listenUnix(const std::filesystem::path& socket_path)
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	const std::string& path_str = socket_path.native();
+	if(path_str.size() >= sizeof(address.sun_path))
+	{
+		m_logger->error("Control socket path too long: {}", socket_path);
+		return false;
+	}
+	std::memcpy(address.sun_path, path_str.c_str(), path_str.size() + 1);
+
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0)
+	{
+		m_logger->error("Failed to create the control socket: {}", std::strerror(errno));
+		return false;
+	}
+
+	// socket file left by a previous instance which didn't end properly: nothing accepts
+	// connections on it, a running instance keeps its socket
+	std::error_code error;
+	if(std::filesystem::is_socket(socket_path, error))
+	{
+		const int probe_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		const bool connected =
+		  probe_fd >= 0
+		  && ::connect(probe_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+		const int probe_error = errno;
+		if(probe_fd >= 0)
+		{
+			::close(probe_fd);
+		}
+		if(connected || probe_error != ECONNREFUSED)
+		{
+			if(connected)
+			{
+				m_logger->error("Control socket {} is in use by another instance", socket_path);
+			}
+			else
+			{
+				m_logger->error(
+				  "Failed to check control socket {}: {}", socket_path, std::strerror(probe_error));
+			}
+			::close(fd);
+			return false;
+		}
+		SPDLOG_DEBUG(m_logger, "Removed stale control socket {}", socket_path);
+		std::filesystem::remove(socket_path, error);
+	}
+
+	// the player can be driven by anyone able to connect, only the user is allowed
+	const mode_t previous_mask = ::umask(0077);
+	const bool bound =
+	  ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+	::umask(previous_mask);
+	if(!bound || ::listen(fd, SOMAXCONN) != 0 || !addListener(fd))
+	{
+		m_logger->error(
+		  "Failed to listen on control socket {}: {}", socket_path, std::strerror(errno));
+		::close(fd);
+		return false;
+	}
+	m_socket_path = socket_path;
+	m_logger->info("Control server listening on {}", socket_path);
+	return true;
+}
+
+bool control::ControlServer::listenTcp(std::uint16_t port,
+                                       const std::filesystem::path& token_path)
+{
+	// any local user can connect: the clients authenticate with a token only the user can read
+	if(!writeToken(token_path))
+	{
+		return false;
+	}
+
+	const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0)
+	{
+		m_logger->error("Failed to create the control TCP socket: {}", std::strerror(errno));
+		return false;
+	}
+	const int enable = 1;
+	::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+	// loopback only, the token is sent in clear
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+	   || ::listen(fd, SOMAXCONN) != 0 || !addListener(fd))
+	{
+		m_logger->error("Failed to listen on control port {}: {}", port, std::strerror(errno));
+		::close(fd);
+		return false;
+	}
+	m_tcp_listen_fd = fd;
+	m_logger->info("Control server listening on 127.0.0.1:{}, token in {}", port, token_path);
+	return true;
+}
+
+bool control::ControlServer::writeToken(const std::filesystem::path& token_path)
+{
+	if(token_path.empty())
+	{
+		m_logger->error("A token file is needed to listen on a control port");
+		return false;
+	}
+
+	m_token = generate_token();
+	// created readable by the user only. Not through a symbolic link, and an existing file must
+	// be a regular file of the user not linked elsewhere: the default path may be in a shared
+	// folder, the file is truncated and restricted only once checked
+	const int fd = ::open(
+	  token_path.c_str(), O_WRONLY | O_CREAT | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if(fd < 0)
+	{
+		m_logger->error(
+		  "Failed to create control token file {}: {}", token_path, std::strerror(errno));
+		return false;
+	}
+	struct stat file_stat{};
+	if(::fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)
+	   || file_stat.st_uid != ::geteuid() || file_stat.st_nlink != 1)
+	{
+		m_logger->error("Control token file {} is not a regular file of the user", token_path);
+		::close(fd);
+		return false;
+	}
+	m_token_path = token_path;
+
+	const std::string content = m_token + '\n';
+	const bool written = ::fchmod(fd, S_IRUSR | S_IWUSR) == 0 && ::ftruncate(fd, 0) == 0
+	                     && ::write(fd, content.data(), content.size())
+	                          == static_cast<ssize_t>(content.size());
+	const int write_error = errno;
+	::close(fd);
+	if(!written)
+	{
+		m_logger->error(
+		  "Failed to write control token file {}: {}", token_path, std::strerror(write_error));
+		return false;
+	}
+	return true;
+}
+
+bool control::ControlServer::addListener(int fd)
+{
+	if(!set_flags(fd) || !m_poller.add(fd))
+	{
+		return false;
+	}
+	m_listen_fds.push_back(fd);
+	return true;
+}
+
+void control::ControlServer::wake() noexcept
+{
+	// one write per batch of out messages, the flag is cleared before they are read
+	if(!m_wake_pending.exchange(true, std::memory_order_acq_rel))
+	{
+		const char byte = 0;
+		[[maybe_unused]] const ssize_t written = ::write(m_wake_fds[1], &byte, 1);
+	}
+}
+
+void control::ControlServer::acceptClients(int listen_fd)
+{
+	for(;;)
+	{
+		const int fd = ::accept(listen_fd, nullptr, nullptr);
+		if(fd < 0)
+		{
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				m_logger->warn("Failed to accept control client: {}", std::strerror(errno));
+			}
+			return;
+		}
+		if(!set_flags(fd) || !m_poller.add(fd))
+		{
+			m_logger->warn("Failed to configure control client socket: {}", std::strerror(errno));
+			::close(fd);
+			continue;
+		}
+		// small answers are sent right away, fails on Unix sockets
+		const int enable = 1;
+		::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+		m_clients.emplace(fd, Client{fd, {}, {}, false, 0, listen_fd != m_tcp_listen_fd});
+		m_logger->info("Control client connected ({} clients)", m_clients.size());
+	}
+}
+
+void control::ControlServer::disconnect(Client& client)
+{
+	const int fd = client.fd;
+	m_poller.remove(fd);
+	::close(fd);
+	m_clients.erase(fd);
+	m_logger->info("Control client disconnected ({} clients)", m_clients.size());
+}
+
+bool control::ControlServer::readClient(Client& client)
+{
+	char buffer[READ_SIZE];
+	for(;;)
+	{
+		const ssize_t count = ::read(client.fd, buffer, sizeof(buffer));
+		if(count == 0)
+		{
+			return false;
+		}
+		if(count < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				return true;
+			}
+			m_logger->warn("Failed to read from control client: {}", std::strerror(errno));
+			return false;
+		}
+
+		client.input.append(buffer, static_cast<std::size_t>(count));
+		std::size_t line_start = 0;
+		for(std::size_t line_end = client.input.find('\n');
+		    line_end != std::string::npos && !m_stop.load(std::memory_order_acquire);
+		    line_end = client.input.find('\n', line_start))
+		{
+			handleLine(client,
+			           std::string_view(client.input).substr(line_start, line_end - line_start));
+			line_start = line_end + 1;
+		}
+		client.input.erase(0, line_start);
+		if(client.input.size() > MAX_REQUEST_SIZE)
+		{
+			m_logger->warn("Control client request too long, disconnected");
+			return false;
+		}
+	}
+}
+
+bool control::ControlServer::writeClient(Client& client)
+{
+	std::size_t written = 0;
+	while(written < client.output.size())
+	{
+		const ssize_t count =
+		  ::write(client.fd, client.output.data() + written, client.output.size() - written);
+		if(count < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			m_logger->warn("Failed to write to control client: {}", std::strerror(errno));
+			return false;
+		}
+		written += static_cast<std::size_t>(count);
+	}
+	client.output.erase(0, written);
+
+	if(client.output.size() > MAX_PENDING_OUTPUT)
+	{
+		m_logger->warn("Control client doesn't read its messages, disconnected");
+		return false;
+	}
+	// watched for writing only while there is pending output
+	const bool watch_writable = !client.output.empty();
+	if(watch_writable != client.watch_writable)
+	{
+		client.watch_writable = watch_writable;
+		return m_poller.modify(client.fd, watch_writable);
+	}
+	return true;
+}
+
+void control::ControlServer::handleLine(Client& client, std::string_view line)
+{
+	if(line.empty() || line == "\r")
+	{
+		return;
+	}
+
+	const nlohmann::json request = nlohmann::json::parse(line.begin(), line.end(), nullptr, false);
+	if(request.is_discarded())
+	{
+		SPDLOG_DEBUG(m_logger, "Invalid control request: invalid json");
+		append_line(client.output, make_error("invalid json"));
+		return;
+	}
+
+	const auto type = request.is_object() ? request.find("type") : request.end();
+	if(type == request.end() || *type != "batch")
+	{
+		append_line(client.output, handleRequest(client, request));
+		return;
+	}
+
+	const auto requests = request.find("requests");
+	nlohmann::json answer;
+	if(requests == request.end() || !requests->is_array())
+	{
+		answer = make_error("invalid batch");
+	}
+	else
+	{
+		nlohmann::json results = nlohmann::json::array();
+		for(const nlohmann::json& batch_request: *requests)
+		{
+			if(m_stop.load(std::memory_order_acquire))
+			{
+				break;
+			}
+			results.push_back(handleRequest(client, batch_request));
+		}
+		answer = {{"ok", true}, {"results", std::move(results)}};
+	}
+	const auto id = request.find("id");
+	if(id != request.end())
+	{
+		answer["id"] = *id;
+	}
+	append_line(client.output, answer);
+}
+
+nlohmann::json control::ControlServer::handleRequest(Client& client, const nlohmann::json& request)
+{
+	nlohmann::json answer = nlohmann::json::object();
+	std::string type;
+	if(request.is_object())
+	{
+		const auto id = request.find("id");
+		if(id != request.end())
+		{
+			answer["id"] = *id;
+		}
+		const auto type_it = request.find("type");
+		if(type_it != request.end() && type_it->is_string())
+		{
+			type = type_it->get<std::string>();
+		}
+	}
+
+	if(type == "auth")
+	{
+		const auto token = request.find("token");
+		if(token == request.end() || !token->is_string()
+		   || !tokens_equal(m_token, token->get_ref<const std::string&>()))
+		{
+			m_logger->warn("Control client authentication failed");
+			answer.update(make_error("invalid token"));
+			return answer;
+		}
+		client.authenticated = true;
+		answer["ok"] = true;
+		return answer;
+	}
+	if(!client.authenticated)
+	{
+		answer.update(make_error("authentication required"));
+		return answer;
+	}
+
+	if(type == "state")
+	{
+		std::string error;
+		const std::optional<Msg::ZoneId> zone = parse_zone(request, error);
+		if(!zone)
+		{
+			answer.update(make_error(error.c_str()));
+			return answer;
+		}
+		answer["ok"] = true;
+		answer["state"] =
+		  to_json(m_com->playback[*zone].load(), std::chrono::steady_clock::now());
+		return answer;
+	}
+	if(type == "subscribe" || type == "unsubscribe")
+	{
+		const std::optional<std::uint32_t> events = get_events(request);
+		if(!events)
+		{
+			answer.update(make_error("invalid events"));
+			return answer;
+		}
+		if(type == "subscribe")
+		{
+			client.subscriptions |= *events;
+		}
+		else
+		{
+			client.subscriptions &= ~*events;
+		}
+		answer["ok"] = true;
+		return answer;
+	}
+	if(type == "tracing")
+	{
+		if constexpr(!Msg::tracing::ENABLED)
+		{
+			answer.update(make_error("message tracing disabled at build time"));
+			return answer;
+		}
+		answer["ok"] = true;
+		answer["messages"] = to_json(Msg::tracing::dump());
+		return answer;
+	}
+	if(type == "batch")
+	{
+		answer.update(make_error("nested batch"));
+		return answer;
+	}
+
+	std::string error;
+	std::optional<Msg::Com::InMessage> message = parse_request(request, error);
+	if(!message)
+	{
+		SPDLOG_DEBUG(m_logger, "Invalid control request: {}", error);
+		answer["ok"] = false;
+		answer["error"] = std::move(error);
+		return answer;
+	}
+
+	answer["ok"] = true;
+	if(std::holds_alternative<Msg::In::Close>(*message))
+	{
+		m_logger->info("Close requested by a control client");
+		m_stop.store(true, std::memory_order_release);
+		return answer;
+	}
+	m_pending_messages.emplace_back(std::move(*message));
+	return answer;
+}
+
+void control::ControlServer::sendNotifications()
+{
+	std::string notification;
+	m_com->out.swap_all(m_out_messages);
+	for(const Msg::Com::OutEnvelope& envelope: m_out_messages)
+	{
+		const Msg::Com::OutMessage& message = envelope.message;
+		[[maybe_unused]] Msg::tracing::clock::time_point handler_start;
+		if constexpr(Msg::tracing::ENABLED)
+		{
+			Msg::tracing::recordDequeue(
+			  Msg::tracing::Direction::OUT, message.index(), envelope.enqueued());
+			handler_start = Msg::tracing::clock::now();
+		}
+		if(m_out_message_handler)
+		{
+			m_out_message_handler(message);
+		}
+		const std::uint32_t event_bit = 1u << message.index();
+		notification.clear();
+		for(auto& [fd, client]: m_clients)
+		{
+			if(client.subscriptions & event_bit)
+			{
+				if(notification.empty())
+				{
+					notification = to_json(message).dump();
+					notification += '\n';
+				}
+				client.output += notification;
+			}
+		}
+		if constexpr(Msg::tracing::ENABLED)
+		{
+			Msg::tracing::recordHandler(Msg::tracing::Direction::OUT,
+			                            message.index(),
+			                            Msg::tracing::clock::now() - handler_start);
+		}
+	}
+	m_out_messages.clear();
+
+	std::vector<int> disconnected;
+	for(auto& [fd, client]: m_clients)
+	{
+		if(!client.output.empty() && !writeClient(client))
+		{
+			disconnected.push_back(fd);
+		}
+	}
+	for(int fd: disconnected)
+	{
+		disconnect(m_clients.at(fd));
+	}
+}
+
+#else
+
+control::ControlServer::~ControlServer() noexcept = default;
+
+bool control::ControlServer::open([[maybe_unused]] Msg::Com& com,
+                                  [[maybe_unused]] const std::filesystem::path& socket_path,
+                                  [[maybe_unused]] std::uint16_t tcp_port,
+                                  [[maybe_unused]] const std::filesystem::path& token_path)
+{
+	m_logger->error("Control server not supported on this platform");
+	return false;
+}
+
+void control::ControlServer::run()
+{
+}
+
+void control::ControlServer::stop() noexcept
+{
+}
+
+#endif
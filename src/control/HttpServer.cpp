@@ -0,0 +1,999 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "control/HttpServer.hpp"
+#include "utils/log.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <ctime>
+#include <optional>
+
+#if defined(__unix__) || defined(__APPLE__)
+#	include <arpa/inet.h>
+#	include <fcntl.h>
+#	include <netinet/in.h>
+#	include <netinet/tcp.h>
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+#if defined(__linux__)
+#	include <sys/sendfile.h>
+#endif
+
+namespace
+{
+	constexpr std::string_view LIBRARY_TARGET = "/library";
+	constexpr std::string_view TRACKS_TARGET = "/tracks/";
+
+	constexpr std::size_t READ_SIZE = 16 * 1024;
+	// requests are only headers, longer ones are refused
+	constexpr std::size_t MAX_HEADER_SIZE = 16 * 1024;
+	// connections sending more pipelined requests while a file is streamed are closed
+	constexpr std::size_t MAX_INPUT_SIZE = 64 * 1024;
+	// sent to a connection before serving the others, a fast client can't starve the slow ones
+	constexpr std::size_t MAX_SEND_PER_EVENT = 1024 * 1024;
+	// accepting is paused above, and when the process runs out of file descriptors
+	constexpr std::size_t MAX_CONNECTIONS = 2048;
+	// paused accepting is retried after this period even if no connection is closed: the file
+	// descriptors can be released by the rest of the process
+	constexpr int ACCEPT_RETRY_PERIOD_MS = 1000;
+
+	// connections without response in progress are closed after being idle for this duration,
+	// the ones with a response in progress after sending nothing for this duration
+	constexpr std::chrono::seconds IDLE_TIMEOUT(60);
+	constexpr int IDLE_CHECK_PERIOD_MS = 10 * 1000;
+
+	constexpr std::string_view CRLF = "\r\n";
+	constexpr std::string_view HEADERS_END = "\r\n\r\n";
+
+	std::string_view status_text(int status) noexcept
+	{
+		switch(status)
+		{
+			case 200:
+				return "OK";
+			case 206:
+				return "Partial Content";
+			case 400:
+				return "Bad Request";
+			case 404:
+				return "Not Found";
+			case 405:
+				return "Method Not Allowed";
+			case 416:
+				return "Range Not Satisfiable";
+			case 431:
+				return "Request Header Fields Too Large";
+			case 503:
+				return "Service Unavailable";
+			default:
+				return "Internal Server Error";
+		}
+	}
+
+	bool iequals(std::string_view a, std::string_view b) noexcept
+	{
+		return a.size() == b.size()
+		       && std::equal(a.cbegin(), a.cend(), b.cbegin(), [](char ca, char cb) {
+			          return std::tolower(static_cast<unsigned char>(ca))
+			                 == std::tolower(static_cast<unsigned char>(cb));
+		          });
+	}
+
+	std::string_view trim(std::string_view str) noexcept
+	{
+		while(!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+		{
+			str.remove_prefix(1);
+		}
+		while(!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+		{
+			str.remove_suffix(1);
+		}
+		return str;
+	}
+
+	// value of the first header with this name, headers are the lines following the request line
+	std::optional<std::string_view> find_header(std::string_view headers,
+	                                            std::string_view name) noexcept
+	{
+		while(!headers.empty())
+		{
+			const std::size_t line_end = std::min(headers.find(CRLF), headers.size());
+			const std::string_view line = headers.substr(0, line_end);
+			headers.remove_prefix(std::min(line_end + CRLF.size(), headers.size()));
+
+			const std::size_t colon = line.find(':');
+			if(colon != std::string_view::npos && iequals(trim(line.substr(0, colon)), name))
+			{
+				return trim(line.substr(colon + 1));
+			}
+		}
+		return std::nullopt;
+	}
+
+	bool has_token(std::string_view list, std::string_view token) noexcept
+	{
+		while(!list.empty())
+		{
+			const std::size_t comma = std::min(list.find(','), list.size());
+			if(iequals(trim(list.substr(0, comma)), token))
+			{
+				return true;
+			}
+			list.remove_prefix(std::min(comma + 1, list.size()));
+		}
+		return false;
+	}
+
+	template<typename T>
+	std::optional<T> parse_number(std::string_view str) noexcept
+	{
+		T value{};
+		const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+		if(str.empty() || error != std::errc() || end != str.data() + str.size())
+		{
+			return std::nullopt;
+		}
+		return value;
+	}
+
+	struct ByteRange
+	{
+		std::uint64_t first;
+		std::uint64_t last; // inclusive
+	};
+
+	enum class RangeStatus
+	{
+		NONE, // no range or ignored range, the whole file is sent
+		SATISFIABLE,
+		UNSATISFIABLE,
+	};
+
+	// single range "bytes=first-last", "bytes=first-" or "bytes=-suffix_length",
+	// multiple ranges and invalid ones are ignored as allowed by RFC 7233
+	RangeStatus parse_range(std::string_view value, std::uint64_t size, ByteRange& range) noexcept
+	{
+		constexpr std::string_view BYTES_UNIT = "bytes=";
+		if(value.substr(0, BYTES_UNIT.size()) != BYTES_UNIT
+		   || value.find(',') != std::string_view::npos)
+		{
+			return RangeStatus::NONE;
+		}
+		value.remove_prefix(BYTES_UNIT.size());
+		const std::size_t dash = value.find('-');
+		if(dash == std::string_view::npos)
+		{
+			return RangeStatus::NONE;
+		}
+		const std::string_view first_str = trim(value.substr(0, dash));
+		const std::string_view last_str = trim(value.substr(dash + 1));
+
+		if(first_str.empty())
+		{
+			const std::optional<std::uint64_t> suffix_length =
+			  parse_number<std::uint64_t>(last_str);
+			if(!suffix_length)
+			{
+				return RangeStatus::NONE;
+			}
+			if(*suffix_length == 0 || size == 0)
+			{
+				return RangeStatus::UNSATISFIABLE;
+			}
+			range = {size - std::min(*suffix_length, size), size - 1};
+			return RangeStatus::SATISFIABLE;
+		}
+
+		const std::optional<std::uint64_t> first = parse_number<std::uint64_t>(first_str);
+		const std::optional<std::uint64_t> last =
+		  last_str.empty() ? std::optional<std::uint64_t>(UINT64_MAX)
+		                   : parse_number<std::uint64_t>(last_str);
+		if(!first || !last || *last < *first)
+		{
+			return RangeStatus::NONE;
+		}
+		if(*first >= size)
+		{
+			return RangeStatus::UNSATISFIABLE;
+		}
+		range = {*first, std::min(*last, size - 1)};
+		return RangeStatus::SATISFIABLE;
+	}
+
+	std::string_view content_type(const std::filesystem::path& path)
+	{
+		std::string extension = path_to_generic_utf8_string(path.extension());
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+			return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		});
+		if(extension == ".flac")
+		{
+			return "audio/flac";
+		}
+		if(extension == ".mp3")
+		{
+			return "audio/mpeg";
+		}
+		if(extension == ".ogg" || extension == ".oga")
+		{
+			return "audio/ogg";
+		}
+		if(extension == ".wav")
+		{
+			return "audio/wav";
+		}
+		return "application/octet-stream";
+	}
+
+	nlohmann::json make_listing(const data::Database& database)
+	{
+		nlohmann::json artists = nlohmann::json::array();
+		for(const data::Artist& artist: database.artists)
+		{
+			nlohmann::json albums = nlohmann::json::array();
+			for(const data::Album& album: artist.albums)
+			{
+				nlohmann::json tracks = nlohmann::json::array();
+				for(const data::Music& music: album.musics)
+				{
+					std::string url = std::string(TRACKS_TARGET) + std::to_string(music.id);
+					tracks.push_back({{"id", music.id},
+					                  {"track", music.track},
+					                  {"title", music.title},
+					                  {"length_seconds", music.length.count()},
+					                  {"url", std::move(url)}});
+				}
+				albums.push_back({{"id", album.id},
+				                  {"name", album.name},
+				                  {"genre", album.genre},
+				                  {"year", album.year},
+				                  {"length_seconds", album.length.count()},
+				                  {"tracks", std::move(tracks)}});
+			}
+			artists.push_back(
+			  {{"id", artist.id}, {"name", artist.name}, {"albums", std::move(albums)}});
+		}
+		return {{"id", database.id},
+		        {"generation_date",
+		         std::chrono::duration_cast<std::chrono::seconds>(
+		           database.generation_date.time_since_epoch())
+		           .count()},
+		        {"artists", std::move(artists)}};
+	}
+
+#if defined(__unix__) || defined(__APPLE__)
+	bool set_flags(int fd) noexcept
+	{
+		const int flags = ::fcntl(fd, F_GETFL);
+		return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0
+		       && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+	}
+
+	// formatted once per second
+	std::string_view http_date()
+	{
+		static std::time_t formatted_time = 0;
+		static char formatted[64] = {};
+		const std::time_t now = std::time(nullptr);
+		if(now != formatted_time)
+		{
+			std::tm tm{};
+			::gmtime_r(&now, &tm);
+			std::strftime(formatted, sizeof(formatted), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+			formatted_time = now;
+		}
+		return formatted;
+	}
+
+	// more data follows, the headers and the beginning of the body share packets
+	ssize_t send_data(int fd, const char* data, std::size_t size, bool more) noexcept
+	{
+#	if defined(MSG_MORE)
+		return ::send(fd, data, size, more ? MSG_MORE : 0);
+#	else
+		static_cast<void>(more);
+		return ::send(fd, data, size, 0);
+#	endif
+	}
+
+	// file content sent by the kernel, without copy to user space
+	ssize_t send_file(int fd, int file_fd, std::uint64_t& offset, std::size_t count) noexcept
+	{
+#	if defined(__linux__)
+		off_t file_offset = static_cast<off_t>(offset);
+		const ssize_t sent = ::sendfile(fd, file_fd, &file_offset, count);
+		if(sent > 0)
+		{
+			offset = static_cast<std::uint64_t>(file_offset);
+		}
+		return sent;
+#	else
+		char buffer[64 * 1024];
+		const ssize_t read =
+		  ::pread(file_fd, buffer, std::min(count, sizeof(buffer)), static_cast<off_t>(offset));
+		if(read <= 0)
+		{
+			return read;
+		}
+		const ssize_t sent = ::send(fd, buffer, static_cast<std::size_t>(read), 0);
+		if(sent > 0)
+		{
+			offset += static_cast<std::uint64_t>(sent);
+		}
+		return sent;
+#	endif
+	}
+#endif
+} // namespace
+
+control::HttpServer::HttpServer(std::shared_ptr<spdlog::logger> logger) noexcept
+  : m_logger(std::move(logger))
+  , m_poller()
+  , m_listen_fd(-1)
+  , m_accept_paused(false)
+  , m_accept_paused_time()
+  , m_wake_fds{-1, -1}
+  , m_stop(false)
+  , m_library()
+  , m_connections()
+{
+}
+
+void control::HttpServer::setDatabase(std::shared_ptr<const data::Database> database)
+{
+	std::shared_ptr<Library> library;
+	if(database)
+	{
+		library = std::make_shared<Library>();
+		for(const data::Artist& artist: database->artists)
+		{
+			for(const data::Album& album: artist.albums)
+			{
+				for(const data::Music& music: album.musics)
+				{
+					library->musics.emplace(music.id, &music);
+				}
+			}
+		}
+		library->listing = make_listing(*database).dump();
+		library->database = std::move(database);
+		m_logger->info("HTTP server library updated: {} tracks", library->musics.size());
+	}
+	std::atomic_store(&m_library, std::shared_ptr<const Library>(std::move(library)));
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+control::HttpServer::~HttpServer() noexcept
+{
+	for(auto& [fd, connection]: m_connections)
+	{
+		if(connection.file_fd >= 0)
+		{
+			::close(connection.file_fd);
+		}
+		::close(fd);
+	}
+	if(m_listen_fd >= 0)
+	{
+		::close(m_listen_fd);
+	}
+	for(int fd: m_wake_fds)
+	{
+		if(fd >= 0)
+		{
+			::close(fd);
+		}
+	}
+}
+
+bool control::HttpServer::open(const std::string& address, std::uint16_t port)
+{
+	assert(m_listen_fd < 0);
+	if(!m_poller.valid())
+	{
+		m_logger->error("Failed to create the HTTP server poller: {}", std::strerror(errno));
+		return false;
+	}
+	if(::pipe(m_wake_fds) != 0 || !set_flags(m_wake_fds[0]) || !set_flags(m_wake_fds[1])
+	   || !m_poller.add(m_wake_fds[0]))
+	{
+		m_logger->error("Failed to create the HTTP server wake pipe: {}", std::strerror(errno));
+		return false;
+	}
+
+	sockaddr_in socket_address{};
+	socket_address.sin_family = AF_INET;
+	socket_address.sin_port = htons(port);
+	if(::inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1)
+	{
+		m_logger->error("Invalid HTTP server address: {}", address);
+		return false;
+	}
+
+	m_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if(m_listen_fd < 0)
+	{
+		m_logger->error("Failed to create the HTTP server socket: {}", std::strerror(errno));
+		return false;
+	}
+	const int enable = 1;
+	::setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+	const auto* bound_address = reinterpret_cast<const sockaddr*>(&socket_address);
+	if(::bind(m_listen_fd, bound_address, sizeof(socket_address)) != 0
+	   || ::listen(m_listen_fd, SOMAXCONN) != 0 || !set_flags(m_listen_fd)
+	   || !m_poller.add(m_listen_fd))
+	{
+		m_logger->error(
+		  "Failed to listen on HTTP server {}:{}: {}", address, port, std::strerror(errno));
+		::close(m_listen_fd);
+		m_listen_fd = -1;
+		return false;
+	}
+	m_logger->info("HTTP server listening on {}:{}", address, port);
+	return true;
+}
+
+void control::HttpServer::run()
+{
+	assert(m_listen_fd >= 0);
+	std::vector<event_poller::event> events;
+	std::chrono::steady_clock::time_point last_idle_check = std::chrono::steady_clock::now();
+	while(!m_stop.load(std::memory_order_acquire))
+	{
+		int timeout = m_connections.empty() ? -1 : IDLE_CHECK_PERIOD_MS;
+		if(m_accept_paused)
+		{
+			timeout = ACCEPT_RETRY_PERIOD_MS;
+		}
+		if(!m_poller.wait(events, timeout))
+		{
+			m_logger->error("HTTP server event loop failed: {}", std::strerror(errno));
+			break;
+		}
+
+		for(const event_poller::event& event: events)
+		{
+			if(event.fd == m_wake_fds[0])
+			{
+				char buffer[64];
+				while(::read(m_wake_fds[0], buffer, sizeof(buffer)) > 0)
+				{
+				}
+				continue;
+			}
+			if(event.fd == m_listen_fd)
+			{
+				acceptConnections();
+				continue;
+			}
+
+			const auto it = m_connections.find(event.fd);
+			if(it == m_connections.end())
+			{
+				continue;
+			}
+			Connection& connection = it->second;
+			bool open = true;
+			if(event.readable || event.error)
+			{
+				open = readConnection(connection) && handleRequests(connection);
+			}
+			if(open && (!connection.output.empty() || connection.file_fd >= 0))
+			{
+				open = writeConnection(connection);
+			}
+			if(!open)
+			{
+				closeConnection(connection);
+			}
+		}
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(now - last_idle_check >= std::chrono::milliseconds(IDLE_CHECK_PERIOD_MS))
+		{
+			closeIdleConnections(now);
+			last_idle_check = now;
+		}
+		if(m_accept_paused
+		   && now - m_accept_paused_time >= std::chrono::milliseconds(ACCEPT_RETRY_PERIOD_MS))
+		{
+			resumeAccepting();
+		}
+	}
+	SPDLOG_DEBUG(m_logger, "HTTP server stopped");
+}
+
+void control::HttpServer::stop() noexcept
+{
+	m_stop.store(true, std::memory_order_release);
+	if(m_wake_fds[1] >= 0)
+	{
+		const char byte = 0;
+		[[maybe_unused]] const ssize_t written = ::write(m_wake_fds[1], &byte, 1);
+	}
+}
+
+void control::HttpServer::acceptConnections()
+{
+	while(m_connections.size() < MAX_CONNECTIONS)
+	{
+		const int fd = ::accept(m_listen_fd, nullptr, nullptr);
+		if(fd < 0)
+		{
+			if(errno == EMFILE || errno == ENFILE)
+			{
+				// the pending connection would be reported again and again
+				m_logger->warn("HTTP server out of file descriptors, accepting paused");
+				break;
+			}
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				m_logger->warn("Failed to accept HTTP connection: {}", std::strerror(errno));
+			}
+			return;
+		}
+		if(!set_flags(fd) || !m_poller.add(fd))
+		{
+			m_logger->warn("Failed to configure HTTP connection socket: {}", std::strerror(errno));
+			::close(fd);
+			continue;
+		}
+		const int enable = 1;
+		::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+		m_connections.emplace(fd,
+		                      Connection{fd,
+		                                 {},
+		                                 {},
+		                                 0,
+		                                 -1,
+		                                 0,
+		                                 0,
+		                                 true,
+		                                 false,
+		                                 std::chrono::steady_clock::now(),
+		                                 std::chrono::steady_clock::now()});
+		SPDLOG_DEBUG(m_logger, "HTTP connection opened ({} connections)", m_connections.size());
+	}
+
+	// resumed when a connection is closed or after the retry period
+	if(!m_accept_paused)
+	{
+		m_poller.remove(m_listen_fd);
+		m_accept_paused = true;
+	}
+	m_accept_paused_time = std::chrono::steady_clock::now();
+}
+
+void control::HttpServer::resumeAccepting()
+{
+	if(m_poller.add(m_listen_fd))
+	{
+		m_accept_paused = false;
+	}
+	else
+	{
+		m_accept_paused_time = std::chrono::steady_clock::now();
+	}
+}
+
+void control::HttpServer::closeConnection(Connection& connection)
+{
+	const int fd = connection.fd;
+	if(connection.file_fd >= 0)
+	{
+		::close(connection.file_fd);
+	}
+	m_poller.remove(fd);
+	::close(fd);
+	m_connections.erase(fd);
+	SPDLOG_DEBUG(m_logger, "HTTP connection closed ({} connections)", m_connections.size());
+
+	if(m_accept_paused)
+	{
+		resumeAccepting();
+	}
+}
+
+void control::HttpServer::closeIdleConnections(std::chrono::steady_clock::time_point now)
+{
+	std::vector<int> idle;
+	for(const auto& [fd, connection]: m_connections)
+	{
+		const bool responding = !connection.output.empty() || connection.file_fd >= 0;
+		// a client not reading its response can't keep it alive by sending requests
+		if(now - (responding ? connection.last_write : connection.last_activity) > IDLE_TIMEOUT)
+		{
+			idle.push_back(fd);
+		}
+	}
+	for(int fd: idle)
+	{
+		closeConnection(m_connections.at(fd));
+	}
+}
+
+bool control::HttpServer::readConnection(Connection& connection)
+{
+	char buffer[READ_SIZE];
+	for(;;)
+	{
+		const ssize_t count = ::read(connection.fd, buffer, sizeof(buffer));
+		if(count == 0)
+		{
+			return false;
+		}
+		if(count < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		connection.input.append(buffer, static_cast<std::size_t>(count));
+		connection.last_activity = std::chrono::steady_clock::now();
+		if(connection.input.size() > MAX_INPUT_SIZE)
+		{
+			m_logger->warn("HTTP connection sent too many requests, closed");
+			return false;
+		}
+	}
+}
+
+bool control::HttpServer::writeConnection(Connection& connection)
+{
+	std::size_t sent_total = 0;
+	while(sent_total < MAX_SEND_PER_EVENT)
+	{
+		ssize_t sent;
+		if(connection.output_offset < connection.output.size())
+		{
+			sent = send_data(connection.fd,
+			                 connection.output.data() + connection.output_offset,
+			                 connection.output.size() - connection.output_offset,
+			                 connection.file_fd >= 0);
+			if(sent > 0)
+			{
+				connection.output_offset += static_cast<std::size_t>(sent);
+			}
+		}
+		else if(connection.file_fd >= 0)
+		{
+			const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(
+			  connection.file_remaining, MAX_SEND_PER_EVENT - sent_total));
+			sent = send_file(connection.fd, connection.file_fd, connection.file_offset, count);
+			if(sent == 0)
+			{
+				// the file shrank, the announced length can't be honored
+				m_logger->warn("HTTP streamed file truncated, connection closed");
+				return false;
+			}
+			if(sent > 0)
+			{
+				connection.file_remaining -= static_cast<std::uint64_t>(sent);
+				if(connection.file_remaining == 0)
+				{
+					::close(connection.file_fd);
+					connection.file_fd = -1;
+				}
+			}
+		}
+		else
+		{
+			// response complete
+			connection.output.clear();
+			connection.output_offset = 0;
+			if(!connection.keep_alive)
+			{
+				return false;
+			}
+			if(!handleRequests(connection))
+			{
+				return false;
+			}
+			if(connection.output.empty())
+			{
+				break;
+			}
+			continue;
+		}
+
+		if(sent < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			SPDLOG_DEBUG(m_logger, "Failed to write to HTTP connection: {}", std::strerror(errno));
+			return false;
+		}
+		sent_total += static_cast<std::size_t>(sent);
+		connection.last_activity = std::chrono::steady_clock::now();
+		connection.last_write = connection.last_activity;
+	}
+
+	// watched for writing only while a response is in progress
+	const bool watch_writable = !connection.output.empty() || connection.file_fd >= 0;
+	if(watch_writable != connection.watch_writable)
+	{
+		connection.watch_writable = watch_writable;
+		return m_poller.modify(connection.fd, watch_writable);
+	}
+	return true;
+}
+
+bool control::HttpServer::handleRequests(Connection& connection)
+{
+	const bool responding = !connection.output.empty() || connection.file_fd >= 0;
+	// the response to a request is queued once the previous one is sent
+	while(connection.output.empty() && connection.file_fd < 0 && connection.keep_alive)
+	{
+		const std::size_t headers_end = connection.input.find(HEADERS_END);
+		if(headers_end == std::string::npos)
+		{
+			if(connection.input.size() > MAX_HEADER_SIZE)
+			{
+				connection.keep_alive = false;
+				appendResponse(connection, 431, false, "text/plain", "Request too large\n");
+				connection.input.clear();
+			}
+			break;
+		}
+
+		const std::string_view request = std::string_view(connection.input).substr(0, headers_end);
+		const std::size_t request_line_end = std::min(request.find(CRLF), request.size());
+		const std::string_view request_line = request.substr(0, request_line_end);
+		const std::string_view headers =
+		  request.substr(std::min(request_line_end + CRLF.size(), request.size()));
+
+		const std::size_t method_end = request_line.find(' ');
+		const std::size_t target_end = request_line.rfind(' ');
+		const std::string_view version =
+		  target_end == std::string_view::npos ? std::string_view{}
+		                                       : request_line.substr(target_end + 1);
+		if(method_end == std::string_view::npos || method_end == target_end
+		   || (version != "HTTP/1.1" && version != "HTTP/1.0"))
+		{
+			connection.keep_alive = false;
+			appendResponse(connection, 400, false, "text/plain", "Bad request\n");
+			connection.input.clear();
+			break;
+		}
+
+		// HTTP/1.0 connections are closed by default
+		const std::optional<std::string_view> connection_header =
+		  find_header(headers, "Connection");
+		if(version == "HTTP/1.0")
+		{
+			connection.keep_alive =
+			  connection_header && has_token(*connection_header, "keep-alive");
+		}
+		else
+		{
+			connection.keep_alive = !connection_header || !has_token(*connection_header, "close");
+		}
+
+		// served requests have no body, it couldn't be skipped reliably
+		const std::optional<std::string_view> content_length =
+		  find_header(headers, "Content-Length");
+		if(find_header(headers, "Transfer-Encoding")
+		   || (content_length && *content_length != "0"))
+		{
+			connection.keep_alive = false;
+			appendResponse(connection, 400, false, "text/plain", "Request body not supported\n");
+			connection.input.clear();
+			break;
+		}
+
+		handleRequest(connection,
+		              request_line.substr(0, method_end),
+		              request_line.substr(method_end + 1, target_end - method_end - 1),
+		              headers);
+		connection.input.erase(0, headers_end + HEADERS_END.size());
+	}
+	if(!responding && (!connection.output.empty() || connection.file_fd >= 0))
+	{
+		// the send timeout starts with the response
+		connection.last_write = std::chrono::steady_clock::now();
+	}
+	return true;
+}
+
+void control::HttpServer::handleRequest(Connection& connection,
+                                        std::string_view method,
+                                        std::string_view target,
+                                        std::string_view headers)
+{
+	SPDLOG_DEBUG(m_logger, "HTTP request: {} {}", method, target);
+	const bool head = method == "HEAD";
+	if(!head && method != "GET")
+	{
+		appendResponse(
+		  connection, 405, false, "text/plain", "Method not allowed\n", "Allow: GET, HEAD\r\n");
+		return;
+	}
+	target = target.substr(0, target.find('?'));
+
+	if(target == LIBRARY_TARGET)
+	{
+		const std::shared_ptr<const Library> library = std::atomic_load(&m_library);
+		if(!library)
+		{
+			appendResponse(connection, 503, head, "text/plain", "Database not loaded\n");
+			return;
+		}
+		appendResponse(connection,
+		               200,
+		               head,
+		               "application/json",
+		               library->listing,
+		               "Cache-Control: no-cache\r\n");
+		return;
+	}
+	if(target.substr(0, TRACKS_TARGET.size()) == TRACKS_TARGET)
+	{
+		sendTrack(connection, head, target.substr(TRACKS_TARGET.size()), headers);
+		return;
+	}
+	appendResponse(connection, 404, head, "text/plain", "Not found\n");
+}
+
+void control::HttpServer::sendTrack(Connection& connection,
+                                    bool head,
+                                    std::string_view target,
+                                    std::string_view headers)
+{
+	const std::shared_ptr<const Library> library = std::atomic_load(&m_library);
+	if(!library)
+	{
+		appendResponse(connection, 503, head, "text/plain", "Database not loaded\n");
+		return;
+	}
+	const std::optional<std::uint64_t> id = parse_number<std::uint64_t>(target);
+	const auto music = id ? library->musics.find(*id) : library->musics.end();
+	if(music == library->musics.end())
+	{
+		appendResponse(connection, 404, head, "text/plain", "Unknown track\n");
+		return;
+	}
+
+	const std::filesystem::path& path = music->second->path.path();
+	const int file_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat file_stat = {};
+	if(file_fd < 0 || ::fstat(file_fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+	{
+		const int error = errno;
+		m_logger->warn("Failed to open streamed file {}: {}", path, std::strerror(error));
+		if(file_fd >= 0)
+		{
+			::close(file_fd);
+		}
+		const bool busy = error == EMFILE || error == ENFILE;
+		appendResponse(connection,
+		               busy ? 503 : 404,
+		               head,
+		               "text/plain",
+		               busy ? "Too many streams\n" : "Track file not found\n");
+		return;
+	}
+	const auto size = static_cast<std::uint64_t>(file_stat.st_size);
+
+	ByteRange range{0, size - 1};
+	const std::optional<std::string_view> range_header = find_header(headers, "Range");
+	const RangeStatus range_status =
+	  range_header ? parse_range(*range_header, size, range) : RangeStatus::NONE;
+	if(range_status == RangeStatus::UNSATISFIABLE)
+	{
+		::close(file_fd);
+		appendResponse(connection,
+		               416,
+		               head,
+		               "text/plain",
+		               "Range not satisfiable\n",
+		               fmt::format("Content-Range: bytes */{}\r\n", size));
+		return;
+	}
+
+	const std::uint64_t length = size == 0 ? 0 : range.last - range.first + 1;
+	std::string extra_headers = "Accept-Ranges: bytes\r\n";
+	if(range_status == RangeStatus::SATISFIABLE)
+	{
+		extra_headers +=
+		  fmt::format("Content-Range: bytes {}-{}/{}\r\n", range.first, range.last, size);
+	}
+	appendHeaders(connection,
+	              range_status == RangeStatus::SATISFIABLE ? 206 : 200,
+	              content_type(path),
+	              length,
+	              extra_headers);
+
+	if(head || length == 0)
+	{
+		::close(file_fd);
+		return;
+	}
+#	if defined(POSIX_FADV_SEQUENTIAL)
+	::posix_fadvise(
+	  file_fd, static_cast<off_t>(range.first), static_cast<off_t>(length), POSIX_FADV_SEQUENTIAL);
+#	endif
+	connection.file_fd = file_fd;
+	connection.file_offset = range.first;
+	connection.file_remaining = length;
+}
+
+void control::HttpServer::appendHeaders(Connection& connection,
+                                        int status,
+                                        std::string_view content_type,
+                                        std::uint64_t content_length,
+                                        std::string_view extra_headers)
+{
+	connection.output += fmt::format("HTTP/1.1 {} {}\r\n"
+	                                 "Server: MagicPlayer\r\n"
+	                                 "Date: {}\r\n"
+	                                 "Content-Type: {}\r\n"
+	                                 "Content-Length: {}\r\n"
+	                                 "Connection: {}\r\n"
+	                                 "{}\r\n",
+	                                 status,
+	                                 status_text(status),
+	                                 http_date(),
+	                                 content_type,
+	                                 content_length,
+	                                 connection.keep_alive ? "keep-alive" : "close",
+	                                 extra_headers);
+}
+
+void control::HttpServer::appendResponse(Connection& connection,
+                                         int status,
+                                         bool head,
+                                         std::string_view content_type,
+                                         std::string_view body,
+                                         std::string_view extra_headers)
+{
+	appendHeaders(connection, status, content_type, body.size(), extra_headers);
+	if(!head)
+	{
+		connection.output += body;
+	}
+}
+
+#else
+
+control::HttpServer::~HttpServer() noexcept = default;
+
+bool control::HttpServer::open([[maybe_unused]] const std::string& address,
+                               [[maybe_unused]] std::uint16_t port)
+{
+	m_logger->error("HTTP server not supported on this platform");
+	return false;
+}
+
+void control::HttpServer::run()
+{
+}
+
+void control::HttpServer::stop() noexcept
+{
+}
+
+#endif
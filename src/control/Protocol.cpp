@@ -0,0 +1,308 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "control/Protocol.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace
+{
+	const nlohmann::json* find_member(const nlohmann::json& request, const char* name)
+	{
+		const auto it = request.find(name);
+		return it == request.end() ? nullptr : &*it;
+	}
+
+	std::optional<utf8_path> get_path(const nlohmann::json& request, std::string& error)
+	{
+		const nlohmann::json* path = find_member(request, "path");
+		if(path == nullptr || !path->is_string())
+		{
+			error = "missing path";
+			return std::nullopt;
+		}
+		utf8_path result = path->get<std::string>();
+		if(!result.valid_encoding())
+		{
+			error = "invalid utf8 path";
+			return std::nullopt;
+		}
+		return result;
+	}
+
+	const char* status_name(sf::SoundSource::Status status) noexcept
+	{
+		switch(status)
+		{
+			case sf::SoundSource::Playing:
+				return "playing";
+			case sf::SoundSource::Paused:
+				return "paused";
+			case sf::SoundSource::Stopped:
+				break;
+		}
+		return "stopped";
+	}
+
+	nlohmann::json histogram_to_json(const latency_histogram::summary& summary)
+	{
+		return {{"count", summary.count},
+		        {"mean", summary.mean()},
+		        {"p50", summary.percentile(0.5)},
+		        {"p99", summary.percentile(0.99)},
+		        {"p999", summary.percentile(0.999)},
+		        {"max", summary.max}};
+	}
+
+	nlohmann::json to_json_impl(const Msg::Out::MusicInfo& message)
+	{
+		return {{"valid", message.valid},
+		        {"duration_seconds", message.durationSeconds},
+		        {"zone", message.zone}};
+	}
+
+	nlohmann::json to_json_impl(const Msg::Out::FolderContent& message)
+	{
+		nlohmann::json content = nlohmann::json::array();
+		for(const PathInfo& info: message.content)
+		{
+			content.push_back({{"path", info.path.str()},
+			                   {"folder", info.is_folder},
+			                   {"size", info.file_size},
+			                   {"audio", info.has_supported_audio_extension}});
+		}
+		return {{"path", message.path.str()}, {"content", std::move(content)}};
+	}
+
+	nlohmann::json to_json_impl(const Msg::Out::Database& message)
+	{
+		// summary only, the database can hold hundreds of thousands of musics
+		std::vector<std::string> sources;
+		sources.reserve(message.database->sources.size());
+		for(const utf8_path& source: message.database->sources)
+		{
+			sources.emplace_back(source.str());
+		}
+		std::size_t album_count = 0;
+		std::size_t music_count = 0;
+		for(const data::Artist& artist: message.database->artists)
+		{
+			album_count += artist.albums.size();
+			for(const data::Album& album: artist.albums)
+			{
+				music_count += album.musics.size();
+			}
+		}
+		return {{"id", message.database->id},
+		        {"sources", std::move(sources)},
+		        {"artists", message.database->artists.size()},
+		        {"albums", album_count},
+		        {"musics", music_count}};
+	}
+
+	nlohmann::json to_json_impl(const Msg::Out::Settings& message)
+	{
+		return {{"settings", data::settings_to_json(message.settings)}};
+	}
+
+	nlohmann::json to_json_impl(const Msg::Out::Waveform& message)
+	{
+		// the bins are only useful to a view, clients are told the overview is ready
+		return {{"fingerprint", message.waveform->fingerprint},
+		        {"total_frames", message.waveform->total_frames},
+		        {"complete", message.waveform->complete}};
+	}
+} // namespace
+
+std::optional<std::size_t> control::event_index(std::string_view name) noexcept
+{
+	const auto it = std::find(std::begin(EVENT_NAMES), std::end(EVENT_NAMES), name);
+	if(it == std::end(EVENT_NAMES))
+	{
+		return std::nullopt;
+	}
+	return static_cast<std::size_t>(std::distance(std::begin(EVENT_NAMES), it));
+}
+
+std::optional<Msg::ZoneId> control::parse_zone(const nlohmann::json& request,
+                                               std::string& error)
+{
+	const nlohmann::json* zone = request.is_object() ? find_member(request, "zone") : nullptr;
+	if(zone == nullptr)
+	{
+		return Msg::MAIN_ZONE;
+	}
+	if(!zone->is_number_unsigned() || zone->get<std::uint64_t>() >= Msg::MAX_ZONES)
+	{
+		error = "invalid zone";
+		return std::nullopt;
+	}
+	return static_cast<Msg::ZoneId>(zone->get<std::uint64_t>());
+}
+
+std::optional<Msg::Com::InMessage> control::parse_request(const nlohmann::json& request,
+                                                          std::string& error)
+{
+	using Msg::Com;
+	if(!request.is_object())
+	{
+		error = "request is not an object";
+		return std::nullopt;
+	}
+	const nlohmann::json* type_json = find_member(request, "type");
+	if(type_json == nullptr || !type_json->is_string())
+	{
+		error = "missing request type";
+		return std::nullopt;
+	}
+	const std::string& type = type_json->get_ref<const std::string&>();
+
+	if(type == "close")
+	{
+		return Com::InMessage(std::in_place_type_t<Msg::In::Close>{});
+	}
+	if(type == "open" || type == "enqueue")
+	{
+		std::optional<utf8_path> path = get_path(request, error);
+		const std::optional<Msg::ZoneId> zone = parse_zone(request, error);
+		if(!path || !zone)
+		{
+			return std::nullopt;
+		}
+		if(type == "open")
+		{
+			return Com::InMessage(std::in_place_type_t<Msg::In::Open>{}, std::move(*path), *zone);
+		}
+		return Com::InMessage(std::in_place_type_t<Msg::In::Enqueue>{}, std::move(*path), *zone);
+	}
+	if(type == "control")
+	{
+		const nlohmann::json* action = find_member(request, "action");
+		if(action == nullptr || !action->is_string())
+		{
+			error = "missing control action";
+			return std::nullopt;
+		}
+		const std::optional<Msg::ZoneId> zone = parse_zone(request, error);
+		if(!zone)
+		{
+			return std::nullopt;
+		}
+		const std::string& action_str = action->get_ref<const std::string&>();
+		using Action = Msg::In::Control::Action;
+		if(action_str == "play")
+		{
+			return Com::InMessage(std::in_place_type_t<Msg::In::Control>{}, Action::PLAY, *zone);
+		}
+		if(action_str == "pause")
+		{
+			return Com::InMessage(std::in_place_type_t<Msg::In::Control>{}, Action::PAUSE, *zone);
+		}
+		if(action_str == "stop")
+		{
+			return Com::InMessage(std::in_place_type_t<Msg::In::Control>{}, Action::STOP, *zone);
+		}
+		error = "unknown control action";
+		return std::nullopt;
+	}
+	if(type == "volume")
+	{
+		const nlohmann::json* volume = find_member(request, "volume");
+		const nlohmann::json* muted = find_member(request, "muted");
+		if(volume == nullptr || !volume->is_number() || (muted != nullptr && !muted->is_boolean()))
+		{
+			error = "invalid volume";
+			return std::nullopt;
+		}
+		const std::optional<Msg::ZoneId> zone = parse_zone(request, error);
+		if(!zone)
+		{
+			return std::nullopt;
+		}
+		return Com::InMessage(std::in_place_type_t<Msg::In::Volume>{},
+		                      muted != nullptr && muted->get<bool>(),
+		                      volume->get<float>(),
+		                      *zone);
+	}
+	if(type == "music_offset")
+	{
+		const nlohmann::json* seconds = find_member(request, "seconds");
+		if(seconds == nullptr || !seconds->is_number() || seconds->get<float>() < 0)
+		{
+			error = "invalid music offset";
+			return std::nullopt;
+		}
+		const std::optional<Msg::ZoneId> zone = parse_zone(request, error);
+		if(!zone)
+		{
+			return std::nullopt;
+		}
+		return Com::InMessage(
+		  std::in_place_type_t<Msg::In::MusicOffset>{}, seconds->get<float>(), *zone);
+	}
+	if(type == "settings")
+	{
+		const nlohmann::json* settings = find_member(request, "settings");
+		const nlohmann::json* save = find_member(request, "save");
+		if(settings == nullptr || !settings->is_object()
+		   || (save != nullptr && !save->is_boolean()))
+		{
+			error = "invalid settings";
+			return std::nullopt;
+		}
+		return Com::InMessage(std::in_place_type_t<Msg::In::Settings>{},
+		                      data::settings_from_json(*settings, spdlog::get(CONTROL_LOGGER_NAME)),
+		                      save == nullptr || save->get<bool>());
+	}
+	if(type == "request_database")
+	{
+		const nlohmann::json* generate_new = find_member(request, "generate_new");
+		if(generate_new != nullptr && !generate_new->is_boolean())
+		{
+			error = "invalid database request";
+			return std::nullopt;
+		}
+		return Com::InMessage(std::in_place_type_t<Msg::In::RequestDatabase>{},
+		                      generate_new != nullptr && generate_new->get<bool>());
+	}
+
+	error = "unknown request type";
+	return std::nullopt;
+}
+
+nlohmann::json control::to_json(const Msg::Com::OutMessage& message)
+{
+	nlohmann::json json =
+	  std::visit([](const auto& message_) { return to_json_impl(message_); }, message);
+	json["event"] = EVENT_NAMES[message.index()];
+	return json;
+}
+
+nlohmann::json control::to_json(const audio::PlaybackState::Snapshot& state,
+                                std::chrono::steady_clock::time_point now)
+{
+	return {{"track_id", state.track_id},
+	        {"status", status_name(state.status)},
+	        {"position_seconds", state.positionSeconds(now)}};
+}
+
+nlohmann::json control::to_json(const std::vector<Msg::tracing::Entry>& entries)
+{
+	nlohmann::json json = nlohmann::json::array();
+	for(const Msg::tracing::Entry& entry: entries)
+	{
+		json.push_back(
+		  {{"direction", entry.direction == Msg::tracing::Direction::IN ? "in" : "out"},
+		   {"type", entry.type},
+		   {"depth", histogram_to_json(entry.depth)},
+		   {"wait_ns", histogram_to_json(entry.wait)},
+		   {"handler_ns", histogram_to_json(entry.handler)}});
+	}
+	return json;
+}
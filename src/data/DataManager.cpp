@@ -6,13 +6,14 @@
 // https://opensource.org/licenses/MIT
 //
 #include "data/DataManager.hpp"
+#include "audio/decoders/Registry.hpp"
 #include "utils/log.hpp"
-#include "utils/audio_extensions.hpp"
 
 #include <spdlog/spdlog.h>
 #include <taglib/tag.h>
 #include <taglib/fileref.h>
 
+#include <algorithm>
 #include <queue>
 #include <future>
 
@@ -221,11 +222,13 @@ bool data::DataManager::loadMusicFromFile(const std::filesystem::path& file_path
                                           std::shared_ptr<data::Database>& database,
                                           Cache& cache)
 {
-	if(!hasSupportedAudioExtension(file_path))
+	// the content is probed by the same registry as the playback, whatever the extension
+	const audio::decoders::Format format = audio::decoders::Registry::get().probe(file_path);
+	if(format == audio::decoders::Format::UNKNOWN)
 	{
 		return true;
 	}
-	SPDLOG_TRACE(m_logger, "Database generation: processing file {}", file_path);
+	SPDLOG_TRACE(m_logger, "Database generation: processing {} file {}", format, file_path);
 
 	TagLib::FileRef fileref(file_path.native().c_str());
 	if(fileref.isNull())
@@ -8,31 +8,35 @@
 #include "data/Database.hpp"
 #include "utils/IdGenerator.hpp"
 
+#include <algorithm>
 #include <cassert>
 
 data::Database::Database() noexcept: id(), sources(), artists()
 {
 }
 
-std::vector<const data::Music*> data::Database::findMusics(std::uint64_t search_id) const noexcept
+std::vector<const data::Music*> data::Database::musics() const noexcept
 {
-	assert(search_id != IdGenerator::INVALID_ID);
 	std::vector<const data::Music*> found_musics;
-
-	if(search_id == id)
+	for(const Artist& artist: artists)
 	{
-		// return all musics of the database
-		for(const Artist& artist: artists)
+		for(const Album& album: artist.albums)
 		{
-			for(const Album& album: artist.albums)
+			for(const Music& music: album.musics)
 			{
-				for(const Music& music: album.musics)
-				{
-					found_musics.push_back(&music);
-				}
+				found_musics.push_back(&music);
 			}
 		}
-		return found_musics;
+	}
+	return found_musics;
+}
+
+std::vector<const data::Music*> data::Database::findMusics(std::uint64_t search_id) const noexcept
+{
+	assert(search_id != IdGenerator::INVALID_ID);
+	if(search_id == id)
+	{
+		return musics();
 	}
 
 	// search artist
@@ -43,8 +47,26 @@ std::vector<const data::Music*> data::Database::findMusics(std::uint64_t search_
 	  [](const Artist& artist, std::uint64_t wanted_id) { return artist.id < wanted_id; });
 	if(it == artists.cend())
 	{
-		return found_musics;
+		return {};
 	}
 
 	return it->findMusics(search_id);
 }
+
+const data::Music* data::Database::findMusic(const utf8_path& path) const noexcept
+{
+	for(const Artist& artist: artists)
+	{
+		for(const Album& album: artist.albums)
+		{
+			for(const Music& music: album.musics)
+			{
+				if(music.path.str_cref() == path.str_cref())
+				{
+					return &music;
+				}
+			}
+		}
+	}
+	return nullptr;
+}
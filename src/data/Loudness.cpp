@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "data/Loudness.hpp"
+#include "utils/log.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+namespace
+{
+	constexpr const char* LOUDNESS_FILE_PATH = "MagicPlayer_loudness.json";
+	constexpr const char* LOUDNESS_TEMPORARY_FILE_PATH = "MagicPlayer_loudness.json.tmp";
+
+	// Digital silence isn't amplified more than this
+	constexpr float MAX_NORMALIZATION_GAIN_DB = 24.f;
+} // namespace
+
+std::ostream& data::operator<<(std::ostream& os, const TrackLoudness& loudness)
+{
+	return os << "TrackLoudness{"
+	          << "file_size: " << loudness.file_size << ","
+	          << "modification_time: " << loudness.modification_time << ","
+	          << "integrated_lufs: " << loudness.integrated_lufs << ","
+	          << "true_peak_db: " << loudness.true_peak_db << ","
+	          << "duration_seconds: " << loudness.duration_seconds << "}";
+}
+
+bool data::get_file_signature(const utf8_path& path,
+                              std::uintmax_t& file_size,
+                              std::int64_t& modification_time) noexcept
+{
+	std::error_code error;
+	file_size = std::filesystem::file_size(path.path(), error);
+	if(error)
+	{
+		return false;
+	}
+	const std::filesystem::file_time_type time =
+	  std::filesystem::last_write_time(path.path(), error);
+	if(error)
+	{
+		return false;
+	}
+	modification_time = static_cast<std::int64_t>(time.time_since_epoch().count());
+	return true;
+}
+
+bool data::get_file_fingerprint(const utf8_path& path, std::uint64_t& fingerprint) noexcept
+{
+	std::uintmax_t file_size;
+	std::int64_t modification_time;
+	if(!get_file_signature(path, file_size, modification_time))
+	{
+		return false;
+	}
+
+	// FNV-1a
+	constexpr std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	constexpr std::uint64_t FNV_PRIME = 1099511628211ull;
+	fingerprint = FNV_OFFSET_BASIS;
+	const auto hash = [&fingerprint](const void* data, std::size_t size) noexcept {
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		for(std::size_t i = 0; i < size; ++i)
+		{
+			fingerprint = (fingerprint ^ bytes[i]) * FNV_PRIME;
+		}
+	};
+	hash(path.str_cref().data(), path.str_cref().size());
+	hash(&file_size, sizeof(file_size));
+	hash(&modification_time, sizeof(modification_time));
+	return true;
+}
+
+data::TrackLoudness data::combine_loudness(const std::vector<TrackLoudness>& tracks) noexcept
+{
+	TrackLoudness combined{0, 0, 0, -std::numeric_limits<double>::infinity(), 0};
+	double energy = 0;
+	for(const TrackLoudness& track: tracks)
+	{
+		energy += std::pow(10.0, track.integrated_lufs / 10) * track.duration_seconds;
+		combined.duration_seconds += track.duration_seconds;
+		combined.true_peak_db = std::max(combined.true_peak_db, track.true_peak_db);
+	}
+	if(combined.duration_seconds <= 0 || energy <= 0)
+	{
+		return tracks.empty() ? combined : tracks.front();
+	}
+	combined.integrated_lufs = 10 * std::log10(energy / combined.duration_seconds);
+	return combined;
+}
+
+float data::normalization_gain_db(const TrackLoudness& loudness, float preamp_db) noexcept
+{
+	const double gain = REFERENCE_LOUDNESS_LUFS + preamp_db - loudness.integrated_lufs;
+	return static_cast<float>(
+	  std::min({gain, -loudness.true_peak_db, static_cast<double>(MAX_NORMALIZATION_GAIN_DB)}));
+}
+
+data::LoudnessDatabase::LoudnessDatabase() noexcept: m_mutex(), m_tracks()
+{
+}
+
+std::optional<data::TrackLoudness> data::LoudnessDatabase::find(const utf8_path& path) const
+{
+	std::uintmax_t file_size;
+	std::int64_t modification_time;
+	if(!get_file_signature(path, file_size, modification_time))
+	{
+		return std::nullopt;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_tracks.find(path.str_cref());
+	if(it == m_tracks.end() || it->second.file_size != file_size
+	   || it->second.modification_time != modification_time)
+	{
+		return std::nullopt;
+	}
+	return it->second;
+}
+
+bool data::LoudnessDatabase::contains(const utf8_path& path,
+                                      std::uintmax_t file_size,
+                                      std::int64_t modification_time) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_tracks.find(path.str_cref());
+	return it != m_tracks.end() && it->second.file_size == file_size
+	       && it->second.modification_time == modification_time;
+}
+
+void data::LoudnessDatabase::insert(const utf8_path& path, const TrackLoudness& loudness)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_tracks[path.str_cref()] = loudness;
+}
+
+std::size_t data::LoudnessDatabase::size() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_tracks.size();
+}
+
+bool data::LoudnessDatabase::save(const std::shared_ptr<spdlog::logger>& logger) const noexcept
+{
+	nlohmann::json tracks_json = nlohmann::json::object();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for(const auto& [path, loudness]: m_tracks)
+		{
+			tracks_json[path] = {{"file_size", loudness.file_size},
+			                     {"modification_time", loudness.modification_time},
+			                     {"integrated_lufs", loudness.integrated_lufs},
+			                     {"true_peak_db", loudness.true_peak_db},
+			                     {"duration_seconds", loudness.duration_seconds}};
+		}
+	}
+	nlohmann::json loudness_json;
+	loudness_json["tracks"] = std::move(tracks_json);
+
+	// write a temporary file first: an interrupted save keeps the previous results
+	{
+		std::ofstream file_stream(LOUDNESS_TEMPORARY_FILE_PATH);
+		if(!file_stream)
+		{
+			SPDLOG_DEBUG(
+			  logger, "Invalid std::ofstream constructed with: {}", LOUDNESS_TEMPORARY_FILE_PATH);
+			logger->warn("Failed to save loudness analysis results");
+			return false;
+		}
+		file_stream << std::setfill('\t') << std::setw(1) << loudness_json << std::endl;
+		if(!file_stream)
+		{
+			logger->warn("Failed to save loudness analysis results");
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(LOUDNESS_TEMPORARY_FILE_PATH, LOUDNESS_FILE_PATH, error);
+	if(error)
+	{
+		SPDLOG_DEBUG(logger, "std::filesystem::rename failed: {}", error.message());
+		logger->warn("Failed to save loudness analysis results");
+		return false;
+	}
+	SPDLOG_DEBUG(
+	  logger, "Saved loudness analysis results of {} tracks", loudness_json["tracks"].size());
+	return true;
+}
+
+void data::LoudnessDatabase::load(const std::shared_ptr<spdlog::logger>& logger) noexcept
+{
+	std::ifstream file_stream(LOUDNESS_FILE_PATH);
+	if(!file_stream)
+	{
+		SPDLOG_DEBUG(logger, "Invalid std::ifstream constructed with: {}", LOUDNESS_FILE_PATH);
+		logger->info("No saved loudness analysis results");
+		return;
+	}
+	const nlohmann::json loudness_json = nlohmann::json::parse(file_stream, nullptr, false);
+	const auto tracks_json = loudness_json.find("tracks");
+	if(loudness_json.is_discarded() || tracks_json == loudness_json.end()
+	   || !tracks_json->is_object())
+	{
+		logger->warn("Invalid saved loudness analysis results, tracks will be analyzed again");
+		return;
+	}
+
+	std::size_t invalid_entries = 0;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(auto it = tracks_json->cbegin(); it != tracks_json->cend(); ++it)
+	{
+		const nlohmann::json& track_json = it.value();
+		const auto file_size = track_json.find("file_size");
+		const auto modification_time = track_json.find("modification_time");
+		const auto integrated_lufs = track_json.find("integrated_lufs");
+		const auto true_peak_db = track_json.find("true_peak_db");
+		const auto duration_seconds = track_json.find("duration_seconds");
+		if(!track_json.is_object() || file_size == track_json.end()
+		   || !file_size->is_number_unsigned() || modification_time == track_json.end()
+		   || !modification_time->is_number_integer() || integrated_lufs == track_json.end()
+		   || !integrated_lufs->is_number() || true_peak_db == track_json.end()
+		   || !true_peak_db->is_number() || duration_seconds == track_json.end()
+		   || !duration_seconds->is_number())
+		{
+			++invalid_entries;
+			continue;
+		}
+		m_tracks[it.key()] = {file_size->get<std::uintmax_t>(),
+		                      modification_time->get<std::int64_t>(),
+		                      integrated_lufs->get<double>(),
+		                      true_peak_db->get<double>(),
+		                      duration_seconds->get<double>()};
+	}
+	if(invalid_entries != 0)
+	{
+		logger->warn("Ignored {} invalid saved loudness analysis results", invalid_entries);
+	}
+	logger->info("Loaded loudness analysis results of {} tracks", m_tracks.size());
+}
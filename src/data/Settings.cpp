@@ -11,17 +11,150 @@
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iomanip>
 
 namespace
 {
 	constexpr const char* DEFAULT_EXPLORER_FOLDER = "./";
+	constexpr float DEFAULT_DECODE_AHEAD_SECONDS = 10.f;
+	constexpr unsigned int DEFAULT_PCM_CACHE_MEGABYTES = 512;
+	constexpr float DEFAULT_CROSSFADE_SECONDS = 0.f;
+	constexpr data::CrossfadeCurve DEFAULT_CROSSFADE_CURVE = data::CrossfadeCurve::EQUAL_POWER;
+	constexpr unsigned int DEFAULT_OUTPUT_SAMPLE_RATE = 48000;
+	constexpr bool DEFAULT_EQUALIZER_ENABLED = false;
+	constexpr bool DEFAULT_LIMITER_ENABLED = true;
+	constexpr float DEFAULT_LIMITER_THRESHOLD_DB = -1.f;
+	constexpr data::VolumeNormalization DEFAULT_VOLUME_NORMALIZATION =
+	  data::VolumeNormalization::TRACK;
+	constexpr float DEFAULT_NORMALIZATION_PREAMP_DB = 0.f;
+	constexpr float MIN_EQUALIZER_FREQUENCY = 20.f;
+	constexpr float MAX_EQUALIZER_FREQUENCY = 20000.f;
+	constexpr float MIN_EQUALIZER_Q = 0.1f;
+	constexpr float MAX_EQUALIZER_Q = 10.f;
+
+	std::vector<data::EqualizerBand> default_equalizer_bands()
+	{
+		using Type = data::EqualizerBand::Type;
+		return {
+		  {Type::LOW_SHELF, 60.f, 0.f, 0.707f},
+		  {Type::PEAK, 230.f, 0.f, 1.f},
+		  {Type::PEAK, 910.f, 0.f, 1.f},
+		  {Type::PEAK, 3600.f, 0.f, 1.f},
+		  {Type::HIGH_SHELF, 14000.f, 0.f, 0.707f},
+		};
+	}
+
+	bool load_equalizer_band(const nlohmann::json& band_json, data::EqualizerBand& band)
+	{
+		if(!band_json.is_object())
+		{
+			return false;
+		}
+		const auto type = band_json.find("type");
+		const auto frequency = band_json.find("frequency");
+		const auto gain_db = band_json.find("gain_db");
+		const auto q = band_json.find("q");
+		if(type == band_json.end() || !type->is_number_integer() || frequency == band_json.end()
+		   || !frequency->is_number() || gain_db == band_json.end() || !gain_db->is_number()
+		   || q == band_json.end() || !q->is_number())
+		{
+			return false;
+		}
+		if(type->get<int>() < static_cast<int>(data::EqualizerBand::Type::LOW_SHELF)
+		   || type->get<int>() > static_cast<int>(data::EqualizerBand::Type::HIGH_SHELF))
+		{
+			return false;
+		}
+		band.type = static_cast<data::EqualizerBand::Type>(type->get<int>());
+		band.frequency =
+		  std::clamp(frequency->get<float>(), MIN_EQUALIZER_FREQUENCY, MAX_EQUALIZER_FREQUENCY);
+		band.gain_db = std::clamp(gain_db->get<float>(),
+		                          -data::Settings::MAX_EQUALIZER_GAIN_DB,
+		                          data::Settings::MAX_EQUALIZER_GAIN_DB);
+		band.q = std::clamp(q->get<float>(), MIN_EQUALIZER_Q, MAX_EQUALIZER_Q);
+		return true;
+	}
 	constexpr const char* SETTINGS_FILE_PATH = "MagicPlayer_settings.json";
 } // namespace
 
-data::Settings::Settings() noexcept: explorer_folder(DEFAULT_EXPLORER_FOLDER)
+data::Settings::Settings() noexcept
+  : explorer_folder(DEFAULT_EXPLORER_FOLDER)
+  , music_sources()
+  , decode_ahead_seconds(DEFAULT_DECODE_AHEAD_SECONDS)
+  , pcm_cache_megabytes(DEFAULT_PCM_CACHE_MEGABYTES)
+  , crossfade_seconds(DEFAULT_CROSSFADE_SECONDS)
+  , crossfade_curve(DEFAULT_CROSSFADE_CURVE)
+  , output_sample_rate(DEFAULT_OUTPUT_SAMPLE_RATE)
+  , equalizer_enabled(DEFAULT_EQUALIZER_ENABLED)
+  , equalizer_bands(default_equalizer_bands())
+  , limiter_enabled(DEFAULT_LIMITER_ENABLED)
+  , limiter_threshold_db(DEFAULT_LIMITER_THRESHOLD_DB)
+  , volume_normalization(DEFAULT_VOLUME_NORMALIZATION)
+  , normalization_preamp_db(DEFAULT_NORMALIZATION_PREAMP_DB)
+{
+}
+
+std::ostream& data::operator<<(std::ostream& os, const EqualizerBand::Type& type)
+{
+	switch(type)
+	{
+		case EqualizerBand::Type::LOW_SHELF:
+			os << "LOW_SHELF";
+			break;
+		case EqualizerBand::Type::PEAK:
+			os << "PEAK";
+			break;
+		case EqualizerBand::Type::HIGH_SHELF:
+			os << "HIGH_SHELF";
+			break;
+	}
+	return os;
+}
+
+std::ostream& data::operator<<(std::ostream& os, const EqualizerBand& band)
 {
+	return os << "EqualizerBand{"
+	          << "type: " << band.type << ","
+	          << "frequency: " << band.frequency << ","
+	          << "gain_db: " << band.gain_db << ","
+	          << "q: " << band.q << "}";
+}
+
+std::ostream& data::operator<<(std::ostream& os, const CrossfadeCurve& curve)
+{
+	switch(curve)
+	{
+		case CrossfadeCurve::LINEAR:
+			os << "LINEAR";
+			break;
+		case CrossfadeCurve::EQUAL_POWER:
+			os << "EQUAL_POWER";
+			break;
+		case CrossfadeCurve::LOGARITHMIC:
+			os << "LOGARITHMIC";
+			break;
+	}
+	return os;
+}
+
+std::ostream& data::operator<<(std::ostream& os, const VolumeNormalization& normalization)
+{
+	switch(normalization)
+	{
+		case VolumeNormalization::OFF:
+			os << "OFF";
+			break;
+		case VolumeNormalization::TRACK:
+			os << "TRACK";
+			break;
+		case VolumeNormalization::ALBUM:
+			os << "ALBUM";
+			break;
+	}
+	return os;
 }
 
 std::ostream& data::operator<<(std::ostream& os, const Settings& settings)
@@ -33,14 +166,29 @@ std::ostream& data::operator<<(std::ostream& os, const Settings& settings)
 	{
 		os << source << ",";
 	}
-	os << "]}";
+	os << "],"
+	   << "decode_ahead_seconds: " << settings.decode_ahead_seconds << ","
+	   << "pcm_cache_megabytes: " << settings.pcm_cache_megabytes << ","
+	   << "crossfade_seconds: " << settings.crossfade_seconds << ","
+	   << "crossfade_curve: " << settings.crossfade_curve << ","
+	   << "output_sample_rate: " << settings.output_sample_rate << ","
+	   << "equalizer_enabled: " << settings.equalizer_enabled << ","
+	   << "equalizer_bands: [";
+	for(const auto& band: settings.equalizer_bands)
+	{
+		os << band << ",";
+	}
+	os << "],"
+	   << "limiter_enabled: " << settings.limiter_enabled << ","
+	   << "limiter_threshold_db: " << settings.limiter_threshold_db << ","
+	   << "volume_normalization: " << settings.volume_normalization << ","
+	   << "normalization_preamp_db: " << settings.normalization_preamp_db << "}";
 	return os;
 }
 
 bool data::saveSettings(data::Settings& settings,
                         const std::shared_ptr<spdlog::logger>& logger) noexcept
 {
-	nlohmann::json settings_json;
 	std::error_code error;
 	utf8_path path = std::filesystem::canonical(settings.explorer_folder.path(), error);
 	if(error)
@@ -56,12 +204,9 @@ bool data::saveSettings(data::Settings& settings,
 	}
 	else
 	{
-		settings_json["explorer_folder"] = path.str();
 		settings.explorer_folder = std::move(path); // apply canonical to settings in memory
 	}
 
-	std::vector<std::string> music_sources_str;
-	music_sources_str.reserve(settings.music_sources.size());
 	for(utf8_path& music_source: settings.music_sources)
 	{
 		path = std::filesystem::canonical(music_source.path(), error);
@@ -79,11 +224,10 @@ bool data::saveSettings(data::Settings& settings,
 		}
 		else
 		{
-			music_sources_str.emplace_back(path.str());
 			music_source = std::move(path); // apply canonical to settings in memory
 		}
 	}
-	settings_json["music_sources"] = std::move(music_sources_str);
+	const nlohmann::json settings_json = settings_to_json(settings);
 
 	std::ofstream file_stream(SETTINGS_FILE_PATH);
 	if(!file_stream)
@@ -98,29 +242,75 @@ bool data::saveSettings(data::Settings& settings,
 	return true;
 }
 
+nlohmann::json data::settings_to_json(const Settings& settings)
+{
+	nlohmann::json settings_json;
+	if(settings.explorer_folder.valid_encoding())
+	{
+		settings_json["explorer_folder"] = settings.explorer_folder.str();
+	}
+	std::vector<std::string> music_sources_str;
+	music_sources_str.reserve(settings.music_sources.size());
+	for(const utf8_path& music_source: settings.music_sources)
+	{
+		if(music_source.valid_encoding())
+		{
+			music_sources_str.emplace_back(music_source.str());
+		}
+	}
+	settings_json["music_sources"] = std::move(music_sources_str);
+	settings_json["decode_ahead_seconds"] = settings.decode_ahead_seconds;
+	settings_json["pcm_cache_megabytes"] = settings.pcm_cache_megabytes;
+	settings_json["crossfade_seconds"] = settings.crossfade_seconds;
+	settings_json["crossfade_curve"] = static_cast<int>(settings.crossfade_curve);
+	settings_json["output_sample_rate"] = settings.output_sample_rate;
+	settings_json["equalizer_enabled"] = settings.equalizer_enabled;
+	nlohmann::json equalizer_bands_json = nlohmann::json::array();
+	for(const EqualizerBand& band: settings.equalizer_bands)
+	{
+		equalizer_bands_json.push_back({{"type", static_cast<int>(band.type)},
+		                                {"frequency", band.frequency},
+		                                {"gain_db", band.gain_db},
+		                                {"q", band.q}});
+	}
+	settings_json["equalizer_bands"] = std::move(equalizer_bands_json);
+	settings_json["limiter_enabled"] = settings.limiter_enabled;
+	settings_json["limiter_threshold_db"] = settings.limiter_threshold_db;
+	settings_json["volume_normalization"] = static_cast<int>(settings.volume_normalization);
+	settings_json["normalization_preamp_db"] = settings.normalization_preamp_db;
+	return settings_json;
+}
+
 data::Settings data::loadSettings(const std::shared_ptr<spdlog::logger>& logger) noexcept
 {
 	// Load json
-	data::Settings settings;
 	nlohmann::json settings_json;
 	std::ifstream file_stream(SETTINGS_FILE_PATH);
 	if(!file_stream)
 	{
 		SPDLOG_DEBUG(logger, "Invalid std::ifstream constructed with: {}", SETTINGS_FILE_PATH);
 		logger->info("Failed to load saved settings, default settings will be used");
-		return settings;
+		return data::Settings{};
 	}
 	file_stream >> settings_json;
 	if(settings_json.empty())
 	{
 		logger->warn("Invalid saved settings, default settings will be used");
-		return settings;
+		return data::Settings{};
 	}
 
+	return settings_from_json(settings_json, logger);
+}
+
+data::Settings data::settings_from_json(const nlohmann::json& settings_json,
+                                        const std::shared_ptr<spdlog::logger>& logger) noexcept
+{
+	data::Settings settings;
+
 	// Load explorer folder
 	utf8_path explorer_folder;
 	bool loaded_explorer_folder = false;
-	nlohmann::json::iterator it = settings_json.find("explorer_folder");
+	nlohmann::json::const_iterator it = settings_json.find("explorer_folder");
 	if(it == settings_json.end())
 	{
 		logger->info("Failed to load saved explorer folder path, default path will be used");
@@ -202,6 +392,240 @@ data::Settings data::loadSettings(const std::shared_ptr<spdlog::logger>& logger)
 		}
 	}
 
+	it = settings_json.find("decode_ahead_seconds");
+	if(it != settings_json.end())
+	{
+		if(!it->is_number())
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for decode ahead duration, default value will be used");
+		}
+		else
+		{
+			const float decode_ahead_seconds = it->get<float>();
+			settings.decode_ahead_seconds = std::clamp(decode_ahead_seconds,
+			                                           Settings::MIN_DECODE_AHEAD_SECONDS,
+			                                           Settings::MAX_DECODE_AHEAD_SECONDS);
+			if(settings.decode_ahead_seconds != decode_ahead_seconds)
+			{
+				logger->warn("Saved decode ahead duration out of range: {:.2f}s, clamped to {:.2f}s",
+				             decode_ahead_seconds,
+				             settings.decode_ahead_seconds);
+			}
+			SPDLOG_DEBUG(logger,
+			             "Loaded decode ahead duration from saved settings: {:.2f}s",
+			             settings.decode_ahead_seconds);
+		}
+	}
+
+	it = settings_json.find("pcm_cache_megabytes");
+	if(it != settings_json.end())
+	{
+		if(!it->is_number_unsigned())
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for decoded audio cache size, default value will be used");
+		}
+		else
+		{
+			const auto pcm_cache_megabytes = it->get<std::uint64_t>();
+			settings.pcm_cache_megabytes = static_cast<unsigned int>(
+			  std::min<std::uint64_t>(pcm_cache_megabytes, Settings::MAX_PCM_CACHE_MEGABYTES));
+			if(settings.pcm_cache_megabytes != pcm_cache_megabytes)
+			{
+				logger->warn("Saved decoded audio cache size out of range: {}MB, clamped to {}MB",
+				             pcm_cache_megabytes,
+				             settings.pcm_cache_megabytes);
+			}
+			SPDLOG_DEBUG(logger,
+			             "Loaded decoded audio cache size from saved settings: {}MB",
+			             settings.pcm_cache_megabytes);
+		}
+	}
+
+	it = settings_json.find("crossfade_seconds");
+	if(it != settings_json.end())
+	{
+		if(!it->is_number())
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for crossfade duration, default value will be used");
+		}
+		else
+		{
+			const float crossfade_seconds = it->get<float>();
+			settings.crossfade_seconds =
+			  std::clamp(crossfade_seconds, 0.f, Settings::MAX_CROSSFADE_SECONDS);
+			if(settings.crossfade_seconds != crossfade_seconds)
+			{
+				logger->warn("Saved crossfade duration out of range: {:.2f}s, clamped to {:.2f}s",
+				             crossfade_seconds,
+				             settings.crossfade_seconds);
+			}
+			SPDLOG_DEBUG(logger,
+			             "Loaded crossfade duration from saved settings: {:.2f}s",
+			             settings.crossfade_seconds);
+		}
+	}
+
+	it = settings_json.find("crossfade_curve");
+	if(it != settings_json.end())
+	{
+		if(!it->is_number_integer() || it->get<int>() < static_cast<int>(CrossfadeCurve::LINEAR)
+		   || it->get<int>() > static_cast<int>(CrossfadeCurve::LOGARITHMIC))
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for crossfade curve, default curve will be used");
+		}
+		else
+		{
+			settings.crossfade_curve = static_cast<CrossfadeCurve>(it->get<int>());
+			SPDLOG_DEBUG(
+			  logger, "Loaded crossfade curve from saved settings: {}", settings.crossfade_curve);
+		}
+	}
+
+	it = settings_json.find("output_sample_rate");
+	if(it != settings_json.end())
+	{
+		const auto& rates = Settings::OUTPUT_SAMPLE_RATES;
+		if(!it->is_number_unsigned()
+		   || (it->get<unsigned int>() != 0
+		       && std::find(std::cbegin(rates), std::cend(rates), it->get<unsigned int>())
+		            == std::cend(rates)))
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for output sample rate, default rate will be used");
+		}
+		else
+		{
+			settings.output_sample_rate = it->get<unsigned int>();
+			SPDLOG_DEBUG(logger,
+			             "Loaded output sample rate from saved settings: {} Hz",
+			             settings.output_sample_rate);
+		}
+	}
+
+	it = settings_json.find("equalizer_enabled");
+	if(it != settings_json.end())
+	{
+		if(!it->is_boolean())
+		{
+			logger->warn("Saved settings contains invalid data for equalizer activation");
+		}
+		else
+		{
+			settings.equalizer_enabled = it->get<bool>();
+		}
+	}
+
+	it = settings_json.find("equalizer_bands");
+	if(it != settings_json.end())
+	{
+		std::vector<EqualizerBand> bands;
+		bool valid = it->is_array();
+		if(valid)
+		{
+			for(const nlohmann::json& band_json: *it)
+			{
+				EqualizerBand band{};
+				if(!load_equalizer_band(band_json, band))
+				{
+					valid = false;
+					break;
+				}
+				if(bands.size() == Settings::MAX_EQUALIZER_BANDS)
+				{
+					logger->warn("Saved settings contains more than {} equalizer bands, extra bands ignored",
+					             Settings::MAX_EQUALIZER_BANDS);
+					break;
+				}
+				bands.push_back(band);
+			}
+		}
+		if(!valid)
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for equalizer bands, default bands will be used");
+		}
+		else
+		{
+			settings.equalizer_bands = std::move(bands);
+			SPDLOG_DEBUG(logger,
+			             "Loaded {} equalizer bands from saved settings",
+			             settings.equalizer_bands.size());
+		}
+	}
+
+	it = settings_json.find("limiter_enabled");
+	if(it != settings_json.end())
+	{
+		if(!it->is_boolean())
+		{
+			logger->warn("Saved settings contains invalid data for limiter activation");
+		}
+		else
+		{
+			settings.limiter_enabled = it->get<bool>();
+		}
+	}
+
+	it = settings_json.find("limiter_threshold_db");
+	if(it != settings_json.end())
+	{
+		if(!it->is_number())
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for limiter threshold, default value will be used");
+		}
+		else
+		{
+			settings.limiter_threshold_db =
+			  std::clamp(it->get<float>(), Settings::MIN_LIMITER_THRESHOLD_DB, 0.f);
+			SPDLOG_DEBUG(logger,
+			             "Loaded limiter threshold from saved settings: {:.1f} dB",
+			             settings.limiter_threshold_db);
+		}
+	}
+
+	it = settings_json.find("volume_normalization");
+	if(it != settings_json.end())
+	{
+		if(!it->is_number_integer()
+		   || it->get<int>() < static_cast<int>(VolumeNormalization::OFF)
+		   || it->get<int>() > static_cast<int>(VolumeNormalization::ALBUM))
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for volume normalization, default mode will be used");
+		}
+		else
+		{
+			settings.volume_normalization = static_cast<VolumeNormalization>(it->get<int>());
+			SPDLOG_DEBUG(logger,
+			             "Loaded volume normalization from saved settings: {}",
+			             settings.volume_normalization);
+		}
+	}
+
+	it = settings_json.find("normalization_preamp_db");
+	if(it != settings_json.end())
+	{
+		if(!it->is_number())
+		{
+			logger->warn(
+			  "Saved settings contains invalid data for normalization preamp, default value will be used");
+		}
+		else
+		{
+			settings.normalization_preamp_db = std::clamp(it->get<float>(),
+			                                              -Settings::MAX_NORMALIZATION_PREAMP_DB,
+			                                              Settings::MAX_NORMALIZATION_PREAMP_DB);
+			SPDLOG_DEBUG(logger,
+			             "Loaded normalization preamp from saved settings: {:.1f} dB",
+			             settings.normalization_preamp_db);
+		}
+	}
+
 	logger->info("Loaded settings");
 	return settings;
 }
@@ -0,0 +1,36 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "data/Spectrum.hpp"
+
+#include <cmath>
+
+data::Spectrum::Spectrum() noexcept
+  : bands_db()
+  , min_frequency(0)
+  , max_frequency(0)
+  , channels(0)
+  , peak_db()
+  , rms_db()
+  , fft_size(0)
+  , analysis_us(0)
+  , realtime_load(0)
+{
+	bands_db.fill(FLOOR_DB);
+	peak_db.fill(FLOOR_DB);
+	rms_db.fill(FLOOR_DB);
+}
+
+float data::Spectrum::bandFrequency(std::size_t band) const noexcept
+{
+	if(min_frequency <= 0)
+	{
+		return 0;
+	}
+	return min_frequency
+	       * std::pow(max_frequency / min_frequency, (static_cast<float>(band) + 0.5f) / BANDS);
+}
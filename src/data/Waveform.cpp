@@ -0,0 +1,279 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "data/Waveform.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	// Cache files are written in host byte order, they are not meant to be shared
+	constexpr const char* WAVEFORM_CACHE_FOLDER = "MagicPlayer_waveforms";
+	constexpr char WAVEFORM_MAGIC[4] = {'M', 'P', 'W', 'F'};
+	constexpr std::uint32_t WAVEFORM_VERSION = 1;
+
+	// The coarsest level has at most this many bins
+	constexpr std::size_t MIN_LEVEL_BINS = 64;
+
+	// Ten hours at 192kHz
+	constexpr std::uint64_t MAX_CACHED_BINS =
+	  10ull * 3600 * 192000 / data::Waveform::BASE_BIN_FRAMES;
+
+	// About a thousand 4 minutes tracks at 44.1kHz, the least recently used files are removed
+	constexpr std::uintmax_t MAX_CACHE_BYTES = 64ull * 1024 * 1024;
+
+	static_assert(sizeof(data::WaveformBin) == 6, "waveform bins are stored as is in the cache");
+
+	data::WaveformBin merge(const data::WaveformBin& a, const data::WaveformBin& b) noexcept
+	{
+		const double a_rms = a.rms;
+		const double b_rms = b.rms;
+		return {std::min(a.min, b.min),
+		        std::max(a.max, b.max),
+		        static_cast<std::uint16_t>(std::sqrt((a_rms * a_rms + b_rms * b_rms) / 2))};
+	}
+
+	std::filesystem::path cache_path(std::uint64_t fingerprint)
+	{
+		std::ostringstream file_name;
+		file_name << std::hex << std::setw(16) << std::setfill('0') << fingerprint << ".bin";
+		return std::filesystem::path(WAVEFORM_CACHE_FOLDER) / file_name.str();
+	}
+
+	struct CacheFile
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type last_use;
+		std::uintmax_t size;
+	};
+
+	// the files modification times are their last use: set when saved and loaded
+	void mark_used(const std::filesystem::path& path) noexcept
+	{
+		std::error_code error;
+		const auto now = std::filesystem::file_time_type::clock::now();
+		std::filesystem::last_write_time(path, now, error);
+	}
+
+	// remove the least recently used files until the cache fits in MAX_CACHE_BYTES
+	void prune_cache(const std::shared_ptr<spdlog::logger>& logger)
+	{
+		std::error_code error;
+		std::filesystem::directory_iterator directory_iterator(WAVEFORM_CACHE_FOLDER, error);
+		if(error)
+		{
+			SPDLOG_DEBUG(logger, "std::filesystem::directory_iterator failed: {}", error.message());
+			return;
+		}
+
+		std::vector<CacheFile> files;
+		std::uintmax_t total_size = 0;
+		for(const std::filesystem::directory_entry& entry: directory_iterator)
+		{
+			std::error_code file_error;
+			if(!entry.is_regular_file(file_error))
+			{
+				continue;
+			}
+			CacheFile file{entry.path(), entry.last_write_time(file_error), 0};
+			if(!file_error)
+			{
+				file.size = entry.file_size(file_error);
+			}
+			if(file_error)
+			{
+				continue;
+			}
+			total_size += file.size;
+			files.push_back(std::move(file));
+		}
+		if(total_size <= MAX_CACHE_BYTES)
+		{
+			return;
+		}
+
+		std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) {
+			return a.last_use < b.last_use;
+		});
+		std::size_t removed = 0;
+		for(const CacheFile& file: files)
+		{
+			if(total_size <= MAX_CACHE_BYTES)
+			{
+				break;
+			}
+			if(std::filesystem::remove(file.path, error))
+			{
+				total_size -= file.size;
+				++removed;
+			}
+		}
+		SPDLOG_DEBUG(logger, "Removed {} least recently used waveforms from the cache", removed);
+	}
+
+	template<typename T>
+	void write(std::ofstream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool read(std::ifstream& stream, T& value)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+} // namespace
+
+data::Waveform::Waveform() noexcept: fingerprint(0), total_frames(0), complete(false), levels(1)
+{
+}
+
+void data::Waveform::buildLevels()
+{
+	levels.resize(1);
+	while(levels.back().size() > MIN_LEVEL_BINS)
+	{
+		const std::vector<WaveformBin>& previous = levels.back();
+		std::vector<WaveformBin> level((previous.size() + 1) / 2);
+		for(std::size_t i = 0; i < level.size(); ++i)
+		{
+			level[i] = 2 * i + 1 < previous.size() ? merge(previous[2 * i], previous[2 * i + 1])
+			                                       : previous[2 * i];
+		}
+		levels.push_back(std::move(level));
+	}
+}
+
+std::size_t data::Waveform::levelFor(std::size_t min_bins) const noexcept
+{
+	for(std::size_t index = levels.size(); index-- > 0;)
+	{
+		if(levels[index].size() >= min_bins)
+		{
+			return index;
+		}
+	}
+	return 0;
+}
+
+std::ostream& data::operator<<(std::ostream& os, const Waveform& waveform)
+{
+	return os << "Waveform{"
+	          << "fingerprint: " << waveform.fingerprint << ","
+	          << "total_frames: " << waveform.total_frames << ","
+	          << "complete: " << waveform.complete << ","
+	          << "levels: " << waveform.levels.size() << ","
+	          << "bins: " << waveform.levels.front().size() << "}";
+}
+
+bool data::saveWaveform(const Waveform& waveform,
+                        const std::shared_ptr<spdlog::logger>& logger) noexcept
+{
+	if(!waveform.complete)
+	{
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(WAVEFORM_CACHE_FOLDER, error);
+	if(error)
+	{
+		SPDLOG_DEBUG(logger, "std::filesystem::create_directories failed: {}", error.message());
+		logger->warn("Failed to create waveform cache folder {}", WAVEFORM_CACHE_FOLDER);
+		return false;
+	}
+
+	const std::filesystem::path path = cache_path(waveform.fingerprint);
+	std::ofstream file_stream(path, std::ios::binary);
+	if(!file_stream)
+	{
+		SPDLOG_DEBUG(logger, "Invalid std::ofstream constructed with: {}", path);
+		logger->warn("Failed to save waveform in cache");
+		return false;
+	}
+
+	const std::vector<WaveformBin>& bins = waveform.levels.front();
+	file_stream.write(WAVEFORM_MAGIC, sizeof(WAVEFORM_MAGIC));
+	write(file_stream, WAVEFORM_VERSION);
+	write(file_stream, static_cast<std::uint32_t>(Waveform::BASE_BIN_FRAMES));
+	write(file_stream, waveform.fingerprint);
+	write(file_stream, waveform.total_frames);
+	write(file_stream, static_cast<std::uint64_t>(bins.size()));
+	file_stream.write(reinterpret_cast<const char*>(bins.data()),
+	                  static_cast<std::streamsize>(bins.size() * sizeof(WaveformBin)));
+	if(!file_stream)
+	{
+		logger->warn("Failed to save waveform in cache");
+		return false;
+	}
+	file_stream.close();
+	SPDLOG_DEBUG(logger, "Saved waveform in cache: {}", path);
+
+	try
+	{
+		prune_cache(logger);
+	}
+	catch(const std::exception& exception)
+	{
+		SPDLOG_DEBUG(logger, "Waveform cache pruning failed: {}", exception.what());
+		logger->warn("Failed to limit the waveform cache size");
+	}
+	return true;
+}
+
+std::shared_ptr<data::Waveform>
+data::loadWaveform(std::uint64_t fingerprint,
+                   const std::shared_ptr<spdlog::logger>& logger) noexcept
+{
+	const std::filesystem::path path = cache_path(fingerprint);
+	std::ifstream file_stream(path, std::ios::binary);
+	if(!file_stream)
+	{
+		return nullptr;
+	}
+
+	char magic[sizeof(WAVEFORM_MAGIC)];
+	std::uint32_t version;
+	std::uint32_t base_bin_frames;
+	std::uint64_t saved_fingerprint;
+	std::uint64_t total_frames;
+	std::uint64_t bin_count;
+	if(!file_stream.read(magic, sizeof(magic)) || !read(file_stream, version)
+	   || !read(file_stream, base_bin_frames) || !read(file_stream, saved_fingerprint)
+	   || !read(file_stream, total_frames) || !read(file_stream, bin_count)
+	   || !std::equal(std::cbegin(magic), std::cend(magic), std::cbegin(WAVEFORM_MAGIC))
+	   || version != WAVEFORM_VERSION || base_bin_frames != Waveform::BASE_BIN_FRAMES
+	   || saved_fingerprint != fingerprint || bin_count > MAX_CACHED_BINS
+	   || bin_count != (total_frames + Waveform::BASE_BIN_FRAMES - 1) / Waveform::BASE_BIN_FRAMES)
+	{
+		logger->warn("Invalid waveform cache file {}, the waveform will be generated again", path);
+		return nullptr;
+	}
+
+	auto waveform = std::make_shared<Waveform>();
+	waveform->fingerprint = fingerprint;
+	waveform->total_frames = total_frames;
+	std::vector<WaveformBin>& bins = waveform->levels.front();
+	bins.resize(static_cast<std::size_t>(bin_count));
+	if(!file_stream.read(reinterpret_cast<char*>(bins.data()),
+	                     static_cast<std::streamsize>(bins.size() * sizeof(WaveformBin))))
+	{
+		logger->warn("Truncated waveform cache file {}, the waveform will be generated again", path);
+		return nullptr;
+	}
+	waveform->complete = true;
+	waveform->buildLevels();
+	mark_used(path);
+	return waveform;
+}
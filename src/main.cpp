@@ -8,31 +8,235 @@
 #include "utils/log.hpp"
 #include "model/Logic.hpp"
 #include "view/GUI.hpp"
-#include "SoundFileReaderMp3.hpp"
+#include "control/ControlServer.hpp"
+#include "control/HttpServer.hpp"
 
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <string>
 #include <thread>
+#include <variant>
 
-int main()
+namespace
 {
-	std::ios_base::sync_with_stdio(false);
+	constexpr const char* SOCKET_FILENAME = "magicplayer.sock";
+	constexpr const char* TOKEN_FILENAME = "magicplayer.token";
+	constexpr const char* DEFAULT_HTTP_ADDRESS = "127.0.0.1";
 
-	if(!init_logger())
+	struct HeadlessOptions
 	{
-		return EXIT_FAILURE;
+		std::filesystem::path socket_path;
+		std::uint16_t tcp_port = 0;
+		std::filesystem::path token_path;
+		std::string http_address = DEFAULT_HTTP_ADDRESS;
+		std::uint16_t http_port = 0;
+	};
+
+	control::ControlServer* RUNNING_SERVER = nullptr;
+	control::HttpServer* RUNNING_HTTP_SERVER = nullptr;
+
+	extern "C" void stop_server(int)
+	{
+		if(RUNNING_SERVER != nullptr)
+		{
+			RUNNING_SERVER->stop();
+		}
+		if(RUNNING_HTTP_SERVER != nullptr)
+		{
+			RUNNING_HTTP_SERVER->stop();
+		}
+	}
+
+	std::filesystem::path runtime_path(const char* filename)
+	{
+		const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+		if(runtime_dir != nullptr && runtime_dir[0] != '\0')
+		{
+			return std::filesystem::path(runtime_dir) / filename;
+		}
+		return filename;
+	}
+
+	std::filesystem::path default_socket_path()
+	{
+		return runtime_path(SOCKET_FILENAME);
+	}
+
+	std::filesystem::path default_token_path()
+	{
+		return runtime_path(TOKEN_FILENAME);
+	}
+
+	bool parse_port(const char* str, std::uint16_t& port)
+	{
+		const long value = std::strtol(str, nullptr, 10);
+		if(value <= 0 || value > 65535)
+		{
+			return false;
+		}
+		port = static_cast<std::uint16_t>(value);
+		return true;
+	}
+
+	void print_usage(const char* program)
+	{
+		std::cerr << "Usage: " << program
+		          << " [--continuous-rendering | --headless [--socket <path>]"
+		             " [--port <port> [--token-file <path>]]"
+		             " [--http-port <port> [--http-address <address>]]]\n"
+		          << "  --continuous-rendering  render the window at full frame rate even when "
+		             "idle\n"
+		          << "  --headless      run without window, driven through the control sockets\n"
+		          << "  --socket        control socket path (default: " << default_socket_path()
+		          << "), empty to disable\n"
+		          << "  --port          loopback TCP control port (default: disabled), open to all "
+		             "the local users: its clients authenticate with the token file content\n"
+		          << "  --token-file    TCP control token file (default: " << default_token_path()
+		          << ")\n"
+		          << "  --http-port     port of the HTTP server streaming the database tracks "
+		             "(default: disabled)\n"
+		          << "  --http-address  IPv4 address of the HTTP server (default: "
+		          << DEFAULT_HTTP_ADDRESS << ", 0.0.0.0 to serve the LAN)" << std::endl;
 	}
 
-	spdlog::get(GENERAL_LOGGER_NAME)->info("MagicPlayer started");
+	int run_gui(bool idle_rendering)
 	{
 		Logic logic;
+		// listens to the out messages, created before the logic runs
+		GUI gui(logic.getCom(), idle_rendering);
 		std::thread logicThread([&]() { logic.run(); });
 
-		GUI gui(logic.getCom());
 		gui.run();
 
 		logicThread.join();
+		return EXIT_SUCCESS;
 	}
+
+	int run_headless(const HeadlessOptions& options)
+	{
+		control::HttpServer http_server(spdlog::get(CONTROL_LOGGER_NAME));
+		if(options.http_port != 0 && !http_server.open(options.http_address, options.http_port))
+		{
+			return EXIT_FAILURE;
+		}
+
+		// destroyed after the logic, whose background tasks may still send out messages
+		control::ControlServer server(spdlog::get(CONTROL_LOGGER_NAME));
+		{
+			Logic logic;
+			if(!server.open(
+			     logic.getCom(), options.socket_path, options.tcp_port, options.token_path))
+			{
+				return EXIT_FAILURE;
+			}
+
+			std::thread httpThread;
+			if(options.http_port != 0)
+			{
+				// the logic sends the database when loaded or regenerated
+				server.setOutMessageHandler([&http_server](const Msg::Com::OutMessage& message) {
+					if(const auto* database = std::get_if<Msg::Out::Database>(&message))
+					{
+						http_server.setDatabase(database->database);
+					}
+				});
+				RUNNING_HTTP_SERVER = &http_server;
+				httpThread = std::thread([&]() { http_server.run(); });
+			}
+
+			RUNNING_SERVER = &server;
+			std::signal(SIGINT, stop_server);
+			std::signal(SIGTERM, stop_server);
+#if defined(SIGPIPE)
+			// disconnected clients are detected by the failed writes
+			std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+			std::thread logicThread([&]() { logic.run(); });
+			server.run();
+			logicThread.join();
+			if(httpThread.joinable())
+			{
+				http_server.stop();
+				httpThread.join();
+			}
+
+			std::signal(SIGINT, SIG_DFL);
+			std::signal(SIGTERM, SIG_DFL);
+			RUNNING_SERVER = nullptr;
+			RUNNING_HTTP_SERVER = nullptr;
+		}
+		return EXIT_SUCCESS;
+	}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	std::ios_base::sync_with_stdio(false);
+
+	bool headless = false;
+	bool idle_rendering = true;
+	HeadlessOptions options;
+	options.socket_path = default_socket_path();
+	options.token_path = default_token_path();
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if(std::strcmp(argv[i], "--continuous-rendering") == 0)
+		{
+			idle_rendering = false;
+		}
+		else if(std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+		{
+			options.socket_path = argv[++i];
+		}
+		else if(std::strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+		{
+			if(!parse_port(argv[++i], options.tcp_port))
+			{
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(std::strcmp(argv[i], "--token-file") == 0 && i + 1 < argc)
+		{
+			options.token_path = argv[++i];
+		}
+		else if(std::strcmp(argv[i], "--http-port") == 0 && i + 1 < argc)
+		{
+			if(!parse_port(argv[++i], options.http_port))
+			{
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(std::strcmp(argv[i], "--http-address") == 0 && i + 1 < argc)
+		{
+			options.http_address = argv[++i];
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// without view, nothing displays the stored logs
+	if(!init_logger(!headless))
+	{
+		return EXIT_FAILURE;
+	}
+
+	spdlog::get(GENERAL_LOGGER_NAME)->info("MagicPlayer started{}", headless ? " (headless)" : "");
+	const int result = headless ? run_headless(options) : run_gui(idle_rendering);
 	spdlog::get(GENERAL_LOGGER_NAME)->info("MagicPlayer ended");
 
-	return EXIT_SUCCESS;
+	return result;
 }
@@ -10,30 +10,38 @@
 #include "utils/audio_extensions.hpp"
 #include "data/DataManager.hpp"
 
-#include "SoundFileReaderMp3.hpp"
-
-#include <SFML/Audio/SoundFileFactory.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <thread>
 #include <future>
+#include <tuple>
 #include <utility>
 
 namespace
 {
-	template<typename T>
-	struct dependent_false : public std::false_type
-	{
-	};
+	// Tracks of the play queue decoded in advance, after the one chained to the current music
+	constexpr std::size_t PREFETCH_TRACKS = 2;
+
+	// Background tasks run concurrently, the others wait in the executor queues
+	constexpr unsigned int MIN_TASK_THREADS = 2;
+	constexpr unsigned int MAX_TASK_THREADS = 4;
+
+	// Messages of a lane dispatched before the in queue is checked again for higher priority ones,
+	// few requests (database requests, settings saving) so that a control waits little for them
+	constexpr std::array<std::size_t, Msg::LANE_COUNT> LANE_BATCH_SIZES = {32, 32, 4};
 
-	std::once_flag SFML_inited;
-	void init_SFML()
+	// Events waiting longer are dispatched before the controls, which can't starve them
+	constexpr std::chrono::milliseconds EVENTS_MAX_WAIT(20);
+
+	// Period of the lane statistics debug logs, while messages are dispatched
+	constexpr std::chrono::seconds LANE_STATISTICS_PERIOD(60);
+
+	[[maybe_unused]] std::int64_t to_microseconds(std::chrono::steady_clock::duration duration)
 	{
-		std::call_once(SFML_inited, []() {
-			sf::SoundFileFactory::registerReader<SoundFileReaderMp3>();
-			SPDLOG_DEBUG(spdlog::get(GENERAL_LOGGER_NAME),
-			             "Custom MP3 file reader registered to SFML SoundFileFactory");
-		});
+		return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
 	}
 } // namespace
 
@@ -71,7 +79,11 @@ void Logic::handleMessage(Msg::In::Open& message)
 
 	if(std::filesystem::is_regular_file(message.path.path(), error))
 	{
-		loadFile(message.path);
+		Zone* zone = getZone(message.zone);
+		if(zone != nullptr)
+		{
+			loadFile(*zone, message.path);
+		}
 		return;
 	}
 	if(error)
@@ -94,30 +106,79 @@ void Logic::handleMessage(Msg::In::Open& message)
 	m_logger->warn("Open request on invalid file/folder {}", message.path);
 }
 
+template<>
+void Logic::handleMessage(Msg::In::Enqueue& message)
+{
+	SPDLOG_DEBUG(m_logger, "Received enqueue request: {}", message.path);
+	if(!message.path.valid_encoding())
+	{
+		m_logger->warn("Tried to enqueue file with invalid utf8 path: {}", message.path);
+		return;
+	}
+
+	std::error_code error;
+	if(!std::filesystem::is_regular_file(message.path.path(), error))
+	{
+		if(error)
+		{
+			SPDLOG_DEBUG(m_logger, "std::filesystem::is_regular_file failed: {}", error.message());
+		}
+		m_logger->warn("Enqueue request on invalid file {}", message.path);
+		return;
+	}
+
+	Zone* zone = getZone(message.zone);
+	if(zone == nullptr)
+	{
+		return;
+	}
+	zone->play_queue.push_back(std::move(message.path));
+	m_logger->info("Enqueued {} in zone {} ({} musics in queue)",
+	               zone->play_queue.back(),
+	               zone->id,
+	               zone->play_queue.size());
+	if(zone->play_queue.size() == 1)
+	{
+		queueNextFile(*zone);
+	}
+	else
+	{
+		prefetchQueues();
+	}
+}
+
 template<>
 void Logic::handleMessage(Msg::In::Control& message)
 {
 	SPDLOG_DEBUG(m_logger, "Received control request: {}", message.action);
+	Zone* zone = getZone(message.zone);
+	if(zone == nullptr)
+	{
+		return;
+	}
+	audio::BufferedMusic& music = zone->music;
 	switch(message.action)
 	{
 		case Msg::In::Control::Action::PLAY:
-			if(m_music.getStatus() == sf::Music::Stopped)
+			if(music.getStatus() == sf::SoundStream::Stopped)
 			{
 				// really stop music if just ended
-				m_music.stop();
+				music.stop();
 			}
-			m_music.play();
-			m_logger->info("Music played/resumed");
+			music.play();
+			m_logger->info("Music played/resumed in zone {}", zone->id);
 			break;
 		case Msg::In::Control::Action::PAUSE:
-			m_music.pause();
-			m_logger->info("Music paused");
+			music.pause();
+			m_logger->info("Music paused in zone {}", zone->id);
 			break;
 		case Msg::In::Control::Action::STOP:
-			m_music.stop();
-			m_logger->info("Music stopped");
+			music.stop();
+			m_logger->info("Music stopped in zone {}", zone->id);
 			break;
 	}
+	music.publishPlaybackState();
+	updateLoudnessThrottling();
 }
 
 template<>
@@ -127,17 +188,22 @@ void Logic::handleMessage(Msg::In::Volume& message)
 	             "Received volume request: {:.2f}% {}muted",
 	             message.volume,
 	             message.muted ? "" : "not ");
+	Zone* zone = getZone(message.zone);
+	if(zone == nullptr)
+	{
+		return;
+	}
 	if(message.muted)
 	{
-		m_music.setVolume(0);
-		m_logger->info("Volume muted");
+		zone->music.setVolume(0);
+		m_logger->info("Volume muted in zone {}", zone->id);
 		return;
 	}
 
 	if(message.volume >= 0 && message.volume <= 100)
 	{
-		m_music.setVolume(message.volume);
-		m_logger->info("Volume set to {:.2f}%", message.volume);
+		zone->music.setVolume(message.volume);
+		m_logger->info("Volume set to {:.2f}% in zone {}", message.volume, zone->id);
 	}
 	else
 	{
@@ -149,22 +215,22 @@ template<>
 void Logic::handleMessage(Msg::In::MusicOffset& message)
 {
 	SPDLOG_DEBUG(m_logger, "Received music offset request: {:.2f} seconds", message.seconds);
-	if(message.seconds <= m_music.getDuration().asSeconds())
+	Zone* zone = getZone(message.zone);
+	if(zone == nullptr)
 	{
-		m_music.setPlayingOffset(sf::seconds(message.seconds));
-		m_logger->info("Set music offset to {:.2f} seconds", message.seconds);
+		return;
+	}
+	if(message.seconds <= zone->music.getDuration().asSeconds())
+	{
+		zone->music.setPlayingOffset(sf::seconds(message.seconds));
+		m_logger->info(
+		  "Set music offset to {:.2f} seconds in zone {}", message.seconds, zone->id);
 	}
 	else
 	{
 		m_logger->warn("Invalid music offset requested: {:.2f} seconds", message.seconds);
 	}
-	m_com.sendOutMessage<Msg::Out::MusicOffset>(m_music.getPlayingOffset().asSeconds());
-}
-
-template<>
-void Logic::handleMessage([[maybe_unused]] Msg::In::RequestMusicOffset& message)
-{
-	m_com.sendOutMessage<Msg::Out::MusicOffset>(m_music.getPlayingOffset().asSeconds());
+	zone->music.publishPlaybackState();
 }
 
 template<>
@@ -177,6 +243,7 @@ void Logic::handleMessage(Msg::In::Settings& message)
 	}
 
 	m_settings = std::move(message.settings);
+	applyPlaybackSettings();
 	m_com.sendOutMessage<Msg::Out::Settings>(m_settings);
 }
 
@@ -194,49 +261,84 @@ void Logic::handleMessage(Msg::In::RequestDatabase& message)
 }
 
 template<>
-void Logic::handleMessage([[maybe_unused]] Msg::In::InnerTaskEnded& message)
+void Logic::handleMessage(Msg::In::InnerTrackEnded& message)
 {
-	auto it = std::find_if(m_pending_futures.begin(),
-	                       m_pending_futures.end(),
-	                       [](const auto& future) { return future.valid(); });
-	if(it == std::end(m_pending_futures))
+	Zone* zone = getZone(message.zone);
+	if(zone == nullptr || message.track_id != zone->music.getTrackId())
 	{
-		m_logger->warn("Task ended message received but no valid future found");
+		SPDLOG_DEBUG(m_logger, "Ignored end of track {}, another music was loaded", message.track_id);
 		return;
 	}
 
-	// Execute post-task
-	std::packaged_task<void()> post_task = it->get();
-	if(post_task.valid())
+	if(message.next_started)
 	{
-		post_task();
+		// the front of the queue was chained by the music stream
+		assert(!zone->play_queue.empty());
+		m_logger->info("Playing {} in zone {}", zone->play_queue.front(), zone->id);
+		zone->music.publishPlaybackState();
+		m_com.sendOutMessage<Msg::Out::MusicInfo>(
+		  true, zone->music.getDuration().asSeconds(), zone->id);
+		if(zone->id == Msg::MAIN_ZONE)
+		{
+			m_waveform_generator.cancel();
+			m_waveform_generator.request(zone->play_queue.front());
+		}
+		zone->play_queue.pop_front();
+		queueNextFile(*zone);
+		return;
 	}
 
-	m_pending_futures.erase(it);
-	SPDLOG_TRACE(m_logger, "Inner task ended: erased future");
+	if(!zone->play_queue.empty())
+	{
+		// not chained by the music stream (different format)
+		utf8_path path = std::move(zone->play_queue.front());
+		zone->play_queue.pop_front();
+		loadFile(*zone, path);
+		return;
+	}
+	zone->music.publishPlaybackState();
+	updateLoudnessThrottling();
 }
 
 Logic::Logic()
   : m_logger(spdlog::get(LOGIC_LOGGER_NAME))
   , m_com()
   , m_end(false)
-  , m_music()
-  , m_pending_futures()
+  , m_lanes()
+  , m_lane_router()
+  , m_collected_messages()
+  , m_lane_statistics_logged(std::chrono::steady_clock::now())
+  , m_spectrum_analyzer(m_logger, m_com.spectrum, m_com.spectrum_enabled)
+  , m_pcm_cache(m_logger)
+  , m_zones()
+  , m_pending_tasks()
+  , m_continuations()
+  , m_resumed_tasks()
   , m_settings()
   , m_data_manager(m_logger)
   , m_database(nullptr)
+  , m_loudness()
+  , m_loudness_scanner(m_logger, m_loudness)
+  , m_waveform_generator(m_logger, [this](std::shared_ptr<const data::Waveform> waveform) {
+	  m_com.sendOutMessage<Msg::Out::Waveform>(std::move(waveform));
+  })
+  , m_executor(std::clamp(std::thread::hardware_concurrency(), MIN_TASK_THREADS, MAX_TASK_THREADS))
+{
+	// the view displays the spectrum of the main zone
+	getZone(Msg::MAIN_ZONE)->music.setSpectrumAnalyzer(&m_spectrum_analyzer);
+}
+
+Logic::Zone::Zone(Msg::ZoneId id_, std::shared_ptr<spdlog::logger> logger) noexcept
+  : id(id_), music(std::move(logger)), play_queue()
 {
-	init_SFML();
 }
 
 Logic::~Logic()
 {
 	SPDLOG_DEBUG(m_logger, "Start ending all background tasks");
-	for(const auto& future: m_pending_futures)
-	{
-		SPDLOG_TRACE(m_logger, "Waiting on pending futures");
-		future.wait();
-	}
+	m_loudness_scanner.stop();
+	// the running tasks are waited, the queued ones are dropped
+	m_executor.stop();
 	SPDLOG_DEBUG(m_logger, "All background tasks ended");
 }
 
@@ -252,32 +354,366 @@ void Logic::run()
 
 	while(!m_end)
 	{
-		Msg::Com::InMessage message_ = m_com.in.front();
+		const bool resumed = resumeContinuations();
+		collectMessages();
+		if(!dispatchMessages() && !resumed)
+		{
+			m_com.in.wait([this]() { return !m_continuations.empty(); });
+		}
+	}
+	SPDLOG_DEBUG(m_logger, "Main loop ended");
+	logLaneStatistics();
+	if constexpr(Msg::tracing::ENABLED)
+	{
+		Msg::tracing::log(*m_logger);
+	}
+}
+
+void Logic::collectMessages()
+{
+	// all the pending messages are moved out of the queue at once, the buffer is reused
+	if(m_com.in.drain(m_collected_messages) == 0)
+	{
+		return;
+	}
+	for(Msg::Com::InEnvelope& envelope: m_collected_messages)
+	{
+		const Msg::Lane lane_id = m_lane_router.route(envelope.message);
+		MessageLane& lane = m_lanes[static_cast<std::size_t>(lane_id)];
+		lane.messages.push_back(std::move(envelope));
+		lane.max_depth = std::max(lane.max_depth, lane.messages.size());
+	}
+	m_collected_messages.clear();
+}
+
+bool Logic::dispatchMessages()
+{
+	auto lane_it = std::find_if(m_lanes.begin(), m_lanes.end(), [](const MessageLane& lane) {
+		return !lane.messages.empty();
+	});
+	if(lane_it == m_lanes.end())
+	{
+		return false;
+	}
+	MessageLane& events = m_lanes[static_cast<std::size_t>(Msg::Lane::EVENTS)];
+	if(!events.messages.empty()
+	   && std::chrono::steady_clock::now() - events.messages.front().sent >= EVENTS_MAX_WAIT)
+	{
+		lane_it = m_lanes.begin() + static_cast<std::ptrdiff_t>(Msg::Lane::EVENTS);
+	}
+
+	MessageLane& lane = *lane_it;
+	const auto lane_id = static_cast<Msg::Lane>(std::distance(m_lanes.begin(), lane_it));
+	const std::size_t batch_size = LANE_BATCH_SIZES[static_cast<std::size_t>(lane_id)];
+	for(std::size_t i = 0; i < batch_size && !lane.messages.empty() && !m_end; ++i)
+	{
+		Msg::Com::InEnvelope& envelope = lane.messages.front();
+		m_com.takeLatest(envelope);
+		const std::chrono::steady_clock::duration wait =
+		  std::chrono::steady_clock::now() - envelope.sent;
+		lane.total_wait += wait;
+		lane.max_wait = std::max(lane.max_wait, wait);
+		++lane.dispatched;
+
+		const std::size_t type = envelope.message.index();
+		[[maybe_unused]] Msg::tracing::clock::time_point handler_start;
+		if constexpr(Msg::tracing::ENABLED)
+		{
+			Msg::tracing::recordDequeue(Msg::tracing::Direction::IN, type, envelope.sent);
+			handler_start = Msg::tracing::clock::now();
+		}
 		std::visit(
 		  [&](auto&& message) noexcept {
 			  SPDLOG_TRACE(m_logger, "Received message {}", message);
 			  handleMessage(message);
 		  },
-		  message_);
-		m_com.in.pop_front();
+		  envelope.message);
+		if constexpr(Msg::tracing::ENABLED)
+		{
+			Msg::tracing::recordHandler(
+			  Msg::tracing::Direction::IN, type, Msg::tracing::clock::now() - handler_start);
+		}
+		m_lane_router.dispatched(lane_id, envelope.message);
+		lane.messages.pop_front();
 	}
-	SPDLOG_DEBUG(m_logger, "Main loop ended");
+
+	if(std::chrono::steady_clock::now() - m_lane_statistics_logged >= LANE_STATISTICS_PERIOD)
+	{
+		m_lane_statistics_logged = std::chrono::steady_clock::now();
+		logLaneStatistics();
+	}
+	return true;
 }
 
-void Logic::loadFile(const utf8_path& path)
+void Logic::logLaneStatistics() const
 {
-	if(m_music.openFromFile(path.str_cref()))
+	for(std::size_t i = 0; i < m_lanes.size(); ++i)
 	{
-		m_music.play();
-		m_logger->info("Loaded {}", path);
+		const MessageLane& lane = m_lanes[i];
+		if(lane.dispatched == 0)
+		{
+			continue;
+		}
+		SPDLOG_DEBUG(m_logger,
+		             "Lane {}: {} messages, {} queued (max {}), wait {}us on average, {}us max",
+		             static_cast<Msg::Lane>(i),
+		             lane.dispatched,
+		             lane.messages.size(),
+		             lane.max_depth,
+		             to_microseconds(lane.total_wait / lane.dispatched),
+		             to_microseconds(lane.max_wait));
+	}
+	SPDLOG_DEBUG(m_logger, "{} messages replaced by newer ones", m_com.coalescedCount());
+}
+
+Logic::Zone* Logic::getZone(Msg::ZoneId id)
+{
+	if(id >= m_zones.size())
+	{
+		m_logger->warn("Invalid zone {} ({} zones at most)", id, m_zones.size());
+		return nullptr;
+	}
+	if(!m_zones[id])
+	{
+		auto zone = std::make_unique<Zone>(id, m_logger);
+		zone->music.setTrackEndCallback([this, id](bool next_started, std::uint64_t track_id) {
+			m_com.sendInMessage<Msg::In::InnerTrackEnded>(next_started, track_id, id);
+		});
+		zone->music.setPlaybackState(&m_com.playback[id]);
+		zone->music.setPcmCache(&m_pcm_cache);
+		applyPlaybackSettings(*zone);
+		m_zones[id] = std::move(zone);
+		if(id != Msg::MAIN_ZONE)
+		{
+			m_logger->info("Zone {} created", id);
+		}
+	}
+	return m_zones[id].get();
+}
+
+void Logic::loadFile(Zone& zone, const utf8_path& path)
+{
+	audio::BufferedMusic& music = zone.music;
+	if(music.getUnderrunCount() != 0)
+	{
+		m_logger->warn("Previous music playback had {} underruns ({} samples of silence)",
+		               music.getUnderrunCount(),
+		               music.getUnderrunSamples());
+	}
+
+	for(const audio::dsp::Chain::StageCost& cost: music.getDspCosts())
+	{
+		SPDLOG_DEBUG(m_logger,
+		             "Previous music {} cost in zone {}: {:.1f}us per block on average, {:.1f}us max, {:.3f}% of real time",
+		             cost.name,
+		             zone.id,
+		             cost.average_us,
+		             cost.max_us,
+		             cost.realtime_load * 100);
+	}
+
+	// waveforms of the previous music must not be sent after the new music info
+	if(zone.id == Msg::MAIN_ZONE)
+	{
+		m_waveform_generator.cancel();
+	}
+	if(music.openFromFile(path, m_settings.decode_ahead_seconds, normalizationGain(path)))
+	{
+		music.play();
+		m_logger->info("Loaded {} in zone {}", path, zone.id);
 		m_logger->info("Music played");
-		m_com.sendOutMessage<Msg::Out::MusicInfo>(true, m_music.getDuration().asSeconds());
+		const audio::PcmCache::Statistics cache = m_pcm_cache.getStatistics();
+		if(cache.budget_bytes != 0)
+		{
+			SPDLOG_DEBUG(m_logger,
+			             "Decoded audio cache: {} tracks, {}/{}MB used, {} hits, {} misses",
+			             cache.tracks,
+			             cache.used_bytes >> 20,
+			             cache.budget_bytes >> 20,
+			             cache.hits,
+			             cache.misses);
+		}
+		music.publishPlaybackState();
+		m_com.sendOutMessage<Msg::Out::MusicInfo>(true, music.getDuration().asSeconds(), zone.id);
+		if(zone.id == Msg::MAIN_ZONE)
+		{
+			m_waveform_generator.request(path);
+		}
+		queueNextFile(zone);
 	}
 	else
 	{
 		m_logger->warn("Failed to load {}", path);
-		m_com.sendOutMessage<Msg::Out::MusicInfo>(false, 0);
+		music.publishPlaybackState();
+		m_com.sendOutMessage<Msg::Out::MusicInfo>(false, 0, zone.id);
+	}
+	updateLoudnessThrottling();
+}
+
+void Logic::queueNextFile(Zone& zone)
+{
+	if(zone.play_queue.empty() || zone.music.hasQueuedNext())
+	{
+		return;
+	}
+
+	const utf8_path& path = zone.play_queue.front();
+	if(zone.music.queueNext(path, m_settings.decode_ahead_seconds, normalizationGain(path)))
+	{
+		SPDLOG_DEBUG(m_logger, "{} will be chained to the current music", path);
+	}
+	else
+	{
+		SPDLOG_DEBUG(m_logger,
+		             "{} can't be chained to the current music, it will be loaded after",
+		             path);
+	}
+	prefetchQueues();
+}
+
+void Logic::prefetchQueues()
+{
+	// one prefetch list for the shared cache worker: the next track of each zone comes before
+	// the following ones, the chained tracks are added to the cache by their decoders
+	std::vector<utf8_path> paths;
+	for(std::size_t rank = 0; rank < PREFETCH_TRACKS; ++rank)
+	{
+		for(const std::unique_ptr<Zone>& zone: m_zones)
+		{
+			if(!zone)
+			{
+				continue;
+			}
+			const std::size_t index = rank + (zone->music.hasQueuedNext() ? 1 : 0);
+			if(index >= zone->play_queue.size())
+			{
+				continue;
+			}
+			const utf8_path& path = zone->play_queue[index];
+			if(std::none_of(paths.cbegin(), paths.cend(), [&](const utf8_path& queued) {
+				   return queued.str_cref() == path.str_cref();
+			   }))
+			{
+				paths.push_back(path);
+			}
+		}
+	}
+	m_pcm_cache.prefetch(std::move(paths));
+}
+
+void Logic::applyPlaybackSettings()
+{
+	m_pcm_cache.setBudget(static_cast<std::size_t>(m_settings.pcm_cache_megabytes) << 20);
+	for(const std::unique_ptr<Zone>& zone: m_zones)
+	{
+		if(zone)
+		{
+			applyPlaybackSettings(*zone);
+		}
+	}
+}
+
+void Logic::applyPlaybackSettings(Zone& zone)
+{
+	zone.music.setCrossfade(m_settings.crossfade_seconds, m_settings.crossfade_curve);
+	zone.music.setOutputSampleRate(m_settings.output_sample_rate);
+	zone.music.setEqualizer(m_settings.equalizer_bands, m_settings.equalizer_enabled);
+	zone.music.setLimiter(m_settings.limiter_enabled, m_settings.limiter_threshold_db);
+}
+
+float Logic::normalizationGain(const utf8_path& path) const
+{
+	if(m_settings.volume_normalization == data::VolumeNormalization::OFF)
+	{
+		return 1.f;
+	}
+
+	std::optional<data::TrackLoudness> loudness = m_loudness.find(path);
+	if(!loudness)
+	{
+		SPDLOG_DEBUG(
+		  m_logger, "Loudness of {} not analyzed yet, played without normalization", path);
+		return 1.f;
+	}
+
+	if(m_settings.volume_normalization == data::VolumeNormalization::ALBUM && m_database)
+	{
+		const data::Music* music = m_database->findMusic(path);
+		if(music != nullptr && music->album != nullptr)
+		{
+			std::vector<data::TrackLoudness> album_loudness;
+			for(const data::Music& album_music: music->album->musics)
+			{
+				std::optional<data::TrackLoudness> music_loudness =
+				  m_loudness.find(album_music.path);
+				if(!music_loudness)
+				{
+					SPDLOG_DEBUG(m_logger,
+					             "Album of {} not fully analyzed yet, track gain used",
+					             path);
+					album_loudness.clear();
+					break;
+				}
+				album_loudness.push_back(*music_loudness);
+			}
+			if(!album_loudness.empty())
+			{
+				loudness = data::combine_loudness(album_loudness);
+			}
+		}
 	}
+
+	const float gain_db =
+	  data::normalization_gain_db(*loudness, m_settings.normalization_preamp_db);
+	SPDLOG_DEBUG(m_logger,
+	             "{} normalized: {:.2f} LUFS, {:.2f} dBTP, gain {:+.2f} dB",
+	             path,
+	             loudness->integrated_lufs,
+	             loudness->true_peak_db,
+	             gain_db);
+	return std::pow(10.f, gain_db / 20);
+}
+
+std::vector<utf8_path>
+Logic::notAnalyzedMusics(const std::shared_ptr<const data::Database>& database) const
+{
+	if(!database)
+	{
+		return {};
+	}
+
+	std::vector<utf8_path> paths;
+	// not by id: the loaded database has no valid id
+	for(const data::Music* music: database->musics())
+	{
+		paths.push_back(music->path);
+	}
+	return m_loudness_scanner.filterAnalyzed(std::move(paths));
+}
+
+void Logic::installDatabase(DatabaseUpdate update)
+{
+	std::shared_ptr<const data::Database> previous =
+	  std::exchange(m_database, std::move(update.database));
+	m_com.sendOutMessage<Msg::Out::Database>(m_database);
+	m_loudness_scanner.start(std::move(update.not_analyzed_musics));
+	updateLoudnessThrottling();
+
+	// the logic may hold the last reference, a large database is freed in the background
+	if(previous)
+	{
+		m_executor.submit([previous_ = std::move(previous)]() noexcept {},
+		                  task_executor::priority::LOW);
+	}
+}
+
+void Logic::updateLoudnessThrottling()
+{
+	const bool playing =
+	  std::any_of(m_zones.cbegin(), m_zones.cend(), [](const std::unique_ptr<Zone>& zone) {
+		  return zone && zone->music.getStatus() == sf::SoundStream::Playing;
+	  });
+	m_loudness_scanner.setThrottled(playing);
 }
 
 void Logic::sendFolderContent(const std::filesystem::path& path)
@@ -363,83 +799,139 @@ void Logic::sendFolderContent(const std::filesystem::path& path)
 	m_com.sendOutMessage<Msg::Out::FolderContent>(path, std::move(path_infos));
 }
 
-void Logic::async_sendFolderContent(const std::filesystem::path& path_)
+void Logic::async_sendFolderContent(const std::filesystem::path& path)
 {
-	async_task(
-	  [this](const std::filesystem::path path) noexcept { sendFolderContent(path); }, path_);
+	// the user is waiting for it
+	async_flow("folder content",
+	           task_executor::priority::HIGH,
+	           task_flow<>().on_worker([this, path]() noexcept { sendFolderContent(path); }));
 }
 
 void Logic::async_loadSettings()
 {
-	async_task([this]() noexcept {
-		data::Settings settings = data::loadSettings(m_logger);
-
-		return std::packaged_task<void()>([this, settings] {
-			m_settings = settings;
-			m_com.sendOutMessage<Msg::Out::Settings>(m_settings);
-			m_com.sendInMessage<Msg::In::Open>(settings.explorer_folder);
-		});
-	});
+	// the explorer folder is listed by the same flow, without an Open message round trip
+	async_flow("settings load",
+	           task_executor::priority::HIGH,
+	           task_flow<>()
+	             .on_worker([this]() noexcept { return data::loadSettings(m_logger); })
+	             .on_owner([this](data::Settings settings) noexcept {
+		             m_settings = std::move(settings);
+		             applyPlaybackSettings();
+		             m_com.sendOutMessage<Msg::Out::Settings>(m_settings);
+		             return m_settings.explorer_folder;
+	             })
+	             .on_worker([this](utf8_path explorer_folder) noexcept {
+		             sendFolderContent(explorer_folder.path());
+	             }));
 }
 
 void Logic::async_loadDatabase()
 {
-	async_task([this]() noexcept {
-		std::shared_ptr<const data::Database> database = m_data_manager.loadDatabase();
+	async_flow("database load",
+	           task_executor::priority::NORMAL,
+	           task_flow<>()
+	             .on_worker([this]() noexcept {
+		             std::shared_ptr<const data::Database> database =
+		               m_data_manager.loadDatabase();
+		             m_loudness.load(m_logger);
+		             return database;
+	             })
+	             .on_worker([this](std::shared_ptr<const data::Database> database) noexcept {
+		             std::vector<utf8_path> not_analyzed = notAnalyzedMusics(database);
+		             return DatabaseUpdate{std::move(database), std::move(not_analyzed)};
+	             })
+	             .on_owner([this](DatabaseUpdate update) noexcept {
+		             installDatabase(std::move(update));
+	             }));
+}
+
+void Logic::async_generateDatabase(std::vector<utf8_path> music_sources)
+{
+	// long, must not delay the folder listings
+	async_flow("database generation",
+	           task_executor::priority::LOW,
+	           task_flow<>()
+	             .on_worker([this, music_sources = std::move(music_sources)]() noexcept {
+		             return m_data_manager.generateDatabase(music_sources);
+	             })
+	             .on_worker([this](std::shared_ptr<const data::Database> database) noexcept {
+		             std::vector<utf8_path> not_analyzed = notAnalyzedMusics(database);
+		             return DatabaseUpdate{std::move(database), std::move(not_analyzed)};
+	             })
+	             .on_owner([this](DatabaseUpdate update) noexcept {
+		             installDatabase(std::move(update));
+	             }));
+}
 
-		return std::packaged_task<void()>([this, database] {
-			m_database = database;
-			m_com.sendOutMessage<Msg::Out::Database>(m_database);
-		});
-	});
+template<typename... Steps>
+void Logic::async_flow(const char* name,
+                       task_executor::priority priority,
+                       task_flow<Steps...> flow)
+{
+	auto pending_task = std::make_unique<PendingTask>();
+	PendingTask* task = pending_task.get();
+	task->name = name;
+	task->priority = priority;
+	task->flow = std::make_unique<task_flow<Steps...>>(std::move(flow));
+	task->queued = std::chrono::steady_clock::now();
+	const std::uint64_t task_id = m_pending_tasks.emplace(std::move(pending_task));
+	resumeTask(task_id, *task, flow_side::OWNER);
 }
 
-void Logic::async_generateDatabase(std::vector<utf8_path> music_sources_)
+void Logic::resumeTask(std::uint64_t task_id, PendingTask& task, flow_side side) noexcept
 {
-	async_task(
-	  [this](std::vector<utf8_path> music_sources) noexcept {
-		  std::shared_ptr<const data::Database> database =
-		    m_data_manager.generateDatabase(music_sources);
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const std::optional<flow_side> next = task.flow->run(side);
+	const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	(side == flow_side::WORKER ? task.worker_time : task.logic_time) += end - start;
 
-		  return std::packaged_task<void()>([this, database] {
-			  m_database = database;
-			  m_com.sendOutMessage<Msg::Out::Database>(m_database);
-		  });
-	  },
-	  std::move(music_sources_));
+	if(next == flow_side::WORKER)
+	{
+		++task.switches;
+		m_executor.submit(
+		  [this, task_id, &task]() noexcept { resumeTask(task_id, task, flow_side::WORKER); },
+		  task.priority);
+		return;
+	}
+	if(side == flow_side::WORKER)
+	{
+		// the next steps run on the logic thread, or the flow ended and the logic frees it
+		++task.switches;
+		m_continuations.push_back(task_id);
+		m_com.in.notify();
+		return;
+	}
+
+	SPDLOG_DEBUG(m_logger,
+	             "Task {} ({}) ended: {}us total, {}us on the workers, {}us on the logic thread, "
+	             "{} thread switches",
+	             task_id,
+	             task.name,
+	             to_microseconds(end - task.queued),
+	             to_microseconds(task.worker_time),
+	             to_microseconds(task.logic_time),
+	             task.switches);
+	m_pending_tasks.erase(task_id);
 }
 
-template<typename Lambda, typename... Parameters>
-void Logic::async_task(Lambda lambda, Parameters... parameters)
+bool Logic::resumeContinuations()
 {
-	if constexpr(std::is_same<typename std::invoke_result<Lambda, Parameters...>::type,
-	                          void>::value)
+	m_continuations.swap_all(m_resumed_tasks);
+	if(m_resumed_tasks.empty())
 	{
-		auto process = [this](Lambda lambda_,
-		                      Parameters... parameters_) noexcept->std::packaged_task<void()>
-		{
-			lambda_(std::forward<Parameters>(parameters_)...);
-			m_com.sendInMessage<Msg::In::InnerTaskEnded>();
-			return std::packaged_task<void()>();
-		};
-		m_pending_futures.push_back(
-		  std::async(std::launch::async, process, lambda, std::forward<Parameters>(parameters)...));
-	}
-	else if constexpr(std::is_same<typename std::invoke_result<Lambda, Parameters...>::type,
-	                               std::packaged_task<void()>>::value)
-	{
-		auto process = [this](Lambda lambda_,
-		                      Parameters... parameters_) noexcept->std::packaged_task<void()>
-		{
-			auto post_task = lambda_(std::forward<Parameters>(parameters_)...);
-			m_com.sendInMessage<Msg::In::InnerTaskEnded>();
-			return post_task;
-		};
-		m_pending_futures.push_back(
-		  std::async(std::launch::async, process, lambda, std::forward<Parameters>(parameters)...));
+		return false;
 	}
-	else
+	for(std::uint64_t task_id: m_resumed_tasks)
 	{
-		static_assert(dependent_false<Lambda>::value, "Invalid lambda return type");
+		std::unique_ptr<PendingTask>* slot = m_pending_tasks.find(task_id);
+		if(slot == nullptr)
+		{
+			m_logger->warn("Continuation of unknown task {}", task_id);
+			continue;
+		}
+		// stable address, the slot may move if the flow starts other ones
+		resumeTask(task_id, **slot, flow_side::OWNER);
 	}
+	m_resumed_tasks.clear();
+	return true;
 }
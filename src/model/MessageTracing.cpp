@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "model/MessageTracing.hpp"
+#include "model/Messages.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <variant>
+
+namespace
+{
+	constexpr const char* IN_NAMES[] = {
+	  "Close",
+	  "Open",
+	  "Enqueue",
+	  "Control",
+	  "Volume",
+	  "MusicOffset",
+	  "Settings",
+	  "RequestDatabase",
+	  "InnerTrackEnded",
+	};
+	static_assert(std::size(IN_NAMES) == std::variant_size_v<Msg::Com::InMessage>);
+
+	constexpr const char* OUT_NAMES[] = {
+	  "MusicInfo",
+	  "FolderContent",
+	  "Database",
+	  "Settings",
+	  "Waveform",
+	};
+	static_assert(std::size(OUT_NAMES) == std::variant_size_v<Msg::Com::OutMessage>);
+
+	constexpr std::size_t DIRECTION_COUNT = 2;
+	constexpr std::size_t MAX_TYPES = std::max(std::size(IN_NAMES), std::size(OUT_NAMES));
+
+	[[maybe_unused]] std::size_t type_count(Msg::tracing::Direction direction) noexcept
+	{
+		return direction == Msg::tracing::Direction::IN ? std::size(IN_NAMES)
+		                                                : std::size(OUT_NAMES);
+	}
+
+	[[maybe_unused]] const char* type_name(Msg::tracing::Direction direction,
+	                                       std::size_t type) noexcept
+	{
+		return direction == Msg::tracing::Direction::IN ? IN_NAMES[type] : OUT_NAMES[type];
+	}
+
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+	struct TypeHistograms
+	{
+		latency_histogram depth;
+		latency_histogram wait;
+		latency_histogram handler;
+	};
+
+	// written by one thread only, kept after the thread end for the dumps
+	struct ThreadHistograms
+	{
+		std::array<std::array<TypeHistograms, MAX_TYPES>, DIRECTION_COUNT> types;
+	};
+
+	std::mutex& registry_mutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	std::vector<std::shared_ptr<const ThreadHistograms>>& registry()
+	{
+		static std::vector<std::shared_ptr<const ThreadHistograms>> threads;
+		return threads;
+	}
+
+	// registered at the first message of the thread, the lock is taken once per thread,
+	// nullptr if the registration failed: the message is not traced
+	TypeHistograms* histograms(Msg::tracing::Direction direction, std::size_t type) noexcept
+	{
+		thread_local ThreadHistograms* current = nullptr;
+		if(current == nullptr)
+		{
+			try
+			{
+				auto thread_histograms = std::make_shared<ThreadHistograms>();
+				std::lock_guard<std::mutex> lock(registry_mutex());
+				registry().push_back(thread_histograms);
+				current = thread_histograms.get();
+			}
+			catch(...)
+			{
+				return nullptr;
+			}
+		}
+		return &current->types[static_cast<std::size_t>(direction)][type];
+	}
+
+	std::uint64_t to_nanoseconds(Msg::tracing::clock::duration duration) noexcept
+	{
+		const auto count =
+		  std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		return count > 0 ? static_cast<std::uint64_t>(count) : 0;
+	}
+#endif
+
+	double to_microseconds(std::uint64_t nanoseconds) noexcept
+	{
+		return static_cast<double>(nanoseconds) / 1000;
+	}
+} // namespace
+
+void Msg::tracing::recordEnqueue(Direction direction, std::size_t type, std::size_t depth) noexcept
+{
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+	if(TypeHistograms* histograms_ = histograms(direction, type))
+	{
+		histograms_->depth.record(depth);
+	}
+#else
+	static_cast<void>(direction);
+	static_cast<void>(type);
+	static_cast<void>(depth);
+#endif
+}
+
+void Msg::tracing::recordDequeue(Direction direction,
+                                 std::size_t type,
+                                 clock::time_point enqueued) noexcept
+{
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+	if(TypeHistograms* histograms_ = histograms(direction, type))
+	{
+		histograms_->wait.record(to_nanoseconds(clock::now() - enqueued));
+	}
+#else
+	static_cast<void>(direction);
+	static_cast<void>(type);
+	static_cast<void>(enqueued);
+#endif
+}
+
+void Msg::tracing::recordHandler(Direction direction,
+                                 std::size_t type,
+                                 clock::duration duration) noexcept
+{
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+	if(TypeHistograms* histograms_ = histograms(direction, type))
+	{
+		histograms_->handler.record(to_nanoseconds(duration));
+	}
+#else
+	static_cast<void>(direction);
+	static_cast<void>(type);
+	static_cast<void>(duration);
+#endif
+}
+
+std::vector<Msg::tracing::Entry> Msg::tracing::dump()
+{
+	std::vector<Entry> entries;
+#if defined(MAGICPLAYER_MESSAGE_TRACING)
+	std::vector<std::shared_ptr<const ThreadHistograms>> threads;
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex());
+		threads = registry();
+	}
+
+	for(const Direction direction: {Direction::IN, Direction::OUT})
+	{
+		for(std::size_t type = 0; type < type_count(direction); ++type)
+		{
+			Entry entry{direction, type_name(direction, type), {}, {}, {}};
+			for(const std::shared_ptr<const ThreadHistograms>& thread: threads)
+			{
+				const TypeHistograms& histograms_ =
+				  thread->types[static_cast<std::size_t>(direction)][type];
+				histograms_.depth.add_to(entry.depth);
+				histograms_.wait.add_to(entry.wait);
+				histograms_.handler.add_to(entry.handler);
+			}
+			if(entry.depth.count != 0 || entry.wait.count != 0 || entry.handler.count != 0)
+			{
+				entries.push_back(entry);
+			}
+		}
+	}
+#endif
+	return entries;
+}
+
+void Msg::tracing::log(spdlog::logger& logger)
+{
+	for(const Entry& entry: dump())
+	{
+		logger.info(
+		  "{} {}: {} messages, depth p50 {} p99 {} max {}, wait p50 {:.1f}us p99 {:.1f}us p999 "
+		  "{:.1f}us max {:.1f}us, handler p50 {:.1f}us p99 {:.1f}us p999 {:.1f}us max {:.1f}us",
+		  entry.direction == Direction::IN ? "In" : "Out",
+		  entry.type,
+		  entry.wait.count,
+		  entry.depth.percentile(0.5),
+		  entry.depth.percentile(0.99),
+		  entry.depth.max,
+		  to_microseconds(entry.wait.percentile(0.5)),
+		  to_microseconds(entry.wait.percentile(0.99)),
+		  to_microseconds(entry.wait.percentile(0.999)),
+		  to_microseconds(entry.wait.max),
+		  to_microseconds(entry.handler.percentile(0.5)),
+		  to_microseconds(entry.handler.percentile(0.99)),
+		  to_microseconds(entry.handler.percentile(0.999)),
+		  to_microseconds(entry.handler.max));
+	}
+}
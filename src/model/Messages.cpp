@@ -8,19 +8,41 @@
 #include "model/Messages.hpp"
 #include "utils/log.hpp"
 
-Msg::In::Open::Open(utf8_path path_): path(std::move(path_))
+#include <array>
+#include <iterator>
+
+namespace
+{
+	template<typename... Alternatives>
+	constexpr std::array<bool, sizeof...(Alternatives)>
+	latest_wins_alternatives(const std::variant<Alternatives...>*) noexcept
+	{
+		return {Msg::is_latest_wins<Alternatives>::value...};
+	}
+
+	// by Msg::Com::InMessage alternative index
+	constexpr auto IS_LATEST_WINS =
+	  latest_wins_alternatives(static_cast<const Msg::Com::InMessage*>(nullptr));
+} // namespace
+
+Msg::In::Open::Open(utf8_path path_, ZoneId zone_): path(std::move(path_)), zone(zone_)
 {
 }
 
-Msg::In::Control::Control(Control::Action action_): action(action_)
+Msg::In::Enqueue::Enqueue(utf8_path path_, ZoneId zone_): path(std::move(path_)), zone(zone_)
 {
 }
 
-Msg::In::Volume::Volume(bool muted_, float volume_): muted(muted_), volume(volume_)
+Msg::In::Control::Control(Control::Action action_, ZoneId zone_): action(action_), zone(zone_)
 {
 }
 
-Msg::In::MusicOffset::MusicOffset(float seconds_): seconds(seconds_)
+Msg::In::Volume::Volume(bool muted_, float volume_, ZoneId zone_)
+  : muted(muted_), volume(volume_), zone(zone_)
+{
+}
+
+Msg::In::MusicOffset::MusicOffset(float seconds_, ZoneId zone_): seconds(seconds_), zone(zone_)
 {
 }
 
@@ -33,12 +55,159 @@ Msg::In::RequestDatabase::RequestDatabase(bool generate_new_): generate_new(gene
 {
 }
 
-Msg::Out::MusicOffset::MusicOffset(float seconds_): seconds(seconds_)
+Msg::In::InnerTrackEnded::InnerTrackEnded(bool next_started_,
+                                          std::uint64_t track_id_,
+                                          ZoneId zone_)
+  : next_started(next_started_), track_id(track_id_), zone(zone_)
+{
+}
+
+Msg::Com::InEnvelope::InEnvelope(InMessage message_)
+  : message(std::move(message_)), sent(std::chrono::steady_clock::now())
+{
+}
+
+Msg::Lane Msg::Com::lane(const InMessage& message) noexcept
+{
+	return std::visit(
+	  [](const auto& message_) noexcept {
+		  using message_type = std::decay_t<decltype(message_)>;
+		  if constexpr(is_latest_wins<message_type>::value
+		               || std::is_same<message_type, In::Control>::value)
+		  {
+			  return Lane::CONTROL;
+		  }
+		  else if constexpr(std::is_same<message_type, In::InnerTrackEnded>::value)
+		  {
+			  return Lane::EVENTS;
+		  }
+		  else
+		  {
+			  return Lane::REQUESTS;
+		  }
+	  },
+	  message);
+}
+
+void Msg::Com::sendInMessages(std::vector<InEnvelope>& messages)
+{
+	std::vector<InEnvelope>::iterator queued = messages.begin();
+	for(InEnvelope& envelope: messages)
+	{
+		if(!coalesce(envelope))
+		{
+			closeCoalescing(envelope.message);
+			if(&*queued != &envelope)
+			{
+				*queued = std::move(envelope);
+			}
+			++queued;
+		}
+	}
+	const auto count = static_cast<std::size_t>(std::distance(messages.begin(), queued));
+	in.push_back(std::make_move_iterator(messages.begin()), std::make_move_iterator(queued));
+	if constexpr(tracing::ENABLED)
+	{
+		// the whole batch is queued at once, the depth includes it
+		const std::size_t depth = in.size();
+		for(std::size_t i = 0; i < count; ++i)
+		{
+			tracing::recordEnqueue(tracing::Direction::IN, messages[i].message.index(), depth);
+		}
+	}
+	messages.clear();
+}
+
+void Msg::Com::takeLatest(InEnvelope& envelope)
 {
+	CoalescingSlot* slot = coalescingSlot(envelope.message);
+	if(slot == nullptr)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(slot->mutex);
+	assert(!slot->queued.empty());
+	std::optional<InMessage> latest = std::move(slot->queued.front());
+	slot->queued.pop_front();
+	if(slot->queued.empty())
+	{
+		slot->open = false;
+	}
+	if(latest)
+	{
+		// the waiting time starts with the first message
+		envelope.message = std::move(*latest);
+	}
 }
 
-Msg::Out::MusicInfo::MusicInfo(bool valid_, float durationSeconds_)
-  : valid(valid_), durationSeconds(durationSeconds_)
+std::uint64_t Msg::Com::coalescedCount() const noexcept
+{
+	return m_coalesced.load(std::memory_order_relaxed);
+}
+
+Msg::Com::CoalescingSlot* Msg::Com::coalescingSlot(const InMessage& message) noexcept
+{
+	return std::visit(
+	  [&](const auto& message_) noexcept -> CoalescingSlot* {
+		  using message_type = std::decay_t<decltype(message_)>;
+		  if constexpr(is_latest_wins<message_type>::value)
+		  {
+			  if(message_.zone < MAX_ZONES)
+			  {
+				  return &m_coalescing_slots[message.index() * MAX_ZONES + message_.zone];
+			  }
+		  }
+		  return nullptr;
+	  },
+	  message);
+}
+
+bool Msg::Com::coalesce(InEnvelope& envelope)
+{
+	CoalescingSlot* slot = coalescingSlot(envelope.message);
+	if(slot == nullptr)
+	{
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(slot->mutex);
+	if(!slot->open)
+	{
+		slot->queued.emplace_back();
+		slot->open = true;
+		return false;
+	}
+	slot->queued.back() = std::move(envelope.message);
+	m_coalesced.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void Msg::Com::closeCoalescing(const InMessage& message)
+{
+	std::visit(
+	  [&](const auto& message_) {
+		  using message_type = std::decay_t<decltype(message_)>;
+		  if constexpr(closes_coalescing<message_type>::value)
+		  {
+			  if(message_.zone >= MAX_ZONES)
+			  {
+				  return;
+			  }
+			  for(std::size_t i = 0; i < IS_LATEST_WINS.size(); ++i)
+			  {
+				  if(IS_LATEST_WINS[i])
+				  {
+					  CoalescingSlot& slot = m_coalescing_slots[i * MAX_ZONES + message_.zone];
+					  std::lock_guard<std::mutex> lock(slot.mutex);
+					  slot.open = false;
+				  }
+			  }
+		  }
+	  },
+	  message);
+}
+
+Msg::Out::MusicInfo::MusicInfo(bool valid_, float durationSeconds_, ZoneId zone_)
+  : valid(valid_), durationSeconds(durationSeconds_), zone(zone_)
 {
 }
 
@@ -62,10 +231,97 @@ Msg::Out::Settings::Settings(data::Settings settings_): settings(std::move(setti
 {
 }
 
+Msg::Out::Waveform::Waveform(std::shared_ptr<const data::Waveform> waveform_)
+  : waveform(std::move(waveform_))
+{
+	assert(waveform != nullptr);
+}
+
 Msg::Sender::Sender(Msg::Com& com) noexcept: m_com(com)
 {
 }
 
+Msg::Lane Msg::LaneRouter::route(const Com::InMessage& message) noexcept
+{
+	Lane lane = Com::lane(message);
+	if(lane == Lane::CONTROL)
+	{
+		const bool ordered = std::visit(
+		  [this](const auto& message_) noexcept {
+			  if constexpr(has_zone<std::decay_t<decltype(message_)>>::value)
+			  {
+				  return message_.zone < MAX_ZONES && m_zone_requests[message_.zone] != 0;
+			  }
+			  else
+			  {
+				  return false;
+			  }
+		  },
+		  message);
+		if(ordered || m_all_zones_requests != 0)
+		{
+			lane = Lane::REQUESTS;
+		}
+	}
+	if(lane == Lane::REQUESTS)
+	{
+		count(message, true);
+	}
+	return lane;
+}
+
+void Msg::LaneRouter::dispatched(Lane lane, const Com::InMessage& message) noexcept
+{
+	if(lane == Lane::REQUESTS)
+	{
+		count(message, false);
+	}
+}
+
+void Msg::LaneRouter::count(const Com::InMessage& message, bool queued) noexcept
+{
+	std::visit(
+	  [&](const auto& message_) noexcept {
+		  using message_type = std::decay_t<decltype(message_)>;
+		  std::size_t* requests = nullptr;
+		  if constexpr(orders_all_zones<message_type>::value)
+		  {
+			  requests = &m_all_zones_requests;
+		  }
+		  else if constexpr(has_zone<message_type>::value)
+		  {
+			  if(message_.zone < MAX_ZONES)
+			  {
+				  requests = &m_zone_requests[message_.zone];
+			  }
+		  }
+		  if(requests == nullptr)
+		  {
+			  return;
+		  }
+		  if(queued)
+		  {
+			  ++*requests;
+		  }
+		  else
+		  {
+			  assert(*requests != 0);
+			  --*requests;
+		  }
+	  },
+	  message);
+}
+
+std::ostream& Msg::operator<<(std::ostream& os, const Msg::Lane& l)
+{
+	constexpr const char* LANE_STR[] = {
+	  "CONTROL",
+	  "EVENTS",
+	  "REQUESTS",
+	};
+	return os << LANE_STR[static_cast<std::size_t>(l)];
+}
+
 std::ostream& Msg::In::operator<<(std::ostream& os, [[maybe_unused]] const Msg::In::Close& m)
 {
 	return os << "Close{}";
@@ -74,7 +330,15 @@ std::ostream& Msg::In::operator<<(std::ostream& os, [[maybe_unused]] const Msg::
 std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Open& m)
 {
 	return os << "Open{"
-	          << "path: " << m.path << "}";
+	          << "path: " << m.path << ","
+	          << "zone: " << m.zone << "}";
+}
+
+std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Enqueue& m)
+{
+	return os << "Enqueue{"
+	          << "path: " << m.path << ","
+	          << "zone: " << m.zone << "}";
 }
 
 std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Control::Action& a)
@@ -91,7 +355,8 @@ std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Control::Acti
 std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Control& m)
 {
 	return os << "Control{"
-	          << "action: " << m.action << "}";
+	          << "action: " << m.action << ","
+	          << "zone: " << m.zone << "}";
 }
 
 std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Volume& m)
@@ -99,19 +364,15 @@ std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Volume& m)
 	ostream_config_guard guard(os, std::boolalpha, std::fixed, std::setprecision(2));
 	return os << "Volume{"
 	          << "muted: " << m.muted << ","
-	          << "volume:" << m.volume << "}";
+	          << "volume:" << m.volume << ","
+	          << "zone: " << m.zone << "}";
 }
 
 std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::MusicOffset& m)
 {
 	return os << "MusicOffset{"
-	          << "seconds: " << m.seconds << "}";
-}
-
-std::ostream& Msg::In::operator<<(std::ostream& os,
-                                  [[maybe_unused]] const Msg::In::RequestMusicOffset& m)
-{
-	return os << "RequestMusicOffset{}";
+	          << "seconds: " << m.seconds << ","
+	          << "zone: " << m.zone << "}";
 }
 
 std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::Settings& m)
@@ -129,16 +390,13 @@ std::ostream& Msg::In::operator<<(std::ostream& os, const RequestDatabase& m)
 	          << "generate_new: " << m.generate_new << "}";
 }
 
-std::ostream& Msg::In::operator<<(std::ostream& os,
-                                  [[maybe_unused]] const Msg::In::InnerTaskEnded& m)
-{
-	return os << "InnerTaskEnded{}";
-}
-
-std::ostream& Msg::Out::operator<<(std::ostream& os, const Msg::Out::MusicOffset& m)
+std::ostream& Msg::In::operator<<(std::ostream& os, const Msg::In::InnerTrackEnded& m)
 {
-	return os << "MusicOffset{"
-	          << "seconds: " << m.seconds << "}";
+	ostream_config_guard guard(os, std::boolalpha);
+	return os << "InnerTrackEnded{"
+	          << "next_started: " << m.next_started << ","
+	          << "track_id: " << m.track_id << ","
+	          << "zone: " << m.zone << "}";
 }
 
 std::ostream& Msg::Out::operator<<(std::ostream& os, const Msg::Out::MusicInfo& m)
@@ -146,7 +404,8 @@ std::ostream& Msg::Out::operator<<(std::ostream& os, const Msg::Out::MusicInfo&
 	ostream_config_guard guard(os, std::boolalpha, std::fixed, std::setprecision(2));
 	return os << "MusicInfo{"
 	          << "valid: " << m.valid << ","
-	          << "durationSeconds:" << m.durationSeconds << "}";
+	          << "durationSeconds:" << m.durationSeconds << ","
+	          << "zone: " << m.zone << "}";
 }
 
 std::ostream& Msg::Out::operator<<(std::ostream& os, const Msg::Out::FolderContent& m)
@@ -182,3 +441,9 @@ std::ostream& Msg::Out::operator<<(std::ostream& os, const Msg::Out::Settings& m
 	return os << "Settings{"
 	          << "settings: " << m.settings << "}";
 }
+
+std::ostream& Msg::Out::operator<<(std::ostream& os, const Msg::Out::Waveform& m)
+{
+	return os << "Waveform{"
+	          << "waveform: " << *m.waveform << "}";
+}
@@ -0,0 +1,198 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "utils/event_poller.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+
+#if defined(MAGICPLAYER_EVENT_POLLER_EPOLL)
+#	include <sys/epoll.h>
+#	include <unistd.h>
+#elif defined(MAGICPLAYER_EVENT_POLLER_POLL)
+#	include <poll.h>
+#endif
+
+#if defined(MAGICPLAYER_EVENT_POLLER_EPOLL)
+
+namespace
+{
+	// events returned by one epoll_wait call, the others are returned by the next ones
+	constexpr int MAX_EVENTS = 256;
+
+	epoll_event make_event(int fd, bool watch_writable) noexcept
+	{
+		epoll_event event{};
+		event.events = EPOLLIN | (watch_writable ? EPOLLOUT : 0u);
+		event.data.fd = fd;
+		return event;
+	}
+} // namespace
+
+event_poller::event_poller() noexcept: m_epoll_fd(::epoll_create1(EPOLL_CLOEXEC)), m_fd_count(0)
+{
+}
+
+event_poller::~event_poller() noexcept
+{
+	if(m_epoll_fd >= 0)
+	{
+		::close(m_epoll_fd);
+	}
+}
+
+bool event_poller::valid() const noexcept
+{
+	return m_epoll_fd >= 0;
+}
+
+bool event_poller::add(int fd, bool watch_writable)
+{
+	epoll_event epoll_ev = make_event(fd, watch_writable);
+	if(::epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &epoll_ev) != 0)
+	{
+		return false;
+	}
+	++m_fd_count;
+	return true;
+}
+
+bool event_poller::modify(int fd, bool watch_writable)
+{
+	epoll_event epoll_ev = make_event(fd, watch_writable);
+	return ::epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &epoll_ev) == 0;
+}
+
+void event_poller::remove(int fd)
+{
+	if(::epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr) == 0)
+	{
+		--m_fd_count;
+	}
+}
+
+bool event_poller::wait(std::vector<event>& events, int timeout_ms)
+{
+	epoll_event epoll_events[MAX_EVENTS];
+	const int max_events = static_cast<int>(std::clamp<std::size_t>(m_fd_count, 1, MAX_EVENTS));
+	const int count = ::epoll_wait(m_epoll_fd, epoll_events, max_events, timeout_ms);
+	events.clear();
+	if(count < 0)
+	{
+		return errno == EINTR;
+	}
+	for(int i = 0; i < count; ++i)
+	{
+		const std::uint32_t flags = epoll_events[i].events;
+		events.push_back({epoll_events[i].data.fd,
+		                  (flags & EPOLLIN) != 0,
+		                  (flags & EPOLLOUT) != 0,
+		                  (flags & (EPOLLERR | EPOLLHUP)) != 0});
+	}
+	return true;
+}
+
+#elif defined(MAGICPLAYER_EVENT_POLLER_POLL)
+
+event_poller::event_poller() noexcept: m_watched()
+{
+}
+
+event_poller::~event_poller() noexcept = default;
+
+bool event_poller::valid() const noexcept
+{
+	return true;
+}
+
+bool event_poller::add(int fd, bool watch_writable)
+{
+	m_watched.push_back({fd, watch_writable});
+	return true;
+}
+
+bool event_poller::modify(int fd, bool watch_writable)
+{
+	auto it = std::find_if(
+	  m_watched.begin(), m_watched.end(), [fd](const watched& item) { return item.fd == fd; });
+	if(it == m_watched.end())
+	{
+		return false;
+	}
+	it->writable = watch_writable;
+	return true;
+}
+
+void event_poller::remove(int fd)
+{
+	m_watched.erase(
+	  std::remove_if(
+	    m_watched.begin(), m_watched.end(), [fd](const watched& item) { return item.fd == fd; }),
+	  m_watched.end());
+}
+
+bool event_poller::wait(std::vector<event>& events, int timeout_ms)
+{
+	std::vector<pollfd> poll_fds;
+	poll_fds.reserve(m_watched.size());
+	for(const watched& item: m_watched)
+	{
+		poll_fds.push_back(
+		  {item.fd, static_cast<short>(item.writable ? POLLIN | POLLOUT : POLLIN), 0});
+	}
+	const int count = ::poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), timeout_ms);
+	events.clear();
+	if(count < 0)
+	{
+		return errno == EINTR;
+	}
+	for(const pollfd& poll_fd: poll_fds)
+	{
+		if(poll_fd.revents != 0)
+		{
+			events.push_back({poll_fd.fd,
+			                  (poll_fd.revents & POLLIN) != 0,
+			                  (poll_fd.revents & POLLOUT) != 0,
+			                  (poll_fd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0});
+		}
+	}
+	return true;
+}
+
+#else
+
+event_poller::event_poller() noexcept = default;
+
+event_poller::~event_poller() noexcept = default;
+
+bool event_poller::valid() const noexcept
+{
+	return false;
+}
+
+bool event_poller::add(int, bool)
+{
+	return false;
+}
+
+bool event_poller::modify(int, bool)
+{
+	return false;
+}
+
+void event_poller::remove(int)
+{
+}
+
+bool event_poller::wait(std::vector<event>& events, int)
+{
+	events.clear();
+	return false;
+}
+
+#endif
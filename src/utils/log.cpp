@@ -45,7 +45,7 @@ namespace
 	TagLibLogger TAGLIB_LOGGER;
 } // namespace
 
-bool init_logger()
+bool init_logger(bool store_logs)
 {
 	assert(NULL_LOGGER != nullptr);
 	try
@@ -54,9 +54,12 @@ bool init_logger()
 		std::vector<spdlog::sink_ptr> sinks;
 
 		// Store sink
-		assert(STORED_LOGS != nullptr);
-		STORED_LOGS->set_level(spdlog::level::trace);
-		sinks.push_back(STORED_LOGS);
+		if(store_logs)
+		{
+			assert(STORED_LOGS != nullptr);
+			STORED_LOGS->set_level(spdlog::level::trace);
+			sinks.push_back(STORED_LOGS);
+		}
 
 		// File sink
 		std::shared_ptr<spdlog::sinks::sink> file_sink =
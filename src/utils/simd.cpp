@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "utils/simd.hpp"
+
+#if defined(MAGICPLAYER_SIMD_AVX2) && defined(_MSC_VER)
+#	include <intrin.h>
+#	include <immintrin.h>
+#endif
+
+namespace
+{
+	bool detect_avx2() noexcept
+	{
+#if !defined(MAGICPLAYER_SIMD_AVX2)
+		return false;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if(info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+} // namespace
+
+bool simd::has_sse2() noexcept
+{
+#if defined(MAGICPLAYER_SIMD_SSE2)
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool simd::has_avx2() noexcept
+{
+	static const bool avx2 = detect_avx2();
+	return avx2;
+}
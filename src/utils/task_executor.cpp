@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "utils/task_executor.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// worker of the current thread, tasks submitted by a task stay on their worker
+	thread_local const task_executor* CURRENT_EXECUTOR = nullptr;
+	thread_local std::size_t CURRENT_WORKER = 0;
+} // namespace
+
+task_executor::task_executor(std::size_t thread_count)
+  : m_queues()
+  , m_threads()
+  , m_next_queue(0)
+  , m_pending(0)
+  , m_mutex()
+  , m_cond()
+  , m_stopped(false)
+{
+	thread_count = std::max<std::size_t>(thread_count, 1);
+	m_queues.reserve(thread_count);
+	for(std::size_t i = 0; i < thread_count; ++i)
+	{
+		m_queues.push_back(std::make_unique<worker_queue>());
+	}
+	m_threads.reserve(thread_count);
+	for(std::size_t i = 0; i < thread_count; ++i)
+	{
+		m_threads.emplace_back([this, i]() { work(i); });
+	}
+}
+
+task_executor::~task_executor() noexcept
+{
+	stop();
+}
+
+void task_executor::stop() noexcept
+{
+	if(m_stopped.exchange(true, std::memory_order_acq_rel))
+	{
+		return;
+	}
+	// the sleeping workers check the stop flag under the lock
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_cond.notify_all();
+	for(std::thread& thread: m_threads)
+	{
+		thread.join();
+	}
+
+	for(std::unique_ptr<worker_queue>& queue: m_queues)
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		for(std::deque<std::unique_ptr<task>>& tasks: queue->tasks)
+		{
+			tasks.clear();
+		}
+	}
+	m_pending.store(0, std::memory_order_relaxed);
+}
+
+std::size_t task_executor::threadCount() const noexcept
+{
+	return m_threads.size();
+}
+
+std::size_t task_executor::pendingCount() const noexcept
+{
+	return m_pending.load(std::memory_order_relaxed);
+}
+
+void task_executor::push(std::unique_ptr<task> task_, priority priority_)
+{
+	if(m_stopped.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	const std::size_t queue_index = CURRENT_EXECUTOR == this
+	                                  ? CURRENT_WORKER
+	                                  : m_next_queue.fetch_add(1, std::memory_order_relaxed)
+	                                      % m_queues.size();
+	worker_queue& queue = *m_queues[queue_index];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks[static_cast<std::size_t>(priority_)].push_back(std::move(task_));
+	}
+	m_pending.fetch_add(1, std::memory_order_release);
+
+	// the sleeping workers check the pending count under the lock
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_cond.notify_one();
+}
+
+std::unique_ptr<task_executor::task> task_executor::take(std::size_t worker)
+{
+	for(std::size_t priority_ = 0; priority_ < PRIORITY_COUNT; ++priority_)
+	{
+		for(std::size_t i = 0; i < m_queues.size(); ++i)
+		{
+			const bool own = (i == 0);
+			worker_queue& queue = *m_queues[(worker + i) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			std::deque<std::unique_ptr<task>>& tasks = queue.tasks[priority_];
+			if(tasks.empty())
+			{
+				continue;
+			}
+			std::unique_ptr<task> task_;
+			if(own)
+			{
+				task_ = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			else
+			{
+				task_ = std::move(tasks.back());
+				tasks.pop_back();
+			}
+			m_pending.fetch_sub(1, std::memory_order_relaxed);
+			return task_;
+		}
+	}
+	return nullptr;
+}
+
+void task_executor::work(std::size_t worker) noexcept
+{
+	CURRENT_EXECUTOR = this;
+	CURRENT_WORKER = worker;
+	while(!m_stopped.load(std::memory_order_acquire))
+	{
+		if(std::unique_ptr<task> task_ = take(worker))
+		{
+			task_->run();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [this]() {
+			return m_stopped.load(std::memory_order_acquire)
+			       || m_pending.load(std::memory_order_acquire) != 0;
+		});
+	}
+}
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "utils/wake_signal.hpp"
+
+#if defined(MAGICPLAYER_WAKE_SIGNAL_FUTEX)
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <ctime>
+#	include <unistd.h>
+#endif
+
+#if defined(MAGICPLAYER_WAKE_SIGNAL_FUTEX)
+
+namespace
+{
+	static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+	              "futex word must be a plain 32 bits integer");
+
+	std::uint32_t* futex_word(std::atomic<std::uint32_t>& atomic) noexcept
+	{
+		return reinterpret_cast<std::uint32_t*>(&atomic);
+	}
+} // namespace
+
+#endif
+
+wake_signal::wake_signal() noexcept: m_sequence(0), m_sleeping(false)
+{
+}
+
+std::uint32_t wake_signal::prepare() noexcept
+{
+	const std::uint32_t token = m_sequence.load(std::memory_order_acquire);
+	// seq_cst: ordered with the notifier condition store, one of the two sees the other
+	m_sleeping.store(true, std::memory_order_seq_cst);
+	return token;
+}
+
+void wake_signal::cancel() noexcept
+{
+	m_sleeping.store(false, std::memory_order_relaxed);
+}
+
+#if defined(MAGICPLAYER_WAKE_SIGNAL_FUTEX)
+
+void wake_signal::wait(std::uint32_t token) noexcept
+{
+	// returns at once if the sequence changed since prepare(), spurious wake ups are fine:
+	// the waiter checks its condition again
+	::syscall(SYS_futex,
+	          futex_word(m_sequence),
+	          FUTEX_WAIT_PRIVATE,
+	          token,
+	          nullptr,
+	          nullptr,
+	          0);
+	m_sleeping.store(false, std::memory_order_relaxed);
+}
+
+void wake_signal::wait_for(std::uint32_t token, std::chrono::nanoseconds timeout) noexcept
+{
+	const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+	timespec relative_timeout{};
+	relative_timeout.tv_sec = static_cast<decltype(relative_timeout.tv_sec)>(seconds.count());
+	relative_timeout.tv_nsec =
+	  static_cast<decltype(relative_timeout.tv_nsec)>((timeout - seconds).count());
+	::syscall(SYS_futex,
+	          futex_word(m_sequence),
+	          FUTEX_WAIT_PRIVATE,
+	          token,
+	          &relative_timeout,
+	          nullptr,
+	          0);
+	m_sleeping.store(false, std::memory_order_relaxed);
+}
+
+void wake_signal::wake() noexcept
+{
+	m_sequence.fetch_add(1, std::memory_order_release);
+	::syscall(SYS_futex, futex_word(m_sequence), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+#else
+
+void wake_signal::wait(std::uint32_t token) noexcept
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cond.wait(lock, [&]() { return m_sequence.load(std::memory_order_relaxed) != token; });
+	lock.unlock();
+	m_sleeping.store(false, std::memory_order_relaxed);
+}
+
+void wake_signal::wait_for(std::uint32_t token, std::chrono::nanoseconds timeout) noexcept
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cond.wait_for(
+	  lock, timeout, [&]() { return m_sequence.load(std::memory_order_relaxed) != token; });
+	lock.unlock();
+	m_sleeping.store(false, std::memory_order_relaxed);
+}
+
+void wake_signal::wake() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_sequence.fetch_add(1, std::memory_order_release);
+	}
+	m_cond.notify_one();
+}
+
+#endif
@@ -21,6 +21,9 @@
 #include <SFML/Graphics/RenderWindow.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
+
 namespace
 {
 	constexpr const char* WINDOW_NAME = "MagicPlayer";
@@ -28,12 +31,22 @@ namespace
 	constexpr unsigned int WINDOW_INITIAL_HEIGHT = 600;
 	constexpr unsigned int FRAME_RATE_LIMIT = 60;
 
+	// idle rendering: full frame rate for a while after an input or a message (hovered items,
+	// tooltips delays and imgui animations), a low rate for the playback position while
+	// playing, no frame otherwise
+	constexpr std::chrono::milliseconds ACTIVE_DURATION(500);
+	constexpr unsigned int PLAYING_FRAME_RATE = 10;
+	// SFML can't wait for a window event and a message at the same time,
+	// the window events are polled at this period while idle
+	constexpr std::chrono::milliseconds IDLE_POLL_PERIOD(20);
+
 	constexpr const char* INNER_WINDOW_MAIN_NAME = "Main";
 	constexpr const char* MAIN_DOCKSPACE_NAME = "Main dockspace";
 	constexpr const char* INNER_WINDOW_PLAYER_NAME = "Player";
 	constexpr const char* INNER_WINDOW_EXPLORER_NAME = "Explorer";
 	constexpr const char* INNER_WINDOW_LOG_VIEWER_NAME = "Log viewer";
 	constexpr const char* INNER_WINDOW_SETTINGS_EDITOR_NAME = "Settings";
+	constexpr const char* INNER_WINDOW_SPECTRUM_NAME = "Spectrum";
 
 	constexpr const char* MENU_SETTING_TXT = ICON_FA_WRENCH " Settings";
 	constexpr const char* MENU_THEME_TXT = ICON_FA_PAINT_BRUSH " Theme";
@@ -41,17 +54,22 @@ namespace
 } // namespace
 
 template<>
-void GUI::handleMessage(Msg::Out::MusicOffset& message)
+void GUI::handleMessage(Msg::Out::MusicInfo& message)
 {
+	if(message.zone != Msg::MAIN_ZONE)
+	{
+		return;
+	}
+	m_logger->info("Received music information: valid = {}, duration = {:.2f} seconds",
+	               message.valid,
+	               message.durationSeconds);
 	m_player.processMessage(message);
 }
 
 template<>
-void GUI::handleMessage(Msg::Out::MusicInfo& message)
+void GUI::handleMessage(Msg::Out::Waveform& message)
 {
-	m_logger->info("Received music information: valid = {}, duration = {:.2f} seconds",
-	               message.valid,
-	               message.durationSeconds);
+	SPDLOG_DEBUG(m_logger, "Received waveform: {}", *message.waveform);
 	m_player.processMessage(message);
 }
 
@@ -78,18 +96,27 @@ void GUI::handleMessage(Msg::Out::Settings& message)
 	m_settingsEditor.processMessage(message);
 }
 
-GUI::GUI(Msg::Com& com_)
+GUI::GUI(Msg::Com& com_, bool idle_rendering)
   : m_com(com_)
+  , m_idle_rendering(idle_rendering)
+  , m_wake(std::make_shared<wake_signal>())
   , m_showThemeConfigWindow(false)
   , m_showLogViewerWindow(false)
   , m_showSettingsEditor(false)
   , m_style(ImGui::ETheming::ColorTheme::ArcDark)
   , m_explorer(INNER_WINDOW_EXPLORER_NAME, Msg::Sender(m_com))
-  , m_player(INNER_WINDOW_PLAYER_NAME, Msg::Sender(m_com))
+  , m_player(INNER_WINDOW_PLAYER_NAME, Msg::Sender(m_com), m_com.playback[Msg::MAIN_ZONE])
   , m_log_viewer(INNER_WINDOW_LOG_VIEWER_NAME)
   , m_settingsEditor(INNER_WINDOW_SETTINGS_EDITOR_NAME, Msg::Sender(m_com))
+  , m_spectrum_viewer(INNER_WINDOW_SPECTRUM_NAME, m_com.spectrum, m_com.spectrum_enabled)
+  , m_messages()
   , m_logger(spdlog::get(VIEW_LOGGER_NAME))
 {
+	m_com.out_listener = [wake = m_wake]() {
+		// the out queue size is updated relaxed, ordered with the waiter fence
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		wake->notify();
+	};
 }
 
 int GUI::run()
@@ -106,12 +133,17 @@ int GUI::run()
 	setupFonts();
 	setupStyle();
 
+	std::chrono::steady_clock::time_point active_until =
+	  std::chrono::steady_clock::now() + ACTIVE_DURATION;
+	std::chrono::steady_clock::time_point last_frame{};
 	while(window.isOpen())
 	{
+		bool active = false;
 		sf::Event event{};
 		while(window.pollEvent(event))
 		{
 			ImGui::SFML::ProcessEvent(event);
+			active = true;
 
 			if(event.type == sf::Event::Closed)
 			{
@@ -120,7 +152,28 @@ int GUI::run()
 		}
 
 		// Process messages
-		processMessages();
+		active |= processMessages();
+
+		if(m_idle_rendering)
+		{
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if(active)
+			{
+				active_until = now + ACTIVE_DURATION;
+			}
+			const std::optional<std::chrono::steady_clock::duration> period = animationPeriod();
+			if(now >= active_until && (!period || now - last_frame < *period))
+			{
+				std::chrono::steady_clock::duration timeout = IDLE_POLL_PERIOD;
+				if(period)
+				{
+					timeout = std::min(timeout, last_frame + *period - now);
+				}
+				waitMessages(timeout);
+				continue;
+			}
+			last_frame = now;
+		}
 
 		ImGui::SFML::Update(window, deltaClock.restart());
 
@@ -145,6 +198,7 @@ void GUI::show()
 	showMainDockspace();
 	m_explorer.show();
 	m_player.show();
+	m_spectrum_viewer.show();
 
 	if(m_showThemeConfigWindow)
 	{
@@ -246,9 +300,12 @@ void GUI::showMainDockspace()
 		ImGuiID dock_main_id = dockspace_id;
 		ImGuiID dock_id_bottom =
 		  ImGui::DockBuilderSplitNode(dock_main_id, ImGuiDir_Down, 0.12f, nullptr, &dock_main_id);
+		ImGuiID dock_id_right =
+		  ImGui::DockBuilderSplitNode(dock_main_id, ImGuiDir_Right, 0.3f, nullptr, &dock_main_id);
 
 		ImGui::DockBuilderDockWindow(INNER_WINDOW_EXPLORER_NAME, dock_main_id);
 		ImGui::DockBuilderDockWindow(INNER_WINDOW_PLAYER_NAME, dock_id_bottom);
+		ImGui::DockBuilderDockWindow(INNER_WINDOW_SPECTRUM_NAME, dock_id_right);
 		ImGui::DockBuilderFinish(dockspace_id);
 		SPDLOG_DEBUG(m_logger, "Set initial position of windows in the main dockspace");
 	}
@@ -292,21 +349,63 @@ void GUI::loadInitialConfig()
 	m_player.init();
 	m_log_viewer.init();
 	m_settingsEditor.init();
+	m_spectrum_viewer.init();
 
 	SPDLOG_DEBUG(m_logger, "Sent initial config messages");
 }
 
-void GUI::processMessages()
+bool GUI::processMessages()
 {
-	while(!m_com.out.empty())
+	// one lock per frame, the messages are handled in place
+	m_com.out.swap_all(m_messages);
+	for(Msg::Com::OutEnvelope& envelope: m_messages)
 	{
-		Msg::Com::OutMessage message_ = m_com.out.front();
+		const std::size_t type = envelope.message.index();
+		[[maybe_unused]] Msg::tracing::clock::time_point handler_start;
+		if constexpr(Msg::tracing::ENABLED)
+		{
+			Msg::tracing::recordDequeue(Msg::tracing::Direction::OUT, type, envelope.enqueued());
+			handler_start = Msg::tracing::clock::now();
+		}
 		std::visit(
 		  [&](auto&& message) noexcept {
 			  SPDLOG_TRACE(m_logger, "Received message {}", message);
 			  handleMessage(message);
 		  },
-		  message_);
-		m_com.out.pop_front();
+		  envelope.message);
+		if constexpr(Msg::tracing::ENABLED)
+		{
+			Msg::tracing::recordHandler(
+			  Msg::tracing::Direction::OUT, type, Msg::tracing::clock::now() - handler_start);
+		}
+	}
+	const bool received = !m_messages.empty();
+	m_messages.clear();
+	return received;
+}
+
+std::optional<std::chrono::steady_clock::duration> GUI::animationPeriod() const
+{
+	if(m_com.playback[Msg::MAIN_ZONE].load().status != sf::SoundSource::Playing)
+	{
+		return std::nullopt;
+	}
+	// the spectrum is analyzed while its window is visible
+	const bool spectrum_visible = m_com.spectrum_enabled.load(std::memory_order_relaxed);
+	const unsigned int frame_rate = spectrum_visible ? FRAME_RATE_LIMIT : PLAYING_FRAME_RATE;
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1))
+	       / frame_rate;
+}
+
+void GUI::waitMessages(std::chrono::steady_clock::duration timeout)
+{
+	const std::uint32_t token = m_wake->prepare();
+	// the out queue size is read relaxed, ordered with the listener fence
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(!m_com.out.empty())
+	{
+		m_wake->cancel();
+		return;
 	}
+	m_wake->wait_for(token, timeout);
 }
@@ -12,10 +12,100 @@
 #endif
 #include <imgui_internal.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// The bar is drawn with one column per WAVEFORM_COLUMN_WIDTH pixels: the number of
+	// vertices depends on the bar width only, whatever the length of the track
+	constexpr float WAVEFORM_COLUMN_WIDTH = 2.0f;
+	constexpr std::size_t MAX_WAVEFORM_COLUMNS = 2048;
+
+	constexpr float SAMPLE_SCALE = -std::numeric_limits<std::int16_t>::min();
+
+	void RenderWaveform(ImDrawList* draw_list,
+	                    const ImRect& bb,
+	                    const data::Waveform& waveform,
+	                    const float fraction)
+	{
+		if(waveform.total_frames == 0)
+		{
+			return;
+		}
+
+		const std::size_t columns =
+		  std::clamp(static_cast<std::size_t>(bb.GetWidth() / WAVEFORM_COLUMN_WIDTH),
+		             std::size_t{1},
+		             MAX_WAVEFORM_COLUMNS);
+		const std::size_t level_index = waveform.levelFor(columns);
+		const std::vector<data::WaveformBin>& bins = waveform.levels[level_index];
+		const double column_bins = static_cast<double>(waveform.total_frames) / columns
+		                           / (data::Waveform::BASE_BIN_FRAMES << level_index);
+		const auto first_bin = [column_bins](std::size_t column) noexcept {
+			return static_cast<std::size_t>(column * column_bins);
+		};
+
+		// columns after the bins summarized so far are left empty
+		std::size_t drawn_columns = 0;
+		while(drawn_columns < columns && first_bin(drawn_columns) < bins.size())
+		{
+			++drawn_columns;
+		}
+		if(drawn_columns == 0)
+		{
+			return;
+		}
+
+		const float column_width = bb.GetWidth() / columns;
+		const float middle = (bb.Min.y + bb.Max.y) * 0.5f;
+		const float half_height = bb.GetHeight() * 0.5f;
+		const ImU32 played_colors[2] = {ImGui::GetColorU32(ImGuiCol_PlotHistogram),
+		                                ImGui::GetColorU32(ImGuiCol_PlotHistogramHovered)};
+		const ImU32 remaining_colors[2] = {ImGui::GetColorU32(ImGuiCol_PlotLines),
+		                                   ImGui::GetColorU32(ImGuiCol_PlotLinesHovered)};
+
+		// two rectangles per column: min/max envelope and RMS band
+		draw_list->PrimReserve(static_cast<int>(drawn_columns * 12),
+		                       static_cast<int>(drawn_columns * 8));
+		for(std::size_t column = 0; column < drawn_columns; ++column)
+		{
+			const std::size_t begin = first_bin(column);
+			const std::size_t end =
+			  std::min(std::max(first_bin(column + 1), begin + 1), bins.size());
+			std::int16_t min = bins[begin].min;
+			std::int16_t max = bins[begin].max;
+			double sum_squares = 0;
+			std::size_t count = 0;
+			for(std::size_t bin = begin; bin < end; ++bin)
+			{
+				min = std::min(min, bins[bin].min);
+				max = std::max(max, bins[bin].max);
+				sum_squares += static_cast<double>(bins[bin].rms) * bins[bin].rms;
+				++count;
+			}
+			const float rms = static_cast<float>(std::sqrt(sum_squares / count));
+
+			const float x = bb.Min.x + column * column_width;
+			const float top = std::min(middle - max / SAMPLE_SCALE * half_height, middle - 0.5f);
+			const float bottom = std::max(middle - min / SAMPLE_SCALE * half_height, middle + 0.5f);
+			const float rms_height = std::min(rms / SAMPLE_SCALE, 1.0f) * half_height;
+			const ImU32* colors =
+			  (column + 0.5f) / columns <= fraction ? played_colors : remaining_colors;
+			draw_list->PrimRect(ImVec2(x, top), ImVec2(x + column_width, bottom), colors[0]);
+			draw_list->PrimRect(ImVec2(x, middle - rms_height),
+			                    ImVec2(x + column_width, middle + rms_height),
+			                    colors[1]);
+		}
+	}
+} // namespace
+
 bool ImGuiCW::PlayerBar(const char* label,
                         float* v,
                         const float min,
                         const float max,
+                        const data::Waveform* waveform,
                         const ImVec2& size_arg)
 {
 	ImGuiWindow* window = ImGui::GetCurrentWindow();
@@ -79,12 +169,23 @@ bool ImGuiCW::PlayerBar(const char* label,
 	ImGui::RenderFrame(
 	  bb.Min, bb.Max, ImGui::GetColorU32(ImGuiCol_FrameBg), true, style.FrameRounding);
 	bb.Expand(ImVec2(-style.FrameBorderSize, -style.FrameBorderSize));
-	ImGui::RenderRectFilledRangeH(window->DrawList,
-	                              bb,
-	                              ImGui::GetColorU32(ImGuiCol_PlotHistogram),
-	                              0.0f,
-	                              fraction,
-	                              style.FrameRounding);
+	if(waveform != nullptr)
+	{
+		RenderWaveform(window->DrawList, bb, *waveform, fraction);
+		const float cursor_x = ImLerp(bb.Min.x, bb.Max.x, fraction);
+		window->DrawList->AddLine(ImVec2(cursor_x, bb.Min.y),
+		                          ImVec2(cursor_x, bb.Max.y),
+		                          ImGui::GetColorU32(ImGuiCol_SliderGrabActive));
+	}
+	else
+	{
+		ImGui::RenderRectFilledRangeH(window->DrawList,
+		                              bb,
+		                              ImGui::GetColorU32(ImGuiCol_PlotHistogram),
+		                              0.0f,
+		                              fraction,
+		                              style.FrameRounding);
+	}
 
 	return value_changed;
 }
@@ -13,18 +13,21 @@
 #include <IconsFontAwesome5.h>
 #include <imgui.h>
 
+#include <algorithm>
+#include <chrono>
+
 namespace
 {
-	constexpr float MUSIC_OFFSET_REFRESH_SECONDS = 0.05f;
 	constexpr float MUSIC_INITIAL_VOLUME = 20.0f;
 } // namespace
 
-Player::Player(std::string name, Msg::Sender sender)
+Player::Player(std::string name, Msg::Sender sender, const audio::PlaybackState& playback)
   : m_sender(sender)
   , m_name(std::move(name))
   , m_musicInfos()
+  , m_waveform()
   , m_volume(MUSIC_INITIAL_VOLUME)
-  , m_musicOffsetClock()
+  , m_playback(playback)
   , m_logger(spdlog::get(VIEW_LOGGER_NAME))
 {
 }
@@ -36,12 +39,12 @@ void Player::init()
 
 void Player::show()
 {
-	// Request music offset
-	if(m_musicInfos.valid
-	   && m_musicOffsetClock.getElapsedTime() > sf::seconds(MUSIC_OFFSET_REFRESH_SECONDS))
+	// Music offset, interpolated between the updates of the audio side
+	if(m_musicInfos.valid)
 	{
-		m_sender.sendInMessage<Msg::In::RequestMusicOffset>();
-		m_musicOffsetClock.restart();
+		const auto offset = static_cast<float>(
+		  m_playback.load().positionSeconds(std::chrono::steady_clock::now()));
+		m_musicInfos.offset = std::min(offset, m_musicInfos.duration);
 	}
 
 	ImGui::Begin(m_name.c_str());
@@ -82,8 +85,12 @@ void Player::show()
 		ImVec2 player_bar_size(ImGui::GetWindowContentRegionWidth() - ImGui::GetFontSize() * 20.0f,
 		                       0.0f);
 		ImGui::SameLine();
-		if(ImGuiCW::PlayerBar(
-		     "player_bar", &trac_pos, 0.0f, m_musicInfos.duration, player_bar_size))
+		if(ImGuiCW::PlayerBar("player_bar",
+		                      &trac_pos,
+		                      0.0f,
+		                      m_musicInfos.duration,
+		                      m_waveform.get(),
+		                      player_bar_size))
 		{
 			m_logger->info("Request to set music offset to {:.2f} seconds", trac_pos);
 			m_sender.sendInMessage<Msg::In::MusicOffset>(trac_pos);
@@ -116,18 +123,18 @@ void Player::show()
 	ImGui::End();
 }
 
-void Player::processMessage(Msg::Out::MusicOffset& message)
-{
-	m_musicInfos.offset = message.seconds;
-}
-
 void Player::processMessage(Msg::Out::MusicInfo& message)
 {
 	m_musicInfos.valid = message.valid;
 	m_musicInfos.offset = 0;
 	m_musicInfos.duration = message.durationSeconds;
+	m_waveform.reset();
 	m_logger->info("Received music information: valid = {}, duration = {:.2f} seconds",
 	               m_musicInfos.valid,
 	               m_musicInfos.duration);
-	m_sender.sendInMessage<Msg::In::RequestMusicOffset>();
+}
+
+void Player::processMessage(Msg::Out::Waveform& message)
+{
+	m_waveform = std::move(message.waveform);
 }
@@ -11,6 +11,8 @@
 #include <imgui_internal.h>
 #include <IconsFontAwesome5.h>
 
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 
 namespace
@@ -33,6 +35,17 @@ SettingsEditor::SettingsEditor(std::string name, Msg::Sender sender)
   , m_name(std::move(name))
   , m_explorer_folder_buffer()
   , m_musics_sources_buffers()
+  , m_decode_ahead_seconds_input()
+  , m_pcm_cache_megabytes_input()
+  , m_crossfade_seconds_input()
+  , m_crossfade_curve_input()
+  , m_output_sample_rate_input()
+  , m_equalizer_enabled_input()
+  , m_equalizer_bands_input()
+  , m_limiter_enabled_input()
+  , m_limiter_threshold_db_input()
+  , m_volume_normalization_input()
+  , m_normalization_preamp_db_input()
   , m_settings()
   , m_database_info()
   , m_selectedPanel(SettingsPanels::FILES_EXPLORER)
@@ -160,6 +173,11 @@ void SettingsEditor::showLeftPanel(const float panel_height) noexcept
 		{
 			m_selectedPanel = SettingsPanels::MUSICS_SOURCES;
 		}
+		if(ImGui::Selectable(SettingsPanelsTxt(SettingsPanels::PLAYBACK).data(),
+		                     m_selectedPanel == SettingsPanels::PLAYBACK))
+		{
+			m_selectedPanel = SettingsPanels::PLAYBACK;
+		}
 		if(ImGui::Selectable(SettingsPanelsTxt(SettingsPanels::DATABASE).data(),
 		                     m_selectedPanel == SettingsPanels::DATABASE))
 		{
@@ -196,6 +214,9 @@ void SettingsEditor::showConfigOptions() noexcept
 		case SettingsPanels::MUSICS_SOURCES:
 			showMusicsSourcesConfigOptions();
 			break;
+		case SettingsPanels::PLAYBACK:
+			showPlaybackConfigOptions();
+			break;
 		case SettingsPanels::DATABASE:
 			showDatabaseConfigOptions();
 			break;
@@ -253,6 +274,102 @@ void SettingsEditor::showMusicsSourcesConfigOptions() noexcept
 	}
 }
 
+void SettingsEditor::showPlaybackConfigOptions() noexcept
+{
+	if(ImGui::TreeNodeEx("Decode ahead", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::PushItemWidth(-1);
+		ImGui::SliderFloat("##Decode ahead",
+		                   &m_decode_ahead_seconds_input,
+		                   data::Settings::MIN_DECODE_AHEAD_SECONDS,
+		                   data::Settings::MAX_DECODE_AHEAD_SECONDS,
+		                   "%.0f seconds");
+		ImGui::PopItemWidth();
+		ImGui::TreePop();
+	}
+	if(ImGui::TreeNodeEx("Decoded audio cache", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::PushItemWidth(-1);
+		ImGui::SliderInt("##Decoded audio cache",
+		                 &m_pcm_cache_megabytes_input,
+		                 0,
+		                 static_cast<int>(data::Settings::MAX_PCM_CACHE_MEGABYTES),
+		                 m_pcm_cache_megabytes_input > 0 ? "%d MB" : "Disabled");
+		ImGui::PopItemWidth();
+		ImGui::TreePop();
+	}
+	if(ImGui::TreeNodeEx("Crossfade", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::PushItemWidth(-1);
+		ImGui::SliderFloat("##Crossfade duration",
+		                   &m_crossfade_seconds_input,
+		                   0.f,
+		                   data::Settings::MAX_CROSSFADE_SECONDS,
+		                   m_crossfade_seconds_input > 0 ? "%.1f seconds" : "Disabled (gapless)");
+		ImGui::Combo("##Crossfade curve",
+		             &m_crossfade_curve_input,
+		             "Linear\0Equal power\0Logarithmic\0");
+		ImGui::PopItemWidth();
+		ImGui::TreePop();
+	}
+	if(ImGui::TreeNodeEx("Output sample rate", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::PushItemWidth(-1);
+		ImGui::Combo("##Output sample rate",
+		             &m_output_sample_rate_input,
+		             "Music sample rate\0" "44100 Hz\0" "48000 Hz\0" "96000 Hz\0" "192000 Hz\0");
+		ImGui::PopItemWidth();
+		ImGui::TextDisabled("Applied from the next music");
+		ImGui::TreePop();
+	}
+	if(ImGui::TreeNodeEx("Equalizer", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Checkbox("Enabled##Equalizer", &m_equalizer_enabled_input);
+		ImGui::PushItemWidth(-1);
+		for(std::size_t i = 0; i < m_equalizer_bands_input.size(); ++i)
+		{
+			data::EqualizerBand& band = m_equalizer_bands_input[i];
+			ImGui::PushID(static_cast<int>(i));
+			ImGui::Text("%.0f Hz", static_cast<double>(band.frequency));
+			ImGui::SliderFloat("##Gain",
+			                   &band.gain_db,
+			                   -data::Settings::MAX_EQUALIZER_GAIN_DB,
+			                   data::Settings::MAX_EQUALIZER_GAIN_DB,
+			                   "%+.1f dB");
+			ImGui::PopID();
+		}
+		ImGui::PopItemWidth();
+		ImGui::TreePop();
+	}
+	if(ImGui::TreeNodeEx("Limiter", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Checkbox("Enabled##Limiter", &m_limiter_enabled_input);
+		ImGui::PushItemWidth(-1);
+		ImGui::SliderFloat("##Limiter threshold",
+		                   &m_limiter_threshold_db_input,
+		                   data::Settings::MIN_LIMITER_THRESHOLD_DB,
+		                   0.f,
+		                   "Threshold: %.1f dB");
+		ImGui::PopItemWidth();
+		ImGui::TreePop();
+	}
+	if(ImGui::TreeNodeEx("Volume normalization", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::PushItemWidth(-1);
+		ImGui::Combo("##Volume normalization",
+		             &m_volume_normalization_input,
+		             "Disabled\0Track gain\0Album gain\0");
+		ImGui::SliderFloat("##Normalization preamp",
+		                   &m_normalization_preamp_db_input,
+		                   -data::Settings::MAX_NORMALIZATION_PREAMP_DB,
+		                   data::Settings::MAX_NORMALIZATION_PREAMP_DB,
+		                   "Preamp: %+.1f dB");
+		ImGui::PopItemWidth();
+		ImGui::TextDisabled("Applied from the next music");
+		ImGui::TreePop();
+	}
+}
+
 void SettingsEditor::showDatabaseConfigOptions() noexcept
 {
 	if(ImGui::TreeNodeEx(ICON_FA_CLOCK " Generation date", ImGuiTreeNodeFlags_DefaultOpen))
@@ -339,6 +456,22 @@ void SettingsEditor::revertSettingsInputs() noexcept
 		std::strncpy(path_buffer.data(), path_txt.data(), path_buffer.size());
 		path_buffer[std::max(path_txt.size(), path_buffer.size() - 1)] = '\0';
 	}
+
+	m_decode_ahead_seconds_input = m_settings.decode_ahead_seconds;
+	m_pcm_cache_megabytes_input = static_cast<int>(m_settings.pcm_cache_megabytes);
+	m_crossfade_seconds_input = m_settings.crossfade_seconds;
+	m_crossfade_curve_input = static_cast<int>(m_settings.crossfade_curve);
+
+	const auto& rates = data::Settings::OUTPUT_SAMPLE_RATES;
+	const auto rate = std::find(std::cbegin(rates), std::cend(rates), m_settings.output_sample_rate);
+	m_output_sample_rate_input =
+	  rate == std::cend(rates) ? 0 : static_cast<int>(std::distance(std::cbegin(rates), rate)) + 1;
+	m_equalizer_enabled_input = m_settings.equalizer_enabled;
+	m_equalizer_bands_input = m_settings.equalizer_bands;
+	m_limiter_enabled_input = m_settings.limiter_enabled;
+	m_limiter_threshold_db_input = m_settings.limiter_threshold_db;
+	m_volume_normalization_input = static_cast<int>(m_settings.volume_normalization);
+	m_normalization_preamp_db_input = m_settings.normalization_preamp_db;
 }
 
 bool SettingsEditor::applySettingsInputs() noexcept
@@ -370,6 +503,22 @@ bool SettingsEditor::applySettingsInputs() noexcept
 
 	m_settings.explorer_folder = std::move(explorer_folder);
 	m_settings.music_sources = std::move(music_sources);
+	m_settings.decode_ahead_seconds = m_decode_ahead_seconds_input;
+	m_settings.pcm_cache_megabytes = static_cast<unsigned int>(std::clamp(
+	  m_pcm_cache_megabytes_input, 0, static_cast<int>(data::Settings::MAX_PCM_CACHE_MEGABYTES)));
+	m_settings.crossfade_seconds = m_crossfade_seconds_input;
+	m_settings.crossfade_curve = static_cast<data::CrossfadeCurve>(m_crossfade_curve_input);
+	m_settings.output_sample_rate =
+	  m_output_sample_rate_input == 0
+	    ? 0
+	    : data::Settings::OUTPUT_SAMPLE_RATES[static_cast<std::size_t>(m_output_sample_rate_input - 1)];
+	m_settings.equalizer_enabled = m_equalizer_enabled_input;
+	m_settings.equalizer_bands = m_equalizer_bands_input;
+	m_settings.limiter_enabled = m_limiter_enabled_input;
+	m_settings.limiter_threshold_db = m_limiter_threshold_db_input;
+	m_settings.volume_normalization =
+	  static_cast<data::VolumeNormalization>(m_volume_normalization_input);
+	m_settings.normalization_preamp_db = m_normalization_preamp_db_input;
 
 	return true;
 }
@@ -383,6 +532,8 @@ std::string_view SettingsEditor::SettingsPanelsTxt(
 			return "Files explorer";
 		case SettingsPanels::MUSICS_SOURCES:
 			return "Musics sources";
+		case SettingsPanels::PLAYBACK:
+			return "Playback";
 		case SettingsPanels::DATABASE:
 			return "Database";
 	}
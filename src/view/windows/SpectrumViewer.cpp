@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#include "view/windows/SpectrumViewer.hpp"
+#include "utils/log.hpp"
+
+#include <imgui.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace
+{
+	constexpr float LEVELS_WIDTH_FONT_RATIO = 2.0f;
+	constexpr float BAR_GAP = 1.0f;
+
+	constexpr const char* CHANNEL_NAMES[data::Spectrum::LEVEL_CHANNELS] = {"Left", "Right"};
+
+	// 0 at the floor, 1 at full scale
+	float level_ratio(float db) noexcept
+	{
+		return std::clamp(1.0f - db / data::Spectrum::FLOOR_DB, 0.0f, 1.0f);
+	}
+} // namespace
+
+SpectrumViewer::SpectrumViewer(std::string name,
+                               triple_buffer<data::Spectrum>& spectrum,
+                               std::atomic<bool>& enabled)
+  : m_name(std::move(name))
+  , m_spectrum(spectrum)
+  , m_enabled(enabled)
+  , m_logger(spdlog::get(VIEW_LOGGER_NAME))
+{
+}
+
+void SpectrumViewer::init()
+{
+}
+
+void SpectrumViewer::show()
+{
+	// nothing is analyzed while the window is hidden
+	const bool visible = ImGui::Begin(m_name.c_str());
+	if(visible != m_enabled.load(std::memory_order_relaxed))
+	{
+		m_enabled.store(visible, std::memory_order_relaxed);
+		SPDLOG_DEBUG(m_logger, "Spectrum analysis {}", visible ? "enabled" : "disabled");
+	}
+	if(!visible)
+	{
+		ImGui::End();
+		return;
+	}
+
+	m_spectrum.update();
+	const data::Spectrum& spectrum = m_spectrum.read_buffer();
+
+	const ImVec2 available = ImGui::GetContentRegionAvail();
+	const float text_height = ImGui::GetTextLineHeightWithSpacing();
+	const float height = std::max(available.y - text_height, text_height);
+	const float levels_width = ImGui::GetFontSize() * LEVELS_WIDTH_FONT_RATIO;
+	showLevels(spectrum, levels_width, height);
+	ImGui::SameLine();
+	showBands(spectrum,
+	          std::max(available.x - levels_width - ImGui::GetStyle().ItemSpacing.x, 1.0f),
+	          height);
+
+	ImGui::Text("%u points FFT, %.1fus per analysis, %.3f%% of real time",
+	            static_cast<unsigned int>(spectrum.fft_size),
+	            static_cast<double>(spectrum.analysis_us),
+	            static_cast<double>(spectrum.realtime_load * 100));
+
+	ImGui::End();
+}
+
+void SpectrumViewer::showLevels(const data::Spectrum& spectrum, float width, float height)
+{
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	const ImVec2 pos = ImGui::GetCursorScreenPos();
+	ImGui::InvisibleButton("##levels", ImVec2(width, height));
+
+	const ImU32 background_color = ImGui::GetColorU32(ImGuiCol_FrameBg);
+	const ImU32 rms_color = ImGui::GetColorU32(ImGuiCol_PlotHistogram);
+	const ImU32 peak_color = ImGui::GetColorU32(ImGuiCol_PlotHistogramHovered);
+	const std::size_t meters = data::Spectrum::LEVEL_CHANNELS;
+	const float meter_width = width / meters;
+	for(std::size_t channel = 0; channel < meters; ++channel)
+	{
+		const float left = pos.x + channel * meter_width;
+		const float right = left + meter_width - BAR_GAP;
+		const float bottom = pos.y + height;
+		draw_list->AddRectFilled(ImVec2(left, pos.y), ImVec2(right, bottom), background_color);
+		if(channel >= spectrum.channels)
+		{
+			continue;
+		}
+		const float rms_top = bottom - height * level_ratio(spectrum.rms_db[channel]);
+		const float peak_y = bottom - height * level_ratio(spectrum.peak_db[channel]);
+		draw_list->AddRectFilled(ImVec2(left, rms_top), ImVec2(right, bottom), rms_color);
+		draw_list->AddLine(ImVec2(left, peak_y), ImVec2(right, peak_y), peak_color);
+	}
+
+	if(ImGui::IsItemHovered())
+	{
+		ImGui::BeginTooltip();
+		for(std::size_t channel = 0; channel < std::min<std::size_t>(meters, spectrum.channels);
+		    ++channel)
+		{
+			ImGui::Text("%s: peak %.1f dB, RMS %.1f dB",
+			            CHANNEL_NAMES[channel],
+			            static_cast<double>(spectrum.peak_db[channel]),
+			            static_cast<double>(spectrum.rms_db[channel]));
+		}
+		ImGui::EndTooltip();
+	}
+}
+
+void SpectrumViewer::showBands(const data::Spectrum& spectrum, float width, float height)
+{
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	const ImVec2 pos = ImGui::GetCursorScreenPos();
+	ImGui::InvisibleButton("##bands", ImVec2(width, height));
+
+	const float bottom = pos.y + height;
+	draw_list->AddRectFilled(
+	  pos, ImVec2(pos.x + width, bottom), ImGui::GetColorU32(ImGuiCol_FrameBg));
+	const ImU32 band_color = ImGui::GetColorU32(ImGuiCol_PlotHistogram);
+	const float band_width = width / data::Spectrum::BANDS;
+	for(std::size_t band = 0; band < data::Spectrum::BANDS; ++band)
+	{
+		const float left = pos.x + band * band_width;
+		const float top = bottom - height * level_ratio(spectrum.bands_db[band]);
+		const float right = left + std::max(band_width - BAR_GAP, 1.0f);
+		draw_list->AddRectFilled(ImVec2(left, top), ImVec2(right, bottom), band_color);
+	}
+
+	if(ImGui::IsItemHovered() && spectrum.max_frequency > 0)
+	{
+		const auto band = std::min(
+		  static_cast<std::size_t>(std::max(ImGui::GetIO().MousePos.x - pos.x, 0.0f) / band_width),
+		  data::Spectrum::BANDS - 1);
+		ImGui::SetTooltip("%.0f Hz: %.1f dB",
+		                  static_cast<double>(spectrum.bandFrequency(band)),
+		                  static_cast<double>(spectrum.bands_db[band]));
+	}
+}
@@ -157,6 +157,14 @@ void FileExplorer::print()
 			{
 				m_sender.sendInMessage<Msg::In::Open>(m_content[i].path);
 			}
+			if(m_content[i].has_supported_audio_extension && ImGui::BeginPopupContextItem())
+			{
+				if(ImGui::MenuItem(ICON_FA_PLUS " Add to queue"))
+				{
+					m_sender.sendInMessage<Msg::In::Enqueue>(m_content[i].path);
+				}
+				ImGui::EndPopup();
+			}
 		}
 	}
 	ImGui::EndChild();
@@ -214,7 +222,8 @@ void FileExplorer::processMessage(Msg::Out::FolderContent& message)
 	// Apply modifications
 	m_path = std::move(path);
 	m_sub_paths = std::move(sub_paths);
-	m_content = message.content;
+	// the message is dropped once handled
+	m_content = std::move(message.content);
 	selected_content = m_content.size();
 
 	m_displayable_split_paths = m_sub_paths.size();
@@ -0,0 +1,44 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+#ifndef MAGICPLAYER_TESTS_CHECK_HPP
+#define MAGICPLAYER_TESTS_CHECK_HPP
+
+#include <cstdlib>
+#include <iostream>
+
+// Minimal test support: each test is an executable registered to CTest, CHECK() reports the
+// failed conditions and the test returns test_result() from main
+namespace check_detail
+{
+	inline int& failures() noexcept
+	{
+		static int count = 0;
+		return count;
+	}
+
+	inline bool check(bool condition, const char* expression, const char* file, int line)
+	{
+		if(!condition)
+		{
+			++failures();
+			std::cerr << file << ':' << line << ": check failed: " << expression << std::endl;
+		}
+		return condition;
+	}
+} // namespace check_detail
+
+// return the condition, to stop a test case at its first failure
+#define CHECK(condition) \
+	check_detail::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+inline int test_result() noexcept
+{
+	return check_detail::failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif //MAGICPLAYER_TESTS_CHECK_HPP
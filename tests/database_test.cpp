@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// The database loaded at startup (not generated, without valid id) and a generated empty
+// database must list their musics without looking them up by the database id.
+//
+#include "data/DataManager.hpp"
+#include "utils/IdGenerator.hpp"
+#include "check.hpp"
+
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/null_sink.h>
+
+#include <filesystem>
+#include <memory>
+#include <system_error>
+
+namespace
+{
+	void check_loaded_database(data::DataManager& data_manager)
+	{
+		const std::shared_ptr<const data::Database> database = data_manager.loadDatabase();
+		if(!CHECK(database != nullptr))
+		{
+			return;
+		}
+		CHECK(database->musics().empty());
+	}
+
+	void check_generated_database(data::DataManager& data_manager)
+	{
+		std::error_code error;
+		const std::filesystem::path folder =
+		  std::filesystem::temp_directory_path(error) / "magicplayer_database_test";
+		std::filesystem::create_directories(folder, error);
+		if(!CHECK(!error))
+		{
+			return;
+		}
+
+		const std::shared_ptr<const data::Database> database =
+		  data_manager.generateDatabase({utf8_path(folder)});
+		std::filesystem::remove_all(folder, error);
+		if(!CHECK(database != nullptr))
+		{
+			return;
+		}
+		CHECK(database->id != IdGenerator::INVALID_ID);
+		CHECK(database->musics().empty());
+		CHECK(database->findMusics(database->id).empty());
+	}
+} // namespace
+
+int main()
+{
+	auto logger =
+	  std::make_shared<spdlog::logger>("test", std::make_shared<spdlog::sinks::null_sink_mt>());
+	data::DataManager data_manager(logger);
+	check_loaded_database(data_manager);
+	check_generated_database(data_manager);
+	return test_result();
+}
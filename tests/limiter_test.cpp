@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// The look-ahead limiter output must never exceed the threshold: on a decaying low frequency
+// signal (the required gain increases every frame for longer than the look-ahead, the sliding
+// window minimum expires an entry every frame without popping any) followed by a transient peak.
+//
+#include "audio/dsp/Limiter.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	constexpr unsigned int SAMPLE_RATE = 48000;
+	constexpr float THRESHOLD_DB = -6.f;
+	constexpr std::size_t BLOCK_FRAMES = 512;
+	constexpr float PI = 3.14159265358979f;
+
+	// 2 seconds of a 30 Hz sine decaying from 4 times the threshold to silence,
+	// then a single frame peak at 2.0
+	std::vector<float> make_signal(unsigned int channels, std::size_t& peak_frame)
+	{
+		const std::size_t decay_frames = 2 * SAMPLE_RATE;
+		const std::size_t frames = decay_frames + SAMPLE_RATE / 2;
+		peak_frame = decay_frames + SAMPLE_RATE / 4;
+		std::vector<float> samples(frames * channels, 0.f);
+		for(std::size_t f = 0; f < decay_frames; ++f)
+		{
+			const float t = static_cast<float>(f) / SAMPLE_RATE;
+			const float envelope = 2.f * std::exp(-3.f * t);
+			for(unsigned int c = 0; c < channels; ++c)
+			{
+				samples[f * channels + c] = envelope * std::sin(2 * PI * 30.f * t);
+			}
+		}
+		for(unsigned int c = 0; c < channels; ++c)
+		{
+			samples[peak_frame * channels + c] = c % 2 == 0 ? 2.f : -2.f;
+		}
+		return samples;
+	}
+
+	void check_limiter(unsigned int channels)
+	{
+		std::size_t peak_frame = 0;
+		std::vector<float> samples = make_signal(channels, peak_frame);
+		const std::size_t frames = samples.size() / channels;
+
+		audio::dsp::Limiter limiter;
+		limiter.setParameters(true, THRESHOLD_DB);
+		limiter.prepare(channels, SAMPLE_RATE);
+		for(std::size_t first = 0; first < frames; first += BLOCK_FRAMES)
+		{
+			limiter.process(samples.data() + first * channels,
+			                std::min(BLOCK_FRAMES, frames - first));
+		}
+
+		// the gains are averaged in double, allow float rounding
+		const float threshold = std::pow(10.f, THRESHOLD_DB / 20) * 1.0001f;
+		const auto over = std::find_if(samples.cbegin(), samples.cend(), [&](float sample) {
+			return std::abs(sample) > threshold;
+		});
+		if(!CHECK(over == samples.cend()))
+		{
+			const auto index = static_cast<std::size_t>(std::distance(samples.cbegin(), over));
+			std::cerr << "  " << channels << " channels: frame " << index / channels
+			          << " is over the threshold: " << *over << std::endl;
+		}
+
+		// the delayed peak is output, limited to the threshold
+		float output_peak = 0;
+		for(std::size_t f = peak_frame; f < frames; ++f)
+		{
+			output_peak = std::max(output_peak, std::abs(samples[f * channels]));
+		}
+		CHECK(output_peak > threshold * 0.9f);
+
+	}
+} // namespace
+
+int main()
+{
+	check_limiter(1);
+	check_limiter(2);
+	return test_result();
+}
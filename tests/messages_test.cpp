@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// The latest wins in messages replace the content of a queued one only while it is the last
+// message queued for its zone: a music offset sent after an open is applied to the new music.
+// The controls are dispatched before the other requests, but not before those of their zone
+// sent before them.
+//
+#include "model/Messages.hpp"
+#include "check.hpp"
+
+#include <memory>
+#include <variant>
+#include <vector>
+
+namespace
+{
+	// the messages as dispatched by the logic
+	std::vector<Msg::Com::InMessage> dispatch(Msg::Com& com)
+	{
+		std::vector<Msg::Com::InEnvelope> envelopes;
+		com.in.drain(envelopes);
+		std::vector<Msg::Com::InMessage> messages;
+		for(Msg::Com::InEnvelope& envelope: envelopes)
+		{
+			com.takeLatest(envelope);
+			messages.push_back(std::move(envelope.message));
+		}
+		return messages;
+	}
+
+	bool is_offset(const Msg::Com::InMessage& message, float seconds)
+	{
+		const auto* offset = std::get_if<Msg::In::MusicOffset>(&message);
+		return offset != nullptr && offset->seconds == seconds;
+	}
+
+	bool is_volume(const Msg::Com::InMessage& message, float volume)
+	{
+		const auto* request = std::get_if<Msg::In::Volume>(&message);
+		return request != nullptr && request->volume == volume;
+	}
+
+	void check_latest_wins()
+	{
+		// Com is large (coalescing slots, playback states), not on the stack
+		auto com = std::make_unique<Msg::Com>();
+		com->sendInMessage<Msg::In::MusicOffset>(10.f);
+		com->sendInMessage<Msg::In::MusicOffset>(20.f);
+		com->sendInMessage<Msg::In::MusicOffset>(30.f);
+		const std::vector<Msg::Com::InMessage> messages = dispatch(*com);
+		if(CHECK(messages.size() == 1))
+		{
+			CHECK(is_offset(messages[0], 30.f));
+		}
+		CHECK(com->coalescedCount() == 2);
+
+		// the dispatched message no longer takes the newer content
+		com->sendInMessage<Msg::In::MusicOffset>(40.f);
+		const std::vector<Msg::Com::InMessage> next = dispatch(*com);
+		if(CHECK(next.size() == 1))
+		{
+			CHECK(is_offset(next[0], 40.f));
+		}
+	}
+
+	void check_offset_after_open()
+	{
+		auto com = std::make_unique<Msg::Com>();
+		com->sendInMessage<Msg::In::MusicOffset>(10.f);
+		com->sendInMessage<Msg::In::Open>(utf8_path("/music/b.flac"));
+		com->sendInMessage<Msg::In::MusicOffset>(20.f);
+		com->sendInMessage<Msg::In::MusicOffset>(25.f);
+		const std::vector<Msg::Com::InMessage> messages = dispatch(*com);
+		if(CHECK(messages.size() == 3))
+		{
+			CHECK(is_offset(messages[0], 10.f));
+			CHECK(std::holds_alternative<Msg::In::Open>(messages[1]));
+			CHECK(is_offset(messages[2], 25.f));
+		}
+	}
+
+	void check_volume_after_stop()
+	{
+		auto com = std::make_unique<Msg::Com>();
+		std::vector<Msg::Com::InEnvelope> batch;
+		batch.emplace_back(std::in_place_type_t<Msg::In::Volume>{}, false, 10.f);
+		batch.emplace_back(std::in_place_type_t<Msg::In::Volume>{}, false, 15.f);
+		batch.emplace_back(std::in_place_type_t<Msg::In::Control>{},
+		                   Msg::In::Control::Action::STOP);
+		batch.emplace_back(std::in_place_type_t<Msg::In::Volume>{}, false, 20.f);
+		com->sendInMessages(batch);
+		com->sendInMessage<Msg::In::Volume>(false, 30.f);
+		const std::vector<Msg::Com::InMessage> messages = dispatch(*com);
+		if(CHECK(messages.size() == 3))
+		{
+			CHECK(is_volume(messages[0], 15.f));
+			CHECK(std::holds_alternative<Msg::In::Control>(messages[1]));
+			CHECK(is_volume(messages[2], 30.f));
+		}
+	}
+
+	void check_other_zone()
+	{
+		// the requests of another zone don't order the messages of this one
+		auto com = std::make_unique<Msg::Com>();
+		com->sendInMessage<Msg::In::MusicOffset>(10.f);
+		com->sendInMessage<Msg::In::Open>(utf8_path("/music/b.flac"), 1);
+		com->sendInMessage<Msg::In::MusicOffset>(20.f);
+		const std::vector<Msg::Com::InMessage> messages = dispatch(*com);
+		if(CHECK(messages.size() == 2))
+		{
+			CHECK(is_offset(messages[0], 20.f));
+			CHECK(std::holds_alternative<Msg::In::Open>(messages[1]));
+		}
+	}
+
+	void check_control_lane()
+	{
+		Msg::LaneRouter router;
+		const Msg::Com::InMessage open(std::in_place_type_t<Msg::In::Open>{},
+		                               utf8_path("/music/b.flac"));
+		const Msg::Com::InMessage offset(std::in_place_type_t<Msg::In::MusicOffset>{}, 20.f);
+		const Msg::Com::InMessage other_offset(std::in_place_type_t<Msg::In::MusicOffset>{},
+		                                       20.f,
+		                                       1);
+		const Msg::Com::InMessage play(std::in_place_type_t<Msg::In::Control>{},
+		                               Msg::In::Control::Action::PLAY);
+		const Msg::Com::InMessage database(std::in_place_type_t<Msg::In::RequestDatabase>{});
+		const Msg::Com::InMessage event(std::in_place_type_t<Msg::In::InnerTrackEnded>{},
+		                                false,
+		                                0,
+		                                0);
+
+		CHECK(router.route(play) == Msg::Lane::CONTROL);
+		CHECK(router.route(event) == Msg::Lane::EVENTS);
+		CHECK(router.route(database) == Msg::Lane::REQUESTS);
+		CHECK(router.route(offset) == Msg::Lane::CONTROL);
+
+		// behind the open of its zone, and the controls sent after it
+		CHECK(router.route(open) == Msg::Lane::REQUESTS);
+		CHECK(router.route(offset) == Msg::Lane::REQUESTS);
+		CHECK(router.route(other_offset) == Msg::Lane::CONTROL);
+		router.dispatched(Msg::Lane::REQUESTS, database);
+		router.dispatched(Msg::Lane::REQUESTS, open);
+		CHECK(router.route(play) == Msg::Lane::REQUESTS);
+		router.dispatched(Msg::Lane::REQUESTS, offset);
+		router.dispatched(Msg::Lane::REQUESTS, play);
+		CHECK(router.route(play) == Msg::Lane::CONTROL);
+
+		// the settings order all the zones
+		const Msg::Com::InMessage settings(std::in_place_type_t<Msg::In::Settings>{},
+		                                   data::Settings{});
+		CHECK(router.route(settings) == Msg::Lane::REQUESTS);
+		CHECK(router.route(other_offset) == Msg::Lane::REQUESTS);
+		router.dispatched(Msg::Lane::REQUESTS, settings);
+		router.dispatched(Msg::Lane::REQUESTS, other_offset);
+		CHECK(router.route(other_offset) == Msg::Lane::CONTROL);
+	}
+} // namespace
+
+int main()
+{
+	check_latest_wins();
+	check_offset_after_open();
+	check_volume_after_stop();
+	check_other_zone();
+	check_control_lane();
+	return test_result();
+}
@@ -0,0 +1,263 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// The vectorized mix kernels (SSE2, AVX2 when available) must match the scalar reference,
+// on lengths with every tail size and on buffers not aligned to the vector size.
+//
+#include "audio/mix_kernels.hpp"
+#include "utils/simd.hpp"
+#include "check.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+	using audio::kernels::GainRamp;
+
+	// every tail length of the AVX2 and SSE2 loops, and a long run
+	constexpr std::size_t MAX_SHORT_LENGTH = 67;
+	constexpr std::size_t LONG_LENGTH = 1031;
+	// element offsets of the buffers, 0 keeps the vector allocation alignment
+	constexpr std::size_t OFFSETS[] = {0, 1, 3};
+
+	std::vector<std::size_t> lengths()
+	{
+		std::vector<std::size_t> values;
+		for(std::size_t length = 0; length <= MAX_SHORT_LENGTH; ++length)
+		{
+			values.push_back(length);
+		}
+		values.push_back(LONG_LENGTH);
+		return values;
+	}
+
+	class Generator
+	{
+	public:
+		explicit Generator(float amplitude) noexcept: m_seed(0x12345678), m_amplitude(amplitude)
+		{
+		}
+
+		float operator()() noexcept
+		{
+			m_seed = m_seed * 1664525u + 1013904223u;
+			return static_cast<float>(static_cast<std::int32_t>(m_seed >> 16) - 32768) / 32768.f
+			       * m_amplitude;
+		}
+
+	private:
+		std::uint32_t m_seed;
+		float m_amplitude;
+	};
+
+	std::vector<std::int16_t> int16_signal(std::size_t count)
+	{
+		std::vector<std::int16_t> samples(count);
+		for(std::size_t i = 0; i < count; ++i)
+		{
+			samples[i] = static_cast<std::int16_t>((i * 7919) % 65536 - 32768);
+		}
+		// extremes, in the vectorized part when long enough
+		if(count > 2)
+		{
+			samples[count / 2] = -32768;
+			samples[count / 3] = 32767;
+		}
+		return samples;
+	}
+
+	float as_float(std::int16_t sample) noexcept
+	{
+		return static_cast<float>(sample);
+	}
+
+	float as_float(float sample) noexcept
+	{
+		return sample;
+	}
+
+	// the compiler may contract the scalar version into fused multiply-adds,
+	// allow one rounding step of difference
+	template<typename T>
+	bool close(T expected, T actual) noexcept
+	{
+		const float tolerance = std::is_same<T, float>::value
+		                          ? 1e-5f * std::max(1.f, std::abs(as_float(expected)))
+		                          : 1.f;
+		return std::abs(as_float(expected) - as_float(actual)) <= tolerance;
+	}
+
+	template<typename T>
+	void check_mix_ramp(float amplitude)
+	{
+		constexpr unsigned int CHANNELS[] = {1, 2, 3, 4, 6, 8};
+		constexpr float RAMP_FRAMES = LONG_LENGTH;
+		constexpr GainRamp RAMPS[][2] = {
+		  {{1.f, -1.f / RAMP_FRAMES}, {0.f, 1.f / RAMP_FRAMES}},
+		  {{0.5f, 0.f}, {0.5f, 0.f}},
+		  {{1.5f, 0.001f}, {1.2f, -0.0002f}}, // saturating
+		};
+
+		Generator generator(amplitude);
+		for(unsigned int channels: CHANNELS)
+		{
+			for(std::size_t frames: lengths())
+			{
+				for(std::size_t offset: OFFSETS)
+				{
+					const std::size_t count = frames * channels;
+					std::vector<T> a(offset + count);
+					std::vector<T> b(offset + count);
+					std::generate(a.begin(), a.end(), [&] { return static_cast<T>(generator()); });
+					std::generate(b.begin(), b.end(), [&] { return static_cast<T>(generator()); });
+
+					for(const auto& ramps: RAMPS)
+					{
+						std::vector<T> reference(offset + count);
+						std::vector<T> result(offset + count);
+						audio::kernels::scalar::mix_ramp(a.data() + offset,
+						                                 ramps[0],
+						                                 b.data() + offset,
+						                                 ramps[1],
+						                                 reference.data() + offset,
+						                                 frames,
+						                                 channels);
+						audio::kernels::mix_ramp(a.data() + offset,
+						                         ramps[0],
+						                         b.data() + offset,
+						                         ramps[1],
+						                         result.data() + offset,
+						                         frames,
+						                         channels);
+						const auto mismatch = std::mismatch(
+						  reference.cbegin(), reference.cend(), result.cbegin(), close<T>);
+						if(!CHECK(mismatch.first == reference.cend()))
+						{
+							std::cerr << "  mix_ramp " << sizeof(T) << " bytes samples, "
+							          << channels << " channels, " << frames << " frames, offset "
+							          << offset << ", sample "
+							          << std::distance(reference.cbegin(), mismatch.first) << ": "
+							          << as_float(*mismatch.first)
+							          << " != " << as_float(*mismatch.second) << std::endl;
+							return;
+						}
+					}
+
+					// in place, out aliasing a
+					std::vector<T> reference(offset + count);
+					audio::kernels::scalar::mix_ramp(a.data() + offset,
+					                                 RAMPS[0][0],
+					                                 b.data() + offset,
+					                                 RAMPS[0][1],
+					                                 reference.data() + offset,
+					                                 frames,
+					                                 channels);
+					audio::kernels::mix_ramp(a.data() + offset,
+					                         RAMPS[0][0],
+					                         b.data() + offset,
+					                         RAMPS[0][1],
+					                         a.data() + offset,
+					                         frames,
+					                         channels);
+					if(!CHECK(std::equal(reference.cbegin() + static_cast<std::ptrdiff_t>(offset),
+					                     reference.cend(),
+					                     a.cbegin() + static_cast<std::ptrdiff_t>(offset),
+					                     close<T>)))
+					{
+						std::cerr << "  in place mix_ramp, " << channels << " channels, " << frames
+						          << " frames, offset " << offset << std::endl;
+						return;
+					}
+				}
+			}
+		}
+	}
+
+	void check_conversions()
+	{
+		for(std::size_t count: lengths())
+		{
+			for(std::size_t offset: OFFSETS)
+			{
+				const std::vector<std::int16_t> signal = int16_signal(count);
+				std::vector<std::int16_t> samples(offset);
+				samples.insert(samples.end(), signal.cbegin(), signal.cend());
+
+				std::vector<float> floats(offset + count);
+				std::vector<float> reference_floats(offset + count);
+				audio::kernels::to_float(samples.data() + offset, floats.data() + offset, count);
+				audio::kernels::scalar::to_float(
+				  samples.data() + offset, reference_floats.data() + offset, count);
+				if(!CHECK(floats == reference_floats))
+				{
+					std::cerr << "  to_float, " << count << " samples, offset " << offset
+					          << std::endl;
+					return;
+				}
+
+				// out of range values must saturate
+				if(count > 2)
+				{
+					floats[offset] = reference_floats[offset] = 1.5f;
+					floats[offset + count - 1] = reference_floats[offset + count - 1] = -1.5f;
+				}
+				std::vector<std::int16_t> result(offset + count);
+				std::vector<std::int16_t> reference(offset + count);
+				audio::kernels::to_int16(floats.data() + offset, result.data() + offset, count);
+				audio::kernels::scalar::to_int16(
+				  reference_floats.data() + offset, reference.data() + offset, count);
+				if(!CHECK(result == reference))
+				{
+					std::cerr << "  to_int16, " << count << " samples, offset " << offset
+					          << std::endl;
+					return;
+				}
+			}
+		}
+	}
+
+	void check_summary()
+	{
+		for(std::size_t count: lengths())
+		{
+			for(std::size_t offset: OFFSETS)
+			{
+				const std::vector<std::int16_t> signal = int16_signal(count);
+				std::vector<std::int16_t> samples(offset);
+				samples.insert(samples.end(), signal.cbegin(), signal.cend());
+
+				audio::kernels::SampleSummary result = audio::kernels::EMPTY_SUMMARY;
+				audio::kernels::SampleSummary reference = audio::kernels::EMPTY_SUMMARY;
+				audio::kernels::summarize(samples.data() + offset, count, result);
+				audio::kernels::scalar::summarize(samples.data() + offset, count, reference);
+				if(!CHECK(result.min == reference.min && result.max == reference.max
+				          && result.sum_squares == reference.sum_squares))
+				{
+					std::cerr << "  summarize, " << count << " samples, offset " << offset
+					          << std::endl;
+					return;
+				}
+			}
+		}
+	}
+} // namespace
+
+int main()
+{
+	std::cout << "SSE2: " << simd::has_sse2() << ", AVX2: " << simd::has_avx2() << std::endl;
+	check_mix_ramp<std::int16_t>(32767.f);
+	check_mix_ramp<float>(1.f);
+	check_conversions();
+	check_summary();
+	return test_result();
+}
@@ -0,0 +1,208 @@
+//
+// Copyright (c) 2019 Maxime Pinard
+//
+// Distributed under the MIT license
+// See accompanying file LICENSE or copy at
+// https://opensource.org/licenses/MIT
+//
+// Lock-free multiple producers/single consumer shared_queue and its wake signal, under stress:
+//  - producers pushing single items, emplaced items and batches: each item is received once,
+//    in the order of its producer
+//  - ping-pong between two threads sleeping on wait() and wait(ready): a lost wake up blocks
+//    the test, stopped by a watchdog
+//
+#include "utils/shared_queue.hpp"
+#include "check.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr std::size_t PRODUCERS = 4;
+	constexpr std::uint32_t ITEMS_PER_PRODUCER = 100000;
+	constexpr std::uint32_t BATCH_SIZE = 7;
+	constexpr std::uint32_t PING_PONGS = 20000;
+	constexpr std::chrono::seconds WATCHDOG_TIMEOUT(60);
+
+	struct Item
+	{
+		std::uint32_t producer;
+		std::uint32_t sequence;
+
+		Item(std::uint32_t producer_, std::uint32_t sequence_) noexcept
+		  : producer(producer_), sequence(sequence_)
+		{
+		}
+	};
+
+	using queue_type = shared_queue<Item, true, lock_free_mpsc>;
+
+	// the three ways of pushing, in turns
+	void produce(queue_type& queue, std::uint32_t producer)
+	{
+		std::vector<Item> batch;
+		std::uint32_t sequence = 0;
+		while(sequence < ITEMS_PER_PRODUCER)
+		{
+			switch(sequence % 3)
+			{
+				case 0:
+					queue.push_back(Item(producer, sequence++));
+					break;
+				case 1:
+					queue.emplace_back(producer, sequence++);
+					break;
+				default:
+					for(std::uint32_t i = 0; i < BATCH_SIZE && sequence < ITEMS_PER_PRODUCER; ++i)
+					{
+						batch.emplace_back(producer, sequence++);
+					}
+					queue.push_back(batch.cbegin(), batch.cend());
+					batch.clear();
+					break;
+			}
+		}
+	}
+
+	void check_producers_order()
+	{
+		queue_type queue;
+		std::vector<std::thread> producers;
+		for(std::uint32_t producer = 0; producer < PRODUCERS; ++producer)
+		{
+			producers.emplace_back([&queue, producer]() { produce(queue, producer); });
+		}
+
+		// the consumer sleeps while the queue is empty, and alternates front() and drain()
+		std::array<std::uint32_t, PRODUCERS> next_sequences{};
+		std::size_t received = 0;
+		std::size_t out_of_order = 0;
+		const auto receive = [&](const Item& item) {
+			if(item.producer >= PRODUCERS || item.sequence != next_sequences[item.producer])
+			{
+				++out_of_order;
+				return;
+			}
+			++next_sequences[item.producer];
+			++received;
+		};
+		std::vector<Item> drained;
+		while(received + out_of_order < PRODUCERS * ITEMS_PER_PRODUCER)
+		{
+			queue.wait();
+			if(received % 2 == 0)
+			{
+				receive(queue.front());
+				queue.pop_front();
+				continue;
+			}
+			queue.drain(drained);
+			for(const Item& item: drained)
+			{
+				receive(item);
+			}
+			drained.clear();
+		}
+
+		for(std::thread& producer: producers)
+		{
+			producer.join();
+		}
+		CHECK(out_of_order == 0);
+		CHECK(received == PRODUCERS * ITEMS_PER_PRODUCER);
+		CHECK(queue.empty());
+		CHECK(queue.drain(drained) == 0);
+	}
+
+	void check_wake_ups()
+	{
+		// each side waits for the answer of the other before sending again
+		queue_type pings;
+		queue_type pongs;
+		std::thread ponger([&]() {
+			for(std::uint32_t i = 0; i < PING_PONGS; ++i)
+			{
+				const std::uint32_t sequence = pings.front().sequence;
+				pings.pop_front();
+				pongs.emplace_back(0, sequence);
+			}
+		});
+		std::uint32_t mismatches = 0;
+		for(std::uint32_t i = 0; i < PING_PONGS; ++i)
+		{
+			pings.emplace_back(0, i);
+			pongs.wait();
+			mismatches += pongs.front().sequence != i;
+			pongs.pop_front();
+		}
+		ponger.join();
+		CHECK(mismatches == 0);
+	}
+
+	void check_ready_wake_ups()
+	{
+		// the other source of wait(ready): a counter made true before notify()
+		queue_type queue;
+		std::atomic<std::uint32_t> counter{0};
+		std::atomic<std::uint32_t> acknowledged{0};
+		std::thread notifier([&]() {
+			for(std::uint32_t i = 1; i <= PING_PONGS; ++i)
+			{
+				counter.store(i, std::memory_order_seq_cst);
+				queue.notify();
+				while(acknowledged.load(std::memory_order_acquire) != i)
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+		std::uint32_t seen = 0;
+		while(seen < PING_PONGS)
+		{
+			queue.wait([&]() { return counter.load(std::memory_order_seq_cst) != seen; });
+			seen = counter.load(std::memory_order_seq_cst);
+			acknowledged.store(seen, std::memory_order_release);
+		}
+		notifier.join();
+		CHECK(seen == PING_PONGS);
+		CHECK(queue.empty());
+	}
+} // namespace
+
+int main()
+{
+	// a lost wake up sleeps forever
+	std::mutex mutex;
+	std::condition_variable finished_cond;
+	bool finished = false;
+	std::thread watchdog([&]() {
+		std::unique_lock<std::mutex> lock(mutex);
+		if(!finished_cond.wait_for(lock, WATCHDOG_TIMEOUT, [&]() { return finished; }))
+		{
+			std::cerr << "shared_queue test blocked, lost wake up" << std::endl;
+			std::abort();
+		}
+	});
+
+	check_producers_order();
+	check_wake_ups();
+	check_ready_wake_ups();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished = true;
+	}
+	finished_cond.notify_one();
+	watchdog.join();
+	return test_result();
+}